@@ -8,7 +8,9 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/un.h>
 #include <unistd.h>
 #include <map>
 #include <vector>
@@ -76,6 +78,73 @@ static string shell_quote(const string &value)
     return quoted;
 }
 
+// Socket of the classification server (cuCLARK --server), relative to the project root
+static string server_socket_path()
+{
+    const char *env = getenv("CUCLARK_SOCKET");
+    if (env && *env)
+        return env;
+    char cwdBuf[4096];
+    if (!getcwd(cwdBuf, sizeof(cwdBuf)))
+        return ".cuclark.sock";
+    return string(cwdBuf) + "/.cuclark.sock";
+}
+
+// Send one request line to the classification server and read its reply.
+// Returns false if no server is listening on the socket.
+static bool server_request(const string &socketPath, const string &request, string &reply)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path))
+        return false;
+    strcpy(addr.sun_path, socketPath.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1)
+        return false;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    string line = request + "\n";
+    if (send(fd, line.c_str(), line.size(), MSG_NOSIGNAL) != (ssize_t)line.size())
+    {
+        close(fd);
+        return false;
+    }
+
+    // the reply is sent when the job is done
+    reply.clear();
+    char buffer[256];
+    ssize_t n;
+    while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+        reply.append(buffer, n);
+    close(fd);
+
+    while (!reply.empty() && (reply[reply.size() - 1] == '\n' || reply[reply.size() - 1] == '\r'))
+        reply.erase(reply.size() - 1);
+    return !reply.empty();
+}
+
+// Window of the minimizers of the server's database, 0 for all k-mers
+// (also for servers that do not report it).
+// Returns false if no server is listening on the socket.
+static bool server_minimizer_window(const string &socketPath, int &window)
+{
+    string reply;
+    if (!server_request(socketPath, "PING", reply) || reply.compare(0, 2, "OK") != 0)
+        return false;
+    window = 0;
+    size_t pos = reply.find("minimizer ");
+    if (pos != string::npos)
+        window = atoi(reply.c_str() + pos + strlen("minimizer "));
+    return true;
+}
+
 static bool parse_positive_int(const string &text, int &value)
 {
     if (text.empty())
@@ -439,14 +508,16 @@ struct ClassifyOptions {
     int numDevices;         // -d, -1 = unset
     int gapIteration;       // -g, -1 = unset (script default: 4)
     string samplingFactor;  // -s, "" = unset
+    int minimizerWindow;    // --minimizer, -1 = unset (all k-mers)
     bool tsk;               // --tsk
     bool extended;          // --extended
+    bool sparse;            // --sparse
     bool gzipped;           // --gzipped
     bool verbose;           // --verbose
 
     ClassifyOptions() : isPaired(false), batchSize(32), kmerSize(-1),
         minFreqTarget(-1), numThreads(-1), numDevices(-1), gapIteration(-1),
-        tsk(false), extended(false), gzipped(false), verbose(false) {}
+        minimizerWindow(-1), tsk(false), extended(false), sparse(false), gzipped(false), verbose(false) {}
 };
 
 static int handle_classification(const ClassifyOptions &opts)
@@ -509,6 +580,39 @@ static int handle_classification(const ClassifyOptions &opts)
     else
         absResultPath = cwd + "/results/" + opts.resultFile;
 
+    // Submit to a running classification server, unless the job asks for
+    // database parameters the server may have been started without, or
+    // for another minimizer window than the server's database.
+    bool serverCompatible = opts.kmerSize <= 0 && opts.minFreqTarget < 0 &&
+        opts.gapIteration <= 0 && opts.samplingFactor.empty() && !opts.tsk;
+    int serverWindow = 0;
+    const int jobWindow = opts.minimizerWindow > 0 ? opts.minimizerWindow : 0;
+    if (serverCompatible && server_minimizer_window(server_socket_path(), serverWindow) && serverWindow != jobWindow)
+    {
+        if (opts.verbose)
+            cout << "Classification server uses " << (serverWindow > 0 ? "minimizers of windows of " + to_string(serverWindow) + " k-mers" : "all k-mers")
+                 << ", running the job locally." << endl;
+        serverCompatible = false;
+    }
+    if (serverCompatible)
+    {
+        string request = "CLASSIFY\t" + absInputFile + "\t" +
+            (opts.isPaired ? makeAbsolute(opts.pairFile) : string()) + "\t" +
+            absResultPath + "\t" + (opts.sparse ? "2" : opts.extended ? "1" : "0");
+        string reply;
+        if (server_request(server_socket_path(), request, reply))
+        {
+            if (opts.verbose)
+                cout << "Submitted to classification server: " << server_socket_path() << endl;
+            if (reply != "OK")
+            {
+                cerr << "Classification server: " << reply << endl;
+                return 1;
+            }
+            return 0;
+        }
+    }
+
     string command = "cd scripts && ./classify_metagenome.sh";
 
     if (opts.isPaired)
@@ -533,10 +637,14 @@ static int handle_classification(const ClassifyOptions &opts)
         command += " -g " + to_string(opts.gapIteration);
     if (!opts.samplingFactor.empty())
         command += " -s " + shell_quote(opts.samplingFactor);
+    if (opts.minimizerWindow > 0)
+        command += " --minimizer " + to_string(opts.minimizerWindow);
     if (opts.tsk)
         command += " --tsk";
     if (opts.extended)
         command += " --extended";
+    if (opts.sparse)
+        command += " --sparse";
     if (opts.gzipped)
         command += " --gzipped";
     if (opts.verbose)
@@ -552,6 +660,82 @@ static int handle_classification(const ClassifyOptions &opts)
     return 0;
 }
 
+static int handle_server(int argc, char *argv[])
+{
+    string socketPath = server_socket_path();
+    string reply;
+
+    for (int i = 2; i < argc; ++i)
+    {
+        string a(argv[i]);
+        if (a == "--stop" || a == "--status")
+        {
+            if (!server_request(socketPath, a == "--stop" ? "STOP" : "PING", reply))
+            {
+                cout << "No classification server running on " << socketPath << endl;
+                return a == "--stop" ? 1 : 3;
+            }
+            if (a == "--stop")
+                cout << "Classification server stopped." << endl;
+            else
+            {
+                size_t pos = reply.find("minimizer ");
+                int window = pos != string::npos ? atoi(reply.c_str() + pos + strlen("minimizer ")) : 0;
+                cout << "Classification server is running on " << socketPath
+                     << (window > 0 ? " (minimizers of windows of " + to_string(window) + " k-mers)." : ".") << endl;
+            }
+            return 0;
+        }
+    }
+
+    const string scriptPath = "./scripts/classify_metagenome.sh";
+    if (!exists_file(scriptPath))
+    {
+        cerr << "Classification script not found: " << scriptPath << endl;
+        return 1;
+    }
+    if (server_request(socketPath, "PING", reply))
+    {
+        cerr << "A classification server is already running on " << socketPath << endl;
+        return 1;
+    }
+
+    string command = "cd scripts && ./classify_metagenome.sh --light --server " + shell_quote(socketPath);
+    bool seenBatch = false;
+    for (int i = 2; i < argc; ++i)
+    {
+        string a(argv[i]);
+        int value = 0;
+        if (a == "-b" || a == "-n" || a == "-d" || a == "--minimizer")
+        {
+            if (i + 1 >= argc || !parse_positive_int(argv[i + 1], value))
+            { cerr << "Missing or invalid argument for " << a << endl; return 1; }
+            command += " " + a + " " + to_string(value);
+            seenBatch |= a == "-b";
+            ++i;
+        }
+        else if (a == "--verbose")
+            command += " --verbose";
+        else
+        {
+            cerr << "Unknown server option: " << a << endl;
+            cerr << "Usage: " << argv[0] << " -S [-b <int>] [-n <int>] [-d <int>] [--minimizer <int>] [--verbose] | -S --status | -S --stop" << endl;
+            return 1;
+        }
+    }
+    if (!seenBatch)
+        command += " -b 32";
+
+    cout << "Starting classification server on " << socketPath << " (stop with -S --stop)." << endl;
+    int rc = system(command.c_str());
+    if (rc != 0)
+    {
+        cerr << "Classification server failed with exit code " << rc << endl;
+        return 1;
+    }
+    return 0;
+}
+
 static int handle_abundance(const string &dbPath, const string &resultFile, const string &outputFile)
 {
     if (dbPath.empty())
@@ -824,7 +1008,7 @@ int main(int argc, char *argv[])
     if (argc < 2)
     {
         cerr << "Usage: " << argv[0] << " [OPTIONS]" << endl;
-        cerr << "Options: -h, --help, -v/--verify, -d <database_path>, -c -O <fastq> -R <result> [options], -a <database> <result> [-o <output>], -m <f1> <f2> [...], -r [<abundance_file>]" << endl;
+        cerr << "Options: -h, --help, -v/--verify, -d <database_path>, -c -O <fastq> -R <result> [options], -S [options], -a <database> <result> [-o <output>], -m <f1> <f2> [...], -r [<abundance_file>]" << endl;
         return 1;
     }
 
@@ -847,10 +1031,19 @@ int main(int argc, char *argv[])
         cout << "     -d <int>               Number of CUDA devices" << endl;
         cout << "     -g <int>               Gap/non-overlapping k-mers for cuCLARK-l (default: 4)" << endl;
         cout << "     -s <factor>            Sampling factor (cuCLARK only)" << endl;
+        cout << "     --minimizer <int>      Database and queries of the minimizers of windows of <int> k-mers" << endl;
         cout << "     --tsk                  Target-specific k-mer files (detailed DB creation)" << endl;
         cout << "     --extended             Extended results output" << endl;
+        cout << "     --sparse               Extended results output with the targets hit only" << endl;
         cout << "     --gzipped              Input files are gzipped" << endl;
         cout << "     --verbose              Verbose diagnostic output" << endl;
+        cout << "                            Jobs are submitted to the classification server if it is running" << endl;
+        cout << "                            (not with -k, -t, -g, -s, --minimizer or --tsk)" << endl;
+        cout << "  -S [OPTIONS]              Run classification server, the database stays loaded" << endl;
+        cout << "     -b <int>, -n <int>, -d <int>, --minimizer <int>, --verbose" << endl;
+        cout << "                            As for -c, used for all submitted jobs" << endl;
+        cout << "     --status               Check whether the server is running" << endl;
+        cout << "     --stop                 Stop the server" << endl;
         cout << "  -a <database> <result> [-o <output>]" << endl;
         cout << "                            Estimate abundance (default output: results/abundance_result.csv)" << endl;
         cout << "  -m <f1> <f2> [f3...]      Merge abundance files from split runs" << endl;
@@ -949,8 +1142,15 @@ int main(int argc, char *argv[])
                 if (i + 1 >= argc) { cerr << "Missing argument for -s" << endl; return 1; }
                 opts.samplingFactor = argv[++i];
             }
+            else if (a == "--minimizer")
+            {
+                if (i + 1 >= argc || !parse_positive_int(argv[i + 1], opts.minimizerWindow))
+                { cerr << "Missing or invalid argument for --minimizer" << endl; return 1; }
+                ++i;
+            }
             else if (a == "--tsk")     opts.tsk = true;
             else if (a == "--extended") opts.extended = true;
+            else if (a == "--sparse")   opts.sparse = true;
             else if (a == "--gzipped") opts.gzipped = true;
             else if (a == "--verbose") opts.verbose = true;
             else
@@ -974,6 +1174,11 @@ int main(int argc, char *argv[])
         return handle_classification(opts);
     }
 
+    if (arg == "-S")
+    {
+        return handle_server(argc, argv);
+    }
+
     if (arg == "-a")
     {
         if (argc < 4)
@@ -1045,6 +1250,6 @@ int main(int argc, char *argv[])
     }
 
     cerr << "Unknown argument: " << arg << endl;
-    cerr << "Usage: " << argv[0] << " -v | -d <database_path> | -c -O <fastq> -R <result> [options] | -a <database_path> <result_file> [-o <output>] | -m <f1> <f2> [...] | -r [<abundance_file>]" << endl;
+    cerr << "Usage: " << argv[0] << " -v | -d <database_path> | -c -O <fastq> -R <result> [options] | -S [options] | -a <database_path> <result_file> [-o <output>] | -m <f1> <f2> [...] | -r [<abundance_file>]" << endl;
     return 1;
 }
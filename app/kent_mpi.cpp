@@ -552,6 +552,7 @@ static NodeResult run_classification_local() {
     }
 
     // Build kent classify command: ./bin/kent -c [OPTIONS]
+    // kent submits the job to the node's classification server (kent -S) if it is running
     ostringstream cmd_ss;
     cmd_ss << "cd " << shell_escape(g_config.cuclark_dir) << " && ./bin/kent -c";
 
@@ -93,7 +93,7 @@ echo ""
 echo "4. Verifying installation..."
 REQUIRED_BINS="bin/kent"
 if [ "$CUDA_AVAILABLE" -eq 1 ]; then
-    REQUIRED_BINS="$REQUIRED_BINS bin/cuCLARK bin/cuCLARK-l bin/getTargetsDef bin/getAccssnTaxID bin/getfilesToTaxNodes bin/getAbundance"
+    REQUIRED_BINS="$REQUIRED_BINS bin/cuCLARK bin/cuCLARK-l bin/getTargetsDef bin/getAccssnTaxID bin/getfilesToTaxNodes bin/getAbundance bin/mergeDb bin/sparseToDense"
 fi
 
 ALL_FOUND=1
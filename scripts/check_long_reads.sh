@@ -0,0 +1,84 @@
+#!/bin/sh
+
+# Regression check for reads with parts longer than a part length container
+# (65535 bases): such parts are split into overlapping parts, and their
+# results do not depend on the chunk size.
+#
+# Two random targets of 20000 bases are generated, and two long reads with
+# three copies of a target each, one of them across a split of the read:
+# each read is expected to hit its target with 3 x (20000-k+1) k-mers, as
+# a k-mer lost or counted twice changes the score. The copies are whole
+# targets, so that no k-mer across their ends is in a target.
+#
+# Usage: ./check_long_reads.sh [<cuCLARK binary>]   (default: ../src/cuCLARK-cpu)
+
+BIN=${1:-../src/cuCLARK-cpu}
+K=31
+TARGETSIZE=20000
+EXPECTED=$((3 * (TARGETSIZE - K + 1)))
+DIR=`mktemp -d`
+trap 'rm -rf $DIR' EXIT
+
+if [ ! -x "$BIN" ]; then
+	echo "Cannot find the binary $BIN. Please run: make cpu (in src/)"
+	exit 1
+fi
+
+# random bases, 70 per line
+randomSeq()
+{
+	awk -v n=$1 -v seed=$2 'BEGIN { srand(seed); for (i = 1; i <= n; i++) { printf "%s", substr("ACGT", int(rand()*4)+1, 1); if (i % 70 == 0) printf "\n" } if (n % 70 != 0) printf "\n" }'
+}
+
+# bases of a target
+bases()
+{
+	grep -v '>' $DIR/target$1.fa
+}
+
+for t in 0 1; do
+	echo ">target$t" > $DIR/target$t.fa
+	randomSeq $TARGETSIZE $((t + 11)) >> $DIR/target$t.fa
+	echo "$DIR/target$t.fa T$t" >> $DIR/targets.txt
+done
+
+# read 1: 100 kb, T1 T0 T1 T0 T0, the second T0 across the first split (65535)
+# read 2: 1.4 Mb, three T1 in random bases, the first one across the second split (131040 for k=31)
+{
+	echo ">long1"
+	for t in 1 0 1 0 0; do
+		bases $t
+	done
+	echo ">long2"
+	randomSeq 120000 21
+	bases 1
+	randomSeq 400000 22
+	bases 1
+	randomSeq 400000 23
+	bases 1
+	randomSeq 420000 24
+} > $DIR/reads.fa
+
+mkdir $DIR/db
+status=0
+for chunk in 256 1; do
+	$BIN -k $K -T $DIR/targets.txt -D $DIR/db/ -O $DIR/reads.fa -R $DIR/results_$chunk -n 2 --cpu --ht-size 100003 --chunk-size $chunk > $DIR/log_$chunk 2>&1
+	if [ $? -ne 0 ]; then
+		echo "Classification failed (--chunk-size $chunk):"
+		cat $DIR/log_$chunk
+		exit 1
+	fi
+	for read in long1:T0 long2:T1; do
+		line=`grep "^${read%%:*}," $DIR/results_$chunk.csv`
+		assignment=`echo "$line" | cut -d, -f3`
+		score=`echo "$line" | cut -d, -f4`
+		if [ "$assignment" != "${read##*:}" ] || [ "$score" != "$EXPECTED" ]; then
+			echo "FAILED (--chunk-size $chunk): ${read%%:*} assigned to $assignment with score $score, expected ${read##*:} with $EXPECTED."
+			status=1
+		fi
+	done
+done
+if [ $status -eq 0 ]; then
+	echo "Long reads: OK."
+fi
+exit $status
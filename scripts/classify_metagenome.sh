@@ -29,6 +29,8 @@
 #
 #   Differences to CLARK:
 #   Deprecated some parameters and added new parameters.
+#   Compressed objects (gzip, zstd) are read directly by cuCLARK,
+#   --gzipped is kept for compatibility.
 #
 
 if [ $# -lt 2 ]; then
@@ -44,16 +46,23 @@ echo "-P <file1> <file2>,  \t paired-end reads:\t filenames.\n"
 echo "-R <fileResults>,    \t file to store results (or corresponding list of results file):\t filename.\n"
 #echo "-m <mode>,           \t mode of execution: 0 (full), 1 (default), 2 (express) or 3 (spectrum).\n"
 echo "-n <numberofthreads>,\t number of threads:\tinteger >= 1.\n"
-echo "-b <numberofbatches>,\t number of batches:\tinteger >= 1.\n";
+echo "-b <numberofbatches>,\t number of batches:\tinteger >= 1, or 'auto' to choose it from the reads and the memory.\n";
+echo "--mem-budget <MB>,   \t host memory for the reads and results of a chunk with -b auto, in MB.\n";
 echo "-d <numberofdevices>,\t number of CUDA devices to use:\tinteger >= 1.\n";
 echo "-g <iteration>,      \t gap or number of non-overlapping k-mers to pass for the database creation (for cuCLARK-l only). The default value is 4.\n"
 echo "-s <factor>,         \t sampling factor value (for cuCLARK only). \n"
+echo "--minimizer <w>,     \t to keep in the database and to query only the minimizers of windows of w consecutive k-mers (database and lookups about w/2 times smaller).\n"
+echo "--prefilter,         \t to check the k-mers of the reads with a compact filter of the database before the lookups (host queries only).\n"
+echo "--interleaved,       \t to store the label of each k-mer next to its key when the database is created (one memory access per hit).\n"
+echo "--packed,            \t to store the keys and labels of the database with the bits they need when the database is created (smaller database, decoded at each lookup).\n"
 echo "--tsk,               \t to request a detailed creation of the database (target specific k-mers files).\n"
 #echo "--ldm,               \t to request the loading of the database by memory mapped-file (in multithreaded mode, multiple parallel threads are requested).\n"
 #echo "--kso,               \t to request a preliminary k-spectrum analysis of each object (for mode 3 only).\n"
 echo "--extended,	   \t to request an extended output for the results file.\n"
+echo "--sparse,	   \t to request an extended output with the targets hit only (target:score pairs).\n"
 echo "--light		   \t to run the RAM-light variant of cuCLARK, namely cuCLARK-l.\n"
-echo "--gzipped            \t to indicate that objects are gzipped.\n"
+echo "--server <socket>    \t to keep the database loaded and classify jobs received on the Unix socket, instead of -O/-P and -R.\n"
+echo "--gzipped            \t to indicate that objects are gzipped (gzip/zstd files are also detected automatically).\n"
 exit
 fi
 
@@ -64,18 +73,9 @@ fi
 
 
 PARAMS=""
-UNRQTD=0
-FILE1="n"
-FILE2="n"
-FILE1U=""
-FILE2U=""
 VARIANT="DEFAULT"
 for param in $@
 do
-	if [ "$param" = "--gzipped" ]; then
-                UNRQTD="--gzipped"
-                continue
-        fi
 	if [ "$param" = "--light" ]; then
         	VARIANT="LIGHT"
 	fi
@@ -88,7 +88,6 @@ done
 
 for var in $@
 do
-	LV=$UNRQTD
 	if [ "$var" = "-T" ]; then
 		echo "Attempt to overwrite the targets definition: '-T <...>'."
 		echo "The targets definition cannot be reset/changed by classify_metagenome.sh." 
@@ -101,72 +100,16 @@ do
                 echo "It was previously set by set_targets.sh. \nPlease rerun classify_metagenome.sh without setting a database directory."
                 exit
         fi
-	if [ "$var" = "-O" ]; then
-		FILE1="s"
-		FILE2="n"
-		PARAMS="$PARAMS $var"
-		continue
-	fi
-	if [ "$var" = "-P" ]; then
-                FILE1="s"
-                FILE2="s"
-		PARAMS="$PARAMS $var"
-                continue
-        fi
-	if [ "$FILE1" = "s" ]; then
-                FILE1=$var
-                if [ "$LV" = "--gzipped" ]; then
-			PRE="."
-		        FILE1=$PRE$var
-			cp $var $FILE1
-			FILE1U=`echo $FILE1 | rev | cut -c 4- | rev`
-			gunzip -f $FILE1
-			PARAMS="$PARAMS $FILE1U"
-                else
-                        PARAMS="$PARAMS $var"
-                fi
-                continue
-        fi	
-	if [ "$FILE2" = "s" ]; then
-		if [ "$LV" = "--gzipped" ]; then
-                	PRE="."
-                        FILE2=$PRE$var
-                        cp $var $FILE2
-			FILE2U=`echo $FILE2 | rev | cut -c 4- | rev`
-			gunzip -f $FILE2
-			PARAMS="$PARAMS $FILE2U"
-		else
-			PARAMS="$PARAMS $var"
-		fi
-		continue
-        fi
 	if [ "$var" = "--gzipped" ] || [ "$var" = "--light" ]; then
         	continue
 	fi
 	PARAMS="$PARAMS $var"
 done
 
-if [ ! -f $FILE1U ] || [ ! -f $FILE2U ]; then
-echo "Failed to uncompress input objects."
-echo "The program must abort."
-exit
-fi
-
 if [ "$VARIANT" = "LIGHT" ]; then
 ../bin/cuCLARK-l $PARAMS
 else
 ../bin/cuCLARK $PARAMS
 fi
-RC=$?
-
-if [ "$UNRQTD" = "--gzipped" ]; then
-	if [ "$FILE1U" != "" ]; then
-		rm -f $FILE1U
-	fi
-	if [ "$FILE2U" != "" ]; then
-		rm -f $FILE2U
-	fi
-fi
-
-exit $RC
+exit $?
 
@@ -0,0 +1,760 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * Common interface of the query backends (CUDA devices or host threads).
+ * Holds the database parts (mapped database file) and the k-mer lookup
+ * shared by the query kernel and the host backend.
+ */
+
+#ifndef CLARKDB_HH
+#define CLARKDB_HH
+
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+#include "./dataType.hh"
+#include "./dbFile.hh"
+
+#define DBLOADBUCKETS	(1 << 22)	// buckets per range when loading in parallel
+
+/**
+ * Copy _bits bits of packed 64-bit words from bit _srcBit of _src to bit
+ * _dstBit of _dst (cleared before). Words at the ends of the ranges copied
+ * in parallel are shared, bits are set atomically.
+ */
+inline void copyBits(uint64_t* _dst, uint64_t _dstBit, const uint64_t* _src, uint64_t _srcBit, uint64_t _bits)
+{
+	while (_bits > 0)
+	{
+		const uint32_t n = _bits < 64 ? _bits : 64;
+		const uint64_t value = readBits(_src, _srcBit, n);
+		uint64_t* word = _dst + (_dstBit >> 6);
+		const uint32_t shift = _dstBit & 63;
+		#ifdef _OPENMP
+		#pragma omp atomic
+		#endif
+		word[0] |= value << shift;
+		if (shift + n > 64)
+		{
+			#ifdef _OPENMP
+			#pragma omp atomic
+			#endif
+			word[1] |= value >> (64 - shift);
+		}
+		_dstBit += n;
+		_srcBit += n;
+		_bits -= n;
+	}
+}
+
+/**
+ * Keys and labels of a database part in separate arrays.
+ */
+template <typename HKMERr>
+struct SplitElements
+{
+	const HKMERr*	keys;
+	const ILBL*		labels;
+
+	HOSTDEVICE SplitElements(const HKMERr* _keys, const ILBL* _labels): keys(_keys), labels(_labels)
+	{}
+
+	HOSTDEVICE HKMERr key(const size_t _i) const
+	{	return keys[_i];	}
+
+	HOSTDEVICE ILBL label(const size_t _i) const
+	{	return labels[_i];	}
+};
+
+/**
+ * Keys and labels of a database part interleaved, key|label per element
+ * in 16-bit units (elements of 4, 6 or 10 bytes are not aligned for keys).
+ */
+template <typename HKMERr>
+struct InterleavedElements
+{
+	const ILBL*		units;
+
+	HOSTDEVICE InterleavedElements(const void* _elements): units((const ILBL*) _elements)
+	{}
+
+	HOSTDEVICE HKMERr key(const size_t _i) const
+	{
+		const size_t keyUnits = sizeof(HKMERr) / sizeof(ILBL);
+		const ILBL* element = units + _i * (keyUnits + 1);
+		HKMERr key = element[0];
+		for (size_t u = 1; u < keyUnits; u++)
+		{	key |= (HKMERr) element[u] << 16*u;	}
+		return key;
+	}
+
+	HOSTDEVICE ILBL label(const size_t _i) const
+	{
+		const size_t keyUnits = sizeof(HKMERr) / sizeof(ILBL);
+		return units[_i * (keyUnits + 1) + keyUnits];
+	}
+};
+
+/**
+ * Bit widths of the packed elements of a database part (keyBits = 0 if
+ * the part is not packed), and first bit of the part in its words.
+ */
+struct DbPacking
+{
+	uint32_t	keyBits;
+	uint32_t	labelBits;
+	uint32_t	firstBit;
+};
+
+/**
+ * Keys and labels of a database part bit-packed, key|label per element.
+ */
+template <typename HKMERr>
+struct PackedElements
+{
+	const uint64_t*	words;
+	DbPacking		packing;
+
+	HOSTDEVICE PackedElements(const void* _words, const DbPacking& _packing): words((const uint64_t*) _words), packing(_packing)
+	{}
+
+	HOSTDEVICE HKMERr key(const size_t _i) const
+	{	return readBits(words, packing.firstBit + (uint64_t) _i * (packing.keyBits + packing.labelBits), packing.keyBits);	}
+
+	HOSTDEVICE ILBL label(const size_t _i) const
+	{
+		return readBits(words, packing.firstBit + (uint64_t) _i * (packing.keyBits + packing.labelBits) + packing.keyBits,
+						packing.labelBits);
+	}
+};
+
+/**
+ *  Query k-mer against a database part.
+ *  Analog to hashTable_hh find, for canonical kmer.
+ *  _bigBuckets are the big buckets of the part, numbered as in the database.
+ */
+template <typename HKMERr, typename ELEMENTS>
+HOSTDEVICE inline bool findElement (const uint8_t& k, const HtSize& _htSize, const uint64_t& _ikmer,
+		const BucketGroup* _bucketIndex, const ELEMENTS& _elements,
+		const DbBigBucket* _bigBuckets, uint32_t _numBigBuckets,
+		uint32_t dbPartStart, uint32_t dbPartEnd,
+		ILBL& _returnLabel)
+{
+	// getting canonical kmer
+	uint64_t _ikmerC = canonicalKmer(k, _ikmer);
+
+	uint64_t quotient = _htSize.quotient(_ikmerC);
+	uint64_t remainder = _ikmerC - quotient * _htSize.size;
+
+	// check for correct dbPart
+	if (remainder < dbPartStart || remainder >= dbPartEnd)
+		return false;
+	const uint64_t bucket = remainder;
+	remainder -= dbPartStart;
+
+	// anchors are relative to the start of the part (modulo 2^32)
+	const BucketGroup group = _bucketIndex[remainder / DBGROUPBUCKETS];
+	uint32_t bucketSize;
+	size_t bucketBegin = (uint32_t) (group.anchor - _bucketIndex[0].anchor)
+						 + bucketInGroup(group, remainder % DBGROUPBUCKETS, bucketSize,
+										 _bigBuckets, _numBigBuckets, bucket);
+	size_t bucketEnd = bucketBegin + bucketSize;
+
+	if(	bucketEnd-bucketBegin > 0)
+	{	// bucket not empty
+		size_t i = bucketBegin;
+		HKMERr key = _elements.key(i);
+
+		if( key > quotient || _elements.key(bucketEnd-1) < quotient)
+		{	// quotient not in range
+			return false;
+		}
+
+		if (bucketSize >= DBBIGBUCKET)
+		{	// big bucket, binary search of the first key >= quotient
+			size_t count = bucketSize;
+			while (count > 0)
+			{
+				const size_t half = count / 2;
+				if (_elements.key(i + half) < quotient)
+				{
+					i += half + 1;
+					count -= half + 1;
+				}
+				else
+					count = half;
+			}
+			if (_elements.key(i) == quotient)
+			{
+				_returnLabel = _elements.label(i);
+				return true;
+			}
+			return false;
+		}
+
+		while(key <= quotient)
+		{
+			if(key == quotient)
+			{	// key found
+				_returnLabel = _elements.label(i);
+				return true;
+			}
+			key = _elements.key(++i);
+		}
+		// key not in list
+		return false;
+	}
+
+	// bucket empty
+	return false;
+}
+
+/**
+ *  Query k-mer against a database part, in any layout.
+ *  Used by the query kernel and by the host backend.
+ *  _labels is NULL if the part is interleaved or packed, _keys are then its elements.
+ */
+template <typename HKMERr>
+HOSTDEVICE inline bool queryElement (const uint8_t& k, const HtSize& _htSize, const uint64_t& _ikmer,
+		const BucketGroup* _bucketIndex, const HKMERr* _keys, const ILBL* _labels, const DbPacking& _packing,
+		const DbBigBucket* _bigBuckets, uint32_t _numBigBuckets,
+		uint32_t dbPartStart, uint32_t dbPartEnd,
+		ILBL& _returnLabel)
+{
+	if (_packing.keyBits > 0)
+		return findElement<HKMERr>(k, _htSize, _ikmer, _bucketIndex, PackedElements<HKMERr>(_keys, _packing),
+								   _bigBuckets, _numBigBuckets, dbPartStart, dbPartEnd, _returnLabel);
+	if (_labels == NULL)
+		return findElement<HKMERr>(k, _htSize, _ikmer, _bucketIndex, InterleavedElements<HKMERr>(_keys),
+								   _bigBuckets, _numBigBuckets, dbPartStart, dbPartEnd, _returnLabel);
+	return findElement<HKMERr>(k, _htSize, _ikmer, _bucketIndex, SplitElements<HKMERr>(_keys, _labels),
+							   _bigBuckets, _numBigBuckets, dbPartStart, dbPartEnd, _returnLabel);
+}
+
+template <typename HKMERr>
+class ClarkDB
+{
+	protected:
+		uint8_t		m_k;			// kmer size
+		size_t		m_numTargets;	// targets in db
+		HtSize		m_htSize;		// buckets in db
+		size_t		m_numBatches;
+		bool		m_verbose;
+		uint32_t	m_minimizerWindow;	// only minimizers of windows of this many k-mers are queried, 0 = all k-mers
+
+		// db
+		int			m_dbParts;
+
+		// database file, mapped
+		DbFile		m_dbFile;
+		bool		m_hostCopy;		// read parts to host memory instead of using the mapping
+
+		// host pointers, into the mapped file or to m_hostAllocs
+		std::vector< const BucketGroup* >	h_bucketIndex;
+		std::vector< const HKMERr* >	h_keys;
+		std::vector< const ILBL* >		h_labels;
+		std::vector< const DbBigBucket* >	h_bigBuckets;
+		std::vector< DbPacking >		m_partPacking;
+		std::vector< void* >			m_hostAllocs;
+
+		std::vector<size_t>		m_partSize;
+		std::vector<size_t>		m_partSizeKeys;
+		std::vector<size_t>		m_partSizeLabels;
+		std::vector<uint32_t>	m_partNumBig;		// entries of the big-bucket table
+		std::vector<uint32_t>	m_partPointer;
+		std::vector<uint64_t>	m_partPointerKeys;
+
+		/**
+		 * Split the database into m_dbParts parts and fill m_partPointer.
+		 * Parts must have at least _minParts entries to keep pointers in 32 bit.
+		 */
+		virtual void divideDb(const size_t _dbSize, const size_t _minParts) = 0;
+
+		// host memory for database parts
+		virtual void* hostMalloc(const size_t _size) = 0;
+		virtual void hostFree(void* _ptr) = 0;
+
+		bool readHostDb(const char * 	_filename,
+						size_t& 		_fileSize,
+						const ITYPE& 	_modCollision
+						);
+
+		void freeHostDb();
+
+	public:
+		ClarkDB(const uint8_t _k,
+				const size_t _numBatches,
+				const size_t _numTargets,
+				const HtSize& _htSize,
+				bool _verbose = false,
+				const uint32_t _minimizerWindow = 0
+				): m_k(_k), m_numTargets(_numTargets), m_htSize(_htSize), m_numBatches(_numBatches),
+				   m_verbose(_verbose), m_minimizerWindow(_minimizerWindow), m_dbParts(0), m_hostCopy(false)
+		{}
+
+		virtual ~ClarkDB() {}
+
+		virtual void freeBatchMemory() = 0;
+
+		virtual size_t malloc(	size_t _numReads,
+								size_t _maxReads,
+								size_t _maxReadsInContainers,
+								std::vector<ITYPE>& _indexBatches,
+								RESULTS* &_fullResults,
+								size_t _resultRowSize,
+								RESULTS* &_finalResults,
+								size_t _finalResultsRowSize,
+								bool _isExtended,
+								std::vector<uint32_t*>& _readsPointer,
+								std::vector<CONTAINER*>& _readsInCon
+								) = 0;
+
+		virtual bool sync() = 0;
+
+		virtual bool waitForBatch(size_t i) = 0;
+
+		virtual bool checkBatch(size_t i) = 0;
+
+		virtual bool read(	const char * 	_filename,
+							size_t& 		_fileSize,
+							size_t& 		_dbParts,
+							const ITYPE& 	_modCollision = 1
+							) = 0;
+
+		virtual bool swapDbParts() = 0;
+
+		virtual bool readyBatch(const size_t _batchId,
+								const size_t _numReads,
+								const size_t _containerCount
+								) = 0;
+
+		virtual bool queryBatch(const size_t _batchId,
+								const bool _isExtended,
+								const bool _isFollowup=false
+								) = 0;
+
+		virtual bool getFinalResult(const size_t _batchId,
+									RESULTS* _finalResult
+									) = 0;
+};
+
+/**
+ * Map the database file and divide it into parts (divideDb).
+ * Without sampling, the parts are the sections of the file: used
+ * in place, or read to host memory by parallel preads (m_hostCopy).
+ * With sampling (_modCollision > 1), the chosen buckets are
+ * copied to host memory, in parallel by ranges of buckets.
+ * Databases of the former format are converted first.
+ */
+template <typename HKMERr>
+bool ClarkDB<HKMERr>::readHostDb(const char * _filename, size_t& _fileSize, const ITYPE& _modCollision)
+{
+	std::string dbFile = std::string(_filename) + ".db";
+
+	if (!DbFile::exists(dbFile.c_str()) && legacyDbExists(_filename))
+	{
+		if (!convertLegacyDb(_filename, m_k, sizeof(HKMERr), m_htSize.size, m_numTargets))
+			return false;
+	}
+	if (!DbFile::exists(dbFile.c_str()))
+	{	// recovered from the targets-specific k-mers files, if any
+		std::cerr << "Failed to open " << dbFile << std::endl;
+		return false;
+	}
+	if (!m_dbFile.open(dbFile.c_str()))
+	{
+		std::cerr << "Please delete the database files to rebuild the database." << std::endl;
+		exit(1);
+	}
+	if (!m_dbFile.matches(m_k, sizeof(HKMERr), m_htSize.size, m_numTargets))
+	{
+		std::cerr << "Please delete the database files to rebuild the database." << std::endl;
+		exit(1);
+	}
+
+	const BucketGroup* index = m_dbFile.index();
+	// interleaved and packed parts have no labels, their keys are the elements
+	const DbLayout layout = m_dbFile.layout();
+	const bool interleaved = layout != DBSPLIT;
+	const bool packed = layout == DBPACKED;
+	const size_t elementBytes = m_dbFile.elementBytes();
+	const uint32_t elementBits = m_dbFile.elementBits();
+	const uint8_t* keys = m_dbFile.keys();
+	const ILBL* labels = m_dbFile.labels();
+	DbPacking packing = {m_dbFile.header().keyBits, m_dbFile.header().labelBits, 0};
+
+	bool allCollision = _modCollision <= 1;
+
+	uint64_t nbElements = 0, nbBigBuckets = 0;
+	std::vector<uint8_t>	choice;
+
+	if (allCollision)
+	{
+		nbElements = m_dbFile.header().numElements;
+		nbBigBuckets = m_dbFile.header().numBigBuckets;
+	}
+	else
+	{
+		// count nonempty buckets per range, prefix scan gives
+		// the index of the first nonempty bucket of each range
+		const size_t numRanges = (m_htSize.size-1) / DBLOADBUCKETS + 1;
+		std::vector<uint64_t> nonZero(numRanges+1, 0), chosen(numRanges, 0), chosenBig(numRanges, 0);
+
+		#ifdef _OPENMP
+		#pragma omp parallel for schedule(dynamic)
+		#endif
+		for (size_t r = 0; r < numRanges; r++)
+		{
+			size_t last = std::min<size_t>((r+1)*DBLOADBUCKETS, m_htSize.size);
+			for (size_t i = r*DBLOADBUCKETS; i < last; i++)
+				nonZero[r+1] += m_dbFile.size(i) != 0;
+		}
+		for (size_t r = 0; r < numRanges; r++)
+			nonZero[r+1] += nonZero[r];
+
+		// choose buckets and count chosen elements
+		choice.assign(m_htSize.size, 0);
+		#ifdef _OPENMP
+		#pragma omp parallel for schedule(dynamic)
+		#endif
+		for (size_t r = 0; r < numRanges; r++)
+		{
+			uint64_t nbNonZeroBuckets = nonZero[r];
+			size_t last = std::min<size_t>((r+1)*DBLOADBUCKETS, m_htSize.size);
+			for (size_t i = r*DBLOADBUCKETS; i < last; i++)
+			{
+				uint32_t bucketSize = m_dbFile.size(i);
+				if (bucketSize > 0)
+				{
+					nbNonZeroBuckets++;
+					// 2 = keep, 1 = skip, 0 = empty
+					choice[i] = (nbNonZeroBuckets % _modCollision) == 0 ? 2: 1;
+					if (choice[i] == 2)
+					{
+						chosen[r] += bucketSize;
+						chosenBig[r] += bucketSize >= DBBIGBUCKET;
+					}
+				}
+			}
+		}
+		for (size_t r = 0; r < numRanges; r++)
+		{
+			nbElements += chosen[r];
+			nbBigBuckets += chosenBig[r];
+		}
+	}
+
+	// calculate total size
+	_fileSize = (m_htSize.size + DBGROUPBUCKETS - 1) / DBGROUPBUCKETS;
+	// bucket index: 8 bit size per bucket, 32 bit anchor per group
+	_fileSize *= sizeof(BucketGroup);
+	// size of keys and labels
+	size_t _fileSizeKeys   = packed ? packedBytes(nbElements, elementBits) : nbElements * sizeof(HKMERr);
+	size_t _fileSizeLabels = packed ? 0 : nbElements * sizeof(ILBL);
+	// sizes of buckets of DBBIGBUCKET or more elements
+	_fileSize += nbBigBuckets * sizeof(DbBigBucket);
+	// total database size
+	_fileSize = _fileSize + _fileSizeKeys + _fileSizeLabels;
+	if (m_verbose) std::cerr << "Total DB size in RAM:\t" << _fileSize/1000000/1000.0 << " GB\n";
+
+	/// divide into parts
+	size_t minParts = (nbElements/(uint32_t)-1)+1;
+	divideDb(_fileSize, minParts);
+	// parts start with a group of buckets
+	for(int i = 1; i < m_dbParts ; i++)
+	{
+		m_partPointer[i] -= m_partPointer[i] % DBGROUPBUCKETS;
+	}
+#ifdef DEBUG_DB
+	for(int i = 0; i <= m_dbParts ; i++)
+	{
+		std::cerr << "m_partPointer " << i << ": " << m_partPointer[i] << " \n";
+	}
+#endif
+
+	// pointers for each part
+	h_bucketIndex.resize(m_dbParts);
+	h_keys.resize(m_dbParts);
+	h_labels.resize(m_dbParts);
+	h_bigBuckets.resize(m_dbParts);
+	m_partPacking.assign(m_dbParts, packing);
+
+	// sizes for each part
+	m_partSize.resize(m_dbParts);
+	m_partSizeKeys.resize(m_dbParts);
+	m_partSizeLabels.resize(m_dbParts);
+	m_partNumBig.resize(m_dbParts);
+
+	m_partPointerKeys.resize(m_dbParts+1);
+
+	if (allCollision)
+	{	// parts are sections of the file
+		const DbBigBucket* bigBuckets = m_dbFile.bigBuckets();
+		const uint32_t numBigBuckets = m_dbFile.header().numBigBuckets;
+		std::vector<uint32_t> partBig(m_dbParts+1);
+		std::vector<uint64_t> keysBegin(m_dbParts);
+		for (int i=0; i<=m_dbParts; i++)
+		{
+			m_partPointerKeys[i] = m_dbFile.offset(m_partPointer[i]);
+			partBig[i] = findBigBucket(bigBuckets, numBigBuckets, m_partPointer[i]);
+		}
+		for (int i=0; i<m_dbParts; i++)
+		{
+			size_t numBuckets = m_partPointer[i+1]-m_partPointer[i];
+			uint64_t numElements = m_partPointerKeys[i+1]-m_partPointerKeys[i];
+			if (numElements >= (uint32_t)-1)
+			{
+				std::cerr << "Bucket pointer overflow. Abort.\n";
+				exit(1);
+			}
+			m_partSize[i]		= (numBuckets + DBGROUPBUCKETS - 1) / DBGROUPBUCKETS * sizeof(BucketGroup);
+			keysBegin[i]		= m_partPointerKeys[i] * elementBytes;
+			m_partSizeKeys[i]	= numElements * elementBytes;
+			m_partSizeLabels[i]	= interleaved ? 0 : numElements * sizeof(ILBL);
+			if (packed)
+			{	// from the word of the first element
+				const uint64_t firstBit = m_partPointerKeys[i] * elementBits;
+				keysBegin[i]		= firstBit / 64 * sizeof(uint64_t);
+				m_partPacking[i].firstBit = firstBit % 64;
+				m_partSizeKeys[i]	= (firstBit % 64 + numElements * elementBits + 63) / 64 * sizeof(uint64_t);
+			}
+
+			h_bucketIndex[i]	= index + m_partPointer[i] / DBGROUPBUCKETS;
+			h_keys[i]			= (const HKMERr*) (keys + keysBegin[i]);
+			h_labels[i]			= interleaved ? NULL : labels + m_partPointerKeys[i];
+			h_bigBuckets[i]		= bigBuckets + partBig[i];
+			m_partNumBig[i]		= partBig[i+1] - partBig[i];
+		}
+
+		if (m_hostCopy)
+		{	// read all parts at once
+			const DbHeader& header = m_dbFile.header();
+			std::vector<DbRange> ranges;
+			for (int i=0; i<m_dbParts; i++)
+			{
+				DbRange range;
+				range.pos	= header.indexPos + m_partPointer[i] / DBGROUPBUCKETS * sizeof(BucketGroup);
+				range.size	= m_partSize[i];
+				range.dest	= hostMalloc(m_partSize[i]);
+				h_bucketIndex[i] = (const BucketGroup*) range.dest;
+				ranges.push_back(range);
+
+				range.pos	= header.keysPos + keysBegin[i];
+				range.size	= m_partSizeKeys[i];
+				range.dest	= hostMalloc(m_partSizeKeys[i]);
+				h_keys[i] = (const HKMERr*) range.dest;
+				ranges.push_back(range);
+
+				if (!interleaved)
+				{
+					range.pos	= header.labelsPos + m_partPointerKeys[i]*sizeof(ILBL);
+					range.size	= m_partSizeLabels[i];
+					range.dest	= hostMalloc(m_partSizeLabels[i]);
+					h_labels[i] = (const ILBL*) range.dest;
+					ranges.push_back(range);
+				}
+
+				if (m_partNumBig[i] > 0)
+				{
+					range.pos	= header.bigBucketsPos + partBig[i]*sizeof(DbBigBucket);
+					range.size	= m_partNumBig[i]*sizeof(DbBigBucket);
+					range.dest	= hostMalloc(range.size);
+					h_bigBuckets[i] = (const DbBigBucket*) range.dest;
+					ranges.push_back(range);
+				}
+				else
+				{
+					h_bigBuckets[i] = NULL;
+				}
+			}
+			for (size_t r=0; r<ranges.size(); r++)
+			{
+				m_hostAllocs.push_back(ranges[r].dest);
+			}
+			if (!m_dbFile.read(ranges))
+			{
+				exit(1);
+			}
+			m_dbFile.close();
+		}
+		else
+		{
+			m_dbFile.populate();
+		}
+	}
+	else
+	{	// copy chosen buckets
+		m_partPointerKeys[0] = 0;
+		for (int i=0; i<m_dbParts; i++)
+		{
+			size_t numBuckets = m_partPointer[i+1]-m_partPointer[i];
+			m_partSize[i] = (numBuckets + DBGROUPBUCKETS - 1) / DBGROUPBUCKETS * sizeof(BucketGroup);
+			BucketGroup* bucketIndex = (BucketGroup*) hostMalloc(m_partSize[i]);
+			m_hostAllocs.push_back(bucketIndex);
+			memset(bucketIndex, 0, m_partSize[i]);
+
+			// chosen elements per range of buckets, prefix scan
+			// gives the position of each range in the part
+			const size_t numRanges = numBuckets / DBLOADBUCKETS + 1;
+			std::vector<uint64_t> rangeStart(numRanges+1, 0);
+
+			#ifdef _OPENMP
+			#pragma omp parallel for schedule(dynamic)
+			#endif
+			for (size_t r = 0; r < numRanges; r++)
+			{
+				size_t first = m_partPointer[i] + r*DBLOADBUCKETS;
+				size_t last = std::min<size_t>(first + DBLOADBUCKETS, m_partPointer[i+1]);
+				for (size_t j = first; j < last; j++)
+				{
+					if (choice[j] == 2)
+						rangeStart[r+1] += m_dbFile.size(j);
+				}
+			}
+			for (size_t r = 0; r < numRanges; r++)
+				rangeStart[r+1] += rangeStart[r];
+
+			const uint64_t numElements = rangeStart[numRanges];
+			if (numElements >= (uint32_t)-1)
+			{
+				std::cerr << "Bucket pointer overflow. Abort.\n";
+				exit(1);
+			}
+			m_partSizeKeys[i]   = packed ? packedBytes(numElements, elementBits) : numElements * elementBytes;
+			m_partSizeLabels[i] = interleaved ? 0 : numElements * sizeof(ILBL);
+			m_partPointerKeys[i+1] = m_partPointerKeys[i] + numElements;
+
+			uint8_t* partKeys = (uint8_t*) hostMalloc(m_partSizeKeys[i]);
+			ILBL* partLabels = NULL;
+			m_hostAllocs.push_back(partKeys);
+			if (packed)
+				memset(partKeys, 0, m_partSizeKeys[i]);
+			if (!interleaved)
+			{
+				partLabels = (ILBL*) hostMalloc(m_partSizeLabels[i]);
+				m_hostAllocs.push_back(partLabels);
+			}
+			std::vector< std::vector<DbBigBucket> > rangeBig(numRanges);
+
+			#ifdef _OPENMP
+			#pragma omp parallel for schedule(dynamic)
+			#endif
+			for (size_t r = 0; r < numRanges; r++)
+			{
+				size_t first = m_partPointer[i] + r*DBLOADBUCKETS;
+				size_t last = std::min<size_t>(first + DBLOADBUCKETS, m_partPointer[i+1]);
+				uint64_t src = m_dbFile.offset(first);
+				uint32_t dst = rangeStart[r];
+				for (size_t j = first; j < last; j++)
+				{
+					uint32_t bucketSize = m_dbFile.size(j);
+					size_t bucket = j - m_partPointer[i];
+					BucketGroup& group = bucketIndex[bucket / DBGROUPBUCKETS];
+					if (bucket % DBGROUPBUCKETS == 0)
+						group.anchor = dst;
+					if (choice[j] == 2)
+					{
+						if (packed)
+							copyBits((uint64_t*) partKeys, (uint64_t) dst*elementBits, (const uint64_t*) keys,
+									 src*elementBits, (uint64_t) bucketSize*elementBits);
+						else
+							memcpy(partKeys + dst*elementBytes, keys + src*elementBytes, bucketSize*elementBytes);
+						if (!interleaved)
+							memcpy(partLabels + dst, labels + src, bucketSize*sizeof(ILBL));
+						uint32_t sizeByte = bucketSize;
+						if (bucketSize >= DBBIGBUCKET)
+						{
+							DbBigBucket big = {(uint32_t) j, bucketSize};
+							rangeBig[r].push_back(big);
+							sizeByte = DBBIGBUCKET;
+						}
+						group.sizes[bucket % DBGROUPBUCKETS / 4] |= sizeByte << 8*(bucket % 4);
+						dst += bucketSize;
+					}
+					src += bucketSize;
+				}
+			}
+
+			// big-bucket table of the part, ranges in order
+			m_partNumBig[i] = 0;
+			for (size_t r = 0; r < numRanges; r++)
+				m_partNumBig[i] += rangeBig[r].size();
+			DbBigBucket* partBig = NULL;
+			if (m_partNumBig[i] > 0)
+			{
+				partBig = (DbBigBucket*) hostMalloc(m_partNumBig[i]*sizeof(DbBigBucket));
+				m_hostAllocs.push_back(partBig);
+				DbBigBucket* next = partBig;
+				for (size_t r = 0; r < numRanges; r++)
+					next = std::copy(rangeBig[r].begin(), rangeBig[r].end(), next);
+			}
+
+			h_bucketIndex[i]	= bucketIndex;
+			h_keys[i]			= (const HKMERr*) partKeys;
+			h_labels[i]			= partLabels;
+			h_bigBuckets[i]		= partBig;
+		}
+		// the copies are used from now on
+		m_dbFile.close();
+	}
+
+#ifdef DEBUG_DB
+	for (int i=0; i<m_dbParts; i++)
+	{
+		std::cerr << i+1 << "/" << (int)m_dbParts << " database: "
+					<< m_partPointerKeys[i+1]-m_partPointerKeys[i] << " elements, "
+					<< (m_partSize[i]+m_partSizeKeys[i]+m_partSizeLabels[i])/1000/1000.0
+					<< " MB\n";
+
+		std::cerr << "Index: " << m_partSize[i]/1000/1000.0
+				  << " MB\t Keys: " << m_partSizeKeys[i]/1000/1000.0
+				  << " MB\t Labels: " << m_partSizeLabels[i]/1000/1000.0
+				  << " MB\n";
+	}
+#endif
+	return true;
+}
+
+/**
+ * Free database parts in host memory and unmap the database file.
+ * Called by the destructors of the backends (hostFree is virtual).
+ */
+template <typename HKMERr>
+void ClarkDB<HKMERr>::freeHostDb()
+{
+	for (size_t i=0; i<m_hostAllocs.size(); i++)
+	{
+		hostFree(m_hostAllocs[i]);
+	}
+	m_hostAllocs.clear();
+	m_dbFile.close();
+	m_dbParts = 0;
+}
+
+#endif
@@ -0,0 +1,444 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * Host backend for systems without CUDA devices.
+ */
+
+#include "CpuClarkDB.hh"
+#include "minimizer.hh"
+
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>	// memcpy
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * Constructor:
+ * Initialize variables
+ */
+template <typename HKMERr>
+CpuClarkDB<HKMERr>::CpuClarkDB(const uint8_t _k, const size_t _numBatches, const size_t _numTargets, const HtSize& _htSize, bool _verbose,
+							  const uint32_t _minimizerWindow, const bool _prefilter)
+							: ClarkDB<HKMERr>(_k, _numBatches, _numTargets, _htSize, _verbose, _minimizerWindow),
+							  m_cycleDone(false), m_resultRowSize(0), m_finalResultsRowSize(0), m_prefilter(_prefilter)
+{
+	m_numReads.resize(m_numBatches);
+	m_containerCount.resize(m_numBatches);
+
+	h_readsPointer.assign(m_numBatches, nullptr);
+	h_readsInContainers.assign(m_numBatches, nullptr);
+
+	h_results.resize(m_numBatches);
+	h_resultsFinal.resize(m_numBatches);
+
+	if (m_verbose) std::cerr << "Querying on the host (CPU).\n";
+}
+
+/**
+ * Destructor:
+ * Free memory allocations
+ */
+template <typename HKMERr>
+CpuClarkDB<HKMERr>::~CpuClarkDB()
+{
+	this->freeHostDb();
+}
+
+template <typename HKMERr>
+void* CpuClarkDB<HKMERr>::hostMalloc(const size_t _size)
+{
+	void* ptr = std::malloc(_size > 0 ? _size : 1);
+	if (ptr == nullptr)
+	{
+		std::cerr << "ERROR: Out of host memory for the database.\n";
+		exit(1);
+	}
+	return ptr;
+}
+
+template <typename HKMERr>
+void CpuClarkDB<HKMERr>::hostFree(void* _ptr)
+{
+	std::free(_ptr);
+}
+
+/**
+ * All parts stay in host memory.
+ * Only split as far as needed to keep bucket pointers in 32 bit.
+ */
+template <typename HKMERr>
+void CpuClarkDB<HKMERr>::divideDb(const size_t _dbSize, const size_t _minParts)
+{
+	m_dbParts = _minParts;
+
+	m_partPointer.resize(m_dbParts+1);
+	m_partPointer[0] = 0;
+	for(int i = 1; i < m_dbParts ; i++)
+	{
+		m_partPointer[i] = m_htSize.size * i / m_dbParts;
+	}
+	m_partPointer[m_dbParts] = m_htSize.size;
+}
+
+/**
+ * Reset memory allocations before new input file.
+ */
+template <typename HKMERr>
+void CpuClarkDB<HKMERr>::freeBatchMemory()
+{
+	for (int i=0; i<m_numBatches; i++)
+	{
+		std::free(h_readsPointer[i]);
+		std::free(h_readsInContainers[i]);
+		h_readsPointer[i] = nullptr;
+		h_readsInContainers[i] = nullptr;
+	}
+
+	if (m_numBatches > 0)
+	{
+		std::free(h_results[0]);
+		std::free(h_resultsFinal[0]);
+	}
+}
+
+/**
+ * Allocate host memory for batch data and results.
+ */
+template <typename HKMERr>
+size_t CpuClarkDB<HKMERr>::malloc(size_t _numReads,
+						size_t _maxReads, size_t _maxReadsInContainers,
+						std::vector<ITYPE>& _indexBatches,
+						RESULTS* &_fullResults,	size_t _resultRowSize,
+						RESULTS* &_finalResults, size_t _finalResultsRowSize,
+						bool _isExtended,
+						std::vector<uint32_t*>& _readsPointer,
+						std::vector<CONTAINER*>& _readsInCon)
+{
+	m_resultRowSize			= _resultRowSize;
+	m_finalResultsRowSize	= _finalResultsRowSize;
+
+	size_t total = 0;
+
+	size_t sizeReadsPointer			= (_maxReads+1)*sizeof(uint32_t),
+		   sizeReadsInContainers	= _maxReadsInContainers*sizeof(CONTAINER);
+
+	for (int i=0; i<m_numBatches; i++)
+	{
+		h_readsPointer[i] = (uint32_t*) std::malloc(sizeReadsPointer);
+		h_readsInContainers[i] = (CONTAINER*) std::malloc(sizeReadsInContainers);
+		if (h_readsPointer[i] == nullptr || h_readsInContainers[i] == nullptr)
+		{
+			std::cerr << "ERROR: Out of host memory.\n"
+					  << "Please increase the number of batches "
+					  << "(-b <numberofbatches>).\n";
+			exit(1);
+		}
+	}
+	_readsPointer = h_readsPointer;
+	_readsInCon = h_readsInContainers;
+
+	total += (sizeReadsPointer + sizeReadsInContainers)*m_numBatches;
+
+	// full results are only kept for the extended output
+	_fullResults = nullptr;
+	if (_isExtended)
+	{
+		_fullResults = (RESULTS*) std::malloc(_resultRowSize*sizeof(RESULTS)*_numReads);
+		total += _resultRowSize*sizeof(RESULTS)*_numReads;
+	}
+
+	_finalResults = nullptr;
+	if (_finalResultsRowSize > 0)
+	{
+		_finalResults = (RESULTS*) std::malloc(_finalResultsRowSize*sizeof(RESULTS)*_numReads);
+		total += _finalResultsRowSize*sizeof(RESULTS)*_numReads;
+	}
+
+	for (int i=0; i<m_numBatches; i++)
+	{
+		h_results[i] = _fullResults ? _fullResults+_resultRowSize*_indexBatches[i] : nullptr;
+		h_resultsFinal[i] = _finalResults+_finalResultsRowSize*_indexBatches[i];
+	}
+
+#ifdef DEBUG_HMEM
+	std::cerr << "Host memory for batch data and results: \t" << total/1000/1000.0<< " MB\n";
+#endif
+	return total;
+}
+
+/**
+ * Batches are queried synchronously, nothing to wait for.
+ */
+template <typename HKMERr>
+bool CpuClarkDB<HKMERr>::sync()
+{
+	return true;
+}
+
+template <typename HKMERr>
+bool CpuClarkDB<HKMERr>::waitForBatch(size_t batchId)
+{
+	return true;
+}
+
+template <typename HKMERr>
+bool CpuClarkDB<HKMERr>::checkBatch(size_t batchId)
+{
+	return true;
+}
+
+/**
+ * Read database from files to host memory.
+ */
+template <typename HKMERr>
+bool CpuClarkDB<HKMERr>::read (const char * _filename, size_t& _fileSize, size_t& _dbParts, const ITYPE& _modCollision)
+{
+	if (!this->readHostDb(_filename, _fileSize, _modCollision))
+		return false;
+
+	// the filter of the whole database also holds for a sampled one
+	if (m_prefilter && !m_filter.load((std::string(_filename) + ".db").c_str(), (std::string(_filename) + ".bf").c_str(), m_verbose))
+		std::cerr << "Querying without the prefilter.\n";
+
+	// the whole database is queried in a single cycle
+	_dbParts = 1;
+
+	if (m_verbose)
+		std::cerr << "DB loaded in RAM.\n";
+	else
+		std::cerr << "CuCLARK initialized.\n";
+
+	return true;
+}
+
+/**
+ *  There is only one cycle: the first call "loads" it, the next one resets.
+ */
+template <typename HKMERr>
+bool CpuClarkDB<HKMERr>::swapDbParts ()
+{
+	if (m_cycleDone)
+	{
+		// reset for possible next file
+		m_cycleDone = false;
+		return false;
+	}
+	m_cycleDone = true;
+	return true;
+}
+
+/**
+ *  Set all parameters for a batch
+ */
+template <typename HKMERr>
+bool CpuClarkDB<HKMERr>::readyBatch (const size_t _batchId, const size_t _numReads, const size_t _containerCount)
+{
+	m_numReads[_batchId] = _numReads;
+	m_containerCount[_batchId] = _containerCount;
+
+	return true;
+}
+
+/**
+ * 	Query a prepared batch against all database parts,
+ * 	calculate final results.
+ * 	Returns true since results are final after one cycle.
+ */
+template <typename HKMERr>
+bool CpuClarkDB<HKMERr>::queryBatch (const size_t _batchId, const bool _isExtended, const bool _isFollowup)
+{
+	const size_t numReads = m_numReads[_batchId];
+	const uint32_t* readsPointer = h_readsPointer[_batchId];
+	const CONTAINER* readsInContainers = h_readsInContainers[_batchId];
+
+	// runs in parallel if called outside of a parallel region,
+	// otherwise each host thread handles its own batch
+	#ifdef _OPENMP
+	#pragma omp parallel
+	#endif
+	{
+		std::vector<uint16_t>	targetHits(m_numTargets, 0);
+		std::vector<ILBL>		targetsHit;
+		std::vector<RESULTS>	scoresRow(m_resultRowSize);
+
+		#ifdef _OPENMP
+		#pragma omp for schedule(dynamic,1024)
+		#endif
+		for (size_t r=0; r<numReads; r++)
+		{
+			RESULTS* row = _isExtended ? h_results[_batchId] + r*m_resultRowSize : &scoresRow[0];
+
+			queryRead(readsPointer+r, readsInContainers, targetHits, targetsHit, row);
+
+			resultRow(row, h_resultsFinal[_batchId] + r*m_finalResultsRowSize);
+		}
+	}
+	return true;
+}
+
+/**
+ *  Copy final results of a finished batch.
+ */
+template <typename HKMERr>
+bool CpuClarkDB<HKMERr>::getFinalResult (const size_t _batchId, RESULTS* _finalResult)
+{
+	memcpy(_finalResult, h_resultsFinal[_batchId], m_finalResultsRowSize*sizeof(RESULTS)*m_numReads[_batchId]);
+	return true;
+}
+
+/**
+ * Queries a read against all database parts, cf. queryKernel.
+ *
+ * Constructs every kmer of each part of the read
+ * (with --minimizer, only the minimizers are queried,
+ * with --prefilter, only kmers that pass the filter),
+ * counts hits per target,
+ * stores non zero scores ordered by target.
+ */
+template <typename HKMERr>
+void CpuClarkDB<HKMERr>::queryRead(const uint32_t* _readsPointer, const CONTAINER* _readsInContainers,
+				std::vector<uint16_t>& _targetHits, std::vector<ILBL>& _targetsHit,
+				RESULTS* _resultRow) const
+{
+	const size_t nucsPerCon = sizeof(CONTAINER)*4;
+	const uint64_t cutoff = (uint64_t)-1 >> (64 - 2*m_k);
+
+	uint32_t partPointer = _readsPointer[0];
+	uint32_t readEnd = _readsPointer[1];
+
+	_targetsHit.clear();
+	MinimizerWindow window(m_minimizerWindow);
+
+	while(partPointer < readEnd)
+	{
+		CONTAINER partLength = _readsInContainers[partPointer];
+		const CONTAINER* part = &_readsInContainers[++partPointer];
+		partPointer += (partLength-1) / nucsPerCon +1;
+		// a part past the read is not read
+		if (partPointer > readEnd)
+			break;
+
+		uint64_t kmer = 0, query;
+		window.reset();
+		for (size_t n=0; n<partLength; n++)
+		{
+			// nucleotides are stored from the most significant bits on
+			CONTAINER nuc = part[n/nucsPerCon] >> 2*(nucsPerCon-1-n%nucsPerCon);
+			kmer = ((kmer << 2) | (nuc & 3)) & cutoff;
+
+			if (n+1 < m_k) continue;
+
+			query = canonicalKmer(m_k, kmer);
+			if (m_minimizerWindow > 0 && !window.push(query, query))
+				continue;
+			if (!m_filter.isEmpty() && !m_filter.contains(query))
+				continue;
+
+			ILBL target;
+			for (int p=0; p<m_dbParts; p++)
+			{
+				if (queryElement(m_k, m_htSize, query, h_bucketIndex[p], h_keys[p], h_labels[p], m_partPacking[p],
+								 h_bigBuckets[p], m_partNumBig[p],
+								 m_partPointer[p], m_partPointer[p+1], target))
+				{
+					if (_targetHits[target]++ == 0)
+						_targetsHit.push_back(target);
+					break;
+				}
+			}
+		}
+	}
+
+	// store nonzeros with index, ordered by target
+	std::sort(_targetsHit.begin(), _targetsHit.end());
+
+	size_t maxTargets = (m_resultRowSize-1)/2;
+	if (_targetsHit.size() > maxTargets)
+	{
+		std::cerr << "Too many different tagets hit by a sequence. Results will be corrupted.\n";
+	}
+	size_t count = 0;
+	for (size_t i=0; i<_targetsHit.size(); i++)
+	{
+		if (count < maxTargets)
+		{
+			_resultRow[2*count+1] = _targetsHit[i];
+			_resultRow[2*count+2] = _targetHits[_targetsHit[i]];
+			count++;
+		}
+		_targetHits[_targetsHit[i]] = 0;
+	}
+	_resultRow[0] = count;
+}
+
+/**
+ * Find best, second best and sum of scores for a read, cf. resultKernel.
+ */
+template <typename HKMERr>
+void CpuClarkDB<HKMERr>::resultRow(const RESULTS* _scoresRow, RESULTS* _resultsRow) const
+{
+	RESULTS best = 0, s_best = 0;
+	RESULTS indexBest = 0, index_sBest = 0;
+	RESULTS sumN = 0;
+
+	RESULTS count = _scoresRow[0];
+	RESULTS targetScore;
+
+	for(int i=0; i<count; ++i)
+	{
+		targetScore = _scoresRow[2*i+2];
+
+		// new best, update best and second best
+		if (targetScore > best)
+		{
+			s_best = best;
+			index_sBest = indexBest;
+			best = targetScore;
+			indexBest = _scoresRow[2*i+1] + 1;
+		}
+		// new second best, update
+		else if (targetScore > s_best)
+		{
+			s_best = targetScore;
+			index_sBest = _scoresRow[2*i+1] + 1;
+		}
+		sumN += targetScore;
+	}
+
+	_resultsRow[0] = sumN;
+	_resultsRow[1] = indexBest;
+	_resultsRow[2] = best;
+	_resultsRow[3] = index_sBest;
+	_resultsRow[4] = s_best;
+}
+
+// instantiations
+template class CpuClarkDB<uint16_t>;
+template class CpuClarkDB<uint32_t>;
+template class CpuClarkDB<uint64_t>;
@@ -0,0 +1,149 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * Host backend for systems without CUDA devices.
+ * Queries batches with OpenMP threads, following queryKernel and resultKernel,
+ * and produces the same result rows as the GPU backend.
+ */
+
+#ifndef CPUCLARKDB_HH
+#define CPUCLARKDB_HH
+
+#include <vector>
+#include "./dataType.hh"
+#include "./ClarkDB.hh"
+#include "./dbFilter.hh"
+
+template <typename HKMERr>
+class CpuClarkDB : public ClarkDB<HKMERr>
+{
+	private:
+		using ClarkDB<HKMERr>::m_k;
+		using ClarkDB<HKMERr>::m_htSize;
+		using ClarkDB<HKMERr>::m_numTargets;
+		using ClarkDB<HKMERr>::m_numBatches;
+		using ClarkDB<HKMERr>::m_verbose;
+		using ClarkDB<HKMERr>::m_minimizerWindow;
+		using ClarkDB<HKMERr>::m_dbParts;
+		using ClarkDB<HKMERr>::h_bucketIndex;
+		using ClarkDB<HKMERr>::h_keys;
+		using ClarkDB<HKMERr>::h_labels;
+		using ClarkDB<HKMERr>::m_partPacking;
+		using ClarkDB<HKMERr>::h_bigBuckets;
+		using ClarkDB<HKMERr>::m_partNumBig;
+		using ClarkDB<HKMERr>::m_partPointer;
+
+		// all parts stay in host memory, there is only one cycle
+		bool		m_cycleDone;
+
+		std::vector<uint32_t*>	h_readsPointer;
+		std::vector<CONTAINER*>	h_readsInContainers;
+
+		std::vector<size_t>		m_numReads;
+		std::vector<size_t>		m_containerCount;
+
+		std::vector<RESULTS*>	h_results;
+		std::vector<RESULTS*>	h_resultsFinal;
+
+		size_t					m_resultRowSize;
+		size_t					m_finalResultsRowSize;
+
+		// k-mers of the database, checked before the lookups (--prefilter)
+		bool					m_prefilter;
+		DbFilter				m_filter;
+
+		void divideDb(const size_t _dbSize, const size_t _minParts);
+
+		void* hostMalloc(const size_t _size);
+		void hostFree(void* _ptr);
+
+		void queryRead(const uint32_t* _readsPointer,
+						const CONTAINER* _readsInContainers,
+						std::vector<uint16_t>& _targetHits,
+						std::vector<ILBL>& _targetsHit,
+						RESULTS* _resultRow
+						) const;
+
+		void resultRow(const RESULTS* _scoresRow,
+						RESULTS* _resultsRow
+						) const;
+
+	public:
+		CpuClarkDB(	const uint8_t _k,
+					const size_t _numBatches,
+					const size_t _numTargets,
+					const HtSize& _htSize,
+					bool _verbose = false,
+					const uint32_t _minimizerWindow = 0,
+					const bool _prefilter = false
+					);
+
+		~CpuClarkDB();
+
+		void freeBatchMemory();
+
+		size_t malloc(	size_t _numReads,
+						size_t _maxReads,
+						size_t _maxReadsInContainers,
+						std::vector<ITYPE>& _indexBatches,
+						RESULTS* &_fullResults,
+						size_t _resultRowSize,
+						RESULTS* &_finalResults,
+						size_t _finalResultsRowSize,
+						bool _isExtended,
+						std::vector<uint32_t*>& _readsPointer,
+						std::vector<CONTAINER*>& _readsInCon
+						);
+
+		bool sync();
+
+		bool waitForBatch(size_t i);
+
+		bool checkBatch(size_t i);
+
+		bool read(	const char * 	_filename,
+					size_t& 		_fileSize,
+					size_t& 		_dbParts,
+					const ITYPE& 	_modCollision = 1
+					);
+
+		bool swapDbParts();
+
+		bool readyBatch(const size_t _batchId,
+						const size_t _numReads,
+						const size_t _containerCount
+						);
+
+		bool queryBatch(const size_t _batchId,
+						const bool _isExtended,
+						const bool _isFollowup=false
+						);
+
+		bool getFinalResult(const size_t _batchId,
+							RESULTS* _finalResult
+							);
+};
+
+#endif
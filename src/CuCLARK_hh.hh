@@ -27,8 +27,25 @@
  * Changes:
  * Heavily modified database loading (CuClarkDB->read),
  * classification process (getObjectsDataComputeFullGPU)
- * and file output (printExtendedResultsSynced).
+ * and file output (printBatchResults).
+ * Input files are streamed in chunks (runSimple).
+ * run/runSimple report failures, so the server mode can answer its clients.
  * Kept database creation process of CLARK with exception of using k-mers in canonical form.
+ * Targets are read in parallel and added to the database by partitions of buckets (makeSpecificTargetSets).
+ * Hash-table size set at runtime (--ht-size).
+ * Database built in two passes over the targets: k-mers counted per bucket, then added to one allocated table.
+ * Out-of-core database creation with bounded memory (--build-memory), by sorted runs and their merge.
+ * Incremental database update for added or removed targets (--update), from the kept k-mer occurrences.
+ * Targets-specific k-mers files (--tsk) written in binary, loaded in parallel for the recovery of the database.
+ * Minimizer-sampled database and queries (--minimizer), hit rate of the minimizers queried.
+ * Prefilter of the database k-mers for the host backend (--prefilter).
+ * Database with interleaved keys and labels (--interleaved).
+ * Database with bit-packed keys and labels (--packed).
+ * Read bases packed into containers eight at a time (packReads.hh).
+ * Batch memory sized by the exact number of containers, large chunks classified in parts.
+ * Read parts of more than PARTMAXBASES bases split into parts overlapping by k-1 bases.
+ * Results formatted per batch by the threads and written in order (resultWriter.hh).
+ * Sparse extended results, with the targets hit only (--sparse).
  * Many smaller changes.
  */
 
@@ -43,10 +60,19 @@
 #include<cstdlib>
 #include "./dataType.hh"
 #include "./HashTableStorage_hh.hh"
+#ifndef CPUONLY
 #include "./CuClarkDB.cuh"
+#endif
+#include "./CpuClarkDB.hh"
+#include "./chunkReader.hh"
+#include "./buildRuns.hh"
+#include "./occFile.hh"
+#include "./minimizer.hh"
 
 
-#define MAXRSIZE	10000
+#define TARGETREADSIZE			(1 << 20)	// bytes read at a time from target files
+#define TARGETPARTSPERTHREAD	8			// partitions of buckets per thread for the database creation
+#define BUILDUPDATEMEMORY		((size_t) 1 << 30)	// bytes of k-mer records for the update without --build-memory
 
 template <typename HKMERr>
 class CuCLARK
@@ -58,7 +84,9 @@ class CuCLARK
 		std::vector< std::string >				m_targetsName;
 
 		// Using fasta/fastq files
-		ITYPE						m_nbObjects;
+		ITYPE						m_nbObjects;		// objects in current chunk
+		size_t						m_nbObjectsTotal;	// objects in current file
+		size_t						m_chunkSize;
 
 		bool						m_isFastaFile;
 		
@@ -68,9 +96,8 @@ class CuCLARK
 		std::vector< std::vector<size_t> >    	m_readsSPos; 	// read starting position
 		std::vector< std::vector<size_t> >    	m_readsEPos; 	// read ending position
 		std::vector< std::vector<size_t> >    	m_readsLength;
+		std::vector< std::vector<uint32_t> >	m_readsQueried;	// minimizers queried (--minimizer)
 		std::vector< size_t >					m_posReads;
-//// new	
-		vector<bool> 							m_batchScheduled;
 
 		// Options for loading db				
 		bool					m_isLightLoading;
@@ -83,7 +110,8 @@ class CuCLARK
 		// Dictionary k-mers <---> TargetsID
 		EHashtable<HKMERr, rElement> *	m_centralHt;
 //// new db		
-		CuClarkDB<HKMERr> * 			m_cuClarkDb;
+		ClarkDB<HKMERr> * 				m_clarkDb;
+		bool							m_useCpu;
 
 //// new
 		// Tables for storing results
@@ -99,13 +127,25 @@ class CuCLARK
 		
 		const size_t	m_kmerSize;
 		const uint8_t	m_k;
+		const HtSize	m_htSize;			// buckets of the database
+		const size_t	m_buildMemory;		// bytes of k-mer records for the out-of-core creation, 0: in memory
+		const bool		m_update;			// keep the k-mer occurrences, update the database from them
+		const uint32_t	m_minimizerWindow;	// only (w,k)-minimizers of windows of w k-mers, 0: all k-mers
+		const bool		m_prefilter;		// check the k-mers of the reads with a filter of the database first
+		const DbLayout	m_layout;			// of the elements in the database written
 		const ITYPE		m_minCountTarget;
 		uint64_t		m_iterKmers;
 		ITYPE			m_minCountObject;
 		bool			m_isExtended;
+		bool			m_isSparse;			// extended results with the targets hit only
 		bool			m_isPaired;
 		bool			m_verbose;
 
+		// number of targets hit per object (extended output)
+		int				m_nonzeroMin;
+		int				m_nonzeroMax;
+		size_t			m_nonzeroSum;
+
 		// Tables storing common and repetitive values for reading sequences
 		int					m_Letter[256];
 		int					m_table[256];
@@ -126,27 +166,38 @@ class CuCLARK
 				const ITYPE&		_samplingFactor = 1,
 				const size_t&		_numBatches = 1,
 				const size_t&		_numDevices = 1,
-			const bool&			_verbose = false
+				const bool&			_verbose = false,
+				const bool&			_useCpu = false,
+				const size_t&		_chunkSize = (size_t)CHUNKSIZE << 20,
+				const uint64_t&		_htSize = HTSIZE,
+				const size_t&		_buildMemory = 0,
+				const bool&			_update = false,
+				const uint32_t&		_minimizerWindow = 0,
+				const bool&			_prefilter = false,
+				const DbLayout&		_layout = DBSPLIT
 		     );
 
 		~CuCLARK();
 
-		void runSimple(const char* 		_fileTofilesname, 
+		bool runSimple(const char* 		_fileTofilesname, 
 				const char* 		_fileResult,
-				const ITYPE& 		_minCountO 	= 0
+				const ITYPE& 		_minCountO 	= 0,
+				const char*			_pairedfile2 = NULL
 			      );
 
-		void run(const char*	_filesToObjects,
+		bool run(const char*	_filesToObjects,
 				const char* 	_fileToResults,
 				const ITYPE& 	_minCountO 	= 0,
-				const bool&		_isExtended	= false
+				const bool&		_isExtended	= false,
+				const bool&		_isSparse	= false
 			);
 
-		void run(const char*	_pairedfile1,
+		bool run(const char*	_pairedfile1,
 				const char*		_pairedfile2,
 				const char*		_fileToResults,
 				const ITYPE&	_minCountO  = 0,
-				const bool&		_isExtended = false
+				const bool&		_isExtended = false,
+				const bool&		_isSparse	= false
 			);
 
 		void clearReadData();
@@ -167,6 +218,60 @@ class CuCLARK
 				const std::vector<std::string>& 		_filesHTC
 				) const;
 
+		template <typename ELMTr>
+		size_t makeSpecificTargetSets(EHashtable<HKMERr, ELMTr>&		_commonKmersHT,
+				const std::vector<std::string>& 		_filesHT, 
+				const std::vector<std::string>& 		_filesHTC
+				) const;
+
+		template <typename ELMTr>
+		size_t makeSpecificTargetSetsExternal(const std::vector<std::string>& 	_filesHT, 
+				const std::vector<std::string>& 		_filesHTC
+				) const;
+
+		void getSpecificKmersFiles(const std::vector<std::string>& 	_labels,
+				std::vector<size_t>& 				_fileOfLabel,
+				std::vector<size_t>& 				_fileOfLabelC
+				) const;
+
+		void saveSpecificKmers(const std::vector<size_t>& 	_fileOfLabel,
+				const std::vector<size_t>& 			_fileOfLabelC,
+				const std::vector<BuildResult>& 		_results,
+				std::vector<uint64_t>& 				_numKmers,
+				std::vector<TskWriter>* 			_writers
+				) const;
+
+		size_t getTargetKmers(const size_t&				_t,
+				const HtSize&					_partSize,
+				const size_t&					_numParts,
+				TargetKmers&					_target
+				) const;
+
+		size_t addTargetKmer(const uint64_t&			_kmerC,
+				const HtSize&					_partSize,
+				TargetKmers&					_target
+				) const;
+
+		uint64_t canonicalKmer(const uint64_t&			_kmer
+				) const;
+
+		size_t findRead(const uint8_t *				_map,
+				const size_t& 					nb,
+				size_t						_i,
+				const bool					_isFasta
+				) const;
+
+		void countContainers(const uint8_t *			_map,
+				const size_t&					_sPos,
+				const size_t&					_ePos,
+				size_t&						_count,
+				size_t&						_peak
+				) const;
+
+		uint32_t countMinimizers(const CONTAINER *			_readInContainers,
+				const uint32_t					_numContainers
+				) const;
+
 		void getObjectsDataComputeFullGPU(const uint8_t *			_map,
 				const size_t& 					nb,
 				const char* _fileResult
@@ -183,7 +288,9 @@ class CuCLARK
 				const ITYPE&                                    _samplingfactor = 1
 			  ) const;
 				
-		void printExtendedResultsSynced(const uint8_t * _map,  const char* _fileResult);
+		bool printResultsHeader(const char* _fileResult) const;
+
+		void printBatchResults(const uint8_t * _map, const size_t _batchId, std::string& _out);
 		
 		void printSpeedStats(const struct timeval& 			_requestEnd, 
 				const struct timeval& 				_requestStart, 
@@ -192,6 +299,14 @@ class CuCLARK
 
 		void getdbName(char * 						_dbname
 			      ) const;
+
+		void getOccName(char * 						_occname
+			      ) const;
+
+		bool getOccTargets(std::vector<OccTarget>&		_targets
+				) const;
+
+		bool isDbUpToDate() const;
 };
 
 #endif
@@ -213,6 +328,8 @@ class CuCLARK
 
 #include "./file.hh"
 #include "./kmersConversion.hh"
+#include "./packReads.hh"
+#include "./resultWriter.hh"
 #include "./analyser.hh"
 
 using namespace std;
@@ -229,11 +346,22 @@ CuCLARK<HKMERr>::CuCLARK(const size_t& 	_kmerLength,
 		const ITYPE&        _samplingFactor,
 		const size_t&		_numBatches,
 		const size_t&		_numDevices,
-		const bool&			_verbose
+		const bool&			_verbose,
+		const bool&			_useCpu,
+		const size_t&		_chunkSize,
+		const uint64_t&		_htSize,
+		const size_t&		_buildMemory,
+		const bool&			_update,
+		const uint32_t&		_minimizerWindow,
+		const bool&			_prefilter,
+		const DbLayout&		_layout
 		):
 	m_nbCPU(_nbCPU),
-	m_kmerSize(_kmerLength), m_k((uint8_t) _kmerLength),
+	m_kmerSize(_kmerLength), m_k((uint8_t) _kmerLength), m_htSize(_htSize), m_buildMemory(_buildMemory), m_update(_update),
+	m_minimizerWindow(_minimizerWindow), m_prefilter(_prefilter), m_layout(_layout),
 	m_nbObjects(0),
+	m_nbObjectsTotal(0),
+	m_chunkSize(_chunkSize),
 	m_folder(_folderName), 
 	m_minCountTarget(_minCountT), 
 	m_powerTable(m_kmerSize),
@@ -242,11 +370,14 @@ CuCLARK<HKMERr>::CuCLARK(const size_t& 	_kmerLength,
 	m_isLightLoading(_isLightLoading),
 	m_posReads(_nbCPU),
 	m_isPaired(false),
+	m_isSparse(false),
 	m_centralHt(nullptr),
 	m_numBatches(_numBatches),
 	m_numDevices(_numDevices),
 	m_verbose(_verbose)
 {
+	m_clarkDb = nullptr;
+	m_useCpu = _useCpu;
 
 #ifdef _OPENMP
 	omp_set_num_threads(m_nbCPU);
@@ -255,12 +386,11 @@ CuCLARK<HKMERr>::CuCLARK(const size_t& 	_kmerLength,
 #endif
 	m_posReads.resize(m_numBatches);
 	m_readsLength.resize(m_numBatches); 
+	m_readsQueried.resize(m_numBatches);
 	m_readsEPos.resize(m_numBatches);
 	m_readsSPos.resize(m_numBatches);
 	m_seqENames.resize(m_numBatches);
 	m_seqSNames.resize(m_numBatches);
-	
-	m_batchScheduled.assign(m_numBatches, false);
 
 	size_t base = 1;
 	for(size_t p = 0; p < m_kmerSize ; p++)
@@ -303,7 +433,13 @@ CuCLARK<HKMERr>::CuCLARK(const size_t& 	_kmerLength,
 
 	vector<string> filesHT, filesHTC;
 	size_t sizeMotherHT = 0;
-	if (!getTargetsData(_filesName, filesHT, filesHTC, _creatingkmfiles, _samplingFactor))
+	bool isDbPresent = getTargetsData(_filesName, filesHT, filesHTC, _creatingkmfiles, _samplingFactor);
+	if (isDbPresent && m_update && !isDbUpToDate())
+	{
+		cerr << "The targets changed since the database was created, it is updated." << endl;
+		isDbPresent = false;
+	}
+	if (!isDbPresent)
 	{
 		cerr << "Starting the creation of the database of targets specific " << m_kmerSize << "-mers from input files..." << endl;
 		sizeMotherHT = makeSpecificTargetSets(filesHT, filesHTC);
@@ -315,6 +451,7 @@ template <typename HKMERr>
 CuCLARK<HKMERr>::~CuCLARK()
 {
 	if (m_centralHt) delete m_centralHt;
+	if (m_clarkDb) delete m_clarkDb;
 }
 
 template <typename HKMERr>
@@ -329,11 +466,10 @@ void CuCLARK<HKMERr>::clearReadData()
 		m_readsEPos[i].clear();
 		m_readsSPos[i].clear();
 		m_readsLength[i].clear();
-		
-		m_batchScheduled[i] = false;
+		m_readsQueried[i].clear();
 	}
 	
-	m_cuClarkDb->freeBatchMemory();
+	m_clarkDb->freeBatchMemory();
 }
 
 /**
@@ -381,19 +517,26 @@ void CuCLARK<HKMERr>::createTargetFilesNames(vector<string>& _filesHT, vector<st
  * Check files and set up to run classification.
  */
 template <typename HKMERr>
-void CuCLARK<HKMERr>::run(const char* _filesToObjects, const char* _fileToResults, const ITYPE& _minCountO, const bool& _isExtended)
+bool CuCLARK<HKMERr>::run(const char* _filesToObjects, const char* _fileToResults, const ITYPE& _minCountO, const bool& _isExtended, const bool& _isSparse)
 {
 	FILE* fd = fopen(_fileToResults, "r");
 	m_isPaired = false;
-	m_isExtended = _isExtended;
+	m_isExtended = _isExtended || _isSparse;
+	m_isSparse = _isSparse;
 	if (fd == NULL )
 	{
 		if (m_verbose) cout << "Processing file \'" << _filesToObjects << "\' in " << m_numBatches << " batches using "<< m_nbCPU << " CPU thread(s)." <<  endl;
-		CuCLARK::runSimple(_filesToObjects, _fileToResults, _minCountO);
-		return;
+		return CuCLARK::runSimple(_filesToObjects, _fileToResults, _minCountO);
 	}
 	fclose(fd);
 
+	// compressed files are never lists of files
+	if (InputFile::compression(_filesToObjects) != INPUT_PLAIN)
+	{
+		if (m_verbose) cout << "Processing file \'" << _filesToObjects << "\' in " << m_numBatches << " batches using "<< m_nbCPU << " CPU thread(s)." <<  endl;
+		return CuCLARK::runSimple(_filesToObjects, _fileToResults, _minCountO);
+	}
+
 	fd = fopen(_filesToObjects, "r");
 	string line = "";
 	getLineFromFile(fd, line);
@@ -409,48 +552,41 @@ void CuCLARK<HKMERr>::run(const char* _filesToObjects, const char* _fileToResult
 	if (line[0] == '>' || line[0] == '@' || ele.size() == 2)
 	{
 		if (m_verbose) cout << "Processing file\'" << _filesToObjects << "\' in " << m_numBatches << " batches using "<< m_nbCPU << " CPU thread(s)." <<  endl;
-		CuCLARK::runSimple(_filesToObjects, _fileToResults, _minCountO);
-		return;
+		return CuCLARK::runSimple(_filesToObjects, _fileToResults, _minCountO);
 	}
 	
 	// run for multiple inputs
 	FILE * r_fd = fopen(_fileToResults, "r");
 	FILE * o_fd = fopen(_filesToObjects, "r");
 	string o_line = "", r_line = "";
+	bool success = true;
 	if (m_verbose) cout <<  "Using " << omp_get_max_threads() << " CPU thread(s)." <<  endl;
 	while (getLineFromFile(o_fd, o_line) && getLineFromFile(r_fd, r_line))
 	{
 		if (m_verbose) cout << "> Processing file \'" << o_line.c_str() << "\' in " << m_numBatches << " batches."<< endl;
-		CuCLARK::runSimple(o_line.c_str(), r_line.c_str(), _minCountO); 
+		success &= CuCLARK::runSimple(o_line.c_str(), r_line.c_str(), _minCountO);
 	}
 	fclose(r_fd); 
 	fclose(o_fd);
-	return;
+	return success;
 }
 
 /**
  * Check files and set up to run classification (paired version).
+ * Both files are read together, mates are merged in memory.
  */
 template <typename HKMERr>
-void CuCLARK<HKMERr>::run(const char* _pairedfile1, const char* _pairedfile2, const char* _fileToResults, const ITYPE& _minCountO, const bool& _isExtended)
+bool CuCLARK<HKMERr>::run(const char* _pairedfile1, const char* _pairedfile2, const char* _fileToResults, const ITYPE& _minCountO, const bool& _isExtended, const bool& _isSparse)
 {
 	FILE* fd 	= fopen(_fileToResults, "r");
 	m_isPaired 	= true;
-	m_isExtended 	= _isExtended;
-	char * mergedFiles = NULL;
-	if (fd == NULL )
+	m_isExtended 	= _isExtended || _isSparse;
+	m_isSparse 	= _isSparse;
+	if (fd == NULL || InputFile::compression(_pairedfile1) != INPUT_PLAIN)
 	{
-		// Merge _pairedfile1 + _pairedfile2
-		mergedFiles = (char *) calloc(strlen(_pairedfile1)+25, 1);
-		sprintf(mergedFiles,"%s_ConcatenatedByCLARK.fa",_pairedfile1);
-		mergePairedFiles(_pairedfile1, _pairedfile2, mergedFiles);
-		if (m_verbose) cout << "Processing file: \'" << mergedFiles << "\' in " << m_numBatches << " batches using "<< m_nbCPU << " CPU thread(s)." <<  endl;
-		CuCLARK::runSimple(mergedFiles, _fileToResults, _minCountO);
-		// Delete file
-		deleteFile(mergedFiles);
-		free(mergedFiles);
-		mergedFiles = NULL;
-		return;
+		if (fd != NULL) fclose(fd);
+		if (m_verbose) cout << "Processing files: \'" << _pairedfile1 << "\', \'" << _pairedfile2 << "\' in " << m_numBatches << " batches using "<< m_nbCPU << " CPU thread(s)." <<  endl;
+		return CuCLARK::runSimple(_pairedfile1, _fileToResults, _minCountO, _pairedfile2);
 	}
 	fclose(fd);
 
@@ -467,17 +603,8 @@ void CuCLARK<HKMERr>::run(const char* _pairedfile1, const char* _pairedfile2, co
 	getElementsFromLine(line, seps, ele);
 	if (line[0] == '>' || line[0] == '@' || ele.size() == 2)
 	{
-		// Merge _pairedfile1 + _pairedfile2 
-		mergedFiles = (char *) calloc(strlen(_pairedfile1)+25, 1);
-		sprintf(mergedFiles,"%s_ConcatenatedByCLARK.fa",_pairedfile1);
-		mergePairedFiles(_pairedfile1, _pairedfile2, mergedFiles);
-		if (m_verbose) cout << "Processing file: \'" << mergedFiles << "\' in " << m_numBatches << " batches using "<< m_nbCPU << " CPU thread(s)." <<  endl;
-		CuCLARK::runSimple(mergedFiles, _fileToResults, _minCountO);
-		// Delete file
-		deleteFile(mergedFiles);
-		free(mergedFiles);
-		mergedFiles = NULL;
-		return;
+		if (m_verbose) cout << "Processing files: \'" << _pairedfile1 << "\', \'" << _pairedfile2 << "\' in " << m_numBatches << " batches using "<< m_nbCPU << " CPU thread(s)." <<  endl;
+		return CuCLARK::runSimple(_pairedfile1, _fileToResults, _minCountO, _pairedfile2);
 	}
 
 	// run for multiple inputs
@@ -485,92 +612,104 @@ void CuCLARK<HKMERr>::run(const char* _pairedfile1, const char* _pairedfile2, co
 	FILE * o1_fd 	= fopen(_pairedfile1, "r");
 	FILE * o2_fd 	= fopen(_pairedfile2, "r");
 	string o1_line 	= "", o2_line   = "", r_line = "";
+	bool success 	= true;
 	if (m_verbose) cout <<  "Using " << omp_get_max_threads() << " CPU thread(s)." <<  endl;
 	while (getLineFromFile(o1_fd, o1_line) && getLineFromFile(o2_fd, o2_line) && getLineFromFile(r_fd, r_line))
 	{
-		// Merge _pairedfile1 + _pairedfile2
-		mergedFiles = (char *) calloc(strlen(o1_line.c_str())+25, 1);
-		sprintf(mergedFiles,"%s_ConcatenatedByCLARK.fa",o1_line.c_str());
-		mergePairedFiles(o1_line.c_str(), o2_line.c_str(), mergedFiles);
-
-		if (m_verbose) cout << "> Processing file: \'" << mergedFiles << "\' in " << m_numBatches << " batches."<< endl;
-		CuCLARK::runSimple(mergedFiles, r_line.c_str(), _minCountO);
-		// Delete file
-		deleteFile(mergedFiles);
-		free(mergedFiles);
-		mergedFiles = NULL;
+		if (m_verbose) cout << "> Processing files: \'" << o1_line.c_str() << "\', \'" << o2_line.c_str() << "\' in " << m_numBatches << " batches."<< endl;
+		success &= CuCLARK::runSimple(o1_line.c_str(), r_line.c_str(), _minCountO, o2_line.c_str());
 	}
 	fclose(r_fd);
 	fclose(o1_fd);
 	fclose(o2_fd);
-	return;
+	return success;
 }
 
 /**
- * Run the classification for a simgle input file.
+ * Run the classification for a simgle input file (or a pair of files).
+ * The file is read and classified in chunks of whole records.
+ * Returns false if the input or the results file cannot be opened.
  */
 template <typename HKMERr>
-void CuCLARK<HKMERr>::runSimple(const char* _fileTofilesname, const char* _fileResult, const ITYPE& _minCountO)
+bool CuCLARK<HKMERr>::runSimple(const char* _fileTofilesname, const char* _fileResult, const ITYPE& _minCountO, const char* _pairedfile2)
 {
-	cerr << "Classifying: " << _fileTofilesname << "\n";
-	m_cuClarkDb->swapDbParts();
-	m_cuClarkDb->sync();
+	cerr << "Classifying: " << _fileTofilesname;
+	if (_pairedfile2 != NULL) cerr << " " << _pairedfile2;
+	cerr << "\n";
 	
 	m_isFastaFile		= true;
 	m_minCountObject 	= _minCountO;
 
-	size_t fileSize;
-	std::ifstream in(_fileTofilesname, std::ios::binary | std::ios::ate);
-	fileSize = in.tellg();
-
-	int fd = open(_fileTofilesname, O_RDONLY);
-	if (fd == -1 || fileSize == 0)
-	{
-		cerr << "Failed to open " << _fileTofilesname << endl;
-		return;
-	}
-	uint8_t *map;
-	map = (uint8_t*) mmap(0, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
-	if ( map == MAP_FAILED )
+	ChunkReader reader(m_chunkSize);
+	if (_pairedfile2 != NULL ? !reader.open(_fileTofilesname, _pairedfile2) : !reader.open(_fileTofilesname))
 	{
-		close(fd);
-		cerr << "Failed to mmapping the file." << endl;
-		return;
+		cerr << "Failed to open " << _fileTofilesname;
+		if (_pairedfile2 != NULL) cerr << " or " << _pairedfile2;
+		cerr << endl;
+		return false;
 	}
 	// Checking file to store result:
 	string sfileResult(_fileResult);
 	sfileResult += ".csv";
 	const char* fileResult = sfileResult.c_str();
-	// Try to access and erase content of the file If non-empty
-	FILE * _fout = fopen(fileResult,"w");
-	if (_fout == NULL)
+	// Try to access and erase content of the file, print header
+	if (!printResultsHeader(fileResult))
 	{
 		cerr << "Failed to create/open file result: " << fileResult << endl;
-		return;
+		return false;
 	}
+	if (m_verbose) cerr << "Reading input in chunks of " << (m_chunkSize >> 20) << " MB.\n";
 
 	struct timeval requestStart, requestEnd;
 
-	fclose(_fout);
-
+	m_nbObjectsTotal = 0;
+	m_nonzeroMin = m_targetsName.size()-1;
+	m_nonzeroMax = 0;
+	m_nonzeroSum = 0;
 
 	gettimeofday(&requestStart, NULL);
 	///////////////////////////////////////////////////////////////////////
-	getObjectsDataComputeFullGPU(map, fileSize, fileResult);
+	const uint8_t* chunk;
+	size_t chunkSize;
+	while (reader.next(chunk, chunkSize))
+	{
+		// chunks too large for the 32-bit container offsets of the batches are classified in parts
+		for (size_t part = 0; chunkSize > 0; chunk += part, chunkSize -= part)
+		{
+			part = chunkSize;
+			if (part > m_numBatches*MAXBATCHBYTES)
+			{
+				size_t posRead = findRead(chunk, chunkSize, m_numBatches*MAXBATCHBYTES, chunk[0] == '>');
+				if (posRead < chunkSize) part = posRead-1;
+			}
+			m_clarkDb->swapDbParts();
+			m_clarkDb->sync();
+
+			getObjectsDataComputeFullGPU(chunk, part, fileResult);
+
+			m_nbObjectsTotal += m_nbObjects;
+			clearReadData();
+		}
+	}
+	reader.close();
+	if (m_nbObjectsTotal > 0)
+		cerr << "Done." << endl;
+
+	/// extra target info
+	if (m_isExtended && m_nbObjectsTotal > 0)
+	{
+		cerr << "MIN targets: " << m_nonzeroMin
+			 << ", MAX targets: " << m_nonzeroMax
+			 << ", AVG targets: " << (float)m_nonzeroSum / m_nbObjectsTotal
+			 << "\n";
+	}
+	///
 	///////////////////////////////////////////////////////////////////////
 	gettimeofday(&requestEnd, NULL);
 	// Measurement execution time
 	printSpeedStats(requestEnd, requestStart, fileResult);
-	clearReadData();
 
-	msync(map, fileSize, MS_SYNC);
-	if (munmap(map, fileSize) == -1)
-	{
-		cerr << "Error un-mmapping the file." << endl;
-	}
-	close(fd);
-
-	return;
+	return true;
 }
 
 /**
@@ -583,12 +722,67 @@ void CuCLARK<HKMERr>::getdbName(char *   _dbname) const
 	size_t sizeHTS =  m_labels.size() + m_labels_c.size(); 
 	if (m_isLightLoading)
 	{
-		sprintf(_dbname,"%s/db_central_k%lu_t%lu_s%lu_m%lu_light_%lu.tsk",m_folder,(size_t)m_kmerSize,sizeHTS,(size_t) HTSIZE,(size_t)m_minCountTarget,(size_t) m_iterKmers);	
+		sprintf(_dbname,"%s/db_central_k%lu_t%lu_s%lu_m%lu_light_%lu.tsk",m_folder,(size_t)m_kmerSize,sizeHTS,(size_t) m_htSize.size,(size_t)m_minCountTarget,(size_t) m_iterKmers);	
+	}
+	else
+	{
+		sprintf(_dbname,"%s/db_central_k%lu_t%lu_s%lu_m%lu.tsk",m_folder,(size_t)m_kmerSize,sizeHTS,(size_t) m_htSize.size,(size_t)m_minCountTarget);
+	}
+	if (m_minimizerWindow > 0)
+	{	// minimizers of windows of w k-mers, before the extension
+		sprintf(_dbname + strlen(_dbname) - strlen(".tsk"), "_w%lu.tsk", (size_t) m_minimizerWindow);
+	}
+}
+
+/**
+ * Name of the k-mer occurrences file of the incremental update. It does not depend
+ * on the targets, unlike the database name.
+ */
+template <typename HKMERr>
+void CuCLARK<HKMERr>::getOccName(char *   _occname) const
+{
+	if (m_isLightLoading)
+	{
+		sprintf(_occname,"%s/db_central_k%lu_s%lu_m%lu_light_%lu.occ",m_folder,(size_t)m_kmerSize,(size_t) m_htSize.size,(size_t)m_minCountTarget,(size_t) m_iterKmers);
 	}
 	else
 	{
-		sprintf(_dbname,"%s/db_central_k%lu_t%lu_s%lu_m%lu.tsk",m_folder,(size_t)m_kmerSize,sizeHTS,(size_t) HTSIZE,(size_t)m_minCountTarget);
+		sprintf(_occname,"%s/db_central_k%lu_s%lu_m%lu.occ",m_folder,(size_t)m_kmerSize,(size_t) m_htSize.size,(size_t)m_minCountTarget);
+	}
+	if (m_minimizerWindow > 0)
+	{
+		sprintf(_occname + strlen(_occname) - strlen(".occ"), "_w%lu.occ", (size_t) m_minimizerWindow);
+	}
+}
+
+/**
+ * Files of the targets, as recorded in the occurrences file.
+ */
+template <typename HKMERr>
+bool CuCLARK<HKMERr>::getOccTargets(vector<OccTarget>& _targets) const
+{
+	_targets.resize(m_targetsID.size());
+	for(size_t t = 0; t < m_targetsID.size(); t++)
+	{
+		if (!getOccTarget(m_targetsID[t].first, _targets[t]))
+		{	return false;	}
 	}
+	return true;
+}
+
+/**
+ * True if the occurrences file was written for the current targets (--update).
+ */
+template <typename HKMERr>
+bool CuCLARK<HKMERr>::isDbUpToDate() const
+{
+	char * ofname = (char*) calloc(130, sizeof(char));
+	getOccName(ofname);
+	OccFile occ;
+	vector<OccTarget> targets;
+	bool isUpToDate = occ.open(ofname, m_k, m_htSize.size) && getOccTargets(targets) && occ.targets() == targets;
+	free(ofname);
+	return isUpToDate;
 }
 
 /**
@@ -604,8 +798,13 @@ void CuCLARK<HKMERr>::loadSpecificTargetSets(const vector<string>& _filesHT,
 {
 	size_t kmersLoaded = 0;
 	ITYPE minCount = m_minCountTarget;
-////	m_centralHt = new EHashtable<HKMERr, rElement>(m_kmerSize, m_labels, m_labels_c);
-	m_cuClarkDb = new CuClarkDB<HKMERr>(m_numDevices, m_kmerSize, m_numBatches, m_targetsName.size()-1, m_verbose);
+////	m_centralHt = new EHashtable<HKMERr, rElement>(m_kmerSize, m_labels, m_labels_c, m_htSize);
+#ifndef CPUONLY
+	if (!m_useCpu)
+		m_clarkDb = new CuClarkDB<HKMERr>(m_numDevices, m_kmerSize, m_numBatches, m_targetsName.size()-1, m_htSize, m_verbose, m_minimizerWindow);
+	else
+#endif
+		m_clarkDb = new CpuClarkDB<HKMERr>(m_kmerSize, m_numBatches, m_targetsName.size()-1, m_htSize, m_verbose, m_minimizerWindow, m_prefilter);
 	char * cfname = (char*) calloc(130, sizeof(char));
 	getdbName(cfname);
 
@@ -619,7 +818,7 @@ void CuCLARK<HKMERr>::loadSpecificTargetSets(const vector<string>& _filesHT,
 	gettimeofday(&requestStart, NULL);
 #endif
 ////	if (m_centralHt->Read(cfname, fileSize, m_nbCPU, _samplingFactor, _mmapLoading))
-	if (m_cuClarkDb->read(cfname, fileSize, m_dbParts, _samplingFactor))
+	if (m_clarkDb->read(cfname, fileSize, m_dbParts, _samplingFactor))
 	{
 #ifdef TIME_DBLOADING
 		gettimeofday(&requestEnd, NULL);
@@ -637,47 +836,54 @@ void CuCLARK<HKMERr>::loadSpecificTargetSets(const vector<string>& _filesHT,
 	}
 	cerr << "The database will be recovered from saved targets-specific data." << endl;
 
-	m_centralHt = new EHashtable<HKMERr, rElement>(m_kmerSize, m_labels, m_labels_c);
+	m_centralHt = new EHashtable<HKMERr, rElement>(m_kmerSize, m_labels, m_labels_c, m_htSize);
 	
-	for(size_t t = 0 ; t < _filesHT.size(); t++)
+	// binary files are mapped and loaded in parallel, files of the former text format one by one
+	std::vector<TskFile> tskFiles(_filesHT.size() + _filesHTC.size());
+	std::vector<const TskFile*> binaryFiles;
+	std::vector<string> binaryLabels, textFiles, textLabels;
+	for(size_t t = 0 ; t < tskFiles.size(); t++)
 	{
-		string nameHT =  _filesHT[t];
-
-		FILE* fd = fopen(nameHT.c_str(),"r");
-		if (fd == NULL)
+		const string& nameHT = t < _filesHT.size() ? _filesHT[t] : _filesHTC[t - _filesHT.size()];
+		const string& label = t < _filesHT.size() ? m_labels[t] : m_labels_c[t - _filesHT.size()];
+		if (!DbFile::exists(nameHT.c_str()))
+		{	cerr << "Failed to open " << nameHT << endl;	}
+		else if (!TskFile::isBinary(nameHT.c_str()))
 		{
-			cerr << "Failed to open " << nameHT << endl;
+			textFiles.push_back(nameHT);
+			textLabels.push_back(label);
 		}
-		else
+		else if (tskFiles[t].open(nameHT.c_str(), m_k))
 		{
-			fclose(fd);
-			m_centralHt->Load(nameHT, m_labels[t], minCount);
-			kmersLoaded = m_centralHt->Size();
+			binaryFiles.push_back(&tskFiles[t]);
+			binaryLabels.push_back(label);
 		}
-		cerr << "\rDataset " << t+1 << " loaded.   " ;
+		else
+		{	exit(-1);	}
 	}
-	for(size_t t = 0 ; t < _filesHTC.size(); t++)
-	{
-		string nameHTO =  _filesHTC[t];
 
-		FILE* fd = fopen(nameHTO.c_str(),"r");
-		if (fd == NULL)
-		{
-			cerr << "Failed to open " << nameHTO << endl;
-		}
-		else
+	// the files are read twice: buckets are counted, then filled
+	for(size_t pass = 0; pass < 2; pass++)
+	{
+		const bool countOnly = pass == 0;
+		m_centralHt->Load(binaryFiles, binaryLabels, minCount, countOnly);
+		if (!countOnly && binaryFiles.size() > 0)
+		{	cerr << "\rDataset " << binaryFiles.size() << " loaded.   " ;	}
+		for(size_t t = 0 ; t < textFiles.size(); t++)
 		{
-			fclose(fd);
-			m_centralHt->Load(nameHTO, m_labels_c[t], minCount);
-			kmersLoaded = m_centralHt->Size();
+			m_centralHt->Load(textFiles[t], textLabels[t], minCount, countOnly);
+			if (!countOnly)
+			{	cerr << "\rDataset " << binaryFiles.size() + t + 1 << " loaded.   " ;	}
 		}
-		cerr << "\rDataset " << t + 1 + _filesHT.size() << " loaded.    " ;
+		if (countOnly)
+		{	m_centralHt->allocate();	}
 	}
+	kmersLoaded = m_centralHt->Size();
 	cerr << kmersLoaded  << " " << m_kmerSize << "-mers finally loaded. ";
 	cerr << "Creating database in disk..." << endl;
 
 	m_centralHt->SortAllHashTable();
-	m_centralHt->Write(cfname, 0, false);
+	m_centralHt->Write(cfname, false, m_layout);
 	free(cfname);
 	cfname = NULL;
 	cerr << "Central Hashtable successfully stored in disk." << endl;
@@ -689,643 +895,769 @@ void CuCLARK<HKMERr>::loadSpecificTargetSets(const vector<string>& _filesHT,
  */
 template <typename HKMERr>
 size_t CuCLARK<HKMERr>::makeSpecificTargetSets(const vector<string>& _filesHT, const vector<string>& _filesHTC) const
+{
+	const bool isExternal = m_buildMemory > 0 || m_update;
+	if (isExternal && (m_isLightLoading || _filesHTC.size() + _filesHT.size() == 0))
+	{	return makeSpecificTargetSetsExternal<lElement>(_filesHT, _filesHTC);	}
+	if (isExternal)
+	{	return makeSpecificTargetSetsExternal<Element>(_filesHT, _filesHTC);	}
+	if (m_isLightLoading || _filesHTC.size() + _filesHT.size() == 0)
+	{
+		EHashtable<HKMERr, lElement> commonKmersHT(m_kmerSize, m_labels, m_labels_c, m_htSize);
+		return makeSpecificTargetSets(commonKmersHT, _filesHT, _filesHTC);
+	}
+	EHashtable<HKMERr, Element> commonKmersHT(m_kmerSize, m_labels, m_labels_c, m_htSize);
+	return makeSpecificTargetSets(commonKmersHT, _filesHT, _filesHTC);
+}
+
+/**
+ *  Build the mother hash table from all targets, remove common k-mers and write the database.
+ *  Targets-specific k-mers files are saved if requested (not for the light database).
+ */
+template <typename HKMERr>
+template <typename ELMTr>
+size_t CuCLARK<HKMERr>::makeSpecificTargetSets(EHashtable<HKMERr, ELMTr>& _commonKmersHT, const vector<string>& _filesHT, const vector<string>& _filesHTC) const
 {
 	size_t nt = 0;
-	if (m_isLightLoading)
+	// targets are read in parallel, one per thread, and added to the
+	// hash table in their order by partitions of buckets
+	const size_t numThreads = omp_get_max_threads();
+	const size_t numParts = numThreads * TARGETPARTSPERTHREAD;
+	const HtSize partSize((m_htSize.size + numParts - 1) / numParts);
+
+	// the targets are read twice: the k-mers of each bucket are counted
+	// first, the table is allocated at once, then the k-mers are added
+	std::vector<TargetKmers> targets(numThreads);
+	for(size_t pass = 0; pass < 2; pass++)
 	{
-		EHashtable<HKMERr, lElement> commonKmersHT(m_kmerSize, m_labels, m_labels_c);
-		// read kmers from files and add to HT
-		for(size_t t = 0 ; t < m_targetsID.size(); t++)
+		for(size_t first = 0; first < m_targetsID.size(); first += numThreads)
 		{
-			FILE* fd = fopen(m_targetsID[t].first.c_str(),"r");
-			if (fd == NULL)
-			{        cerr << "Failed to open " << m_targetsID[t].first << endl;
-				continue;
-			}
-			char c[MAXRSIZE];
-			size_t len = fread(&c, 1, MAXRSIZE, fd), i = 0;
-			uint64_t _km_f = 0, _km_r = 0;		// kmer, reverse kmer
-			uint8_t cpt = 0;					// kmer length
-			uint64_t iter = 0;
-			// fasta
-			if (len > 0 && c[0] == '>')
-			{
-				while (len != 0)
-				{
-					while( i < len)
-					{
-						if (m_table[c[i]] >= 0)		// process read
-						{
-							nt++;
-							_km_r <<= 2;    
-							_km_r += 3 - m_table[c[i]];
-							if (cpt  == m_kmerSize - 1)		// kmer complete
-							{
-								//[/////////////////////////////////////////////////////////////////////
-								if ( iter % m_iterKmers == 0  )		// skip kmers for light loading
-								{       commonKmersHT.addElement(_km_r, m_targetsID[t].second, 1);}
-								_km_r = 0; cpt = 0; 	// reset kmer
-								i++;
-								iter++;
-								continue;
-								//]//////////////////////////////////////////////////////////////////////
-							}
-							cpt++;  
-							i++;
-							continue;
-						}
-						if (m_table[c[i]] == -10)	// c[i] == '\n', skip
-						{       i++;
-							continue;   }
-						if (m_table[c[i]] == -1)	// c[i] == unknown nucleotide, reset kmer, skip
-						{        nt++; _km_r = 0; cpt = 0; i++;
-							continue;  }
-						if (m_table[c[i]] == -2)	// c[i] == '>', skip to next line
-						{
-							_km_r = 0; cpt = 0; 
-							while (len != 0)
-							{
-								while(i < len && c[i] != '\n')
-								{       i++;}
-								if (i < len)
-								{   break;}
-								len = fread(&c, 1, MAXRSIZE, fd );
-								i = 0;
-							}
-							i++;
-							continue;
-						}
-						cerr << m_targetsID[t].first << ": " ;
-						cerr << "Failed to process sequence -- wrong character found [ASCII]: " << (size_t) c << endl;
-					}
-					len = fread(&c, 1, MAXRSIZE, fd );
-					i = 0;
-				}
-				fclose(fd);
-				cerr << "\r Progress report: (" <<t+1<< "/"<<m_targetsID.size()<<")    ";
-				continue;
-			}
-			// fastq
-			if (len > 0 && c[0] == '@')
+			const size_t numTargets = std::min(numThreads, m_targetsID.size() - first);
+			size_t ntPass = 0;
+			#pragma omp parallel for schedule(dynamic, 1) reduction(+:ntPass)
+			for(size_t t = 0; t < numTargets; t++)
 			{
-				while (len != 0)
-				{
-					while(i < len && c[i] != '\n')
-					{       i++;}
-					if (i < len)
-					{   break;}
-					len = fread(&c, 1, MAXRSIZE, fd );
-					i = 0;
-				}
-				i++;
-				while (len != 0)
-				{
-					while( i < len)
-					{
-						if (m_table[c[i]] >= 0)
-						{
-							nt++;
-							_km_r <<= 2; 
-							_km_r += 3 - m_table[c[i]];
-							if (cpt  == m_kmerSize - 1)
-							{
-								//[/////////////////////////////////////////////////////////////////////
-								if ( iter % m_iterKmers == 0 )
-								{       commonKmersHT.addElement(_km_r, m_targetsID[t].second, 1);}
-								_km_r = 0; cpt = 0; 
-								i++;
-								iter++;
-								continue;
-								//]//////////////////////////////////////////////////////////////////////
-							}
-							cpt++;
-							i++;
-							continue;
-						}
-						if (m_table[c[i]] == -10)
-						{
-							_km_r = 0; cpt = 0;
-							// Pass third line
-							i++;
-							while (len != 0)
-							{
-								while(i < len && c[i] != '\n')
-								{       i++;}
-								if (i < len)
-								{   break;}
-								len = fread(&c, 1, MAXRSIZE, fd );
-								i = 0;
-							}
-							i++;
-							// Pass fouth line
-							while (len != 0)
-							{
-								while(i < len && c[i] != '\n')
-								{       i++;}
-								if (i < len)
-								{   break;}
-								len = fread(&c, 1, MAXRSIZE, fd );
-								i = 0;
-							}
-							i++;
-							// Pass first line
-							while (len != 0)
-							{
-								while(i < len && c[i] != '\n')
-								{       i++;}
-								if (i < len)
-								{   break;}
-								len = fread(&c, 1, MAXRSIZE, fd );
-								i = 0;
-							}
-							i++;
-							continue;
-						}
-						if (m_table[c[i]] == -1)
-						{
-							nt++;
-							_km_r = 0; cpt = 0; 
-							i++;
-							continue;
-						}
-						cerr << m_targetsID[t].first << ": " ;
-						cerr << "Failed to process sequence -- wrong character found [ASCII]: " << (size_t) c << endl;
-					}
-					len = fread(&c, 1, MAXRSIZE, fd );
-					i = 0;
-				}
-				fclose(fd);
-				cerr << "\r Progress report: (" <<t+1<< "/"<<m_targetsID.size()<<")              ";
-				continue;
+				ntPass += getTargetKmers(first + t, partSize, numParts, targets[t]);
 			}
-			// spectrum form
-			fseek(fd, 0, 0);
-			string s_kmer = "";
-			ITYPE val;
-			uint8_t counter = 0;
-			while (getFirstAndSecondElementInLine(fd, s_kmer, val))
+			if (pass == 0)
 			{
-				if (counter % m_iterKmers == 0 && val > m_minCountTarget)
-				{
-					commonKmersHT.addElement(s_kmer, m_targetsID[t].second, (size_t) val);
-					counter = 0;
-				}
-				counter++;
+				_commonKmersHT.countTargets(targets, numTargets);
+				cerr << "\r Counting k-mers: (" << first + numTargets << "/" << m_targetsID.size() << ")              ";
 				continue;
 			}
-			fclose(fd);
-			cerr << "\r Progress report: (" <<t+1<< "/"<<m_targetsID.size()<<")              ";
+			nt += ntPass;
+			_commonKmersHT.addTargets(targets, numTargets);
+			cerr << "\r Progress report: (" << first + numTargets << "/" << m_targetsID.size() << ")              ";
 		}
-		cerr << nt << " nt read in total." << endl;
-		cerr << "Mother Hashtable successfully built. "<<commonKmersHT.Size()<<" " << m_kmerSize << "-mers stored." <<  endl;
-		size_t sizeMotherTable = commonKmersHT.Size();
+		if (pass == 0)
+		{	_commonKmersHT.allocate();	}
+	}
+	targets.clear();
 
-		commonKmersHT.SortAllHashTable(2);
-		commonKmersHT.RemoveCommon(m_labels_c, m_minCountTarget);
-		char * cfname = (char*) calloc(130, sizeof(char));
-		getdbName(cfname);
+	cerr << nt << " nt read in total." << endl;
+	cerr << "Mother Hashtable successfully built. " << _commonKmersHT.Size() << " " << m_kmerSize << "-mers stored." <<  endl;
+	size_t sizeMotherTable = _commonKmersHT.Size();
 
-		cerr << "Creating light database in disk..." << endl;
-		uint64_t nbElement = commonKmersHT.Write(cfname,2);
-		free(cfname);
-		cfname = NULL;
-		cerr << nbElement << " " << m_kmerSize << "-mers successfully stored in database." << endl;
+	if (!m_isLightLoading && _filesHTC.size() + _filesHT.size() > 0)
+	{
+		_commonKmersHT.SaveIntersectionMultiple(_filesHTC, m_labels_c);
+		_commonKmersHT.SaveMultiple(_filesHT, m_labels);
+	}
+	_commonKmersHT.SortAllHashTable();
+	_commonKmersHT.RemoveCommon(m_labels_c, m_minCountTarget);
+	char * cfname = (char*) calloc(130, sizeof(char));
+	getdbName(cfname);
+	if (m_isLightLoading)
+	{	cerr << "Creating light database in disk..." << endl;	}
+	else
+	{	cerr << "Creating database in disk..." << endl;	}
+	uint64_t nbElement = _commonKmersHT.Write(cfname, true, m_layout);
+	free(cfname);
+	cfname = NULL;
+	cerr << nbElement << " " << m_kmerSize << "-mers successfully stored in database." << endl;
+
+	return sizeMotherTable;
+}
 
-		return sizeMotherTable;
+/**
+ *  Create the database out of core, with about m_buildMemory bytes of k-mer records.
+ *  The occurrences of the k-mers (bucket, key, target) are written to sorted runs,
+ *  the runs are merged by partitions of buckets in parallel. The occurrences of a k-mer
+ *  are merged in the order of the targets, so that the elements, the removal of
+ *  common k-mers and the database are the same as for the table in memory.
+ *  With m_update, the merged occurrences are kept in the occurrences file. The next
+ *  update reads only the added targets, the occurrences of the other targets are
+ *  taken from the file as one more run, renumbered in the new order of the targets.
+ */
+template <typename HKMERr>
+template <typename ELMTr>
+size_t CuCLARK<HKMERr>::makeSpecificTargetSetsExternal(const vector<string>& _filesHT, const vector<string>& _filesHTC) const
+{
+	const size_t numThreads = omp_get_max_threads();
+	const size_t numParts = numThreads * TARGETPARTSPERTHREAD;
+	const HtSize partSize((m_htSize.size + numParts - 1) / numParts);
+	const bool saveFiles = !m_isLightLoading && _filesHTC.size() + _filesHT.size() > 0;
+	const size_t buildMemory = m_buildMemory > 0 ? m_buildMemory : BUILDUPDATEMEMORY;
+
+	//// labels of the targets, as in the table in memory
+	vector<string> labels(1 + m_labels.size() + m_labels_c.size());
+	std::map<string, ILBL> mapLbls;
+	for(size_t t = 0; t < m_labels.size(); t++)
+	{
+		labels[t] = m_labels[t];
+		mapLbls[m_labels[t]] = t;
+	}
+	for(size_t t = 0; t < m_labels_c.size(); t++)
+	{
+		labels[t + m_labels.size()] = m_labels_c[t];
+		mapLbls[m_labels_c[t]] = t + m_labels.size();
+	}
+	labels[m_labels.size() + m_labels_c.size()] = "";
+	mapLbls[""] = m_labels.size() + m_labels_c.size();
+	vector<ILBL> targetLabels(m_targetsID.size());
+	for(size_t t = 0; t < m_targetsID.size(); t++)
+	{
+		targetLabels[t] = mapLbls.find(m_targetsID[t].second)->second;
 	}
-	if (_filesHTC.size() + _filesHT.size() == 0)
+
+	char * cfname = (char*) calloc(130, sizeof(char));
+	char * ofname = (char*) calloc(130, sizeof(char));
+	getdbName(cfname);
+	getOccName(ofname);
+	BuildRuns runs;
+	runs.open(cfname, numParts);
+
+	//// targets to read: all, or those not found in the occurrences file (--update)
+	vector<OccTarget> occTargets;
+	vector<size_t> toRead;
+	if (m_update && !getOccTargets(occTargets))
+	{	exit(-1);	}
+	OccFile occ;
+	if (m_update && occ.open(ofname, m_k, m_htSize.size))
 	{
-		EHashtable<HKMERr, lElement> commonKmersHT(m_kmerSize, m_labels, m_labels_c);
-		for(size_t t = 0 ; t < m_targetsID.size(); t++)
+		std::map<string, vector<size_t> > newTargets;
+		for(size_t t = m_targetsID.size(); t > 0; t--)
+		{	newTargets[occTargets[t-1].file].push_back(t-1);	}
+		vector<bool> isKept(m_targetsID.size(), false);
+		vector<uint32_t> targetMap(occ.targets().size(), BUILDREMOVED);
+		size_t nbKept = 0;
+		for(size_t o = 0; o < occ.targets().size(); o++)
 		{
-			FILE* fd = fopen(m_targetsID[t].first.c_str(),"r");
-			if (fd == NULL)
+			vector<size_t>& same = newTargets[occ.targets()[o].file];
+			if (!same.empty() && occTargets[same.back()] == occ.targets()[o])
 			{
-				cerr << "Failed to open " << m_targetsID[t].first << endl;
+				targetMap[o] = same.back();
+				isKept[same.back()] = true;
+				same.pop_back();
+				nbKept++;
 			}
-			else
+		}
+		for(size_t t = 0; t < m_targetsID.size(); t++)
+		{
+			if (!isKept[t])
+			{	toRead.push_back(t);	}
+		}
+		cerr << "Updating the database: " << nbKept << " targets kept, " << toRead.size() << " added, "
+			 << occ.targets().size() - nbKept << " removed." << endl;
+		const uint64_t recordsPos = occ.header().recordsPos, numRecords = occ.header().numRecords;
+		if (!runs.addSortedRun(occ.release(), recordsPos, numRecords, partSize.size, targetMap))
+		{	exit(-1);	}
+	}
+	else
+	{
+		for(size_t t = 0; t < m_targetsID.size(); t++)
+		{	toRead.push_back(t);	}
+	}
+
+	//// sorted runs
+	const size_t partRecords = std::max<size_t>(buildMemory / sizeof(BuildRecord) / numParts, 1);
+	vector< vector<BuildRecord> > parts(numParts);
+	for(size_t p = 0; p < numParts; p++)
+	{	parts[p].reserve(partRecords);	}
+	size_t nt = 0;
+	std::vector<TargetKmers> targets(numThreads);
+	for(size_t first = 0; first < toRead.size(); first += numThreads)
+	{
+		const size_t numTargets = std::min(numThreads, toRead.size() - first);
+		#pragma omp parallel for schedule(dynamic, 1) reduction(+:nt)
+		for(size_t t = 0; t < numTargets; t++)
+		{
+			nt += getTargetKmers(toRead[first + t], partSize, numParts, targets[t]);
+		}
+		bool isFull = false;
+		#pragma omp parallel for schedule(dynamic) reduction(||:isFull)
+		for(size_t p = 0; p < numParts; p++)
+		{
+			for(size_t t = 0; t < numTargets; t++)
 			{
-				char c[MAXRSIZE];
-				size_t len = fread(&c, 1, MAXRSIZE, fd), i = 0;
-				uint64_t _km_f = 0, _km_r = 0;
-				bool _isfull = false;
-				uint8_t cpt = 0;		
-				// fasta
-				if (len > 0 && c[0] == '>')
-				{
-					while (len != 0)
-					{
-						while( i < len)
-						{
-							if (m_table[c[i]] >= 0)
-							{
-								nt++;
-								if (_isfull)
-								{
-									_km_f >>= 2;
-									_km_f += m_powerTable[cpt][m_table[c[i]]];
-
-									/////////////////////////////////////////////////////////////////////
-									commonKmersHT.addElement(_km_f, m_targetsID[t].second, 1);
-									///////////////////////////////////////////////////////////////////////
-									i++;
-									continue;
-								}
-								_km_r <<= 2;    
-								_km_r += 3 - m_table[c[i]];
-								if (cpt  == m_kmerSize -1)
-								{       
-									_isfull = true;
-									//[/////////////////////////////////////////////////////////////////////
-									commonKmersHT.addElement(_km_r, m_targetsID[t].second, 1);
-									//]//////////////////////////////////////////////////////////////////////
-									_km_f = _km_r;
-									// The following 6 lines come from Jellyfish source code
-									_km_f = ((_km_f >> 2)  & 0x3333333333333333UL) | ((_km_f & 0x3333333333333333UL) << 2);
-									_km_f = ((_km_f >> 4)  & 0x0F0F0F0F0F0F0F0FUL) | ((_km_f & 0x0F0F0F0F0F0F0F0FUL) << 4);
-									_km_f = ((_km_f >> 8)  & 0x00FF00FF00FF00FFUL) | ((_km_f & 0x00FF00FF00FF00FFUL) << 8);
-									_km_f = ((_km_f >> 16) & 0x0000FFFF0000FFFFUL) | ((_km_f & 0x0000FFFF0000FFFFUL) << 16);
-									_km_f = ( _km_f >> 32                        ) | ( _km_f                        << 32);
-									_km_f = (((uint64_t)-1) - _km_f) >> (64 - (m_k << 1));
-									i++;
-									continue;
-								}
-								cpt++;  i++;    
-								continue;
-							}
-							if (m_table[c[i]] == -10)
-							{	i++;
-								continue;   }
-							if (m_table[c[i]] == -1)
-							{	nt++; _km_r = 0; cpt = 0; _isfull = false; i++; 
-								continue;  }
-							if (m_table[c[i]] == -2)
-							{
-								_km_r = 0; cpt = 0; _isfull = false; 
-								while (len != 0)
-								{
-									while(i < len && c[i] != '\n')  {	i++;}
-									if (i < len)		{   break;}
-									len = fread(&c, 1, MAXRSIZE, fd );
-									i = 0;
-								}
-								i++;   
-								continue;
-							}
-							cerr << m_targetsID[t].first << ": " ;
-							cerr << "Failed to process sequence -- wrong character found [ASCII]: " << (size_t) c << endl;
-						}
-						len = fread(&c, 1, MAXRSIZE, fd );
-						i = 0;
-					}
-					fclose(fd);
-					cerr << "\r Progress report: (" <<t+1<< "/"<<m_targetsID.size()<<")    ";
-					continue;	
-				}
-				// fastq
-				if (len > 0 && c[0] == '@')
+				const std::vector<uint64_t>& kmers = targets[t].kmers[p];
+				const std::vector<ITYPE>& counts = targets[t].counts[p];
+				for(size_t i = 0; i < kmers.size(); i++)
 				{
-					i = 0;
-					while (len != 0)
-					{
-						while(i < len && c[i] != '\n')            {	i++;}
-						if (i < len)      {   break;}
-						len = fread(&c, 1, MAXRSIZE, fd );
-						i = 0;
-					}
-					i++;
-					while (len != 0)
-					{
-						while( i < len)
-						{
-							if (m_table[c[i]] >= 0)
-							{
-								nt++;
-								if (_isfull)
-								{
-									_km_f >>= 2; 
-									_km_f += m_powerTable[cpt][m_table[c[i]]];
-									/////////////////////////////////////////////////////////////////////
-									commonKmersHT.addElement(_km_f, m_targetsID[t].second, 1);
-									///////////////////////////////////////////////////////////////////////
-									i++;    
-									continue;
-								}
-								_km_r <<= 2;    
-								_km_r += 3 - m_table[c[i]];
-								if ( cpt  == m_kmerSize - 1)
-								{       _isfull = true;
-									//[/////////////////////////////////////////////////////////////////////
-									commonKmersHT.addElement(_km_r, m_targetsID[t].second, 1);
-									//]//////////////////////////////////////////////////////////////////////
-									_km_f = _km_r;
-									// The following 6 lines come from Jellyfish source code
-									_km_f = ((_km_f >> 2)  & 0x3333333333333333UL) | ((_km_f & 0x3333333333333333UL) << 2);
-									_km_f = ((_km_f >> 4)  & 0x0F0F0F0F0F0F0F0FUL) | ((_km_f & 0x0F0F0F0F0F0F0F0FUL) << 4);
-									_km_f = ((_km_f >> 8)  & 0x00FF00FF00FF00FFUL) | ((_km_f & 0x00FF00FF00FF00FFUL) << 8);
-									_km_f = ((_km_f >> 16) & 0x0000FFFF0000FFFFUL) | ((_km_f & 0x0000FFFF0000FFFFUL) << 16);
-									_km_f = ( _km_f >> 32                        ) | ( _km_f                        << 32);
-									_km_f = (((uint64_t)-1) - _km_f) >> (64 - (m_k << 1));
-									i++;
-									continue;
-								}
-								cpt++;  
-								i++;    
-								continue;
-							}
-							if (m_table[c[i]] == -10)
-							{
-								_km_r = 0; cpt = 0; _isfull = false; 
-								// Pass third line
-								i++;
-								while (len != 0)
-								{
-									while(i < len && c[i] != '\n')		{	i++;}
-									if (i < len)   		{   break;}
-									len = fread(&c, 1, MAXRSIZE, fd );
-									i = 0;
-								}
-								i++;
-								// Pass fouth line
-								while (len != 0)
-								{
-									while(i < len && c[i] != '\n')         {	i++;}
-									if (i < len)         {   break;}
-									len = fread(&c, 1, MAXRSIZE, fd );
-									i = 0;
-								}
-								i++;
-								// Pass first line
-								while (len != 0)
-								{
-									while(i < len && c[i] != '\n')        {		i++;}
-									if (i < len){   break;}
-									len = fread(&c, 1, MAXRSIZE, fd );
-									i = 0;
-								}
-								i++;    
-								continue;
-							}
-							if (m_table[c[i]] == -1)
-							{ 	nt++;   
-								_km_r = 0; cpt = 0; _isfull = false;
-								i++;    
-								continue;
-							}
-							cerr << m_targetsID[t].first << ": " ;
-							cerr << "Failed to process sequence -- wrong character found [ASCII]: " << (size_t) c << endl;
-						}
-						len = fread(&c, 1, MAXRSIZE, fd );
-						i = 0;  
-					}
-					fclose(fd);
-					cerr << "\r Progress report: (" <<t+1<< "/"<<m_targetsID.size()<<")              ";
-					continue;
-				}
-				// spectrum form
-				fseek(fd, 0, 0);
-				string s_kmer = "";
-				ITYPE val;
-				while (getFirstAndSecondElementInLine(fd, s_kmer, val))
-				{	if (val > m_minCountTarget)
-					{	commonKmersHT.addElement(s_kmer, m_targetsID[t].second, (size_t) val);}
+					const uint64_t quotient = m_htSize.quotient(kmers[i]);
+					BuildRecord record;
+					record.key = (HKMERr) quotient;
+					record.bucket = kmers[i] - quotient * m_htSize.size;
+					record.target = toRead[first + t];
+					record.count = counts.empty() ? 1 : counts[i];
+					record.occurrences = 1;
+					parts[p].push_back(record);
 				}
-				fclose(fd);
-				cerr << "\r Progress report: (" <<t+1<< "/"<<m_targetsID.size()<<")              ";
 			}
+			isFull = isFull || parts[p].size() >= partRecords;
 		}
-		cerr << nt << " nt read in total." << endl;
-		cerr << "Mother Hashtable successfully built. " << commonKmersHT.Size() << " " << m_kmerSize << "-mers stored." <<  endl;
-		size_t sizeMotherTable = commonKmersHT.Size();
-
-		commonKmersHT.SortAllHashTable(2);
-		commonKmersHT.RemoveCommon(m_labels_c, m_minCountTarget);
-		char * cfname = (char*) calloc(130, sizeof(char));
-		getdbName(cfname);
-		cerr << "Creating database in disk..." << endl;	
-		uint64_t nbElement = commonKmersHT.Write(cfname,2);
-		free(cfname);
-		cfname = NULL;
-		cerr << nbElement << " " << m_kmerSize << "-mers successfully stored in database." << endl;
-
-		return sizeMotherTable;
+		if (isFull && !runs.addRun(parts))
+		{	exit(-1);	}
+		cerr << "\r Progress report: (" << first + numTargets << "/" << toRead.size() << ")              ";
 	}
-	///////////////////////////////////////////////////////////////////////////////
-	EHashtable<HKMERr, Element> commonKmersHT(m_kmerSize, m_labels, m_labels_c);
-	for(size_t t = 0 ; t < m_targetsID.size(); t++)
+	targets.clear();
+	bool isEmpty = true;
+	for(size_t p = 0; p < numParts; p++)
+	{	isEmpty = isEmpty && parts[p].empty();	}
+	if ((!isEmpty || runs.numRuns() == 0) && !runs.addRun(parts))
+	{	exit(-1);	}
+	cerr << nt << " nt read in total." << endl;
+	cerr << runs.numRuns() << " sorted runs of k-mers written." << endl;
+
+	//// merge of the runs, elements kept for the database or the targets-specific k-mers files
+	if (!runs.startResults(m_update))
+	{	exit(-1);	}
+	const size_t mergeRecords = buildMemory / sizeof(BuildRecord) / numThreads / runs.numRuns();
+	uint64_t sizeMotherTable = 0, nbElement = 0, nbSpec = 0, nbStored = 0;
+	bool success = true;
+	#pragma omp parallel for schedule(dynamic) reduction(+:sizeMotherTable,nbElement,nbSpec,nbStored)
+	for(size_t p = 0; p < numParts; p++)
 	{
-		FILE* fd = fopen(m_targetsID[t].first.c_str(),"r");
-		if (fd == NULL)
+		RunMerger merger(runs, p, mergeRecords);
+		const size_t bufferRecords = std::max<size_t>(mergeRecords, BUILDMERGEBUFFER);
+		std::vector<BuildResult> results;
+		results.reserve(bufferRecords);
+		std::vector<BuildRecord> occurrences, kmer;
+		while (!merger.empty())
 		{
-			cerr << "Failed to open " << m_targetsID[t].first << endl;
+			// occurrences of a k-mer, without removed targets, in the order of the targets
+			kmer.clear();
+			const BuildRecord record = merger.top();
+			while (!merger.empty() && merger.top().bucket == record.bucket && merger.top().key == record.key)
+			{
+				if (merger.top().target != BUILDREMOVED)
+				{	kmer.push_back(merger.top());	}
+				merger.pop();
+			}
+			if (kmer.empty())
+			{	continue;	}
+			std::sort(kmer.begin(), kmer.end());
+			ELMTr e;
+			e.Set(targetLabels[kmer[0].target], kmer[0].count);
+			for(size_t i = 0; i < kmer.size(); i++)
+			{
+				for(uint32_t o = i == 0 ? 1 : 0; o < kmer[i].occurrences; o++)
+				{	updateElement(e, labels[e.GetLabel()], labels[targetLabels[kmer[i].target]], kmer[i].count);	}
+				if (m_update)
+				{	occurrences.push_back(kmer[i]);	}
+			}
+			if (m_update && occurrences.size() >= bufferRecords)
+			{
+				success = runs.addOccurrences(p, occurrences) && success;
+				occurrences.clear();
+			}
+			sizeMotherTable++;
+
+			BuildResult result;
+			result.key = record.key;
+			result.bucket = record.bucket;
+			result.count = e.GetCount();
+			result.label = e.GetLabel();
+			result.multiplicity = e.GetMultiplicity();
+			markSpecific(e, labels, mapLbls, m_labels_c, m_minCountTarget, nbElement, nbSpec);
+			result.dbLabel = e.GetLabel();
+			result.marked = e.Marked() ? 1 : 0;
+			if (result.marked)
+			{	nbStored++;	}
+			else if (!saveFiles || result.multiplicity > 2)
+			{	continue;	}
+			results.push_back(result);
+			if (results.size() == results.capacity())
+			{
+				success = runs.addResults(p, results) && success;
+				results.clear();
+			}
 		}
-		else
+		success = runs.addResults(p, results) && success;
+		if (m_update)
+		{	success = runs.addOccurrences(p, occurrences) && success;	}
+	}
+	if (!success)
+	{	exit(-1);	}
+	cerr << "Mother Hashtable successfully built. " << sizeMotherTable << " " << m_kmerSize << "-mers stored." <<  endl;
+	cerr <<"Removal of common k-mers done: "<<nbElement+nbSpec<<" specific "<< m_kmerSize<<"-mers found";
+	if (m_labels_c.size() > 0)
+	{	cerr << " including "<<nbSpec<<" in centromeres."<<endl;	}
+	else 
+	{	cerr << "." << endl;	}
+	//// database and targets-specific k-mers files, in the order of the buckets
+	if (m_isLightLoading)
+	{	cerr << "Creating light database in disk..." << endl;	}
+	else
+	{	cerr << "Creating database in disk..." << endl;	}
+	std::string dbFilename = std::string(cfname) + ".db";
+	DbWriter writer;
+	if (!writer.open(dbFilename.c_str(), m_k, sizeof(HKMERr), m_htSize.size, labels.size() - 1, nbStored, 1, m_layout))
+	{	exit(-1);	}
+	std::vector<BuildResult> results;
+	std::vector<size_t> fileOfLabel, fileOfLabelC;
+	std::vector<uint64_t> numKmers(_filesHT.size() + _filesHTC.size(), 0);
+	std::vector<TskWriter> tskWriters(saveFiles ? numKmers.size() : 0);
+	if (saveFiles)
+	{
+		// k-mers per file counted first, to place the sections of the files
+		getSpecificKmersFiles(labels, fileOfLabel, fileOfLabelC);
+		for(size_t p = 0; p < numParts; p++)
 		{
-			char c[MAXRSIZE];
-			size_t len = fread(&c, 1, MAXRSIZE, fd), i = 0;
-			uint64_t _km_f = 0, _km_r = 0;
-			bool _isfull = false;
-			uint8_t cpt = 0;
-			if (len > 0 && c[0] == '>')
+			for(uint64_t r = 0; r < runs.numResults(p); r += results.size())
 			{
-				while (len != 0)
-				{
-					while( i < len)
-					{
-						if (m_table[c[i]] >= 0)
-						{
-							nt++;
-							if (_isfull)
-							{
-								_km_f >>= 2;
-								_km_f += m_powerTable[cpt][m_table[c[i]]];
-
-								/////////////////////////////////////////////////////////////////////
-								commonKmersHT.addElement(_km_f, m_targetsID[t].second, 1);
-								///////////////////////////////////////////////////////////////////////
-								i++;
-								continue;
-							}
-							_km_r <<= 2;    
-							_km_r += 3 - m_table[c[i]];
-							if (cpt == m_kmerSize - 1)
-							{       _isfull = true;
-								//[/////////////////////////////////////////////////////////////////////
-								commonKmersHT.addElement(_km_r, m_targetsID[t].second, 1);
-								//]//////////////////////////////////////////////////////////////////////
-								_km_f = _km_r;
-								// The following 6 lines come from Jellyfish source code
-								_km_f = ((_km_f >> 2)  & 0x3333333333333333UL) | ((_km_f & 0x3333333333333333UL) << 2);
-								_km_f = ((_km_f >> 4)  & 0x0F0F0F0F0F0F0F0FUL) | ((_km_f & 0x0F0F0F0F0F0F0F0FUL) << 4);
-								_km_f = ((_km_f >> 8)  & 0x00FF00FF00FF00FFUL) | ((_km_f & 0x00FF00FF00FF00FFUL) << 8);
-								_km_f = ((_km_f >> 16) & 0x0000FFFF0000FFFFUL) | ((_km_f & 0x0000FFFF0000FFFFUL) << 16);
-								_km_f = ( _km_f >> 32                        ) | ( _km_f                        << 32);
-								_km_f = (((uint64_t)-1) - _km_f) >> (64 - (m_k << 1));
-								i++;
-								continue;
-							}
-							cpt++;  i++;
-							continue;
-						}
-						if (m_table[c[i]] == -10)
-						{       i++;
-							continue;   }
-						if (m_table[c[i]] == -1)
-						{        nt++; _km_r = 0; cpt = 0; _isfull = false; i++;
-							continue;  }
-						if (m_table[c[i]] == -2)
-						{
-							_km_r = 0; cpt = 0; _isfull = false;
-							while (len != 0)
-							{
-								while(i < len && c[i] != '\n')  {       i++;}
-								if (i < len)            {   break;}
-								len = fread(&c, 1, MAXRSIZE, fd );
-								i = 0;
-							}
-							i++;
-							continue;
-						}
-						cerr << m_targetsID[t].first << ": " ;
-						cerr << "Failed to process sequence -- wrong character found [ASCII]: " << (size_t) c << endl;
-					}
-					len = fread(&c, 1, MAXRSIZE, fd );
-					i = 0;
+				results.resize(std::max<size_t>(buildMemory / sizeof(BuildResult), BUILDMERGEBUFFER));
+				if (!runs.readResults(p, r, results))
+				{	exit(-1);	}
+				saveSpecificKmers(fileOfLabel, fileOfLabelC, results, numKmers, NULL);
+			}
+		}
+		for(size_t t = 0; t < tskWriters.size(); t++)
+		{
+			const string& file = t < _filesHT.size() ? _filesHT[t] : _filesHTC[t - _filesHT.size()];
+			if (!tskWriters[t].open(file.c_str(), m_k, m_htSize.size, numKmers[t]))
+			{	exit(-1);	}
+		}
+	}
+	uint64_t bucket = 0;
+	for(size_t p = 0; p < numParts; p++)
+	{
+		for(uint64_t r = 0; r < runs.numResults(p); r += results.size())
+		{
+			results.resize(std::max<size_t>(buildMemory / sizeof(BuildResult), BUILDMERGEBUFFER));
+			if (!runs.readResults(p, r, results))
+			{	exit(-1);	}
+			if (saveFiles)
+			{	saveSpecificKmers(fileOfLabel, fileOfLabelC, results, numKmers, &tskWriters);	}
+			for(size_t i = 0; i < results.size(); i++)
+			{
+				for(; bucket < results[i].bucket; bucket++)
+				{	writer.endBucket();	}
+				if (results[i].marked)
+				{
+					const HKMERr key = results[i].key;
+					writer.add(&key, results[i].dbLabel);
 				}
-				fclose(fd);
-				cerr << "\r Progress report: (" <<t+1<< "/"<<m_targetsID.size()<<")    ";
-				continue;
 			}
-			if (len > 0 && c[0] == '@')
+		}
+	}
+	for(; bucket < m_htSize.size; bucket++)
+	{	writer.endBucket();	}
+	if (!writer.close())
+	{	exit(-1);	}
+	for(size_t t = 0; t < tskWriters.size(); t++)
+	{
+		if (!tskWriters[t].close())
+		{	exit(-1);	}
+	}
+	cerr << nbStored << " " << m_kmerSize << "-mers successfully stored in database." << endl;
+
+	//// occurrences of all targets, for the next update
+	if (m_update)
+	{
+		OccWriter occWriter;
+		if (!occWriter.open(ofname, m_k, m_htSize.size, occTargets))
+		{	exit(-1);	}
+		std::vector<BuildRecord> records;
+		for(size_t p = 0; p < numParts; p++)
+		{
+			for(uint64_t r = 0; r < runs.numOccurrences(p); r += records.size())
 			{
-				while (len != 0)
+				records.resize(std::max<size_t>(buildMemory / sizeof(BuildRecord), BUILDMERGEBUFFER));
+				if (!runs.readOccurrences(p, r, records))
+				{	exit(-1);	}
+				occWriter.add(records);
+			}
+		}
+		if (!occWriter.close())
+		{	exit(-1);	}
+		cerr << "K-mer occurrences of the targets stored for the next update." << endl;
+	}
+	runs.close();
+	free(cfname);
+	free(ofname);
+	cfname = NULL;
+	ofname = NULL;
+
+	return sizeMotherTable;
+}
+
+/**
+ *  Targets-specific k-mers file of the elements of each label, (size_t) -1 for none:
+ *  elements of multiplicity 1 go to the file of their label, elements of multiplicity 2
+ *  to the file of the centromere of their chromosome (labels differing only in the last
+ *  character), files of centromeres after the files of labels.
+ */
+template <typename HKMERr>
+void CuCLARK<HKMERr>::getSpecificKmersFiles(const vector<string>& _labels, vector<size_t>& _fileOfLabel, vector<size_t>& _fileOfLabelC) const
+{
+	_fileOfLabel.assign(_labels.size(), (size_t) -1);
+	_fileOfLabelC.assign(_labels.size(), (size_t) -1);
+	for(size_t l = 0; l < _labels.size(); l++)
+	{
+		const string& Lbl = _labels[l];
+		for(size_t t = 0; t < m_labels.size() && _fileOfLabel[l] == (size_t) -1; t++)
+		{
+			if (m_labels[t] == Lbl)
+			{	_fileOfLabel[l] = t;	}
+		}
+		for(size_t i_lbl = 0; Lbl.size() > 0 && i_lbl < m_labels_c.size(); i_lbl++)
+		{
+			const string& label = m_labels_c[i_lbl];
+			bool sameChr = Lbl.size() == label.size();
+			for(size_t t = 0 ; sameChr && t < Lbl.size() - 1 ; t++ )
+			{       sameChr = sameChr && Lbl[t] == label[t];}
+			if (sameChr)
+			{
+				_fileOfLabelC[l] = m_labels.size() + i_lbl;
+				break;
+			}
+		}
+	}
+}
+
+/**
+ *  K-mers of the out-of-core creation for the targets-specific k-mers files
+ *  (see EHashtable::SaveMultiple and EHashtable::SaveIntersectionMultiple):
+ *  counted in _numKmers, or added to the files if _writers is given.
+ */
+template <typename HKMERr>
+void CuCLARK<HKMERr>::saveSpecificKmers(const vector<size_t>& _fileOfLabel, const vector<size_t>& _fileOfLabelC, const vector<BuildResult>& _results, vector<uint64_t>& _numKmers, vector<TskWriter>* _writers) const
+{
+	for(size_t i = 0; i < _results.size(); i++)
+	{
+		const BuildResult& e = _results[i];
+		size_t file;
+		if (e.multiplicity <= 1)
+		{	file = _fileOfLabel[e.label];	}
+		else if (e.multiplicity == 2)
+		{	file = _fileOfLabelC[e.label];	}
+		else
+		{	continue;	}
+		if (file == (size_t) -1)
+		{	continue;	}
+		if (_writers == NULL)
+		{	_numKmers[file]++;	}
+		else
+		{	(*_writers)[file].add(e.bucket + e.key * m_htSize.size, e.count);	}
+	}
+}
+
+/**
+ *  Add a k-mer of a target to the partition of its bucket.
+ *  Returns the partition.
+ */
+template <typename HKMERr>
+inline size_t CuCLARK<HKMERr>::addTargetKmer(const uint64_t& _kmerC, const HtSize& _partSize, TargetKmers& _target) const
+{
+	const uint64_t remainder = _kmerC - m_htSize.quotient(_kmerC) * m_htSize.size;
+	const size_t part = _partSize.quotient(remainder);
+	_target.kmers[part].push_back(_kmerC);
+	return part;
+}
+
+/**
+ *  Canonical form of a k-mer.
+ */
+template <typename HKMERr>
+inline uint64_t CuCLARK<HKMERr>::canonicalKmer(const uint64_t& _kmer) const
+{
+	uint64_t _kmerR = _kmer;
+	// The following 6 lines come from Jellyfish source code
+	_kmerR = ((_kmerR >> 2)  & 0x3333333333333333UL) | ((_kmerR & 0x3333333333333333UL) << 2);
+	_kmerR = ((_kmerR >> 4)  & 0x0F0F0F0F0F0F0F0FUL) | ((_kmerR & 0x0F0F0F0F0F0F0F0FUL) << 4);
+	_kmerR = ((_kmerR >> 8)  & 0x00FF00FF00FF00FFUL) | ((_kmerR & 0x00FF00FF00FF00FFUL) << 8);
+	_kmerR = ((_kmerR >> 16) & 0x0000FFFF0000FFFFUL) | ((_kmerR & 0x0000FFFF0000FFFFUL) << 16);
+	_kmerR = ( _kmerR >> 32                        ) | ( _kmerR                        << 32);
+	_kmerR = (((uint64_t)-1) - _kmerR) >> (64 - (m_k << 1));
+	return _kmer < _kmerR ? _kmer : _kmerR;
+}
+
+/**
+ *  Read the k-mers of target _t (fasta, fastq or spectrum file),
+ *  in canonical form and divided into partitions of buckets.
+ *  For the light database, only every m_iterKmers-th non-overlapping k-mer is kept.
+ *  With minimizers, only the (w,k)-minimizers of the sequences are kept, for the light
+ *  database too. The k-mers of spectrum files have no positions, they are kept as before.
+ *  Returns the number of nucleotides read.
+ */
+template <typename HKMERr>
+size_t CuCLARK<HKMERr>::getTargetKmers(const size_t& _t, const HtSize& _partSize, const size_t& _numParts, TargetKmers& _target) const
+{
+	_target.label = m_targetsID[_t].second;
+	_target.kmers.assign(_numParts, std::vector<uint64_t>());
+	_target.counts.assign(_numParts, std::vector<ITYPE>());
+
+	FILE* fd = fopen(m_targetsID[_t].first.c_str(),"r");
+	if (fd == NULL)
+	{
+		cerr << "Failed to open " << m_targetsID[_t].first << endl;
+		return 0;
+	}
+	std::vector<char> buffer(TARGETREADSIZE);
+	char* c = &buffer[0];
+	size_t len = fread(c, 1, TARGETREADSIZE, fd);
+	const bool isFasta = len > 0 && c[0] == '>';
+	const bool isFastq = len > 0 && c[0] == '@';
+	size_t nt = 0;
+
+	if (isFasta || isFastq)
+	{
+		uint64_t _km_f = 0, _km_r = 0;		// kmer, reverse kmer
+		bool _isfull = false;
+		uint8_t cpt = 0;					// kmer length
+		uint64_t iter = 0;					// kmers seen (light database)
+		uint64_t kmerC;
+		MinimizerWindow window(m_minimizerWindow);
+		size_t skipLines = isFastq ? 1 : 0;	// header, or separator, quality and header of fastq
+		while (len != 0)
+		{
+			for(size_t i = 0; i < len; i++)
+			{
+				if (skipLines > 0)
 				{
-					while(i < len && c[i] != '\n')            {       i++;}
-					if (i < len)      {   break;}
-					len = fread(&c, 1, MAXRSIZE, fd );
-					i = 0;
+					skipLines -= c[i] == '\n' ? 1 : 0;
+					continue;
 				}
-				i++;
-				while (len != 0)
+				const int v = m_table[(uint8_t) c[i]];
+				if (v >= 0)		// process read
 				{
-					while( i < len)
+					nt++;
+					if (m_isLightLoading && m_minimizerWindow == 0)
 					{
-						if (m_table[c[i]] >= 0)
-						{
-							nt++;
-							if (_isfull)
-							{
-								_km_f >>= 2; 
-								_km_f += m_powerTable[cpt][m_table[c[i]]];
-
-								/////////////////////////////////////////////////////////////////////
-								commonKmersHT.addElement(_km_f, m_targetsID[t].second, 1);
-								///////////////////////////////////////////////////////////////////////
-								i++;
-								continue;
-							}
-							_km_r <<= 2;    
-							_km_r += 3 - m_table[c[i]];
-							if (cpt  == m_kmerSize - 1)
-							{       _isfull = true;
-								//[/////////////////////////////////////////////////////////////////////
-								commonKmersHT.addElement(_km_r, m_targetsID[t].second, 1);
-								//]//////////////////////////////////////////////////////////////////////
-								_km_f = _km_r;
-								// The following 6 lines come from Jellyfish source code
-								_km_f = ((_km_f >> 2)  & 0x3333333333333333UL) | ((_km_f & 0x3333333333333333UL) << 2);
-								_km_f = ((_km_f >> 4)  & 0x0F0F0F0F0F0F0F0FUL) | ((_km_f & 0x0F0F0F0F0F0F0F0FUL) << 4);
-								_km_f = ((_km_f >> 8)  & 0x00FF00FF00FF00FFUL) | ((_km_f & 0x00FF00FF00FF00FFUL) << 8);
-								_km_f = ((_km_f >> 16) & 0x0000FFFF0000FFFFUL) | ((_km_f & 0x0000FFFF0000FFFFUL) << 16);
-								_km_f = ( _km_f >> 32                        ) | ( _km_f                        << 32);
-								_km_f = (((uint64_t)-1) - _km_f) >> (64 - (m_k << 1));
-
-								i++;
-								continue;
-							}
-							cpt++;
-							i++;
-							continue;
-						}
-						if (m_table[c[i]] == -10)
+						_km_r <<= 2;
+						_km_r += 3 - v;
+						if (cpt == m_kmerSize - 1)		// kmer complete
 						{
-							_km_r = 0; cpt = 0; _isfull = false;
-							// Pass third line
-							i++;
-							while (len != 0)
-							{
-								while(i < len && c[i] != '\n')          {       i++;}
-								if (i < len)            {   break;}
-								len = fread(&c, 1, MAXRSIZE, fd );
-								i = 0;
-							}
-							i++;
-							// Pass fouth line
-							while (len != 0)
-							{
-								while(i < len && c[i] != '\n')         {       i++;}
-								if (i < len)         {   break;}
-								len = fread(&c, 1, MAXRSIZE, fd );
-								i = 0;
-							}
-							i++;
-							// Pass first line
-							while (len != 0)
-							{
-								while(i < len && c[i] != '\n')        {       i++;}
-								if (i < len){   break;}
-								len = fread(&c, 1, MAXRSIZE, fd );
-								i = 0;
-							}
-							i++;
+							if (iter % m_iterKmers == 0)	// skip kmers for light loading
+							{	addTargetKmer(canonicalKmer(_km_r), _partSize, _target);	}
+							_km_r = 0; cpt = 0;			// non-overlapping kmers
+							iter++;
 							continue;
 						}
-						if (m_table[c[i]] == -1)
-						{       nt++;  _km_r = 0; cpt = 0; _isfull = false;
-							i++;
-							continue;
-						}
-						cerr << m_targetsID[t].first << ": " ;
-						cerr << "Failed to process sequence -- wrong character found [ASCII]: " << (size_t) c << endl;
+						cpt++;
+						continue;
+					}
+					if (_isfull)
+					{
+						_km_f >>= 2;
+						_km_f += m_powerTable[cpt][v];
+						kmerC = canonicalKmer(_km_f);
+						if (m_minimizerWindow == 0 || window.push(kmerC, kmerC))
+						{	addTargetKmer(kmerC, _partSize, _target);	}
+						continue;
 					}
-					len = fread(&c, 1, MAXRSIZE, fd );
-					i = 0;
+					_km_r <<= 2;
+					_km_r += 3 - v;
+					if (cpt == m_kmerSize - 1)
+					{
+						_isfull = true;
+						kmerC = canonicalKmer(_km_r);
+						if (m_minimizerWindow == 0 || window.push(kmerC, kmerC))
+						{	addTargetKmer(kmerC, _partSize, _target);	}
+						_km_f = _km_r;
+						// The following 6 lines come from Jellyfish source code
+						_km_f = ((_km_f >> 2)  & 0x3333333333333333UL) | ((_km_f & 0x3333333333333333UL) << 2);
+						_km_f = ((_km_f >> 4)  & 0x0F0F0F0F0F0F0F0FUL) | ((_km_f & 0x0F0F0F0F0F0F0F0FUL) << 4);
+						_km_f = ((_km_f >> 8)  & 0x00FF00FF00FF00FFUL) | ((_km_f & 0x00FF00FF00FF00FFUL) << 8);
+						_km_f = ((_km_f >> 16) & 0x0000FFFF0000FFFFUL) | ((_km_f & 0x0000FFFF0000FFFFUL) << 16);
+						_km_f = ( _km_f >> 32                        ) | ( _km_f                        << 32);
+						_km_f = (((uint64_t)-1) - _km_f) >> (64 - (m_k << 1));
+						continue;
+					}
+					cpt++;
+					continue;
 				}
-				fclose(fd);
-				cerr << "\r Progress report: (" <<t+1<< "/"<<m_targetsID.size()<<")              ";
-				continue;
+				if (v == -10)	// c[i] == '\n', end of the sequence line of fastq
+				{
+					if (isFastq)
+					{
+						_km_r = 0; cpt = 0; _isfull = false; window.reset();
+						skipLines = 3;
+					}
+					continue;
+				}
+				if (v == -2 && isFasta)		// c[i] == '>', skip header line
+				{
+					_km_r = 0; cpt = 0; _isfull = false; window.reset();
+					skipLines = 1;
+					continue;
+				}
+				// unknown nucleotide, reset kmer
+				nt++;
+				_km_r = 0; cpt = 0; _isfull = false; window.reset();
 			}
-			// spectrum form
-			fseek(fd, 0, 0);
-			string s_kmer = "";
-			ITYPE val;
-			while (getFirstAndSecondElementInLine(fd, s_kmer, val))
-			{       if (val > m_minCountTarget)
-				{       commonKmersHT.addElement(s_kmer, m_targetsID[t].second, (size_t) val);}
+			len = fread(c, 1, TARGETREADSIZE, fd);
+		}
+		fclose(fd);
+		return nt;
+	}
+	// spectrum form
+	fseek(fd, 0, 0);
+	string s_kmer = "";
+	ITYPE val;
+	uint8_t counter = 0;
+	size_t otherLength = 0;
+	while (getFirstAndSecondElementInLine(fd, s_kmer, val))
+	{
+		if ((!m_isLightLoading || counter % m_iterKmers == 0) && val > m_minCountTarget)
+		{
+			// k-mers of another length do not fit the keys of the database
+			if (s_kmer.size() == m_kmerSize)
+			{
+				uint64_t kmerIndex = 0, rev_kmerIndex = 0;
+				vectorToIndex(s_kmer, kmerIndex);
+				getReverseComplement(s_kmer, rev_kmerIndex);
+				const size_t part = addTargetKmer(kmerIndex < rev_kmerIndex ? kmerIndex : rev_kmerIndex, _partSize, _target);
+				_target.counts[part].push_back(val);
 			}
-			fclose(fd);
-			cerr << "\r Progress report: (" <<t+1<< "/"<<m_targetsID.size()<<")              ";
+			else
+			{	otherLength++;	}
+			counter = 0;
 		}
+		counter++;
 	}
-	cerr << nt << " nt read in total." << endl;
-	cerr << "Mother Hashtable successfully built. " << commonKmersHT.Size() << " " << m_kmerSize << "-mers stored." <<  endl;
-	size_t sizeMotherTable = commonKmersHT.Size();
-	//
-	commonKmersHT.SaveIntersectionMultiple(_filesHTC, m_labels_c);
-	commonKmersHT.SaveMultiple(_filesHT, m_labels);
-	//
-	commonKmersHT.SortAllHashTable(2);
-	commonKmersHT.RemoveCommon(m_labels_c, m_minCountTarget);
-	char * cfname = (char*) calloc(130, sizeof(char));
-	getdbName(cfname);
-	cerr << "Creating database in disk..." << endl;
-	uint64_t nbElement = commonKmersHT.Write(cfname,2);
-	free(cfname);
-	cfname = NULL;
-	cerr << nbElement << " " << m_kmerSize << "-mers successfully stored in database." << endl;
+	fclose(fd);
+	if (otherLength > 0)
+	{
+		cerr << otherLength << " k-mers of another length than " << m_kmerSize << " skipped in "
+			 << m_targetsID[_t].first << endl;
+	}
+	return nt;
+}
 
-	return sizeMotherTable;
-	///////////////////////////////////////////////////////////////////////////////
+/**
+ * Find the first read starting at or after _i.
+ * Return the position after its '>' or '@', at least nb if there is none.
+ */
+template <typename HKMERr>
+size_t CuCLARK<HKMERr>::findRead(const uint8_t * _map, const size_t& nb, size_t _i, const bool _isFasta) const
+{
+	size_t i = _i, posRead = nb;
+	if (_isFasta)		// fasta
+	{
+		while (i < nb && !(_map[i] == '>' && _map[i-1] == '\n'))
+		{	i++;	}
+		posRead = i+1;
+	}
+	else				// fastq
+	{
+		size_t pos[6];
+		for(size_t l = 0; l < 6; l++)
+		{
+			while (i < nb && _map[i++] != '\n')
+			{       }
+			pos[l] = i;
+		}
+		// a read starts with '@', followed by a line of letters and a '+'
+		for(size_t l = 0; l < 4; l++)
+		{
+			if (_map[pos[l]] == '@')
+			{
+				i = pos[l+1];
+				while (m_Letter[_map[i++]] >= 0)
+				{}
+				if (i == pos[l+2] && _map[i] == '+')
+				{
+					posRead = pos[l]+1;
+					break;
+				}
+			}
+		}
+	}
+	return posRead;
+}
+
+/**
+ * Number of minimizers of a read stored in containers, the k-mers
+ * queried with --minimizer: each part is a new sequence of k-mers, cf.
+ * CpuClarkDB::queryRead.
+ */
+template <typename HKMERr>
+uint32_t CuCLARK<HKMERr>::countMinimizers(const CONTAINER * _readInContainers, const uint32_t _numContainers) const
+{
+	const size_t nucsPerContainer = sizeof(CONTAINER)*4;
+	const uint64_t cutoff = (uint64_t)-1 >> (64 - 2*m_kmerSize);
+	MinimizerWindow window(m_minimizerWindow);
+	uint32_t count = 0;
+	uint64_t minimizer;
+
+	for (uint32_t partPointer = 0; partPointer < _numContainers; )
+	{
+		const CONTAINER partLength = _readInContainers[partPointer];
+		const CONTAINER* part = &_readInContainers[++partPointer];
+		partPointer += (partLength-1) / nucsPerContainer +1;
+
+		uint64_t kmer = 0;
+		window.reset();
+		for (size_t n = 0; n < partLength; n++)
+		{
+			CONTAINER nuc = part[n/nucsPerContainer] >> 2*(nucsPerContainer-1-n%nucsPerContainer);
+			kmer = ((kmer << 2) | (nuc & 3)) & cutoff;
+			if (n+1 >= m_kmerSize && window.push(canonicalKmer(kmer), minimizer))
+				count++;
+		}
+	}
+	return count;
+}
+
+/**
+ * Add the containers of a read to _count, as they are stored by
+ * getObjectsDataComputeFullGPU: for each part of at least k bases,
+ * its length and its bases, four per byte. Parts of more than
+ * PARTMAXBASES bases are stored as parts of PARTMAXBASES bases
+ * overlapping by k-1 bases, and the rest.
+ * _peak is the most containers written while storing the read,
+ * as the parts too short are removed after they are stored.
+ */
+template <typename HKMERr>
+void CuCLARK<HKMERr>::countContainers(const uint8_t * _map, const size_t& _sPos, const size_t& _ePos, size_t& _count, size_t& _peak) const
+{
+	const size_t nucsPerContainer = sizeof(CONTAINER)*4;
+	size_t part = 0;
+	for (size_t i_c = _sPos; i_c <= _ePos; i_c++)
+	{
+		if (i_c < _ePos && m_table[_map[i_c]] >= 0)
+		{
+			part++;
+			continue;
+		}
+		if (i_c < _ePos && _map[i_c] == '\n')
+			continue;
+		// part ends, its length is stored in a container
+		if (part > 0)
+		{
+			// a part of more than PARTMAXBASES bases is split, the next part starts with the last k-1 bases
+			while (part > PARTMAXBASES)
+			{
+				_count += 1 + (PARTMAXBASES + nucsPerContainer-1)/nucsPerContainer;
+				part -= PARTMAXBASES - (m_kmerSize-1);
+			}
+			size_t partContainers = 1 + (part + nucsPerContainer-1)/nucsPerContainer;
+			if (part >= m_kmerSize)
+			{
+				_count += partContainers;
+			}
+			else if (_count + partContainers + 1 > _peak)
+			{
+				// and the length of the next part
+				_peak = _count + partContainers + 1;
+			}
+		}
+		part = 0;
+	}
+	if (_count > _peak)
+		_peak = _count;
 }
 
 /**
@@ -1334,17 +1666,37 @@ size_t CuCLARK<HKMERr>::makeSpecificTargetSets(const vector<string>& _filesHT, c
 template <typename HKMERr>
 void CuCLARK<HKMERr>::getObjectsDataComputeFullGPU(const uint8_t * _map,  const size_t&   nb, const char* _fileResult)
 {
-	// find and store the start and end of each reads name,
-	// the start and end of each read and its length
 	size_t i_r = 0, bigSteps = 1 + nb / m_numBatches, lastSize = 0;
-	if (_map[0] == '>')			// fasta
+	const bool isFasta = _map[0] == '>';
+	if (!isFasta && _map[0] != '@')
+	{ 
+		cerr << "Failed to recognize the format of the file." << endl; exit(-1) ;
+	}
+
+	// find the first read of each batch (position after '>' or '@'),
+	// drop batches without reads (small chunks)
+	size_t numBatches = 1;
+	m_posReads[0] = 1;
+	for(i_r = 1; i_r < m_numBatches ; i_r++)
+	{
+		size_t posRead = findRead(_map, nb, bigSteps * i_r, isFasta);
+		if (posRead < nb && posRead > m_posReads[numBatches-1])
+			m_posReads[numBatches++] = posRead;
+	}
+
+	// find and store the start and end of each reads name,
+	// the start and end of each read and its length,
+	// count the containers of each batch
+	vector<size_t> numContainers(numBatches, 0), numContainersPeak(numBatches, 0);
+	if (isFasta)			// fasta
 	{
 #ifdef _OPENMP
 #pragma omp parallel for private(i_r) firstprivate(lastSize)
 #endif
-		for (i_r = 0; i_r < m_numBatches ; i_r++)
+		for (i_r = 0; i_r < numBatches ; i_r++)
 		{
-			size_t i = bigSteps * i_r, i_l = 0, bigMax = bigSteps*(i_r+1);
+			size_t iNext = i_r+1 < numBatches ? m_posReads[i_r+1]-1: nb;
+			size_t i = m_posReads[i_r], i_l = 0;
 			
 			vector<size_t>	readsLength;
 			vector<size_t>	seqSNames;
@@ -1361,8 +1713,6 @@ void CuCLARK<HKMERr>::getObjectsDataComputeFullGPU(const uint8_t * _map,  const
 				readsEPos.reserve(lastSize);
 			}	
 				
-			while (_map[i++] != '>')
-			{}
 			while (true)
 			{
 				readsLength.push_back(0);
@@ -1387,7 +1737,9 @@ void CuCLARK<HKMERr>::getObjectsDataComputeFullGPU(const uint8_t * _map,  const
 				}
 				readsLength[i_l] *= -1;
 				readsLength[i_l] += readsEPos[i_l] -  readsSPos[i_l] + 1;
-				if ((i >= bigMax && _map[i] == '>' )|| i >= nb)
+				if (readsLength[i_l] >= m_kmerSize)
+					countContainers(_map, readsSPos[i_l], readsEPos[i_l], numContainers[i_r], numContainersPeak[i_r]);
+				if (i >= iNext)
 				{       break;}
 				i++;
 				i_l++;
@@ -1402,80 +1754,14 @@ void CuCLARK<HKMERr>::getObjectsDataComputeFullGPU(const uint8_t * _map,  const
 			lastSize = m_readsLength[i_r].size()*1.05;
 		}
 	}
-	else if (_map[0] == '@')		// fastq
+	else					// fastq
 	{
-		m_posReads[0] = 1;
-		size_t pos1, pos2, pos3, pos4, pos5, pos6;
-		for(i_r = 1; i_r < m_numBatches ; i_r++)
-		{
-			size_t i = bigSteps * i_r;
-			while (i < nb && _map[i++] != '\n')
-			{       }
-			pos1 = i;
-			while (i < nb && _map[i++] != '\n')
-			{       }
-			pos2 = i;
-			while (i < nb && _map[i++] != '\n')
-			{       }
-			pos3 = i;
-			while (i < nb && _map[i++] != '\n')
-			{       }
-			pos4 = i;
-			while (i < nb && _map[i++] != '\n')
-			{       }
-			pos5 = i;
-			while (i < nb && _map[i++] != '\n')
-			{       }
-			pos6 = i;
-			if (_map[pos1] == '@')
-			{
-				i = pos2;
-				while (m_Letter[_map[i++]] >= 0)
-				{}
-				if (i == pos3 && _map[i] == '+')
-				{
-					m_posReads[i_r] = pos1+1;
-					continue;
-				}
-			}
-			if (_map[pos2] == '@')
-			{
-				i = pos3;
-				while (m_Letter[_map[i++]] >= 0)
-				{}
-				if (i == pos4 && _map[i] == '+')
-				{       m_posReads[i_r] = pos2+1;
-					continue;
-				}
-			}
-			if (_map[pos3] == '@')
-			{
-				i = pos4;
-				while (m_Letter[_map[i++]] >= 0)
-				{}
-				if (i == pos5 && _map[i] == '+')
-				{       m_posReads[i_r] = pos3+1;
-					continue;
-				}
-			}
-			if (_map[pos4] == '@')
-			{
-				i = pos5;
-				while (m_Letter[_map[i++]] >= 0)
-				{}
-				if (i == pos6 && _map[i] == '+')
-				{       m_posReads[i_r] = pos4+1;
-					continue;
-				}
-			}
-		}
-
 #ifdef _OPENMP
 #pragma omp parallel for private(i_r) firstprivate(lastSize)
 #endif
-		for (i_r = 0; i_r < m_numBatches ; i_r++)
+		for (i_r = 0; i_r < numBatches ; i_r++)
 		{
-			size_t iNext = i_r+1 < m_numBatches ? m_posReads[i_r+1]: nb;
+			size_t iNext = i_r+1 < numBatches ? m_posReads[i_r+1]: nb;
 			size_t i = m_posReads[i_r], i_l = 0;
 
 			vector<size_t>	readsLength;
@@ -1511,6 +1797,8 @@ void CuCLARK<HKMERr>::getObjectsDataComputeFullGPU(const uint8_t * _map,  const
 				}
 				readsEPos[i_l] = i++;
 				readsLength.push_back(readsEPos[i_l] -  readsSPos[i_l]);
+				if (readsLength[i_l] >= m_kmerSize)
+					countContainers(_map, readsSPos[i_l], readsEPos[i_l], numContainers[i_r], numContainersPeak[i_r]);
 				// Pass third line
 				while (i < nb && _map[i++] != '\n')
 				{}
@@ -1532,10 +1820,6 @@ void CuCLARK<HKMERr>::getObjectsDataComputeFullGPU(const uint8_t * _map,  const
 			lastSize = m_readsLength[i_r].size()*1.05;
 		}
 	}
-	else 
-	{ 
-		cerr << "Failed to recognize the format of the file." << endl; exit(-1) ;
-	}
 	
 	// get index of first read in batch, count the number of all reads
 	vector<ITYPE> indexBatches;
@@ -1544,75 +1828,61 @@ void CuCLARK<HKMERr>::getObjectsDataComputeFullGPU(const uint8_t * _map,  const
 	size_t maxReads = 0;
 	for(size_t i = 0; i < m_numBatches; i++)
 	{
+		// dropped batches are empty
 		indexBatches[i+1] = indexBatches[i] + m_readsLength[i].size();
 		if(m_readsLength[i].size() > maxReads) maxReads = m_readsLength[i].size();
 	}
 	m_nbObjects = indexBatches.back();
 	
-	// get average read length for memory allocation
+	// containers of the largest batch, while it is stored
 	size_t numContainerMax = 0;
-#ifdef _OPENMP
-	#pragma omp parallel for
-#endif
-	for(size_t i = 0; i < m_numBatches; i++)
+	for(size_t i = 0; i < numBatches; i++)
 	{
-		size_t avgReadLength = 0;
-		for(size_t n = 0; n < m_readsLength[i].size(); n++)
-		{
-			avgReadLength += m_readsLength[i][n];
-		}	
-		avgReadLength = avgReadLength/m_readsLength[i].size() +1;
-		size_t numContainer = avgReadLength/(sizeof(CONTAINER)*4)+3;
 #ifdef DEBUG_BATCH
-		cerr << "Batch " << i << ": AVG read length " << avgReadLength
-			<< ", Estimated # containers per read: " << numContainer << "\n";
-#endif			
-
-		if(numContainer > numContainerMax)
-		{
-#ifdef _OPENMP
-			#pragma omp critical (numContainer)
-			if(numContainer > numContainerMax)
-#endif			
-				numContainerMax = numContainer;
-		}
+		cerr << "Batch " << i << ": # containers " << numContainers[i]
+			<< " (" << numContainersPeak[i] << " while stored)\n";
+#endif
+		if(numContainersPeak[i] > numContainerMax) numContainerMax = numContainersPeak[i];
 	}
 #ifdef DEBUG_BATCH
-	cerr << "Estimated # containers per read: " << numContainerMax << "\n";
+	cerr << "# containers of the largest batch: " << numContainerMax << "\n";
 #endif
 
 	// compact results
 	// need to store index and counter for each target hit, also sum
-	if (m_isLightLoading)
-		m_resultRowSize = 2*MAXHITS+2; 		// = 48, maximum used in light test 10M was 1+21*2=43
-	else
-		m_resultRowSize = 2*MAXHITS+2; 		// = 32, maximum used in normal test 10M was 1+2*10 = 21
+	m_resultRowSize = RESULTROWSIZE;	// = 48 light, 32 normal, maximum used in test 10M was 43 light, 21 normal
 		
 	// space for result vector (sumN, indexBest, best, index_sBest, s_best)
-	m_finalResultsRowSize = 5;
+	m_finalResultsRowSize = FINALROWSIZE;
 	
 	// the pointers to the containers
 	std::vector<uint32_t*> readsPointer;
 	// the part lengths and nucleotides for each read
 	std::vector<CONTAINER*> readsInContainers;
-	// allocate gpu mem
-	size_t total = m_cuClarkDb->malloc(m_nbObjects, maxReads, maxReads*numContainerMax,
+	// allocate gpu mem, one container more for the part length checked past the last read
+	size_t total = m_clarkDb->malloc(m_nbObjects, maxReads, numContainerMax+1,
 										indexBatches,
 										m_fullResults, m_resultRowSize,
 										m_finalResults, m_finalResultsRowSize,
 										m_isExtended,
 										readsPointer,
 										readsInContainers);
+
+	// results of the batches are written in order, when they are formatted
+	ResultWriter writer;
+	writer.open(_fileResult, numBatches);
+	if (m_nbObjectsTotal == 0) cerr << (m_isExtended ? "Writing extended results... " : "Writing results... ") << endl;
 	
 #ifdef _OPENMP
 	#pragma omp parallel
 #endif
 	{
+		std::string output;
 		
 #ifdef _OPENMP
 		#pragma omp for schedule(dynamic) //ordered//schedule(static,1) //private(i_r)
 #endif
-		for (i_r = 0; i_r < m_numBatches; i_r++)
+		for (i_r = 0; i_r < numBatches; i_r++)
 		{
 			CONTAINER _kmerContainer;
 			// going to store 4 nucleotides per byte
@@ -1639,6 +1909,23 @@ void CuCLARK<HKMERr>::getObjectsDataComputeFullGPU(const uint8_t * _map,  const
 					// part continues
 					if (m_table[_map[i_c]] >= 0)
 					{
+						// part full, its length is stored in a container:
+						// the part ends, the next one starts with its last k-1 bases
+						if (!_newSeq && myReadsInContainers[partBegin] + curNucs == PARTMAXBASES)
+						{
+							if (curNucs > 0)
+							{
+								_kmerContainer <<= 2*(nucsPerContainer-curNucs);
+								myReadsInContainers[containerCount++] = _kmerContainer;
+								myReadsInContainers[partBegin] += curNucs;
+							}
+							_kmerContainer = 0; curNucs = 0; _newSeq = true;
+							for (size_t back = m_kmerSize-1; back > 0; )
+							{
+								if (m_table[_map[--i_c]] >= 0) back--;
+							}
+							continue;
+						}
 						if (_newSeq)
 						{
 							// add element to store part length
@@ -1657,6 +1944,17 @@ void CuCLARK<HKMERr>::getObjectsDataComputeFullGPU(const uint8_t * _map,  const
 							
 							_newSeq = false;
 						}
+						// next eight bases at once if they all are nucleotides
+						CONTAINER _packed;
+						if (sizeof(CONTAINER)*4 == PACKBASES && i_c + PACKBASES <= m_readsEPos[i_r][i_lr]
+							&& myReadsInContainers[partBegin] + curNucs + PACKBASES <= PARTMAXBASES && packBases(_map + i_c, _packed))
+						{
+							myReadsInContainers[containerCount++] = (_kmerContainer << 2*(nucsPerContainer-curNucs)) | (_packed >> 2*curNucs);
+							myReadsInContainers[partBegin] += nucsPerContainer;
+							_kmerContainer = _packed;
+							i_c += PACKBASES;
+							continue;
+						}
 						_kmerContainer <<= 2;
 						_kmerContainer ^= m_rTable[_map[i_c]];
 						curNucs++;
@@ -1706,39 +2004,32 @@ void CuCLARK<HKMERr>::getObjectsDataComputeFullGPU(const uint8_t * _map,  const
 				_kmerContainer = 0; curNucs = 0; _newSeq = true;	
 			}
 			
-			if (containerCount > (uint32_t)-1)
-			{
-				cerr << "ERROR: Batch overflow. Please increase the number of batches (-b <numberofbatches>)." << endl;
-				exit(-1);
-			}	
-			
 			myReadsPointer[m_readsLength[i_r].size()] = containerCount;
+
+			// k-mers queried of each read, for the hit rate
+			if (m_minimizerWindow > 0)
+			{
+				m_readsQueried[i_r].resize(m_readsLength[i_r].size());
+				for (size_t i = 0; i < m_readsLength[i_r].size(); i++)
+					m_readsQueried[i_r][i] = countMinimizers(myReadsInContainers + myReadsPointer[i], myReadsPointer[i+1] - myReadsPointer[i]);
+			}
 			
-			float numContainerActual = (float)containerCount/m_readsLength[i_r].size();			
 #ifdef DEBUG_BATCH
 			cerr << "Batch " << i_r << "\t # Containers: " << containerCount
-				 << " (AVG # per read: " << numContainerActual << ").\n";
+				 << " (AVG # per read: " << (float)containerCount/m_readsLength[i_r].size() << ").\n";
 #endif			 
-			if (numContainerActual > numContainerMax)
-			{
-				cerr << "Bad container estimation. Abort." << endl;
-				exit(-1);
-			}		
 #ifdef DEBUG_BATCH
 			cerr 	<< "Host " << omp_get_thread_num()
 					<< " Batch " << i_r << "\t CUDA start.\t"
 					<< "Read data size: " << readsInContainers.size()*sizeof(CONTAINER) /1000 /1000.0 << " MB\t"
 					<< "Result data size: " << m_finalResultsRowSize*m_readsLength[i_r].size() /1000 /1000.0 << " MB\n";
 #endif				
-			// pass batch parameters to m_cuClarkDb			
-			m_cuClarkDb->readyBatch(i_r, m_readsLength[i_r].size(), containerCount);
+			// pass batch parameters to m_clarkDb			
+			m_clarkDb->readyBatch(i_r, m_readsLength[i_r].size(), containerCount);
 
-			// query batches sequencially
-#ifdef _OPENMP
-			#pragma omp critical(cudaQuery)
-#endif
+			// query batch, the GPU backend schedules batches sequentially
 			{
-				m_batchScheduled[i_r] = m_cuClarkDb->queryBatch( i_r, m_isExtended);
+				m_clarkDb->queryBatch( i_r, m_isExtended);
 				
 #ifdef DEBUG_BATCH
 				// print batch information
@@ -1750,34 +2041,46 @@ void CuCLARK<HKMERr>::getObjectsDataComputeFullGPU(const uint8_t * _map,  const
 #endif
 			}
 					
-			// start printing results early if possible
-#ifdef _OPENMP
-			if (m_dbParts == 1 && omp_get_max_threads() > 1 && i_r == 0)
+			// results are final if the database has one part
+			if (m_dbParts == 1)
 			{
-				printExtendedResultsSynced(_map, _fileResult);
+				m_clarkDb->waitForBatch(i_r);
+				printBatchResults(_map, i_r, output);
+				writer.put(i_r, output);
 			}
-#endif
-			
 		}
 	}
 
 	// swap db parts if available (multi threaded)
-	while(m_cuClarkDb->swapDbParts())
+	while(m_clarkDb->swapDbParts())
 	{			
 		// query batches again
-		for (i_r = 0; i_r < m_numBatches; i_r++)
+		for (i_r = 0; i_r < numBatches; i_r++)
 		{
-			m_batchScheduled[i_r] = m_cuClarkDb->queryBatch( i_r, m_isExtended, true);
+			m_clarkDb->queryBatch( i_r, m_isExtended, true);
 		}
 	}
 	
-	// print results
+	// print results after the last part
+	if (m_dbParts > 1)
+	{
 #ifdef _OPENMP
-	if (m_dbParts > 1 || omp_get_max_threads() == 1)
+		#pragma omp parallel
 #endif
-	{
-		printExtendedResultsSynced(_map, _fileResult);
+		{
+			std::string output;
+#ifdef _OPENMP
+			#pragma omp for schedule(dynamic)
+#endif
+			for (i_r = 0; i_r < numBatches; i_r++)
+			{
+				m_clarkDb->waitForBatch(i_r);
+				printBatchResults(_map, i_r, output);
+				writer.put(i_r, output);
+			}
+		}
 	}
+	writer.close();
 
 	return;
 }
@@ -1880,18 +2183,11 @@ bool CuCLARK<HKMERr>::getTargetsData(const char* _filesName, vector<string>& _fi
 	char * cfname = (char*) calloc(130, sizeof(char));
 	char * cfname_s = (char*) calloc(130+4, sizeof(char));
 	getdbName(cfname);
-	sprintf(cfname_s, "%s.sz", cfname);
-	FILE * dbfd_sz = fopen(cfname_s, "r");
-	sprintf(cfname_s, "%s.ky", cfname);
-	FILE * dbfd_ky = fopen(cfname_s, "r");
-	sprintf(cfname_s, "%s.lb", cfname);
-	FILE * dbfd_lbl = fopen(cfname_s, "r");
-	if (dbfd_sz != NULL && dbfd_ky != NULL && dbfd_lbl != NULL)
+	sprintf(cfname_s, "%s.db", cfname);
+	// databases of the former format are converted when loaded
+	if (DbFile::exists(cfname_s) || legacyDbExists(cfname))
 	{
 		areHTfilespresent = true;
-		fclose(dbfd_sz);
-		fclose(dbfd_ky);
-		fclose(dbfd_lbl);
 	}
 	free(cfname);
 	free(cfname_s);
@@ -1919,6 +2215,10 @@ void CuCLARK<HKMERr>::print(const bool& _creatingkmfiles, const ITYPE& _sampling
 	{
 		cerr << "Using light database in RAM (" << m_iterKmers << ")" << endl;
 	}
+	if (m_minimizerWindow > 0)
+	{
+		cerr << "Using minimizers of windows of " << m_minimizerWindow << " " << m_kmerSize << "-mers" << endl;
+	}
 	if (_samplingfactor > 2)
 	{
 		cerr << "Sampling factor is " << _samplingfactor << endl;
@@ -1933,20 +2233,21 @@ void CuCLARK<HKMERr>::printSpeedStats(const struct timeval& _requestEnd, const s
 {
 	double diff = (_requestEnd.tv_sec - _requestStart.tv_sec) + (_requestEnd.tv_usec - _requestStart.tv_usec) / 1000000.0;
 	cerr << "Done in " << std::fixed << std::setprecision(1) << diff
-	     << "s (" << (size_t)(((double) m_nbObjects) / diff * 60.0) << " reads/min, "
-	     << m_nbObjects << " reads)\n";
+	     << "s (" << (size_t)(((double) m_nbObjectsTotal) / diff * 60.0) << " reads/min, "
+	     << m_nbObjectsTotal << " reads)\n";
 	cerr << "Results: " << _fileResult << "\n";
 }
 
 /**
- * Prints results to file in normal or extended format.
- * Waits for a batch to finisch before printing its results.
+ * Prints header of the results file.
  */
 template <typename HKMERr>
-void CuCLARK<HKMERr>::printExtendedResultsSynced(const uint8_t * _map,  const char* _fileResult)
+bool CuCLARK<HKMERr>::printResultsHeader(const char* _fileResult) const
 {
 	ofstream f_out;
 	f_out.open(_fileResult, std::ofstream::out );
+	if (!f_out.is_open())
+		return false;
 
 	// print header
 	string header[] = {"Gamma", "Assignment", "Score", "Confidence"};
@@ -1954,7 +2255,17 @@ void CuCLARK<HKMERr>::printExtendedResultsSynced(const uint8_t * _map,  const ch
 
 	f_out <<"Object_ID";
 
-	if (m_isExtended)
+	// sparse: one column of the targets hit, named with all targets
+	if (m_isSparse)
+	{
+		f_out << ",Hits(";
+		for(size_t t = 1 ; t < m_targetsName.size();  t++)
+		{
+			f_out << (t > 1 ? ";" : "") << m_targetsName[t];
+		}
+		f_out << ")";
+	}
+	else if (m_isExtended)
 	{
 		for(size_t t = 1 ; t < m_targetsName.size();  t++)
 		{
@@ -1967,156 +2278,136 @@ void CuCLARK<HKMERr>::printExtendedResultsSynced(const uint8_t * _map,  const ch
 	f_out << endl;
 
 	f_out.close();
-	//
-	FILE *fout = fopen(_fileResult, "a");
+	return true;
+}
 
+/**
+ * Prints results of a batch into _out in normal, extended or sparse format.
+ */
+template <typename HKMERr>
+void CuCLARK<HKMERr>::printBatchResults(const uint8_t * _map, const size_t _batchId, std::string& _out)
+{
 	ITYPE best = 0, s_best = 0, indexBest = 0, index_sBest = 0, total = 0;
 	double gamma = 0, delta = 0;
-	
-	//// print extended results
-	if (m_isExtended)
+	ITYPE objectNorm;
+
+	// first object of the batch
+	size_t t = 0;
+	for (size_t i = 0; i < _batchId; i++)
+		t += m_readsLength[i].size();
+
+	const size_t numTargets = m_targetsName.size()-1;
+	// zero scores of the extended results
+	std::string zeros;
+	if (m_isExtended && !m_isSparse)
 	{
-		int nonzero_count = 0, nonzero_sum = 0,
-			nonzero_max = 0, nonzero_min = m_targetsName.size()-1;
-		int targetIndex, targetScore;
-		size_t writeIndex;
-		
-		int i_r=0;
-		int i_lr=0;
-		char objectName[OBJECTNAMEMAX];
-		ITYPE objectNorm;
-		size_t batchLastIndex = m_readsLength[i_r].size();
-		
-		// wait for first batch
-		while(!m_batchScheduled[i_r]);
-		m_cuClarkDb->waitForBatch(i_r);
-		cerr << "Writing extended results... " << endl;
-		
-		for(size_t t = 0; t < m_nbObjects; t++)
+		zeros.reserve(2*numTargets);
+		for (size_t i = 0; i < numTargets; i++)
+			zeros += ",0";
+	}
+	int nonzeroMin = numTargets, nonzeroMax = 0;
+	size_t nonzeroSum = 0;
+
+	_out.clear();
+	_out.reserve(m_readsLength[_batchId].size() * (m_isExtended && !m_isSparse ? 2*numTargets + 64 : 64));
+	for (size_t i_lr = 0; i_lr < m_readsLength[_batchId].size(); i_lr++, t++)
+	{
+		// name, as much as printed by "%s"
+		size_t nameSize = m_seqENames[_batchId][i_lr] - m_seqSNames[_batchId][i_lr];
+		if (nameSize >= OBJECTNAMEMAX) nameSize = OBJECTNAMEMAX-1;
+		const char* objectName = (const char*) &_map[m_seqSNames[_batchId][i_lr]];
+		const char* nameEnd = (const char*) memchr(objectName, '\0', nameSize);
+		if (nameEnd != NULL) nameSize = nameEnd - objectName;
+		_out.append(objectName, nameSize);
+
+		//// extended results
+		if (m_isExtended)
 		{
-			if(t==batchLastIndex)
+			const RESULTS* fullRow = m_fullResults + t*m_resultRowSize;
+
+			if (m_isSparse)
 			{
-				// wait for next batch
-				while(!m_batchScheduled[++i_r]);
-				m_cuClarkDb->waitForBatch(i_r);
-				batchLastIndex += m_readsLength[i_r].size();
-				i_lr=0;
+				// print target and score of the targets hit
+				_out += ',';
+				for(size_t r_h = 0 ; r_h < fullRow[0] ; r_h++)
+				{
+					if (r_h > 0) _out += ';';
+					_out += m_targetsName[fullRow[r_h*2+1]+1];
+					_out += ':';
+					appendUnsigned(_out, fullRow[r_h*2+2]);
+				}
 			}
-			
-			writeIndex = 0;
-			std::ostringstream ss;
-			
-			// print all scores
-			for(size_t r_h = 0 ; r_h < m_fullResults[t*m_resultRowSize] ; r_h++)
+			else
 			{
-				// get next target
-				targetIndex = m_fullResults[t*m_resultRowSize+r_h*2+1];
-				targetScore = m_fullResults[t*m_resultRowSize+r_h*2+2];
-
-				// write zeros until target
-				for ( ; writeIndex < targetIndex; writeIndex++)
-					ss << ",0";
-				// write target score
-				ss << "," << targetScore;
-				writeIndex++;
-					
+				size_t writeIndex = 0;
+
+				// print all scores
+				for(size_t r_h = 0 ; r_h < fullRow[0] ; r_h++)
+				{
+					// get next target
+					size_t targetIndex = fullRow[r_h*2+1];
+
+					// write zeros until target
+					if (writeIndex < targetIndex)
+					{
+						_out.append(zeros, 0, 2*(targetIndex-writeIndex));
+						writeIndex = targetIndex;
+					}
+					// write target score
+					_out += ',';
+					appendUnsigned(_out, fullRow[r_h*2+2]);
+					writeIndex++;
+				}
+				// write zeros until end
+				if (writeIndex < numTargets)
+					_out.append(zeros, 0, 2*(numTargets-writeIndex));
 			}
-			// write zeros until end
-			for ( ; writeIndex < m_targetsName.size()-1; writeIndex++)
-				ss << ",0";
-
-			total 		= m_finalResults[t*m_finalResultsRowSize];
-			indexBest 	= m_finalResults[t*m_finalResultsRowSize+1];
-			best 		= m_finalResults[t*m_finalResultsRowSize+2];
-			index_sBest = m_finalResults[t*m_finalResultsRowSize+3];
-			s_best 		= m_finalResults[t*m_finalResultsRowSize+4];
-
-			size_t nameSize = m_seqENames[i_r][i_lr] - m_seqSNames[i_r][i_lr];
-			if (nameSize >= OBJECTNAMEMAX) nameSize = OBJECTNAMEMAX-1;
-			strncpy(objectName, (const char*) &_map[m_seqSNames[i_r][i_lr]], nameSize);
-			objectName[nameSize] = '\0';
-		
-			objectNorm = m_isPaired ? m_readsLength[i_r][i_lr] - NBN : m_readsLength[i_r][i_lr];
-			i_lr++;
-			
-			gamma = (double)total / ((double)objectNorm - m_kmerSize + 1.0);
-			delta = best + s_best;
-			delta = (delta < 0.001) ? 0: (double) best/ delta;
-			
-			
-			// print name, hit rate, best, confidence score
-			fprintf(fout,"%s%s,%g,%s,%u,%g\n",
-					objectName,ss.str().c_str(),gamma,
-					m_targetsName[indexBest].c_str(),best,
-					delta);
-					
-			/// extra target info		
-			nonzero_count = m_fullResults[t*m_resultRowSize];
-			if (nonzero_count > nonzero_max) nonzero_max = nonzero_count;
-			if (nonzero_count < nonzero_min) nonzero_min = nonzero_count;
-			nonzero_sum += nonzero_count;
+
+			/// extra target info
+			int nonzero_count = fullRow[0];
+			if (nonzero_count > nonzeroMax) nonzeroMax = nonzero_count;
+			if (nonzero_count < nonzeroMin) nonzeroMin = nonzero_count;
+			nonzeroSum += nonzero_count;
 			///
 		}
-		fclose(fout);
-		cerr << "Done." << endl;
 
-		/// extra target info
-		cerr << "MIN targets: " << nonzero_min
-			 << ", MAX targets: " << nonzero_max
-			 << ", AVG targets: " << (float)nonzero_sum / m_nbObjects
-			 << "\n";
-		///
-
-		return;
-	}
-	
-	//// print normal results
-	int i_r=0;
-	int i_lr=0;
-	char objectName[OBJECTNAMEMAX];
-	ITYPE objectNorm;
-	size_t batchLastIndex = m_readsLength[i_r].size();
-	
-	// wait for first batch
-	while(!m_batchScheduled[i_r]);
-	m_cuClarkDb->waitForBatch(i_r);
-	cerr << "Writing results... " << endl;
-	
-	for(size_t t = 0; t < m_nbObjects; t++)
-	{
-		if(t==batchLastIndex)
-		{
-			// wait for next batch
-			while(!m_batchScheduled[++i_r]);
-			m_cuClarkDb->waitForBatch(i_r);
-			batchLastIndex += m_readsLength[i_r].size();
-			i_lr=0;
-		}
-			
 		total 		= m_finalResults[t*m_finalResultsRowSize];
 		indexBest 	= m_finalResults[t*m_finalResultsRowSize+1];
 		best 		= m_finalResults[t*m_finalResultsRowSize+2];
 		index_sBest = m_finalResults[t*m_finalResultsRowSize+3];
 		s_best 		= m_finalResults[t*m_finalResultsRowSize+4];
-		
-		size_t nameSize = m_seqENames[i_r][i_lr] - m_seqSNames[i_r][i_lr];
-		if (nameSize >= OBJECTNAMEMAX) nameSize = OBJECTNAMEMAX-1;
-		strncpy(objectName, (const char*) &_map[m_seqSNames[i_r][i_lr]], nameSize);
-		objectName[nameSize] = '\0';
-		
-		objectNorm = m_isPaired ? m_readsLength[i_r][i_lr] - NBN : m_readsLength[i_r][i_lr];
-		i_lr++;
-		
-		gamma = (double)(total)/(((double) objectNorm - m_kmerSize) + 1.0);
+
+		objectNorm = m_isPaired ? m_readsLength[_batchId][i_lr] - NBN : m_readsLength[_batchId][i_lr];
+
+		// hit rate of the k-mers queried, only the minimizers with --minimizer
+		if (m_minimizerWindow > 0 && m_readsQueried[_batchId][i_lr] > 0)
+			gamma = (double)(total)/m_readsQueried[_batchId][i_lr];
+		else
+			gamma = (double)(total)/(((double) objectNorm - m_kmerSize) + 1.0);
 		delta = best + s_best;
-		delta = (delta < 0.001) ? 0: ((double) best)/(delta);			
-		
+		delta = (delta < 0.001) ? 0: ((double) best)/(delta);
+
 		// print name, hit rate, best, confidence score
-		fprintf(fout,"%s,%g,%s,%u,%g\n",
-				objectName,gamma,
-				m_targetsName[indexBest].c_str(),best,
-				delta);
+		_out += ',';
+		appendDouble(_out, gamma);
+		_out += ',';
+		_out += m_targetsName[indexBest];
+		_out += ',';
+		appendUnsigned(_out, best);
+		_out += ',';
+		appendDouble(_out, delta);
+		_out += '\n';
+	}
+
+	if (m_isExtended && !m_readsLength[_batchId].empty())
+	{
+#ifdef _OPENMP
+		#pragma omp critical(nonzero)
+#endif
+		{
+			if (nonzeroMax > m_nonzeroMax) m_nonzeroMax = nonzeroMax;
+			if (nonzeroMin < m_nonzeroMin) m_nonzeroMin = nonzeroMin;
+			m_nonzeroSum += nonzeroSum;
+		}
 	}
-	fclose(fout);
-	cerr << "Done." << endl;
 }
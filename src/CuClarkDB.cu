@@ -30,6 +30,7 @@
  */
  
 #include "CuClarkDB.cuh"
+#include "minimizer.hh"
 
 #include <iostream>
 #include <fstream>
@@ -74,27 +75,40 @@
 
 // forward declaration
 template <typename HKMERr>
-__device__ bool queryElement (const uint8_t& k, const uint64_t& _ikmer,
-			uint32_t* d_bucketPointers, HKMERr* d_keys, ILBL* d_labels,
-			uint32_t dbPartStart, uint32_t dbPartEnd,
-			ILBL& _returnLabel);
-template <typename HKMERr>
-__global__ void queryKernel (uint8_t k,
+__global__ void queryKernel (uint8_t k, HtSize htSize,
 			uint32_t* readsPointer, CONTAINER* readsInContainers,
-			uint32_t* bucketPointers, HKMERr* keys, ILBL* labels,
+			BucketGroup* bucketIndex, HKMERr* keys, ILBL* labels, DbPacking packing,
+			DbBigBucket* bigBuckets, uint32_t numBigBuckets,
 			uint32_t dbPartStart, uint32_t dbPartEnd,
-			RESULTS* results, size_t pitch, size_t numTargets);
+			RESULTS* results, size_t pitch, size_t numTargets,
+			uint32_t minimizerWindow);
 __global__ void mergeKernel (RESULTS* resultA, RESULTS* resultB, size_t pitch, size_t numReads, RESULTS* results);
 __global__ void resultKernel (RESULTS* scores, size_t spitch, size_t numReads, RESULTS* results, size_t rpitch);
 
+/**
+ * Number of usable CUDA devices, 0 if there is no device or driver.
+ */
+int getCudaDeviceCount()
+{
+	int numDevices = 0;
+	if (cudaGetDeviceCount(&numDevices) != cudaSuccess)
+	{
+		// reset error state
+		cudaGetLastError();
+		return 0;
+	}
+	return numDevices;
+}
+
 /**
  * Constructor:
  * Initialize variables, find CUDA devices
  */	
 template <typename HKMERr>
-CuClarkDB<HKMERr>::CuClarkDB(const size_t _numDevices, const uint8_t _k, const size_t _numBatches, const size_t _numTargets, bool _verbose)
-							: m_k(_k),m_numTargets(_numTargets),m_numBatches(_numBatches),
-							  m_verbose(_verbose),d_resultsFinal(nullptr)
+CuClarkDB<HKMERr>::CuClarkDB(const size_t _numDevices, const uint8_t _k, const size_t _numBatches, const size_t _numTargets, const HtSize& _htSize, bool _verbose,
+							  const uint32_t _minimizerWindow)
+							: ClarkDB<HKMERr>(_k, _numBatches, _numTargets, _htSize, _verbose, _minimizerWindow),
+							  m_loadedOffset(-1), d_resultsFinal(nullptr)
 {
 	m_numReads.resize(m_numBatches);
 	m_sizeReadsPointer.resize(m_numBatches);
@@ -114,6 +128,9 @@ CuClarkDB<HKMERr>::CuClarkDB(const size_t _numDevices, const uint8_t _k, const s
 	
 	m_numDevices = 0;
 	m_dbPartsPerDevice = 1;
+
+	// database parts in pinned memory, for asynchronous copies to the devices
+	m_hostCopy = true;
 	
 	// cf. CUDA samples/0_Simple/simpleP2P
 	if (m_verbose) std::cerr << "Checking for CUDA devices: ";
@@ -215,9 +232,10 @@ CuClarkDB<HKMERr>::CuClarkDB(const size_t _numDevices, const uint8_t _k, const s
     }
     
     // pointers for each device
-    d_bucketPointers.resize(m_numDevices*m_dbPartsPerDevice);
+    d_bucketIndex.resize(m_numDevices*m_dbPartsPerDevice);
 	d_keys.resize(m_numDevices*m_dbPartsPerDevice);
 	d_labels.resize(m_numDevices*m_dbPartsPerDevice);
+	d_bigBuckets.resize(m_numDevices*m_dbPartsPerDevice);
 	
 	d_readsPointer.resize(m_numDevices);
 	d_readsInContainers.resize(m_numDevices);
@@ -247,12 +265,7 @@ CuClarkDB<HKMERr>::CuClarkDB(const size_t _numDevices, const uint8_t _k, const s
 template <typename HKMERr>
 CuClarkDB<HKMERr>::~CuClarkDB() 
 {
-	for (int i=0; i<m_dbParts; i++)
-	{		
-		cudaFreeHost(h_bucketPointers[i]);
-		cudaFreeHost(h_keys[i]);
-		cudaFreeHost(h_labels[i]);
-	}
+	this->freeHostDb();
 
 	for(int i=0; i<m_numDevices; i++)
 	{
@@ -261,9 +274,10 @@ CuClarkDB<HKMERr>::~CuClarkDB()
 		for(int j=0; j<m_dbPartsPerDevice; ++j)
 		{
 			int index = m_dbPartsPerDevice*i+j;
-			cudaFree(d_bucketPointers[index]);
+			cudaFree(d_bucketIndex[index]);
 			cudaFree(d_keys[index]);
 			cudaFree(d_labels[index]);
+			cudaFree(d_bigBuckets[index]);
 			}
 	}
 
@@ -455,92 +469,44 @@ bool CuClarkDB<HKMERr>::checkBatch(size_t batchId)
 	return cudaGetLastError() == cudaSuccess;
 }
 
-/** 
- * Read database from files to pinned host memory,
- * divide into parts according to CUDA device memory.
- * cf. hashTable_hh read
+/**
+ * Pinned host memory for database parts.
  */
 template <typename HKMERr>
-bool CuClarkDB<HKMERr>::read (const char * _filename, size_t& _fileSize, size_t& _dbParts, const ITYPE& _modCollision)
+void* CuClarkDB<HKMERr>::hostMalloc(const size_t _size)
 {
+	void* ptr = nullptr;
+	cudaHostAlloc(&ptr, _size, 0);
+	CUERR
+	return ptr;
+}
 
-	char * file_sze = (char*) calloc(strlen(_filename)+4,sizeof(char));
-	char * file_key = (char*) calloc(strlen(_filename)+4,sizeof(char));
-	char * file_lbl = (char*) calloc(strlen(_filename)+4,sizeof(char));
-
-	sprintf(file_sze, "%s.sz", _filename);
-	sprintf(file_key, "%s.ky", _filename);
-	sprintf(file_lbl, "%s.lb", _filename);
-
-	std::ifstream ifs_sze;
-	std::ifstream ifs_key;
-	std::ifstream ifs_lbl;
-
-	ifs_sze.open(file_sze, std::ios::binary);
-	ifs_key.open(file_key, std::ios::binary);
-	ifs_lbl.open(file_lbl, std::ios::binary);
-	
-	if (!ifs_sze.is_open())
-	{	std::cerr << "Failed to open " << file_sze << std::endl; return false;	}
-	if (!ifs_key.is_open())
-	{	std::cerr << "Failed to open " << file_key << std::endl; return false;   }
-	if (!ifs_lbl.is_open())
-	{	std::cerr << "Failed to open " << file_lbl << std::endl; return false;   }
-	
-	bool allCollision = _modCollision <= 1;
-	
-	/// read bucket sizes
-	std::vector<uint8_t>	bucketSizes;
-	bucketSizes.resize(HTSIZE);
-	
-	ifs_sze.read((char*) &bucketSizes[0], HTSIZE);
-
-	uint64_t nbElements = 0;
-	uint32_t nbNonZeroBuckets = 0;
-	std::vector<uint8_t>	choice(HTSIZE,0);
-	
-	// choose buckets and count chosen elements
-	for (uint32_t i = 0; i < HTSIZE; i++)
-	{
-		if (bucketSizes[i] > 0)
-		{
-			nbNonZeroBuckets++;
-			// 2 = keep, 1 = skip, 0 = empty
-			choice[i] = (allCollision || (nbNonZeroBuckets % _modCollision)== 0) ? 2: 1;
-			if (choice[i] == 2)
-				nbElements += bucketSizes[i];
-		}
-	}
-
-	// calculate total size
-	_fileSize = HTSIZE;	
-	// bucket pointers: 8bit -> 32bit per element
-	_fileSize *= sizeof(uint32_t);
-	// size of keys and labels
-	size_t _fileSizeKeys   = nbElements * sizeof(HKMERr);
-	size_t _fileSizeLabels = nbElements * sizeof(ILBL);
-	// total database size
-	_fileSize = _fileSize + _fileSizeKeys + _fileSizeLabels;
-	if (m_verbose) std::cerr << "Total DB size in RAM:\t" << _fileSize/1000000/1000.0 << " GB\n";
+template <typename HKMERr>
+void CuClarkDB<HKMERr>::hostFree(void* _ptr)
+{
+	cudaFreeHost(_ptr);
+}
 
-	/// divide into parts
+/**
+ * Divide database into parts according to CUDA device memory.
+ */
+template <typename HKMERr>
+void CuClarkDB<HKMERr>::divideDb(const size_t _dbSize, const size_t _minParts)
+{
 	if (m_verbose) std::cerr << "Total device memory:\t" << m_memSizes.back()/1000000/1000.0 << " GB (" << m_numDevices*RESERVED/1000000 << " MB reserved)\n";
-	
-	size_t minParts = (nbElements/(uint32_t)-1)+1;
 
-	m_cyclesPerDevice = _fileSize / m_memSizes.back() + 1;
+	m_cyclesPerDevice = _dbSize / m_memSizes.back() + 1;
 	m_dbParts = m_cyclesPerDevice*m_numDevices*m_dbPartsPerDevice;
 	
 	// adjust number of parts to prevent overflow
-	if (m_dbParts < minParts)
+	if (m_dbParts < _minParts)
 	{
 		std::cerr << "Overflow prevented.\n";
-		m_cyclesPerDevice = (minParts-1)/(m_numDevices*m_dbPartsPerDevice)+1;
+		m_cyclesPerDevice = (_minParts-1)/(m_numDevices*m_dbPartsPerDevice)+1;
 		m_dbParts = m_cyclesPerDevice*m_numDevices*m_dbPartsPerDevice;
 	}
 	
 	m_cyclesToDo = m_cyclesPerDevice;
-	_dbParts = m_cyclesPerDevice;
 	
 	// no space for merging needed if db fits on one device
 	if (m_dbParts == 1)
@@ -554,213 +520,70 @@ bool CuClarkDB<HKMERr>::read (const char * _filename, size_t& _fileSize, size_t&
 	for(int i = 0; i < m_dbParts ; i++)
 	{
 		// data per cycle distributed proportional to device memory size
-		m_partPointer[1+i] = HTSIZE/m_cyclesPerDevice * (i/(m_numDevices*m_dbPartsPerDevice) + (float)m_memSizes[i%(m_numDevices*m_dbPartsPerDevice)] / m_memSizes[m_numDevices*m_dbPartsPerDevice-1]);
+		m_partPointer[1+i] = m_htSize.size/m_cyclesPerDevice * (i/(m_numDevices*m_dbPartsPerDevice) + (float)m_memSizes[i%(m_numDevices*m_dbPartsPerDevice)] / m_memSizes[m_numDevices*m_dbPartsPerDevice-1]);
 	}	
-	m_partPointer[m_dbParts] = HTSIZE;
-#ifdef DEBUG_DB	
-	for(int i = 0; i <= m_dbParts ; i++)
-	{
-		std::cerr << "m_partPointer " << i << ": " << m_partPointer[i] << " \n";
-	}
-#endif
-	
-	/// calculate pointers to buckets
-	
-	// pointers for each part
-	h_bucketPointers.resize(m_dbParts);
-	h_keys.resize(m_dbParts);
-	h_labels.resize(m_dbParts);
-	
-	// sizes for each part
-	m_partSize.resize(m_dbParts);
-	m_partSizeKeys.resize(m_dbParts);
-	m_partSizeLabels.resize(m_dbParts);
-			
-	#ifdef _OPENMP
-	#pragma omp parallel for schedule(dynamic)
-	#endif
-	for (int i=0; i<m_dbParts; i++)
-	{
-		size_t numBuckets = m_partPointer[i+1]-m_partPointer[i];
-		m_partSize[i] = (numBuckets + 1) * sizeof(uint32_t);
-		cudaMallocHost(&h_bucketPointers[i], m_partSize[i]);
-		CUERR
-		
-		h_bucketPointers[i][0] = 0;
-		
-		// partial_sum
-		size_t firstIndex = m_partPointer[i];
-		size_t lastIndex = m_partPointer[i+1];
-		uint32_t* result = h_bucketPointers[i]+1;
+	m_partPointer[m_dbParts] = m_htSize.size;
+}
 
-		if (firstIndex < lastIndex)
-		{
-		  uint32_t val = 0;
-		  if(choice[firstIndex] == 2)
-		  {
-			val = bucketSizes[firstIndex];
-		  }
-		  *result = val;
-		  while (++firstIndex < lastIndex)
-		  {
-			if(choice[firstIndex] == 2)
-			{
-				val = val + bucketSizes[firstIndex];
-			}
-			if (val < *result)
-			{
-				std::cerr << "Bucket pointer overflow. Abort.\n";
-			}
-			*++result = val;
-		  }
-		  ++result;
-		}
-		
-		m_partSizeKeys[i]   = h_bucketPointers[i][numBuckets] * sizeof(HKMERr);
-		m_partSizeLabels[i] = h_bucketPointers[i][numBuckets] * sizeof(ILBL);
-		
-#ifdef DEBUG_DB
-		std::cerr << i+1 << "/" << (int)m_dbParts << " database: " 
-					<< h_bucketPointers[i][numBuckets] << " elements, "
-					<< (m_partSize[i]+m_partSizeKeys[i]+m_partSizeLabels[i])/1000/1000.0
-					<< " MB\n";
-		
-		std::cerr << "Pointers: " << m_partSize[i]/1000/1000.0
-				  << " MB\t Keys: " << m_partSizeKeys[i]/1000/1000.0
-				  << " MB\t Labels: " << m_partSizeLabels[i]/1000/1000.0
-				  << " MB\n";
-#endif
-	}
-	
-	// point to db parts in keys and labels
-	m_partPointerKeys.resize(m_dbParts+1);
-	m_partPointerKeys[0] = 0;
+/** 
+ * Read database file to pinned host memory (parallel preads),
+ * divide into parts according to CUDA device memory.
+ */
+template <typename HKMERr>
+bool CuClarkDB<HKMERr>::read (const char * _filename, size_t& _fileSize, size_t& _dbParts, const ITYPE& _modCollision)
+{
+	if (!this->readHostDb(_filename, _fileSize, _modCollision))
+		return false;
+
+	_dbParts = m_cyclesPerDevice;
 	
 	std::vector<size_t>	max_partSize(m_numDevices*m_dbPartsPerDevice,0),
 						max_partSizeKeys(m_numDevices*m_dbPartsPerDevice,0),
-						max_partSizeLabels(m_numDevices*m_dbPartsPerDevice,0);	
+						max_partSizeLabels(m_numDevices*m_dbPartsPerDevice,0),
+						max_partSizeBig(m_numDevices*m_dbPartsPerDevice,sizeof(DbBigBucket));
 	
 	for (int i=0; i<m_dbParts; i++)
 	{
-		size_t numBuckets = m_partPointer[i+1]-m_partPointer[i];
-		m_partPointerKeys[i+1] = m_partPointerKeys[i] + h_bucketPointers[i][numBuckets];
-		
 		int device = (i/m_dbPartsPerDevice) % m_numDevices;
 		if (max_partSize[device] 		< m_partSize[i]) 		max_partSize[device] 		= m_partSize[i];
 		if (max_partSizeKeys[device]  	< m_partSizeKeys[i]) 	max_partSizeKeys[device] 	= m_partSizeKeys[i];
 		if (max_partSizeLabels[device]  < m_partSizeLabels[i]) 	max_partSizeLabels[device] 	= m_partSizeLabels[i];
+		if (max_partSizeBig[device]  < m_partNumBig[i]*sizeof(DbBigBucket)) 	max_partSizeBig[device] 	= m_partNumBig[i]*sizeof(DbBigBucket);
 	}
 #ifdef DEBUG_DB
-	for (int i=0; i<m_dbParts; i++)
+	for (int i=0; i<m_numDevices; i++)
 	{
-		std::cerr << "Max part size pointers: " << max_partSize[i]
+		std::cerr << "Max part size index: " << max_partSize[i]
 				<< " Max part size keys: " << max_partSizeKeys[i]
 				<< " Max part size labels: " << max_partSizeLabels[i]
 				<< "\n";
 	}
 #endif
 	
-	#ifdef _OPENMP
-	#pragma omp parallel
-	#endif
-	{	
-		/// read bucket contents
-		#ifdef _OPENMP
-		#pragma omp single nowait
-		#endif
-		{
-			for (int i=0; i<m_dbParts; i++)
-			{				
-				cudaHostAlloc(&h_keys[i], m_partSizeKeys[i], 0);
-				CUERR
-				
-				if (_modCollision <= 1)
-				{	// read everything
-					ifs_key.read((char*) &h_keys[i][0], m_partSizeKeys[i]);
-				}
-				else
-				{	// read if choice == 2
-					uint8_t bucketSize;
-					size_t ignoreSize = 0;
-					uint32_t storeIndexKeys = 0;
-					for (uint32_t j = m_partPointer[i]; j < m_partPointer[i+1]; j++)
-					{
-						bucketSize = bucketSizes[j];
-						switch(choice[j])
-						{
-							case 1:
-								ignoreSize += bucketSize;
-								break;
-							case 2:
-								ifs_key.ignore(ignoreSize*sizeof(HKMERr));
-								ignoreSize = 0;
-								ifs_key.read((char*) &h_keys[i][storeIndexKeys], bucketSize*sizeof(HKMERr));
-								storeIndexKeys += bucketSize;
-								break;
-						}
-					}
-				}
-			}
-		}
-		#ifdef _OPENMP
-		#pragma omp single
-		#endif
-		{
-			for (int i=0; i<m_dbParts; i++)
-			{
-				cudaHostAlloc(&h_labels[i], m_partSizeLabels[i], 0);
-				CUERR
-
-				if (_modCollision <= 1)
-				{	// read everything
-					ifs_lbl.read((char*) &h_labels[i][0], m_partSizeLabels[i]);
-				}
-				else
-				{	// read if choice == 2
-					uint8_t bucketSize;
-					size_t ignoreSize = 0;
-					uint32_t storeIndexLabels = 0;
-					for (uint32_t j = m_partPointer[i]; j < m_partPointer[i+1]; j++)
-					{
-						bucketSize = bucketSizes[j];
-						switch(choice[j])
-						{
-							case 1:
-								ignoreSize += bucketSize;
-								break;
-							case 2:
-								ifs_lbl.ignore(ignoreSize*sizeof(ILBL));
-								ignoreSize = 0;
-								ifs_lbl.read((char*) &h_labels[i][storeIndexLabels], bucketSize*sizeof(ILBL));
-								storeIndexLabels += bucketSize;
-								break;
-						}
-					}
-				}
-			}
-		}
-
-		#ifdef _OPENMP
-		#pragma omp single
-		#endif	
-		for (int i=0; i<m_numDevices; i++)
+	for (int i=0; i<m_numDevices; i++)
+	{
+		cudaSetDevice(i);
+		
+		// allocate device memory
+		for(int j=0; j<m_dbPartsPerDevice; ++j)
 		{
-			cudaSetDevice(i);
+			int index = m_dbPartsPerDevice*i+j;
 			
-			// allocate device memory
-			for(int j=0; j<m_dbPartsPerDevice; ++j)
+			cudaMalloc(&d_bucketIndex[index], max_partSize[i]);
+			CUERR
+			cudaMalloc(&d_keys[index], max_partSizeKeys[i]);
+			CUERR
+			// no labels if the parts are interleaved or packed, the kernel reads them with the keys
+			d_labels[index] = NULL;
+			if (max_partSizeLabels[i] > 0)
 			{
-				int index = m_dbPartsPerDevice*i+j;
-				
-				cudaMalloc(&d_bucketPointers[index], max_partSize[i]);
-				CUERR
-				cudaMalloc(&d_keys[index], max_partSizeKeys[i]);
-				CUERR
 				cudaMalloc(&d_labels[index], max_partSizeLabels[i]);
 				CUERR
 			}
+			cudaMalloc(&d_bigBuckets[index], max_partSizeBig[i]);
+			CUERR
 		}
- 	}
+	}
  	if (m_verbose)
  		std::cerr << "DB loaded in RAM.\n";
  	else
@@ -787,7 +610,8 @@ bool CuClarkDB<HKMERr>::swapDbParts ()
 #endif
 	int offset = m_numDevices*m_dbPartsPerDevice*(m_cyclesPerDevice - m_cyclesToDo);
 	
-	for (int i=0; i<m_numDevices; i++)
+	// parts are still on the devices if there is only one cycle (next chunk or file)
+	for (int i=0; i<m_numDevices && offset != m_loadedOffset; i++)
 	{
 		cudaSetDevice(i);
 		for(int j=0; j<m_dbPartsPerDevice; ++j)
@@ -797,9 +621,12 @@ bool CuClarkDB<HKMERr>::swapDbParts ()
 			std::cerr << "Swap - Device " << i << " Index " << index << " Offset " << offset << std::endl;
 #endif			
 			// copy database to part device
-			cudaMemcpyAsync(d_bucketPointers[index], &h_bucketPointers[index+offset][0], m_partSize[index+offset], cudaMemcpyHostToDevice, 0);
+			cudaMemcpyAsync(d_bucketIndex[index], &h_bucketIndex[index+offset][0], m_partSize[index+offset], cudaMemcpyHostToDevice, 0);
 			cudaMemcpyAsync(d_keys[index],   &h_keys  [index+offset][0], m_partSizeKeys[index+offset],   cudaMemcpyHostToDevice, 0);
-			cudaMemcpyAsync(d_labels[index], &h_labels[index+offset][0], m_partSizeLabels[index+offset], cudaMemcpyHostToDevice, 0);
+			if (m_partSizeLabels[index+offset] > 0)
+				cudaMemcpyAsync(d_labels[index], &h_labels[index+offset][0], m_partSizeLabels[index+offset], cudaMemcpyHostToDevice, 0);
+			if (m_partNumBig[index+offset] > 0)
+				cudaMemcpyAsync(d_bigBuckets[index], h_bigBuckets[index+offset], m_partNumBig[index+offset]*sizeof(DbBigBucket), cudaMemcpyHostToDevice, 0);
 		}
 #ifdef DEBUG_DB			
 		cudaDeviceSynchronize();
@@ -810,6 +637,7 @@ bool CuClarkDB<HKMERr>::swapDbParts ()
 	if (m_cyclesToDo < m_cyclesPerDevice)
 		std::cerr << "DB parts to do: " << m_cyclesToDo << std::endl;
 #endif	
+	m_loadedOffset = offset;
 	m_cyclesToDo--;
 	return true;
 }
@@ -827,13 +655,40 @@ bool CuClarkDB<HKMERr>::readyBatch (const size_t _batchId, const size_t _numRead
 	return true;
 }
 
+/**
+ * 	Schedule a prepared batch for database query on GPUs.
+ *  Batches of different host threads are scheduled sequentially.
+ */
+template <typename HKMERr>
+bool CuClarkDB<HKMERr>::queryBatch (const size_t _batchId, const bool _isExtended, const bool _isFollowup)
+{
+	bool scheduled;
+#ifdef _OPENMP
+	#pragma omp critical(cudaQuery)
+#endif
+	scheduled = scheduleBatch(_batchId, _isExtended, _isFollowup);
+	return scheduled;
+}
+
+/**
+ *  Copy final results of a finished batch.
+ */
+template <typename HKMERr>
+bool CuClarkDB<HKMERr>::getFinalResult (const size_t _batchId, RESULTS* _finalResult)
+{
+	if (!waitForBatch(_batchId))
+		return false;
+	memcpy(_finalResult, h_resultsFinal[_batchId], m_sizeResultFinalRow*m_numReads[_batchId]);
+	return true;
+}
+
 /**
  * 	Schedule a prepared batch for database query on GPUs,
  *  Schedule results merging if needed,
  * 	Schedule calculation of final results at the end.
  */
 template <typename HKMERr>
-bool CuClarkDB<HKMERr>::queryBatch (const size_t _batchId, const bool _isExtended, const bool _isFollowup)
+bool CuClarkDB<HKMERr>::scheduleBatch (const size_t _batchId, const bool _isExtended, const bool _isFollowup)
 {
 	size_t d_pitch = m_sizeResultRow;
 	
@@ -866,11 +721,13 @@ bool CuClarkDB<HKMERr>::queryBatch (const size_t _batchId, const bool _isExtende
 			if(_batchId==0) std::cerr << "query - Device " << i << " Index " << index << " Offset " << dbPartOffset << std::endl;
 #endif
 			queryKernel<<<numBlocks, m_threadsPerBlock_queryKernel, m_sharedSize_queryKernel, stream>>>
-							(m_k,
+							(m_k, m_htSize,
 							d_readsPointer[i], d_readsInContainers[i],
-							d_bucketPointers[index], d_keys[index], d_labels[index],
+							d_bucketIndex[index], d_keys[index], d_labels[index], m_partPacking[index+dbPartOffset],
+							d_bigBuckets[index], m_partNumBig[index+dbPartOffset],
 							m_partPointer[index+dbPartOffset], m_partPointer[index+dbPartOffset+1],
-							d_results[i][j], d_pitch, m_numTargets);
+							d_results[i][j], d_pitch, m_numTargets,
+							m_minimizerWindow);
 #ifdef DEBUG_QUERY
 			cudaStreamSynchronize(stream);
 			CUERR
@@ -992,16 +849,19 @@ bool CuClarkDB<HKMERr>::queryBatch (const size_t _batchId, const bool _isExtende
  * Processes one read per block:
  * Loads read data into shared memory,
  * contructs one kmer per thread and queries it,
+ * (with --minimizer, only if it is a minimizer of the read part),
  * scores in shared memory,
  * continues until the read is completed.
  * Stores non zero scores in global memory.
  */
 template <typename HKMERr>
-__global__ void queryKernel (uint8_t k,
+__global__ void queryKernel (uint8_t k, HtSize htSize,
 			uint32_t* readsPointer, CONTAINER* readsInContainers,
-			uint32_t* bucketPointers, HKMERr* keys, ILBL* labels,
+			BucketGroup* bucketIndex, HKMERr* keys, ILBL* labels, DbPacking packing,
+			DbBigBucket* bigBuckets, uint32_t numBigBuckets,
 			uint32_t dbPartStart, uint32_t dbPartEnd,
-			RESULTS* results, size_t pitch, size_t numTargets)
+			RESULTS* results, size_t pitch, size_t numTargets,
+			uint32_t minimizerWindow)
 {
 	int tid = threadIdx.x;
 	int bid = blockIdx.x;
@@ -1034,7 +894,9 @@ __global__ void queryKernel (uint8_t k,
 	uint32_t partPointer = readsPointer[bid];
 	uint32_t readEnd = readsPointer[bid+1];
 	uint32_t partIterator;
-	short numKmer;
+	int numKmer;
+	const CONTAINER* part;
+	uint32_t kmerPos;
 	
 	uint32_t firstContainer;
 	uint32_t containerPerWarp = (k+warpSize-2)/nucsPerCon+1;
@@ -1044,6 +906,11 @@ __global__ void queryKernel (uint8_t k,
 		partLength = readsInContainers[partPointer];
 		firstContainer = ++partPointer;
 		partPointer += (partLength-1) / nucsPerCon +1;
+		// a part past the read is not read
+		if (partPointer > readEnd)
+			break;
+		part = readsInContainers + firstContainer;
+		kmerPos = tid;
 		// number of kmer for wlane == 0 to check if warp has work to do
 		numKmer = partLength - k + 1 - wid*warpSize;
 		while (numKmer > 0)
@@ -1101,7 +968,10 @@ __global__ void queryKernel (uint8_t k,
 			printf("Block %d, Thread %2d: %s\n",bid,tid,kmer_string);
 #endif
 			
-			if (queryElement(k, kmer, bucketPointers, keys, labels, dbPartStart, dbPartEnd, target))
+			// with minimizers, only the minimizers of the part are queried
+			if ((minimizerWindow == 0
+				|| isPartMinimizer(part, partLength-k+1, kmerPos, k, minimizerWindow, minimizerOrder(canonicalKmer(k, kmer))))
+				&& queryElement(k, htSize, kmer, bucketIndex, keys, labels, packing, bigBuckets, numBigBuckets, dbPartStart, dbPartEnd, target))
 			{
 				ILBL target32 = target / 2;
 				uint32_t value = 1 <<((target % 2)*16);
@@ -1112,6 +982,7 @@ __global__ void queryKernel (uint8_t k,
 			}
 			// advance to next section
 			numKmer -= blockDim.x;
+			kmerPos += blockDim.x;
 			firstContainer += blockDim.x/nucsPerCon;
 		}				
 	}
@@ -1182,77 +1053,6 @@ __global__ void queryKernel (uint8_t k,
 	}
 }
 
-/**
- *  Query k-mer against a database part.
- *  Analog to hashTable_hh find, for canonical kmer
- */
-template <typename HKMERr>
-__device__ bool queryElement (const uint8_t& k, const uint64_t& _ikmer,
-		uint32_t* d_bucketPointers, HKMERr* d_keys, ILBL* d_labels,
-		uint32_t dbPartStart, uint32_t dbPartEnd,
-		ILBL& _returnLabel)
-{
-	// getting reverse kmer
-	size_t _ikmerR = _ikmer;
-	// The following 6 lines come from Jellyfish source code
-	_ikmerR = ((_ikmerR >> 2)  & 0x3333333333333333UL) | ((_ikmerR & 0x3333333333333333UL) << 2);
-	_ikmerR = ((_ikmerR >> 4)  & 0x0F0F0F0F0F0F0F0FUL) | ((_ikmerR & 0x0F0F0F0F0F0F0F0FUL) << 4);
-	_ikmerR = ((_ikmerR >> 8)  & 0x00FF00FF00FF00FFUL) | ((_ikmerR & 0x00FF00FF00FF00FFUL) << 8);
-	_ikmerR = ((_ikmerR >> 16) & 0x0000FFFF0000FFFFUL) | ((_ikmerR & 0x0000FFFF0000FFFFUL) << 16);
-	_ikmerR = ( _ikmerR >> 32                        ) | (_ikmerR                        << 32);
-	_ikmerR = (((uint64_t)-1) - _ikmerR) >> (64 - (k << 1));
-	
-	// getting canonical kmer
-	size_t _ikmerC = _ikmer < _ikmerR ? _ikmer : _ikmerR;
-	
-	size_t quotient = _ikmerC / HTSIZE;
-	size_t remainder = _ikmerC - quotient * HTSIZE;
-	
-	// check for correct dbPart
-	if (remainder < dbPartStart || remainder >= dbPartEnd)
-		return false;
-	remainder -= dbPartStart;
-	
-	size_t bucketBegin = d_bucketPointers[remainder];
-	size_t bucketEnd = d_bucketPointers[remainder+1];
-	
-#ifdef DEBUG_KERNEL
-	if(dbPartStart==0)
-	{
-		printf("Part: %u-%u, Kmer: %" PRIu64 ", Remainder: %" PRIu64 ", Bucket size: %2d\n", dbPartStart, dbPartEnd, _ikmerC, remainder, bucketEnd-bucketBegin);
-	}
-#endif
-
-	if(	bucketEnd-bucketBegin > 0)
-	{	// bucket not empty	
-		size_t i = bucketBegin;
-		HKMERr key = d_keys[i];
-		
-		if( key > quotient || d_keys[bucketEnd-1] < quotient)
-		{	// quotient not in range
-			return false;
-		}
-		
-		while(key <= quotient)
-		{
-			if(key == quotient)
-			{	// key found
-				_returnLabel = d_labels[i];
-/*#ifdef DEBUG_KERNEL
-				printf("Part: %d, Label: %4d, Remainder: %8d\n", dbPart, _returnLabel, remainder);
-#endif*/
-				return true;
-			}
-			key = d_keys[++i];
-		}
-		// key not in list
-		return false;
-	} 
-
-	// bucket empty
-	return false;
-}
-
 /**
  * Merge two results into one.
  * 1 thread handles results of 1 read.
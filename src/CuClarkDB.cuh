@@ -35,35 +35,43 @@
 #include <vector>
 #include <cuda_runtime.h>
 #include "./dataType.hh"
+#include "./ClarkDB.hh"
+
+int getCudaDeviceCount();
 
 template <typename HKMERr>
-class CuClarkDB
+class CuClarkDB : public ClarkDB<HKMERr>
 {
 	private:
-		uint8_t		m_k;			// kmer size
-		size_t		m_numTargets;	// targets in db	
-		size_t		m_numBatches;
+		using ClarkDB<HKMERr>::m_k;
+		using ClarkDB<HKMERr>::m_htSize;
+		using ClarkDB<HKMERr>::m_numTargets;
+		using ClarkDB<HKMERr>::m_numBatches;
+		using ClarkDB<HKMERr>::m_verbose;
+		using ClarkDB<HKMERr>::m_minimizerWindow;
+		using ClarkDB<HKMERr>::m_dbParts;
+		using ClarkDB<HKMERr>::h_bucketIndex;
+		using ClarkDB<HKMERr>::h_keys;
+		using ClarkDB<HKMERr>::h_labels;
+		using ClarkDB<HKMERr>::m_partPacking;
+		using ClarkDB<HKMERr>::h_bigBuckets;
+		using ClarkDB<HKMERr>::m_partSize;
+		using ClarkDB<HKMERr>::m_partSizeKeys;
+		using ClarkDB<HKMERr>::m_partSizeLabels;
+		using ClarkDB<HKMERr>::m_partNumBig;
+		using ClarkDB<HKMERr>::m_partPointer;
+		using ClarkDB<HKMERr>::m_partPointerKeys;
+		using ClarkDB<HKMERr>::m_hostCopy;
+
 		int			m_numDevices;
-		bool		m_verbose;
 
 		std::vector<size_t>	m_memSizes;
 		
 		// db
-		int			m_dbParts;
 		int			m_dbPartsPerDevice;
 		int			m_cyclesPerDevice;
 		int			m_cyclesToDo;
-		
-		// host pointers
-		std::vector< uint32_t* >	h_bucketPointers;
-		std::vector< HKMERr* >		h_keys;
-		std::vector< ILBL* >		h_labels;
-		
-		std::vector<size_t>		m_partSize;
-		std::vector<size_t>		m_partSizeKeys;
-		std::vector<size_t>		m_partSizeLabels;
-		std::vector<uint32_t>	m_partPointer;
-		std::vector<uint64_t>	m_partPointerKeys;
+		int			m_loadedOffset;		// first DB part currently on the devices, -1 if none
 			
 		std::vector<uint32_t*>	h_readsPointer;
 		std::vector<CONTAINER*>	h_readsInContainers;
@@ -79,9 +87,10 @@ class CuClarkDB
 		size_t					m_sizeResultFinalRow;
 		
 		// device pointers
-		std::vector<uint32_t*>	d_bucketPointers;
+		std::vector<BucketGroup*>	d_bucketIndex;
 		std::vector<HKMERr*>	d_keys;
 		std::vector<ILBL*>		d_labels;
+		std::vector<DbBigBucket*>	d_bigBuckets;
 		
 		std::vector<uint32_t*>	d_readsPointer;
 		std::vector<CONTAINER*>	d_readsInContainers;
@@ -95,14 +104,25 @@ class CuClarkDB
 		// kernel parameters
 		size_t 		m_threadsPerBlock_queryKernel;
 		size_t		m_sharedSize_queryKernel;
+
+		void divideDb(const size_t _dbSize, const size_t _minParts);
+		
+		void* hostMalloc(const size_t _size);
+		void hostFree(void* _ptr);
+		
+		bool scheduleBatch(const size_t _batchId,
+						const bool _isExtended,
+						const bool _isFollowup
+						);
 	
 	public:
-		CuClarkDB();
 		CuClarkDB(	const size_t _numDevices,
 					const uint8_t _k,
 					const size_t _numBatches,
 					const size_t _numTargets,
-					bool _verbose = false
+					const HtSize& _htSize,
+					bool _verbose = false,
+					const uint32_t _minimizerWindow = 0
 					);
 		
 		~CuClarkDB();
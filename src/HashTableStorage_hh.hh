@@ -26,6 +26,10 @@
  * 
  * Changes:
  * Changed hash table operations to canonical k-mers.
+ * K-mers of several targets added in parallel, by partitions of buckets (addTargets).
+ * Common k-mers removed in parallel.
+ * Buckets counted before k-mers are added (countTargets, allocate).
+ * Targets-specific k-mers saved to binary files and loaded in parallel (tskFile.hh).
  */
 
 #ifndef HASHTABLESTORAGE_HH
@@ -40,6 +44,10 @@
 
 #include "./hashTable_hh.hh"
 #include "./dataType.hh"
+#include "./tskFile.hh"
+
+#define TSKSAVEBUCKETS		(1 << 20)	// buckets per range selected by one thread when saving
+#define TSKLOADPARTSPERTHREAD	8		// partitions of buckets per thread when loading
 
 
 // CLASS 
@@ -52,6 +60,89 @@
 //	 		 This design is efficient and allows fast queries for small, large or big datasets (hundred to billion).
 // 
 
+/**
+ * Canonical k-mers of a target, divided into partitions of consecutive buckets.
+ * Counts are kept for spectrum files only, k-mers of sequences count once.
+ */
+struct TargetKmers
+{
+	std::string					label;
+	std::vector< std::vector<uint64_t> >		kmers;
+	std::vector< std::vector<ITYPE> >		counts;
+};
+
+/**
+ * K-mer selected for a targets-specific k-mers file.
+ */
+struct TskKmer
+{
+	uint64_t	kmer;
+	ITYPE		count;
+	uint32_t	file;
+};
+
+/**
+ * Update an element with another occurrence of its k-mer, in the target labeled _label.
+ * The multiplicity is increased by one for a different label, and by one more
+ * for a different chromosome (labels differing before the last character).
+ */
+template <typename ELMTr>
+inline void updateElement(ELMTr& _e, const std::string& _lbl, const std::string& _label, const size_t& _count)
+{
+	bool upLbl = _label[0] == _lbl[0] && _lbl.size() == _label.size() ;
+	for(size_t t = 1 ; upLbl && t < _lbl.size() - 1; t++)
+	{	upLbl = upLbl && _label[t] == _lbl[t];}
+	bool isSameLbl = upLbl && _label[_lbl.size()-1] == _lbl[_lbl.size()-1];
+	if (!isSameLbl)
+	{
+		_e.IncreaseMultiplicity();
+	}
+	_e.AddToCount(_count);
+	if (!upLbl)
+	{
+		_e.IncreaseMultiplicity();
+	}
+}
+
+/**
+ * Mark an element to be stored in the database: its k-mer is specific to one target,
+ * or (multiplicity 2) to a chromosome and its centromere, then it is labeled
+ * with the centromere _labels_c if found.
+ * Specific k-mers are counted in _nbElement, centromere k-mers in _nbSpec.
+ */
+template <typename ELMTr>
+inline void markSpecific(ELMTr& _e, const std::vector<std::string>& _Labels, const std::map<std::string, ILBL>& _mapLbls,
+		const std::vector<std::string>& _labels_c, const size_t& _minCount, uint64_t& _nbElement, uint64_t& _nbSpec)
+{
+	if (_e.GetMultiplicity() == 1 && _e.GetCount() > _minCount)
+	{
+		_e.Mark();
+		_nbElement++;
+		return;
+	}
+	if (_labels_c.size() > 0 && _e.GetMultiplicity() == 2  && _e.GetCount() > _minCount)
+	{
+		_e.Mark();
+		const std::string& Lbl = _Labels[_e.GetLabel()];
+		std::string centro = Lbl.substr(0, Lbl.size()-1), candidate, c_label;
+		bool found = false;
+		for(size_t t = 0; !found && t < _labels_c.size(); t++)
+		{
+			if (_labels_c[t].size() == Lbl.size())
+			{
+				candidate = _labels_c[t].substr(0, Lbl.size()-1);
+				found = centro.compare(candidate) == 0;
+				c_label = _labels_c[t];
+			}
+		}
+		if (found)
+		{
+			_e.Label = _mapLbls.find(c_label)->second;
+			_nbSpec++;
+		}
+	}
+}
+
 class Hashtable
 {
 	protected:
@@ -74,34 +165,55 @@ class EHashtable: public Hashtable
 		std::vector< std::string >	m_Labels;
 		std::map< std::string, ILBL > 	m_mapLbls;
 
+		bool addCanonical(const uint64_t&			_kmerC,
+			const ILBL& 					_label,
+			const size_t& 					_count
+			);
+
+		void selectKmers(const size_t&				_begin,
+			const size_t&					_end,
+			const std::vector<size_t>&			_fileOfLabel,
+			const IOCCR&					_minMult,
+			const IOCCR&					_maxMult,
+			std::vector<TskKmer>&				_kmers
+			);
+
+		bool saveKmers(const std::vector<std::string>&		_files,
+			const std::vector<size_t>&			_fileOfLabel,
+			const IOCCR&					_minMult,
+			const IOCCR&					_maxMult
+			);
+
 	public:
 		EHashtable();	
 		EHashtable(const size_t& _kmerSize);
 		
 		EHashtable(const size_t& _kmerSize, 
 			const std::vector< std::string >&	 	_labelsA, 
-			const std::vector< std::string >& 		_labelsC
+			const std::vector< std::string >& 		_labelsC,
+			const HtSize&					_htSize = HtSize()
 			);
 
 		~EHashtable();
 		bool iskmerLengthValid() const;
-		bool addElement(const uint64_t& 			_kmerF, 
-			const std::string& 				_label, 
-			const size_t& 					_count
-			);
-		bool addElement(const std::string&	 		_kmerI, 
-			const std::string& 				_label, 
-			const size_t& 					_count
+		void countTargets(std::vector<TargetKmers>&		_targets,
+			const size_t&					_numTargets
 			);
-		bool addElement(const std::string& 			_kmer, 
-			const std::string& 				_label
+
+		void allocate()
+		{	m_hTable.allocate();	}
+
+		void addTargets(const std::vector<TargetKmers>&	_targets,
+			const size_t&					_numTargets
 			);
-		bool addElement(const std::string& _kmer);
+
+		const HtSize& htSize() const
+		{	return m_hTable.htSize();	}
 
 		bool clear();
 
-		void SortAllHashTable(const size_t& _iteratorPos = 0)
-		{	m_hTable.sortall(_iteratorPos);	}
+		void SortAllHashTable()
+		{	m_hTable.sortall();	}
 		
 		bool SaveMultiple(const std::vector<std::string>& 	_filesHT, 
 			const std::vector<std::string>& 		_labels, 
@@ -126,10 +238,10 @@ class EHashtable: public Hashtable
 		{	return m_hTable.find(_kmerI, _iLabel);	}		
 
 		uint64_t Write(const char * 				_filename, 
-			const size_t& 					_iteratorPos, 
-			const bool& 					_clearAfter = true
+			const bool& 					_clearAfter = true,
+			const DbLayout&					_layout = DBSPLIT
 			)
-		{	return m_hTable.write(_filename, _iteratorPos, _clearAfter);	}
+		{	return m_hTable.write(_filename, m_Labels.size()-1, _clearAfter, _layout);	}
 
 		bool Read(const char * 					_filename, 
 			size_t& 					_sizefile, 
@@ -141,7 +253,14 @@ class EHashtable: public Hashtable
 
 		void Load(const string& 				_fileHT, 
 			const std::string& 				_label, 
-			const ITYPE& 					_minCount = 0
+			const ITYPE& 					_minCount = 0,
+			const bool&					_countOnly = false
+			);
+
+		void Load(const std::vector<const TskFile*>&		_files,
+			const std::vector<std::string>&			_labels,
+			const ITYPE&					_minCount = 0,
+			const bool&					_countOnly = false
 			);
 };
 
@@ -153,6 +272,7 @@ class EHashtable: public Hashtable
 //
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 #include <cmath>
 #include "file.hh"
 #include "kmersConversion.hh"
@@ -182,12 +302,12 @@ Hashtable::~Hashtable(){}
 template <typename HKMERr, typename ELMTr>
 bool EHashtable<HKMERr, ELMTr>::iskmerLengthValid() const
 {
-	double beta = log(((double)HTSIZE))/log(4.0);
+	double beta = log(((double)m_hTable.htSize().size))/log(4.0);
 	if ( sizeof(HKMERr)*4*1 + beta < m_kmerSize )
 	{
 		cerr << "The k-mer length (" << m_kmerSize  << ") requested is too big against hash-table settings." << endl;
 		cerr << "Please choose a k-mer length smaller than "<< (size_t) (( sizeof(HKMERr)*4*1*1.0 + beta ));
-		cerr << " or increase the value of HTSIZE and/or change the type of the Cell key (files dataType.hh, parameters.hh)." << endl;
+		cerr << " or increase the hash-table size (--ht-size) and/or change the type of the Cell key (files dataType.hh, parameters.hh)." << endl;
 		cerr << "The program must exit now." << endl;
 		return false;
 	}
@@ -208,7 +328,7 @@ EHashtable<HKMERr, ELMTr>::EHashtable(const size_t& _kmerSize): Hashtable(_kmerS
 }
 
 template <typename HKMERr, typename ELMTr>
-EHashtable<HKMERr, ELMTr>::EHashtable(const size_t& _kmerSize, const std::vector< std::string >& _labelsA, const std::vector< std::string >& _labelsC): Hashtable(_kmerSize), m_Labels(1+_labelsA.size()+_labelsC.size()), m_hTable((uint8_t) _kmerSize)
+EHashtable<HKMERr, ELMTr>::EHashtable(const size_t& _kmerSize, const std::vector< std::string >& _labelsA, const std::vector< std::string >& _labelsC, const HtSize& _htSize): Hashtable(_kmerSize), m_Labels(1+_labelsA.size()+_labelsC.size()), m_hTable((uint8_t) _kmerSize, _htSize)
 {
 	//// create list of labels and map from label back to index
 	for(size_t t = 0; t < _labelsA.size(); t++)
@@ -229,45 +349,19 @@ EHashtable<HKMERr, ELMTr>::EHashtable(const size_t& _kmerSize, const std::vector
 	template <typename HKMERr, typename ELMTr>
 bool EHashtable<HKMERr, ELMTr>::RemoveCommon(const std::vector<std::string>& _labels_c, const size_t& _minCount)
 {
-	m_hTable.resetIterator();
-	ELMTr e;
 	uint64_t nbElement = 0;
 	uint64_t nbSpec = 0;
-	string Lbl, centro, candidate, c_label;
-	ILBL i_lbl = 0;
-	bool found = false;
-	std::map<string,ILBL>::iterator it_Lbl;
 	const bool centromereRequested = _labels_c.size() > 0 ;
-	while (m_hTable.next())
+	const size_t htSize = m_hTable.htSize().size;
+	//// buckets are independent
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 65536) reduction(+:nbElement,nbSpec)
+#endif
+	for(size_t b = 0; b < htSize; b++)
 	{
-		m_hTable.elementIterator(e);
-		if (e.GetMultiplicity() == 1 && e.GetCount() > _minCount)
+		for(size_t u = 0; u < m_hTable.bucketSize(b); u++)
 		{
-			m_hTable.markElementAtIterator();
-			nbElement++;
-			continue;
-		}
-		if (centromereRequested && e.GetMultiplicity() == 2  && e.GetCount() > _minCount)
-		{
-			m_hTable.markElementAtIterator();
-			Lbl = m_Labels[e.GetLabel()];
-			centro = Lbl.substr(0, Lbl.size()-1);
-			found = false;
-			for(size_t t = 0; !found && t < _labels_c.size(); t++)
-			{
-				if (_labels_c[t].size() == Lbl.size())
-				{
-					candidate = _labels_c[t].substr(0, Lbl.size()-1);
-					found = centro.compare(candidate) == 0;
-					c_label = _labels_c[t];
-				}
-			}
-			if (found)
-			{
-				it_Lbl = m_mapLbls.find(c_label);
-				m_hTable.updateLabelAtIterator(it_Lbl->second);
-				nbSpec++;
-			}
+			markSpecific(m_hTable.element(b, u), m_Labels, m_mapLbls, _labels_c, _minCount, nbElement, nbSpec);
 		}
 	}
 
@@ -279,117 +373,152 @@ bool EHashtable<HKMERr, ELMTr>::RemoveCommon(const std::vector<std::string>& _la
 	return true;
 }
 
+/**
+ * K-mers of multiplicity _minMult to _maxMult of the buckets [_begin, _end),
+ * with the file of their label, _fileOfLabel[label] ((size_t) -1 for none).
+ */
 	template <typename HKMERr, typename ELMTr>
-bool EHashtable<HKMERr, ELMTr>::SaveMultiple(const std::vector<std::string>& _filesHT, const std::vector<std::string>& _labels, const IOCCR& _multiplicity, const size_t& _minCount)
+void EHashtable<HKMERr, ELMTr>::selectKmers(const size_t& _begin, const size_t& _end, const std::vector<size_t>& _fileOfLabel, const IOCCR& _minMult, const IOCCR& _maxMult, std::vector<TskKmer>& _kmers)
 {
-	size_t kmerSize = m_kmerSize;
-	if (_filesHT.size() < 1 || _labels.size() < 1 || _filesHT.size() != _labels.size() )
+	_kmers.clear();
+	for(size_t b = _begin; b < _end; b++)
 	{
-		return false;
+		for(size_t u = 0; u < m_hTable.bucketSize(b); u++)
+		{
+			const ELMTr& e = m_hTable.element(b, u);
+			if (e.GetMultiplicity() < _minMult || e.GetMultiplicity() > _maxMult
+				|| e.GetLabel() >= _fileOfLabel.size() || _fileOfLabel[e.GetLabel()] == (size_t) -1)
+			{	continue;	}
+			TskKmer kmer;
+			kmer.file = _fileOfLabel[e.GetLabel()];
+			kmer.kmer = m_hTable.kmer(b, u);
+			kmer.count = e.GetCount();
+			_kmers.push_back(kmer);
+		}
 	}
-	vector<FILE*> fds(_filesHT.size());
-	std::map<string, size_t> stringToIndex;
+}
 
-	for(size_t t = 0; t < _filesHT.size() ; t++)
+/**
+ * Save selected k-mers to binary targets-specific k-mers files, in the order of the buckets.
+ * Ranges of buckets are selected in parallel, counted, then selected again and written in order.
+ */
+	template <typename HKMERr, typename ELMTr>
+bool EHashtable<HKMERr, ELMTr>::saveKmers(const std::vector<std::string>& _files, const std::vector<size_t>& _fileOfLabel, const IOCCR& _minMult, const IOCCR& _maxMult)
+{
+	const size_t htSize = m_hTable.htSize().size;
+	const size_t numRanges = (htSize + TSKSAVEBUCKETS - 1) / TSKSAVEBUCKETS;
+#ifdef _OPENMP
+	const size_t numThreads = omp_get_max_threads();
+#else
+	const size_t numThreads = 1;
+#endif
+	std::vector< std::vector<TskKmer> > kmers(numThreads);
+
+	std::vector<uint64_t> numKmers(_files.size(), 0);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for(size_t r = 0; r < numRanges; r++)
 	{
-		// Writing/Saving data in file
-		fds[t] = fopen(_filesHT[t].c_str(), "w+");
-		fprintf(fds[t], "#Target specific k-mers labeled %s and appearing strictly more than %lu times.\n", _labels[t].c_str(), _minCount);
-		fprintf(fds[t], "#IKMER ICOUNT %lu-MER \n#\n", kmerSize);
-		stringToIndex[ _labels[t]] = t;
+#ifdef _OPENMP
+		std::vector<TskKmer>& selected = kmers[omp_get_thread_num()];
+#else
+		std::vector<TskKmer>& selected = kmers[0];
+#endif
+		selectKmers(r * TSKSAVEBUCKETS, std::min(htSize, (r + 1) * TSKSAVEBUCKETS), _fileOfLabel, _minMult, _maxMult, selected);
+		for(size_t i = 0; i < selected.size(); i++)
+		{
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+			numKmers[selected[i].file]++;
+		}
 	}
-	m_hTable.resetIterator();
-	string kmer;
-	while (m_hTable.next())
-	{
-		ELMTr e;
-		uint64_t kmerIndex;
-		m_hTable.elementIterator(kmerIndex, e);
 
-		if (e.GetMultiplicity() <= _multiplicity /*&& e.GetCount() > _minCount */)
+	bool success = true;
+	std::vector<TskWriter> writers(_files.size());
+	for(size_t t = 0; t < _files.size(); t++)
+	{
+		success = writers[t].open(_files[t].c_str(), m_kmerSize, htSize, numKmers[t]) && success;
+	}
+	for(size_t first = 0; success && first < numRanges; first += numThreads)
+	{
+		const size_t last = std::min(first + numThreads, numRanges);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+		for(size_t r = first; r < last; r++)
 		{
-			if (stringToIndex.find(m_Labels[e.GetLabel()]) != stringToIndex.end())
-			{
-				size_t i_lbl = stringToIndex.find(m_Labels[e.GetLabel()])->second;
-				IndexTovector(kmerIndex, kmerSize, kmer);
-				fprintf(fds[i_lbl],"%" PRIu64 "\t%lu\t%s\n", kmerIndex, e.GetCount(), kmer.c_str());
-			}
+			selectKmers(r * TSKSAVEBUCKETS, std::min(htSize, (r + 1) * TSKSAVEBUCKETS), _fileOfLabel, _minMult, _maxMult, kmers[r - first]);
+		}
+		for(size_t r = first; r < last; r++)
+		{
+			const std::vector<TskKmer>& selected = kmers[r - first];
+			for(size_t i = 0; i < selected.size(); i++)
+			{	writers[selected[i].file].add(selected[i].kmer, selected[i].count);	}
 		}
 	}
-
-	//Closing all files
-	for(size_t t = 0; t < _filesHT.size() ; t++)
+	for(size_t t = 0; t < writers.size(); t++)
 	{
-		fclose(fds[t]);
+		success = writers[t].close() && success;
 	}
-
-	return true;
+	return success;
 }
 
+/**
+ * Save the k-mers of multiplicity up to _multiplicity labeled with _labels,
+ * one file per label.
+ */
 	template <typename HKMERr, typename ELMTr>
-bool EHashtable<HKMERr, ELMTr>::SaveIntersectionMultiple(const std::vector<std::string>& _filesHT, const std::vector<std::string>& _labels)
+bool EHashtable<HKMERr, ELMTr>::SaveMultiple(const std::vector<std::string>& _filesHT, const std::vector<std::string>& _labels, const IOCCR& _multiplicity, const size_t& _minCount)
 {
-	size_t kmerSize =  m_kmerSize;
 	if (_filesHT.size() < 1 || _labels.size() < 1 || _filesHT.size() != _labels.size() )
 	{
 		return false;
 	}
-
-	vector<FILE*> fds(_filesHT.size());
+	std::map<string, size_t> stringToIndex;
 	for(size_t t = 0; t < _filesHT.size() ; t++)
 	{
-		// Writing/Saving data in file
-		fds[t] = fopen(_filesHT[t].c_str(), "w+");
-		string name= _labels[t];
-		string	centro = name.substr(0, name.size()-1);
-		fprintf(fds[t], "#K-mers specific to chromosome-centromere %s\n", centro.c_str());
-		fprintf(fds[t], "#IKMER ICOUNT %lu-MER\n#\n", kmerSize);
+		stringToIndex[ _labels[t]] = t;
 	}
-
-	ELMTr e;
-	uint64_t kmerIndex;
-	m_hTable.resetIterator();
-	string kmer;
-	while (m_hTable.next())
+	std::vector<size_t> fileOfLabel(m_Labels.size(), (size_t) -1);
+	for(size_t l = 0; l < m_Labels.size(); l++)
 	{
-		m_hTable.elementIterator(kmerIndex, e);
+		if (stringToIndex.find(m_Labels[l]) != stringToIndex.end())
+		{	fileOfLabel[l] = stringToIndex.find(m_Labels[l])->second;	}
+	}
+	return saveKmers(_filesHT, fileOfLabel, 0, _multiplicity);
+}
 
-		bool label_found = false, sameChr = false;
-		size_t i_lbl = 0;
-		while (!label_found && i_lbl < _labels.size())
+/**
+ * Save the k-mers of multiplicity 2 to the file of the centromere
+ * of their chromosome (labels differing only in the last character).
+ */
+	template <typename HKMERr, typename ELMTr>
+bool EHashtable<HKMERr, ELMTr>::SaveIntersectionMultiple(const std::vector<std::string>& _filesHT, const std::vector<std::string>& _labels)
+{
+	if (_filesHT.size() < 1 || _labels.size() < 1 || _filesHT.size() != _labels.size() )
+	{
+		return false;
+	}
+	std::vector<size_t> fileOfLabel(m_Labels.size(), (size_t) -1);
+	for(size_t l = 0; l < m_Labels.size(); l++)
+	{
+		const string& Lbl = m_Labels[l];
+		for(size_t i_lbl = 0; Lbl.size() > 0 && i_lbl < _labels.size(); i_lbl++)
 		{
-			if ( e.GetMultiplicity() == 2 )
-			{
-				string label = _labels[i_lbl];
-				string Lbl = m_Labels[e.GetLabel()];
-				bool sameChr = Lbl.size() == label.size();
-				for(size_t t = 0 ; sameChr && t < Lbl.size() - 1 ; t++ )
-				{       sameChr = sameChr && Lbl[t] == label[t];}
-
-				if (sameChr)
-				{
-					label_found = true;
-					IndexTovector(kmerIndex, kmerSize, kmer);
-					fprintf(fds[i_lbl], "%" PRIu64 "\t%lu\t%s\n",kmerIndex,e.GetCount(), kmer.c_str()); 
-				}
-				else
-				{
-					i_lbl++;
-				}
-			}
-			else
+			const string& label = _labels[i_lbl];
+			bool sameChr = Lbl.size() == label.size();
+			for(size_t t = 0 ; sameChr && t < Lbl.size() - 1 ; t++ )
+			{       sameChr = sameChr && Lbl[t] == label[t];}
+			if (sameChr)
 			{
-				label_found = true;
+				fileOfLabel[l] = i_lbl;
+				break;
 			}
 		}
 	}
-
-	//Closing all files
-	for(size_t t = 0; t < _filesHT.size() ; t++)
-	{
-		fclose(fds[t]);
-	}
-	return true;
+	return saveKmers(_filesHT, fileOfLabel, 2, 2);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -406,97 +535,93 @@ bool EHashtable<HKMERr, ELMTr>::clear()
 	m_hTable.clear();
 }
 
+/**
+ * Add a canonical k-mer, or update its multiplicity and count.
+ * Returns true if the k-mer is new.
+ * Only the bucket of the k-mer is modified.
+ */
 	template <typename HKMERr, typename ELMTr>
-bool EHashtable<HKMERr, ELMTr>::addElement(const std::string&   _kmer)
-{
-	return addElement(_kmer, "", 1);
-}
-
-	template <typename HKMERr, typename ELMTr>
-bool EHashtable<HKMERr, ELMTr>::addElement(const std::string& _kmer, const string& _label)
-{
-	return addElement(_kmer,  _label, 1);
-}
-
-	template <typename HKMERr, typename ELMTr>
-bool EHashtable<HKMERr, ELMTr>::addElement(const uint64_t& _kmerF, const std::string& _label, const size_t& _count)
+bool EHashtable<HKMERr, ELMTr>::addCanonical(const uint64_t& _kmerC, const ILBL& _label, const size_t& _count)
 {
-	//// getting reverse kmer
-	uint64_t _kmerR = _kmerF;
-	uint8_t m_k = m_kmerSize;
-	_kmerR = ((_kmerR >> 2)  & 0x3333333333333333UL) | ((_kmerR & 0x3333333333333333UL) << 2);
-	_kmerR = ((_kmerR >> 4)  & 0x0F0F0F0F0F0F0F0FUL) | ((_kmerR & 0x0F0F0F0F0F0F0F0FUL) << 4);
-	_kmerR = ((_kmerR >> 8)  & 0x00FF00FF00FF00FFUL) | ((_kmerR & 0x00FF00FF00FF00FFUL) << 8);
-	_kmerR = ((_kmerR >> 16) & 0x0000FFFF0000FFFFUL) | ((_kmerR & 0x0000FFFF0000FFFFUL) << 16);
-	_kmerR = ( _kmerR >> 32                        ) | ( _kmerR                        << 32);
-	_kmerR = (((uint64_t)-1) - _kmerR) >> (64 - (m_k << 1));
-	
-	//// getting canonical kmer
-	uint64_t _kmerC = _kmerF < _kmerR ? _kmerF : _kmerR;
-	
-	//// checking hash table
 	size_t e_x = 0, e_y = 0;
 	ILBL e_l = 0;
 	IOCCR mult;
 	ICount count;
-	string Lbl;
-	bool upLbl, isSameLbl;
-	
+
+	// Checking
 	if (m_hTable.find(_kmerC, e_x, e_y, e_l, mult, count))
 	{
-		Lbl = m_Labels[e_l];
-		upLbl = _label[0] == Lbl[0] && Lbl.size() == _label.size() ;
-		for(size_t t = 1 ; upLbl && t < Lbl.size() - 1; t++)
-		{       upLbl = upLbl && _label[t] == Lbl[t];}
-		isSameLbl = upLbl && _label[Lbl.size()-1] == Lbl[Lbl.size()-1];
-		m_hTable.updateElement(e_x, e_y, _count, !upLbl, isSameLbl);
-		return true;
+		updateElement(m_hTable.element(e_x, e_y), m_Labels[e_l], m_Labels[_label], _count);
+		return false;
 	}
 
 	// Element is not in the table already. Then adding now.
-	std::map<string,ILBL>::iterator it_Lbl = m_mapLbls.find(_label);
-	m_hTable.insert(_kmerC, it_Lbl->second, _count);
-	m_localIndex++;
+	m_hTable.insert(_kmerC, _label, _count);
 	return true;
 }
 
+/**
+ * Count the cells needed by the k-mers of consecutive targets, before the table
+ * is allocated. Distinct k-mers of a target are counted once, the k-mers of
+ * each partition are sorted.
+ */
 	template <typename HKMERr, typename ELMTr>
-bool EHashtable<HKMERr, ELMTr>::addElement(const std::string& _kmerI, const std::string& _label, const size_t& _count)
+void EHashtable<HKMERr, ELMTr>::countTargets(std::vector<TargetKmers>& _targets, const size_t& _numTargets)
 {
-	string _kmer;
-	_kmer = _kmerI;
-
-	uint64_t kmerIndex = 0;
-	vectorToIndex(_kmer, kmerIndex);
-	uint64_t rev_kmerIndex = 0;
-	getReverseComplement(_kmer, rev_kmerIndex);
-	
-	size_t e_x = 0, e_y = 0;
-	ILBL e_l = 0;
-	IOCCR mult;
-	ICount count;
-
-	//// getting canonical kmer
-	uint64_t _kmerC = kmerIndex < rev_kmerIndex ? kmerIndex : rev_kmerIndex;
-
-	// Checking
-	if (m_hTable.find(_kmerC, e_x, e_y, e_l, mult, count))
+	if (_numTargets == 0)
+	{	return;	}
+	const size_t numParts = _targets[0].kmers.size();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for(size_t p = 0; p < numParts; p++)
 	{
-		string Lbl = m_Labels[e_l];
-		bool upLbl = _label[0] == Lbl[0] && Lbl.size() == _label.size() ;
-		for(size_t t = 1 ; upLbl && t < Lbl.size() - 1; t++)
-		{	upLbl = upLbl && _label[t] == Lbl[t];}
-		bool isSameLbl = upLbl && _label[Lbl.size()-1] == Lbl[Lbl.size()-1];
-		m_hTable.updateElement(e_x, e_y, _count, !upLbl, isSameLbl);
-		return true;
+		for(size_t t = 0; t < _numTargets; t++)
+		{
+			std::vector<uint64_t>& kmers = _targets[t].kmers[p];
+			std::sort(kmers.begin(), kmers.end());
+			for(size_t i = 0; i < kmers.size(); i++)
+			{
+				if (i == 0 || kmers[i] != kmers[i-1])
+				{	m_hTable.count(kmers[i]);	}
+			}
+		}
 	}
+}
 
-	// Element is not in the table already. Then adding now.
-	std::map<string,ILBL>::iterator it_Lbl = m_mapLbls.find(_label);
-	m_hTable.insert(_kmerC, it_Lbl->second, _count);
-	m_localIndex++;
-
-	return true;
+/**
+ * Add the k-mers of consecutive targets, with the same result as adding them
+ * target by target. Partitions cover disjoint ranges of buckets
+ * and are filled in parallel, each in the order of the targets.
+ */
+	template <typename HKMERr, typename ELMTr>
+void EHashtable<HKMERr, ELMTr>::addTargets(const std::vector<TargetKmers>& _targets, const size_t& _numTargets)
+{
+	if (_numTargets == 0)
+	{	return;	}
+	std::vector<ILBL> labels(_numTargets);
+	for(size_t t = 0; t < _numTargets; t++)
+	{
+		labels[t] = m_mapLbls.find(_targets[t].label)->second;
+	}
+	const size_t numParts = _targets[0].kmers.size();
+	size_t added = 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) reduction(+:added)
+#endif
+	for(size_t p = 0; p < numParts; p++)
+	{
+		for(size_t t = 0; t < _numTargets; t++)
+		{
+			const std::vector<uint64_t>& kmers = _targets[t].kmers[p];
+			const std::vector<ITYPE>& counts = _targets[t].counts[p];
+			for(size_t i = 0; i < kmers.size(); i++)
+			{
+				added += addCanonical(kmers[i], labels[t], counts.empty() ? 1 : counts[i]) ? 1 : 0;
+			}
+		}
+	}
+	m_localIndex += added;
 }
 
 template <typename HKMERr, typename ELMTr>
@@ -510,7 +635,7 @@ bool EHashtable<HKMERr, ELMTr>::queryElement(const IKMER& _ikmer, ILBL& _iLabel)
 }
 
 	template <typename HKMERr, typename ELMTr>
-void EHashtable<HKMERr, ELMTr>::Load(const string& _fileHT, const std::string& _label, const ITYPE& _minCount)
+void EHashtable<HKMERr, ELMTr>::Load(const string& _fileHT, const std::string& _label, const ITYPE& _minCount, const bool& _countOnly)
 {
 	FILE * fd = fopen(_fileHT.c_str(), "r");
 
@@ -542,7 +667,11 @@ void EHashtable<HKMERr, ELMTr>::Load(const string& _fileHT, const std::string& _
 	it_Lbl = m_mapLbls.find(_label);
 	while ( getFirstAndSecondElementInLine(fd, kIndex, count) )
 	{
-		if (count > _minCount)
+		if (count > _minCount && _countOnly)
+		{
+			m_hTable.count(kIndex);
+		}
+		else if (count > _minCount)
 		{
 			m_hTable.insert(kIndex, it_Lbl->second);
 			m_localIndex++;
@@ -551,3 +680,60 @@ void EHashtable<HKMERr, ELMTr>::Load(const string& _fileHT, const std::string& _
 	fclose(fd);
 }
 
+/**
+ * Load binary targets-specific k-mers files, file t labeled _labels[t].
+ * Partitions of buckets are counted or filled in parallel. The k-mers of a partition
+ * are found in a file by binary search if it is ordered by the buckets of this table,
+ * files of another hash-table size are scanned.
+ */
+	template <typename HKMERr, typename ELMTr>
+void EHashtable<HKMERr, ELMTr>::Load(const std::vector<const TskFile*>& _files, const std::vector<std::string>& _labels, const ITYPE& _minCount, const bool& _countOnly)
+{
+	const HtSize& htSize = m_hTable.htSize();
+#ifdef _OPENMP
+	const size_t numParts = omp_get_max_threads() * TSKLOADPARTSPERTHREAD;
+#else
+	const size_t numParts = 1;
+#endif
+	const size_t partSize = (htSize.size + numParts - 1) / numParts;
+	std::vector<ILBL> labels(_files.size());
+	for(size_t t = 0; t < _files.size(); t++)
+	{	labels[t] = m_mapLbls.find(_labels[t])->second;	}
+
+	size_t loaded = 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1) reduction(+:loaded)
+#endif
+	for(size_t p = 0; p < numParts; p++)
+	{
+		const uint64_t begin = p * partSize, end = std::min<uint64_t>(begin + partSize, htSize.size);
+		for(size_t t = 0; t < _files.size(); t++)
+		{
+			const TskFile& file = *_files[t];
+			const uint64_t* kmers = file.kmers();
+			const ITYPE* counts = file.counts();
+			const bool ordered = file.header().htSize == htSize.size;
+			for(uint64_t i = ordered ? file.lowerBound(htSize, begin) : 0; i < file.header().numKmers; i++)
+			{
+				const uint64_t bucket = htSize.remainder(kmers[i]);
+				if (bucket < begin || bucket >= end)
+				{
+					if (ordered)
+					{	break;	}
+					continue;
+				}
+				if (counts[i] <= _minCount)
+				{	continue;	}
+				if (_countOnly)
+				{	m_hTable.count(kmers[i]);	}
+				else
+				{
+					m_hTable.insert(kmers[i], labels[t]);
+					loaded++;
+				}
+			}
+		}
+	}
+	m_localIndex += loaded;
+}
+
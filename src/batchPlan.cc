@@ -0,0 +1,201 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * Number of batches chosen from the input and the memory (-b auto).
+ */
+
+#include <iostream>
+#include <cstdio>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "./batchPlan.hh"
+#include "./chunkReader.hh"
+#include "./dataType.hh"
+
+using namespace std;
+
+// assumed without a sample (list of files, server): short FASTQ reads, the most memory per byte
+#define PLANREADBASES	100
+#define PLANREADBYTES	(2*PLANREADBASES + 30)
+
+/**
+ * Count the reads and bases of the first records of the input.
+ * If the input cannot be sampled, short reads are assumed.
+ */
+void sampleInput(const char* _filename, const char* _filename2, InputSample& _sample)
+{
+	_sample.bytes = PLANREADBYTES;
+	_sample.reads = 1;
+	_sample.bases = PLANREADBASES;
+	_sample.maxLength = PLANREADBASES;
+	_sample.inputSize = 0;
+	_sample.sampled = false;
+	if (_filename == NULL)
+		return;
+
+	// input size, unknown for compressed input
+	struct stat st;
+	for (size_t i = 0; i < 2; i++)
+	{
+		const char* filename = i == 0 ? _filename : _filename2;
+		if (filename == NULL)
+			continue;
+		if (stat(filename, &st) != 0 || InputFile::compression(filename) != INPUT_PLAIN)
+		{
+			_sample.inputSize = 0;
+			break;
+		}
+		_sample.inputSize += st.st_size;
+	}
+
+	ChunkReader reader(PLANSAMPLE);
+	if (_filename2 != NULL ? !reader.open(_filename, _filename2) : !reader.open(_filename))
+		return;
+	const uint8_t* chunk;
+	size_t chunkSize;
+	if (!reader.next(chunk, chunkSize) || chunkSize == 0 || (chunk[0] != '>' && chunk[0] != '@'))
+		return;
+
+	const bool isFasta = chunk[0] == '>';
+	size_t reads = 0, bases = 0, maxLength = 0, length = 0, line = 0;
+	for (size_t i = 0; i < chunkSize; line++)
+	{
+		const uint8_t* end = (const uint8_t*) memchr(chunk + i, '\n', chunkSize - i);
+		const size_t lineEnd = end != NULL ? end - chunk : chunkSize;
+		const bool isHeader = isFasta ? chunk[i] == '>' : line % 4 == 0;
+		if (isHeader)
+		{
+			reads++;
+			length = 0;
+		}
+		else if (isFasta || line % 4 == 1)
+		{
+			length += lineEnd - i;
+			bases += lineEnd - i;
+			if (length > maxLength) maxLength = length;
+		}
+		i = lineEnd + 1;
+	}
+	if (reads == 0)
+		return;
+
+	_sample.bytes = chunkSize;
+	_sample.reads = reads;
+	_sample.bases = bases;
+	_sample.maxLength = maxLength;
+	_sample.sampled = true;
+}
+
+/**
+ * Available host memory in bytes (MemAvailable, or the free pages).
+ */
+size_t availableMemory()
+{
+	FILE* fd = fopen("/proc/meminfo", "r");
+	if (fd != NULL)
+	{
+		char line[256];
+		unsigned long long kb;
+		while (fgets(line, sizeof(line), fd) != NULL)
+		{
+			if (sscanf(line, "MemAvailable: %llu kB", &kb) == 1)
+			{
+				fclose(fd);
+				return (size_t) kb << 10;
+			}
+		}
+		fclose(fd);
+	}
+	return (size_t) sysconf(_SC_AVPHYS_PAGES) * (size_t) sysconf(_SC_PAGESIZE);
+}
+
+/**
+ * Choose the number of batches and the chunk size.
+ * _memBudget is the host memory in bytes, 0 for the default share of the available memory.
+ */
+BatchPlan planBatches(const InputSample& _sample, const size_t _threads, const size_t _chunkSize,
+		const bool _useCpu, const bool _isExtended, const size_t _memBudget)
+{
+	BatchPlan plan;
+	plan.memBudget = _memBudget > 0 ? _memBudget : availableMemory() / PLANHOSTSHARE;
+
+	// per byte of input
+	const double reads = PLANSLACK * _sample.reads / _sample.bytes;
+	// each read has its bases, 4 per byte, a part length and a last container partly used
+	const double containers = PLANSLACK * ((double) _sample.bases / _sample.bytes / (sizeof(CONTAINER)*4)) + 2*reads;
+
+	// device: read pointers, containers, results for each part of the database and for merging, final results
+	const size_t resultBuffers = DBPARTSPERDEVICE+1 > 3 ? DBPARTSPERDEVICE+1 : 3;
+	const double devicePerByte = reads * (sizeof(uint32_t) + (resultBuffers*RESULTROWSIZE + FINALROWSIZE)*sizeof(RESULTS))
+								 + containers * sizeof(CONTAINER);
+	// host: chunk read and chunk filled, read positions, read pointers, containers, final and full results
+	const bool fullResults = _isExtended || !_useCpu;
+	const double hostPerByte = 2 + reads * (5*sizeof(size_t) + sizeof(uint32_t) + (FINALROWSIZE + (fullResults ? RESULTROWSIZE : 0))*sizeof(RESULTS))
+							   + containers * sizeof(CONTAINER);
+
+	plan.chunkSize = _chunkSize;
+	if (plan.chunkSize * hostPerByte > plan.memBudget)
+	{
+		plan.chunkSize = plan.memBudget / hostPerByte;
+		if (plan.chunkSize < PLANCHUNKMIN) plan.chunkSize = PLANCHUNKMIN;
+	}
+	plan.hostMemory = plan.chunkSize * hostPerByte;
+
+	// input of a chunk, less for a small file
+	size_t input = plan.chunkSize;
+	if (_sample.inputSize > 0 && _sample.inputSize < input)
+		input = _sample.inputSize;
+
+	// one batch per thread at least, more batches only if a batch does not fit into the device memory
+	plan.batches = _threads > 0 ? _threads : 1;
+	if (!_useCpu)
+	{
+		const size_t deviceBatches = (size_t) (input * devicePerByte / RESERVED) + 1;
+		if (deviceBatches > plan.batches) plan.batches = deviceBatches;
+	}
+	if ((input - 1) / MAXBATCHBYTES + 1 > plan.batches)
+		plan.batches = (input - 1) / MAXBATCHBYTES + 1;
+
+	plan.maxReads = (size_t) ((double) input / plan.batches * reads) + 1;
+	plan.batchMemory = _useCpu ? 0 : (size_t) ((double) input / plan.batches * devicePerByte);
+	return plan;
+}
+
+void printBatchPlan(const InputSample& _sample, const BatchPlan& _plan)
+{
+	cerr << "Batch plan: " << (_sample.sampled ? "sampled " : "assumed ") << _sample.reads << " reads of "
+		 << _sample.bases / _sample.reads << " bases on average (up to " << _sample.maxLength << ")";
+	if (_sample.inputSize > 0)
+		cerr << ", input of " << (_sample.inputSize >> 20) << " MB";
+	cerr << ".\n";
+	cerr << "Batch plan: " << _plan.batches << " batches of up to " << _plan.maxReads << " reads";
+	if (_plan.batchMemory > 0)
+		cerr << ", " << (_plan.batchMemory >> 20) << " MB of device memory each (" << RESERVED/1000000 << " MB reserved)";
+	cerr << ".\n";
+	cerr << "Batch plan: chunks of " << (_plan.chunkSize >> 20) << " MB, "
+		 << (_plan.hostMemory >> 20) << " MB of host memory (budget " << (_plan.memBudget >> 20) << " MB).\n";
+}
@@ -0,0 +1,84 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * Number of batches chosen from the input and the memory (-b auto).
+ *
+ * The first records of the input give the reads and bases per byte.
+ * A batch is the share of a chunk (or of a smaller input) of one thread,
+ * and its reads, containers and results follow from them.
+ * On CUDA devices, the batches are made small enough for the device memory
+ * reserved next to the database (RESERVED). The host memory of a chunk,
+ * with all its batches, is kept in the memory budget (--mem-budget, by
+ * default a share of the available memory) with smaller chunks if needed.
+ */
+
+#ifndef BATCHPLAN_HH
+#define BATCHPLAN_HH
+
+#include <stddef.h>
+
+#define PLANSAMPLE		(4 << 20)	// bytes of input sampled
+#define PLANSLACK		1.25		// for batches with more or shorter reads than the sample
+#define PLANHOSTSHARE	2			// by default, 1/PLANHOSTSHARE of the available host memory
+#define PLANCHUNKMIN	(1 << 20)	// smallest chunk, in bytes
+
+/**
+ * Reads of the input sampled, or assumed if it cannot be sampled.
+ */
+struct InputSample
+{
+	size_t		bytes;
+	size_t		reads;
+	size_t		bases;
+	size_t		maxLength;
+	size_t		inputSize;		// bytes of input, 0 if not known (compressed)
+	bool		sampled;
+};
+
+struct BatchPlan
+{
+	size_t		batches;
+	size_t		chunkSize;		// bytes of input per chunk
+	size_t		maxReads;		// reads of a batch, estimated
+	size_t		batchMemory;	// device memory of a batch, 0 on the host
+	size_t		hostMemory;		// host memory of a chunk
+	size_t		memBudget;		// for the host memory
+};
+
+void sampleInput(const char* _filename, const char* _filename2, InputSample& _sample);
+
+size_t availableMemory();
+
+BatchPlan planBatches(const InputSample&	_sample,
+		const size_t		_threads,
+		const size_t		_chunkSize,
+		const bool			_useCpu,
+		const bool			_isExtended,
+		const size_t		_memBudget
+		);
+
+void printBatchPlan(const InputSample& _sample, const BatchPlan& _plan);
+
+#endif
@@ -0,0 +1,388 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * Temporary files of the out-of-core database creation.
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <sstream>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "./buildRuns.hh"
+
+using namespace std;
+
+/**
+ * Write all bytes at a position of the file.
+ */
+static bool writeAll(const int _fd, const void* _data, size_t _size, uint64_t _pos)
+{
+	const uint8_t* data = (const uint8_t*) _data;
+	while (_size > 0)
+	{
+		ssize_t written = pwrite(_fd, data, _size, _pos);
+		if (written <= 0)
+		{
+			perror("Failed to write temporary file of the database creation");
+			return false;
+		}
+		data += written;
+		_pos += written;
+		_size -= written;
+	}
+	return true;
+}
+
+/**
+ * Read all bytes at a position of the file.
+ */
+static bool readAll(const int _fd, void* _data, size_t _size, uint64_t _pos)
+{
+	uint8_t* data = (uint8_t*) _data;
+	while (_size > 0)
+	{
+		ssize_t bytes = pread(_fd, data, _size, _pos);
+		if (bytes <= 0)
+		{
+			perror("Failed to read temporary file of the database creation");
+			return false;
+		}
+		data += bytes;
+		_pos += bytes;
+		_size -= bytes;
+	}
+	return true;
+}
+
+BuildRuns::BuildRuns(): m_numParts(0), m_resultFd(-1), m_occurrenceFd(-1)
+{}
+
+BuildRuns::~BuildRuns()
+{
+	close();
+}
+
+/**
+ * Create a temporary file, removed from the directory at once.
+ */
+int BuildRuns::create(const std::string& _filename) const
+{
+	int fd = ::open(_filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		perror(("Failed to create " + _filename).c_str());
+		return -1;
+	}
+	unlink(_filename.c_str());
+	return fd;
+}
+
+/**
+ * Temporary files are created with names <_prefix>.run<i>.tmp and <_prefix>.result.tmp.
+ */
+bool BuildRuns::open(const char* _prefix, const size_t& _numParts)
+{
+	close();
+	m_prefix = _prefix;
+	m_numParts = _numParts;
+	return true;
+}
+
+void BuildRuns::close()
+{
+	for (size_t r = 0; r < m_runs.size(); r++)
+	{	::close(m_runs[r]);	}
+	m_runs.clear();
+	m_runPos.clear();
+	m_partBegin.clear();
+	m_targetMaps.clear();
+	if (m_resultFd >= 0)
+	{	::close(m_resultFd);	}
+	if (m_occurrenceFd >= 0)
+	{	::close(m_occurrenceFd);	}
+	m_resultFd = -1;
+	m_occurrenceFd = -1;
+	m_resultBegin.clear();
+	m_resultSize.clear();
+	m_occurrenceSize.clear();
+}
+
+/**
+ * Sort the partitions (in parallel) and write them as one run.
+ * Equal occurrences of a k-mer in a target are stored once.
+ * The partitions are emptied.
+ */
+bool BuildRuns::addRun(std::vector< std::vector<BuildRecord> >& _parts)
+{
+	std::ostringstream filename;
+	filename << m_prefix << ".run" << m_runs.size() << ".tmp";
+	int fd = create(filename.str());
+	if (fd < 0)
+	{	return false;	}
+	m_runs.push_back(fd);
+	m_runPos.push_back(0);
+	m_targetMaps.push_back(std::vector<uint32_t>());
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for (size_t p = 0; p < m_numParts; p++)
+	{
+		std::vector<BuildRecord>& records = _parts[p];
+		std::sort(records.begin(), records.end());
+		size_t n = 0;
+		for (size_t i = 0; i < records.size(); i++)
+		{
+			if (n > 0 && records[n-1].sameOccurrence(records[i]))
+			{	records[n-1].occurrences += records[i].occurrences;	}
+			else
+			{	records[n++] = records[i];	}
+		}
+		records.resize(n);
+	}
+
+	std::vector<uint64_t> begin(m_numParts + 1, 0);
+	for (size_t p = 0; p < m_numParts; p++)
+	{	begin[p+1] = begin[p] + _parts[p].size();	}
+
+	bool success = true;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for (size_t p = 0; p < m_numParts; p++)
+	{
+		if (!writeAll(fd, _parts[p].data(), _parts[p].size() * sizeof(BuildRecord), begin[p] * sizeof(BuildRecord)))
+		{	success = false;	}
+		std::vector<BuildRecord>().swap(_parts[p]);
+	}
+	m_partBegin.push_back(begin);
+	return success;
+}
+
+/**
+ * Add records already sorted by bucket, from position _pos of an open file, as a run.
+ * The file is closed with the runs. Partitions have _partBuckets buckets, they are
+ * found by binary search. Targets are renumbered by _targetMap when read,
+ * to BUILDREMOVED if they are not in it.
+ */
+bool BuildRuns::addSortedRun(const int _fd, const uint64_t& _pos, const uint64_t& _numRecords,
+							 const uint64_t& _partBuckets, const std::vector<uint32_t>& _targetMap)
+{
+	m_runs.push_back(_fd);
+	m_runPos.push_back(_pos);
+	m_targetMaps.push_back(_targetMap);
+
+	std::vector<uint64_t> begin(m_numParts + 1, _numRecords);
+	begin[0] = 0;
+	for (size_t p = 1; p < m_numParts; p++)
+	{
+		// first record of a bucket >= p * _partBuckets
+		uint64_t first = begin[p-1], count = _numRecords - first;
+		while (count > 0)
+		{
+			const uint64_t half = count / 2;
+			BuildRecord record;
+			if (!readAll(_fd, &record, sizeof(BuildRecord), _pos + (first + half) * sizeof(BuildRecord)))
+			{	return false;	}
+			if (record.bucket < p * _partBuckets)
+			{
+				first += half + 1;
+				count -= half + 1;
+			}
+			else
+			{	count = half;	}
+		}
+		begin[p] = first;
+	}
+	m_partBegin.push_back(begin);
+	return true;
+}
+
+/**
+ * Read up to _records.size() records of a partition of a run, from record _first on.
+ * _records is resized to the number of records read.
+ */
+bool BuildRuns::readRun(const size_t& _run, const size_t& _part, const uint64_t& _first, std::vector<BuildRecord>& _records) const
+{
+	const uint64_t available = runRecords(_run, _part) - _first;
+	if (_records.size() > available)
+	{	_records.resize(available);	}
+	if (!readAll(m_runs[_run], _records.data(), _records.size() * sizeof(BuildRecord),
+				 m_runPos[_run] + (m_partBegin[_run][_part] + _first) * sizeof(BuildRecord)))
+	{	return false;	}
+	const std::vector<uint32_t>& targetMap = m_targetMaps[_run];
+	if (!targetMap.empty())
+	{
+		for (size_t i = 0; i < _records.size(); i++)
+		{
+			const uint32_t target = _records[i].target;
+			_records[i].target = target < targetMap.size() ? targetMap[target] : BUILDREMOVED;
+		}
+	}
+	return true;
+}
+
+/**
+ * Create the result file, and the file of the merged occurrences if requested.
+ * The results (occurrences) of a partition are at most its records,
+ * so partition p starts at the slot of its first record.
+ */
+bool BuildRuns::startResults(const bool& _occurrences)
+{
+	m_resultFd = create(m_prefix + ".result.tmp");
+	if (m_resultFd < 0)
+	{	return false;	}
+	if (_occurrences)
+	{
+		m_occurrenceFd = create(m_prefix + ".occurrences.tmp");
+		if (m_occurrenceFd < 0)
+		{	return false;	}
+	}
+	m_resultBegin.assign(m_numParts, 0);
+	m_resultSize.assign(m_numParts, 0);
+	m_occurrenceSize.assign(m_numParts, 0);
+	for (size_t p = 0; p + 1 < m_numParts; p++)
+	{
+		m_resultBegin[p+1] = m_resultBegin[p];
+		for (size_t r = 0; r < m_runs.size(); r++)
+		{	m_resultBegin[p+1] += runRecords(r, p);	}
+	}
+	return true;
+}
+
+/**
+ * Append results of a partition. Partitions may be appended to in parallel.
+ */
+bool BuildRuns::addResults(const size_t& _part, const std::vector<BuildResult>& _results)
+{
+	const uint64_t pos = (m_resultBegin[_part] + m_resultSize[_part]) * sizeof(BuildResult);
+	m_resultSize[_part] += _results.size();
+	return writeAll(m_resultFd, _results.data(), _results.size() * sizeof(BuildResult), pos);
+}
+
+/**
+ * Read up to _results.size() results of a partition, from result _first on.
+ * _results is resized to the number of results read.
+ */
+bool BuildRuns::readResults(const size_t& _part, const uint64_t& _first, std::vector<BuildResult>& _results) const
+{
+	const uint64_t available = m_resultSize[_part] - _first;
+	if (_results.size() > available)
+	{	_results.resize(available);	}
+	return readAll(m_resultFd, _results.data(), _results.size() * sizeof(BuildResult),
+				   (m_resultBegin[_part] + _first) * sizeof(BuildResult));
+}
+
+/**
+ * Append merged occurrences of a partition. Partitions may be appended to in parallel.
+ */
+bool BuildRuns::addOccurrences(const size_t& _part, const std::vector<BuildRecord>& _records)
+{
+	const uint64_t pos = (m_resultBegin[_part] + m_occurrenceSize[_part]) * sizeof(BuildRecord);
+	m_occurrenceSize[_part] += _records.size();
+	return writeAll(m_occurrenceFd, _records.data(), _records.size() * sizeof(BuildRecord), pos);
+}
+
+/**
+ * Read up to _records.size() merged occurrences of a partition, from occurrence _first on.
+ * _records is resized to the number of occurrences read.
+ */
+bool BuildRuns::readOccurrences(const size_t& _part, const uint64_t& _first, std::vector<BuildRecord>& _records) const
+{
+	const uint64_t available = m_occurrenceSize[_part] - _first;
+	if (_records.size() > available)
+	{	_records.resize(available);	}
+	return readAll(m_occurrenceFd, _records.data(), _records.size() * sizeof(BuildRecord),
+				   (m_resultBegin[_part] + _first) * sizeof(BuildRecord));
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Order of the heap, smallest record first, then the earlier run.
+ */
+static bool laterRecord(const std::pair<BuildRecord, size_t>& _a, const std::pair<BuildRecord, size_t>& _b)
+{
+	if (_b.first < _a.first)
+	{	return true;	}
+	if (_a.first < _b.first)
+	{	return false;	}
+	return _a.second > _b.second;
+}
+
+RunMerger::RunMerger(const BuildRuns& _runs, const size_t& _part, const size_t& _bufferRecords):
+	m_runs(_runs), m_part(_part),
+	m_buffers(_runs.numRuns(), std::vector<BuildRecord>(std::max<size_t>(_bufferRecords, BUILDMERGEBUFFER))),
+	m_pos(_runs.numRuns(), 0), m_next(_runs.numRuns(), 0)
+{
+	for (size_t r = 0; r < m_runs.numRuns(); r++)
+	{
+		if (refill(r))
+		{	m_heap.push_back(std::make_pair(m_buffers[r][0], r));	}
+	}
+	std::make_heap(m_heap.begin(), m_heap.end(), laterRecord);
+}
+
+/**
+ * Read the next records of a run. Returns false at the end of the run.
+ */
+bool RunMerger::refill(const size_t& _run)
+{
+	std::vector<BuildRecord>& buffer = m_buffers[_run];
+	if (m_next[_run] >= m_runs.runRecords(_run, m_part))
+	{
+		std::vector<BuildRecord>().swap(buffer);
+		return false;
+	}
+	buffer.resize(buffer.capacity());
+	if (!m_runs.readRun(_run, m_part, m_next[_run], buffer))
+	{	exit(-1);	}
+	m_next[_run] += buffer.size();
+	m_pos[_run] = 0;
+	return true;
+}
+
+/**
+ * Remove the smallest record.
+ */
+void RunMerger::pop()
+{
+	std::pop_heap(m_heap.begin(), m_heap.end(), laterRecord);
+	const size_t r = m_heap.back().second;
+	m_heap.pop_back();
+	if (++m_pos[r] < m_buffers[r].size() || refill(r))
+	{
+		m_heap.push_back(std::make_pair(m_buffers[r][m_pos[r]], r));
+		std::push_heap(m_heap.begin(), m_heap.end(), laterRecord);
+	}
+}
@@ -0,0 +1,178 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * Temporary files of the out-of-core database creation (--build-memory).
+ *
+ * The k-mers of the targets are collected as records (bucket, key, target)
+ * in a buffer of bounded size. A full buffer is sorted and written as a run.
+ * Runs are divided into the same partitions of consecutive buckets,
+ * a partition of all runs is merged independently of the others.
+ * The merged elements are stored in a result file, in the order of the buckets,
+ * from which the database is written.
+ *
+ * The files are removed from the directory as soon as they are created.
+ *
+ * For the incremental update (--update), the sorted k-mer occurrences of a
+ * former creation (occFile.hh) are merged as one more run, and the merged
+ * occurrences are kept for the next update.
+ */
+
+#ifndef BUILDRUNS_HH
+#define BUILDRUNS_HH
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include "./dataType.hh"
+
+#define BUILDMERGEBUFFER	(1 << 12)	// minimum records read at a time from a run
+#define BUILDREMOVED		((uint32_t) -1)	// target of records of removed targets
+
+/**
+ * Occurrence of a k-mer in a target.
+ */
+struct BuildRecord
+{
+	uint64_t	key;		// quotient of the canonical k-mer, as stored in the table
+	uint32_t	bucket;
+	uint32_t	target;		// index of the target, order of insertion
+	uint32_t	count;
+	uint32_t	occurrences;	// of the k-mer with this count in the target
+
+	bool operator<(const BuildRecord& _r) const
+	{
+		if (bucket != _r.bucket)
+		{	return bucket < _r.bucket;	}
+		if (key != _r.key)
+		{	return key < _r.key;	}
+		return target < _r.target;
+	}
+
+	bool sameOccurrence(const BuildRecord& _r) const
+	{	return bucket == _r.bucket && key == _r.key && target == _r.target && count == _r.count;	}
+};
+
+/**
+ * Element of the merged table kept for the database or the
+ * targets-specific k-mers files.
+ */
+struct BuildResult
+{
+	uint64_t	key;
+	uint32_t	bucket;
+	uint32_t	count;
+	ILBL		label;		// first target of the k-mer
+	ILBL		dbLabel;	// label in the database (centromere)
+	IOCCR		multiplicity;
+	uint8_t		marked;		// stored in the database
+};
+
+class BuildRuns
+{
+	private:
+		std::string								m_prefix;
+		size_t									m_numParts;
+		std::vector<int>						m_runs;
+		std::vector<uint64_t>					m_runPos;		// per run, position of the records in the file
+		std::vector< std::vector<uint64_t> >	m_partBegin;	// per run, first record of each partition and end
+		std::vector< std::vector<uint32_t> >	m_targetMaps;	// per run, new index of the targets, empty if unchanged
+		int										m_resultFd;
+		int										m_occurrenceFd;
+		std::vector<uint64_t>					m_resultBegin;	// per partition, first result (and occurrence) slot
+		std::vector<uint64_t>					m_resultSize;
+		std::vector<uint64_t>					m_occurrenceSize;
+
+		int create(const std::string& _filename) const;
+
+	public:
+		BuildRuns();
+
+		~BuildRuns();
+
+		bool open(const char* _prefix, const size_t& _numParts);
+
+		void close();
+
+		bool addRun(std::vector< std::vector<BuildRecord> >& _parts);
+
+		bool addSortedRun(const int _fd, const uint64_t& _pos, const uint64_t& _numRecords,
+						  const uint64_t& _partBuckets, const std::vector<uint32_t>& _targetMap);
+
+		size_t numRuns() const
+		{	return m_runs.size();	}
+
+		size_t numParts() const
+		{	return m_numParts;	}
+
+		uint64_t runRecords(const size_t& _run, const size_t& _part) const
+		{	return m_partBegin[_run][_part+1] - m_partBegin[_run][_part];	}
+
+		bool readRun(const size_t& _run, const size_t& _part, const uint64_t& _first, std::vector<BuildRecord>& _records) const;
+
+		bool startResults(const bool& _occurrences = false);
+
+		bool addResults(const size_t& _part, const std::vector<BuildResult>& _results);
+
+		uint64_t numResults(const size_t& _part) const
+		{	return m_resultSize[_part];	}
+
+		bool readResults(const size_t& _part, const uint64_t& _first, std::vector<BuildResult>& _results) const;
+
+		bool addOccurrences(const size_t& _part, const std::vector<BuildRecord>& _records);
+
+		uint64_t numOccurrences(const size_t& _part) const
+		{	return m_occurrenceSize[_part];	}
+
+		bool readOccurrences(const size_t& _part, const uint64_t& _first, std::vector<BuildRecord>& _records) const;
+};
+
+/**
+ * K-way merge of a partition of all runs, records in sorted order.
+ */
+class RunMerger
+{
+	private:
+		const BuildRuns&						m_runs;
+		const size_t							m_part;
+		std::vector< std::vector<BuildRecord> >	m_buffers;
+		std::vector<size_t>						m_pos;		// in the buffer
+		std::vector<uint64_t>					m_next;		// next record to read from the run
+		std::vector< std::pair<BuildRecord, size_t> >	m_heap;
+
+		bool refill(const size_t& _run);
+
+	public:
+		RunMerger(const BuildRuns& _runs, const size_t& _part, const size_t& _bufferRecords);
+
+		bool empty() const
+		{	return m_heap.empty();	}
+
+		const BuildRecord& top() const
+		{	return m_heap.front().first;	}
+
+		void pop();
+};
+
+#endif
@@ -0,0 +1,287 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * Streaming input of FASTA/FASTQ files in chunks of whole records.
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <string.h>
+
+#include "./chunkReader.hh"
+
+using namespace std;
+
+ChunkReader::ChunkReader(const size_t _chunkSize):
+	m_isPaired(false),
+	m_chunkSize(_chunkSize > 0 ? _chunkSize : 1),
+	m_eof(true),
+	m_format(0),
+	m_fillBuffer(0)
+{
+}
+
+ChunkReader::~ChunkReader()
+{
+	close();
+}
+
+/**
+ * Open input file and start reading the first chunk.
+ */
+bool ChunkReader::open(const char* _filename)
+{
+	close();
+
+	if (!m_input.open(_filename))
+		return false;
+
+	m_isPaired = false;
+	m_eof = false;
+	m_format = 0;
+	m_fillBuffer = 0;
+	m_carry.clear();
+
+	m_pending = std::async(std::launch::async, &ChunkReader::readChunk, this, std::ref(m_buffers[m_fillBuffer]));
+	return true;
+}
+
+/**
+ * Open paired-end input files and start reading the first chunk.
+ */
+bool ChunkReader::open(const char* _filename1, const char* _filename2)
+{
+	close();
+
+	if (!m_input.open(_filename1) || !m_input2.open(_filename2))
+	{
+		m_input.close();
+		return false;
+	}
+
+	m_isPaired = true;
+	m_eof = false;
+	m_format = 0;
+	m_fillBuffer = 0;
+	m_carry.clear();
+
+	m_pending = std::async(std::launch::async, &ChunkReader::readPairedChunk, this, std::ref(m_buffers[m_fillBuffer]));
+	return true;
+}
+
+/**
+ * Wait for reading thread and close input file.
+ */
+void ChunkReader::close()
+{
+	if (m_pending.valid())
+		m_pending.wait();
+	m_pending = std::future<size_t>();
+
+	m_input.close();
+	m_input2.close();
+	m_eof = true;
+}
+
+/**
+ * Get next chunk of whole records.
+ * The chunk stays valid until the next call.
+ * Returns false at end of input.
+ */
+bool ChunkReader::next(const uint8_t* &_chunk, size_t& _chunkSize)
+{
+	if (!m_pending.valid())
+		return false;
+
+	_chunkSize = m_pending.get();
+	if (_chunkSize == 0)
+		return false;
+	_chunk = &m_buffers[m_fillBuffer][0];
+
+	// read following chunk into the other buffer in the meantime
+	m_fillBuffer ^= 1;
+	if (m_isPaired && !m_eof)
+		m_pending = std::async(std::launch::async, &ChunkReader::readPairedChunk, this, std::ref(m_buffers[m_fillBuffer]));
+	else if (!m_eof || !m_carry.empty())
+		m_pending = std::async(std::launch::async, &ChunkReader::readChunk, this, std::ref(m_buffers[m_fillBuffer]));
+
+	return true;
+}
+
+/**
+ * Fill buffer with a chunk of whole records.
+ * If a single record is larger than the chunk size, the chunk grows.
+ * Returns size of the chunk without padding.
+ */
+size_t ChunkReader::readChunk(std::vector<uint8_t>& _buffer)
+{
+	_buffer.assign(m_carry.begin(), m_carry.end());
+	m_carry.clear();
+
+	size_t target = m_chunkSize, chunkEnd = 0;
+	while (true)
+	{
+		size_t have = _buffer.size();
+		if (!m_eof && have < target)
+		{
+			_buffer.resize(target);
+			have += readInput(&_buffer[have], target - have);
+			_buffer.resize(have);
+		}
+		if (m_format == 0 && have > 0)
+			m_format = _buffer[0];
+
+		if (m_eof)
+		{
+			chunkEnd = have;
+			break;
+		}
+		chunkEnd = recordsEnd(&_buffer[0], have);
+		if (chunkEnd > 0)
+			break;
+		target *= 2;
+	}
+
+	m_carry.assign(_buffer.begin() + chunkEnd, _buffer.end());
+	_buffer.resize(chunkEnd);
+	_buffer.resize(chunkEnd + CHUNKPADDING, 0);
+
+	return chunkEnd;
+}
+
+/**
+ * Fill buffer with paired-end records, merged to one fasta record each:
+ * the read id (without mate suffix) and both mates separated by 'N'.
+ * Returns size of the chunk without padding.
+ */
+size_t ChunkReader::readPairedChunk(std::vector<uint8_t>& _buffer)
+{
+	_buffer.clear();
+
+	const uint8_t *line1, *line2;
+	size_t length1, length2;
+	while (_buffer.size() < m_chunkSize)
+	{
+		if (!m_input.readLine(line1, length1) || !m_input2.readLine(line2, length2))
+		{
+			m_eof = true;
+			break;
+		}
+		if (m_format == 0)
+		{
+			if (length1 == 0 || length2 == 0 || line1[0] != line2[0])
+			{
+				std::cerr << "Error: the files have different format!" << std::endl;
+				exit(1);
+			}
+			if (line1[0] != '@')
+			{
+				std::cerr << "Error: paired-end reads must be FASTQ files!" << std::endl;
+				exit(1);
+			}
+			m_format = '>';
+		}
+		if (length1 == 0 || length2 == 0 || line1[0] != '@' || line2[0] != '@')
+			continue;
+
+		// compare read ids, separated by ' ', '\t' or '/'
+		size_t id1 = 0, id2 = 0, idEnd1, idEnd2;
+		while (id1 < length1 && strchr(" \t/@", line1[id1]) != NULL) id1++;
+		while (id2 < length2 && strchr(" \t/@", line2[id2]) != NULL) id2++;
+		for (idEnd1 = id1; idEnd1 < length1 && strchr(" \t/@", line1[idEnd1]) == NULL; idEnd1++) {}
+		for (idEnd2 = id2; idEnd2 < length2 && strchr(" \t/@", line2[idEnd2]) == NULL; idEnd2++) {}
+		if (idEnd1 - id1 != idEnd2 - id2 || memcmp(line1 + id1, line2 + id2, idEnd1 - id1) != 0)
+		{
+			std::cerr << "Error: read id does not match between files!" << std::endl;
+			exit(1);
+		}
+		_buffer.push_back('>');
+		_buffer.insert(_buffer.end(), line1 + id1, line1 + idEnd1);
+		_buffer.push_back('\n');
+
+		if (!m_input.readLine(line1, length1) || !m_input2.readLine(line2, length2))
+		{
+			std::cerr << "Error: Found read without sequence" << std::endl;
+			exit(1);
+		}
+		// Add "N" to concatenate sequences, and separate content of each sequence
+		_buffer.insert(_buffer.end(), line1, line1 + length1);
+		_buffer.push_back('N');
+		_buffer.insert(_buffer.end(), line2, line2 + length2);
+		_buffer.push_back('\n');
+
+		// skip '+' and quality lines
+		for (size_t l = 0; l < 2; l++)
+		{
+			if (!m_input.readLine(line1, length1) || !m_input2.readLine(line2, length2))
+				break;
+		}
+	}
+
+	size_t chunkEnd = _buffer.size();
+	_buffer.resize(chunkEnd + CHUNKPADDING, 0);
+
+	return chunkEnd;
+}
+
+/**
+ * Read up to _size bytes from input, sets m_eof at end of input.
+ */
+size_t ChunkReader::readInput(uint8_t* _buffer, const size_t _size)
+{
+	size_t total = m_input.read(_buffer, _size);
+	if (total < _size)
+		m_eof = true;
+	return total;
+}
+
+/**
+ * Find the end of the last complete record in data.
+ * Returns 0 if there is none.
+ */
+size_t ChunkReader::recordsEnd(const uint8_t* _data, const size_t _size) const
+{
+	if (m_format == '@')
+	{
+		// fastq, four lines per record
+		size_t lines = 0, end = 0;
+		const uint8_t* pos = _data;
+		const uint8_t* last = _data + _size;
+		while ((pos = (const uint8_t*) memchr(pos, '\n', last - pos)) != NULL)
+		{
+			pos++;
+			if (++lines % 4 == 0)
+				end = pos - _data;
+		}
+		return end;
+	}
+	// fasta, last record starts with the last header
+	for (size_t i = _size-1; i > 0; i--)
+	{
+		if (_data[i] == '>' && _data[i-1] == '\n')
+			return i;
+	}
+	return 0;
+}
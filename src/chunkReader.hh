@@ -0,0 +1,85 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * Streaming input of FASTA/FASTQ files in chunks of whole records.
+ * The next chunk is read by a separate thread while the current one is classified,
+ * so memory usage is bounded by the chunk size instead of the file size.
+ * Compressed input is decompressed by the reading thread.
+ * Paired-end FASTQ files are read together and merged into fasta records
+ * (mate1 + 'N' + mate2) in memory.
+ */
+
+#ifndef CHUNKREADER_HH
+#define CHUNKREADER_HH
+
+#include <stdint.h>
+#include <vector>
+#include <future>
+#include "./inputFile.hh"
+
+// zero bytes after each chunk, parsers may look one byte past the end
+#define CHUNKPADDING	8
+
+class ChunkReader
+{
+	private:
+		InputFile				m_input;
+		InputFile				m_input2;		// second mate file
+		bool					m_isPaired;
+		size_t					m_chunkSize;
+		bool					m_eof;
+		uint8_t					m_format;		// '>' for fasta, '@' for fastq
+
+		// one buffer is handed out, the other one is filled in the background
+		std::vector<uint8_t>	m_buffers[2];
+		size_t					m_fillBuffer;
+		// begin of an incomplete record at the end of the last chunk
+		std::vector<uint8_t>	m_carry;
+
+		std::future<size_t>		m_pending;
+
+		size_t readChunk(std::vector<uint8_t>& _buffer);
+
+		size_t readPairedChunk(std::vector<uint8_t>& _buffer);
+
+		size_t readInput(uint8_t* _buffer, const size_t _size);
+
+		size_t recordsEnd(const uint8_t* _data, const size_t _size) const;
+
+	public:
+		ChunkReader(const size_t _chunkSize);
+
+		~ChunkReader();
+
+		bool open(const char* _filename);
+
+		bool open(const char* _filename1, const char* _filename2);
+
+		void close();
+
+		bool next(const uint8_t* &_chunk, size_t& _chunkSize);
+};
+
+#endif
@@ -26,6 +26,8 @@
  * 
  * Changes:
  * Added new types.
+ * Hash-table size set at runtime (HtSize).
+ * Canonical form of a k-mer shared by the host and the query kernel.
  */
 
 #ifndef DATATYPE_HH
@@ -43,8 +45,88 @@ typedef uint16_t		RESULTS;
 typedef uint16_t		CONTAINER;
 //////
 
+#define PARTMAXBASES	((CONTAINER) -1)	// bases of a read part, its length is stored in a container
+
 #define MTRGTS 		65535
 
+// functions used by the query kernel and on the host
+#ifdef __CUDACC__
+#define HOSTDEVICE __host__ __device__
+#else
+#define HOSTDEVICE
+#endif
+
+/**
+ * Hash-table size, set at runtime (--ht-size, stored in the database).
+ * A k-mer is stored in bucket kmer % size with key kmer / size.
+ * The division is a multiply-high and shift with a precomputed
+ * magic number, as for a compile-time constant (cf. libdivide).
+ */
+struct HtSize
+{
+	uint64_t	size;
+	uint64_t	magic;		// 0 if size is a power of 2
+	uint32_t	shift;
+	uint32_t	add;		// magic has 65 bits, the top bit is added
+
+	HtSize(const uint64_t _size = HTSIZE): size(_size), magic(0), shift(0), add(0)
+	{
+		while (((uint64_t) 2 << shift) <= _size && shift < 63)
+			shift++;
+		if ((_size & (_size - 1)) != 0)
+		{
+			// 2^(64+shift) / size < 2^64
+			unsigned __int128 m = ((unsigned __int128) 1 << (64 + shift)) / _size;
+			uint64_t rem = ((unsigned __int128) 1 << (64 + shift)) % _size;
+			if (_size - rem < ((uint64_t) 1 << shift))
+			{
+				magic = (uint64_t) m + 1;
+			}
+			else
+			{
+				uint64_t twice = rem + rem;
+				magic = (uint64_t) m + (uint64_t) m + (twice >= _size || twice < rem) + 1;
+				add = 1;
+			}
+		}
+	}
+
+	HOSTDEVICE uint64_t quotient(const uint64_t _n) const
+	{
+		if (magic == 0)
+			return _n >> shift;
+#ifdef __CUDA_ARCH__
+		uint64_t q = __umul64hi(magic, _n);
+#else
+		uint64_t q = ((unsigned __int128) magic * _n) >> 64;
+#endif
+		if (add)
+			return (((_n - q) >> 1) + q) >> shift;
+		return q >> shift;
+	}
+
+	HOSTDEVICE uint64_t remainder(const uint64_t _n) const
+	{
+		return _n - quotient(_n) * size;
+	}
+};
+
+/**
+ * Canonical form of a k-mer (the smaller of the k-mer and its reverse complement).
+ */
+HOSTDEVICE inline uint64_t canonicalKmer(const uint8_t _k, const uint64_t _kmer)
+{
+	uint64_t _kmerR = _kmer;
+	// The following 6 lines come from Jellyfish source code
+	_kmerR = ((_kmerR >> 2)  & 0x3333333333333333UL) | ((_kmerR & 0x3333333333333333UL) << 2);
+	_kmerR = ((_kmerR >> 4)  & 0x0F0F0F0F0F0F0F0FUL) | ((_kmerR & 0x0F0F0F0F0F0F0F0FUL) << 4);
+	_kmerR = ((_kmerR >> 8)  & 0x00FF00FF00FF00FFUL) | ((_kmerR & 0x00FF00FF00FF00FFUL) << 8);
+	_kmerR = ((_kmerR >> 16) & 0x0000FFFF0000FFFFUL) | ((_kmerR & 0x0000FFFF0000FFFFUL) << 16);
+	_kmerR = ( _kmerR >> 32                        ) | ( _kmerR                        << 32);
+	_kmerR = (((uint64_t)-1) - _kmerR) >> (64 - (_k << 1));
+	return _kmer < _kmerR ? _kmer : _kmerR;
+}
+
 struct IKMER
 {
 	uint64_t         skmer[SB];
@@ -209,80 +291,6 @@ struct ICount
 
 };
 
-template <typename T> struct sVector
-{
-        T*       ptr;
-        uint32_t idx;
-        uint32_t cap;
-
-        sVector(): idx(0), cap(0), ptr(NULL)
-        {}
-        ~sVector()
-        {
-                clear();
-        }
-        size_t  size()  const
-        {
-                return idx;
-        }
-        bool empty() const
-        {
-                return (idx == 0);
-        }
-        T& front() const
-        {
-                return (*ptr);
-        }
-        void resize(const size_t& _size)
-        {
-                ptr = (T*) malloc(_size * sizeof(T));
-                idx = _size;
-                cap = _size;
-        }
-        void push_back(const T& _cell)
-        {
-                if (idx < cap)
-                {
-                        ptr[idx++] = _cell;
-                }
-                else
-                {
-                        // Creation of a new array
-                        cap = cap == 0 ? 1: 2*cap;
-                        T* ptr_n = (T*) malloc(cap * sizeof(T));
-                        // Copy & update
-                        for(size_t t = 0; t < idx; t++)
-                        {
-                                ptr_n[t] = ptr[t];
-                        }
-                        ptr_n[idx++] = _cell;
-                        free(ptr);
-                        ptr = NULL;
-                        // Re-addressing
-                        ptr = ptr_n;
-                }
-        }
-        T& operator[](const size_t& _pos) const
-        {
-                return ptr[_pos];
-        }
-        T* begin() const
-        {
-                return ptr;
-        }
-        T* end() const
-        {
-                return ptr+idx;
-        }
-        void clear()
-        {
-                free(ptr);
-                ptr = NULL;
-                idx = 0;
-                cap = 0;
-        }
-};
-
 struct Element
 {
 	ILBL		Label;
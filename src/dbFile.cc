@@ -0,0 +1,719 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * Single-file database format, reading and writing.
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdio>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "./dbFile.hh"
+
+using namespace std;
+
+static uint64_t alignSection(const uint64_t _pos)
+{
+	return (_pos + DBALIGN - 1) / DBALIGN * DBALIGN;
+}
+
+/**
+ * FNV-1a hash of the header, the checksum field counts as 0.
+ */
+static uint64_t headerChecksum(DbHeader _header)
+{
+	_header.checksum = 0;
+	const uint8_t* bytes = (const uint8_t*) &_header;
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < _header.headerSize; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static uint64_t numGroups(const uint64_t _htSize)
+{
+	return (_htSize + DBGROUPBUCKETS - 1) / DBGROUPBUCKETS;
+}
+
+static uint64_t numAnchors(const uint64_t _htSize)
+{
+	return _htSize / DBANCHORBUCKETS + 1;
+}
+
+/**
+ * Positions of the sections for the given sizes.
+ * Interleaved or packed elements take the keys section, the labels section is empty.
+ */
+static void layoutSections(DbHeader& _header, const DbLayout _layout)
+{
+	_header.indexPos	= alignSection(sizeof(DbHeader));
+	_header.anchorsPos	= alignSection(_header.indexPos + numGroups(_header.htSize)*sizeof(BucketGroup));
+	_header.keysPos		= alignSection(_header.anchorsPos + numAnchors(_header.htSize)*sizeof(uint64_t));
+	if (_layout == DBPACKED)
+	{
+		_header.labelsPos	= _header.keysPos;
+		_header.bigBucketsPos	= alignSection(_header.keysPos + packedBytes(_header.numElements, _header.keyBits + _header.labelBits));
+	}
+	else if (_layout == DBINTERLEAVED)
+	{
+		_header.labelsPos	= _header.keysPos;
+		_header.bigBucketsPos	= alignSection(_header.keysPos + _header.numElements*(_header.keyBytes + _header.labelBytes));
+	}
+	else
+	{
+		_header.labelsPos	= alignSection(_header.keysPos + _header.numElements*_header.keyBytes);
+		_header.bigBucketsPos	= alignSection(_header.labelsPos + _header.numElements*_header.labelBytes);
+	}
+	_header.fileSize	= _header.bigBucketsPos + _header.numBigBuckets*sizeof(DbBigBucket);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+DbFile::DbFile(): m_fd(-1), m_map(NULL), m_mapSize(0)
+{
+	memset(&m_header, 0, sizeof(DbHeader));
+}
+
+DbFile::~DbFile()
+{
+	close();
+}
+
+/**
+ * Map a database file and check its header and sections.
+ */
+bool DbFile::open(const char* _filename)
+{
+	close();
+	m_filename = _filename;
+
+	m_fd = ::open(_filename, O_RDONLY);
+	if (m_fd == -1)
+	{
+		cerr << "Failed to open " << _filename << endl;
+		return false;
+	}
+	struct stat st;
+	if (fstat(m_fd, &st) == -1 || (size_t) st.st_size < sizeof(DbHeader))
+	{
+		return corrupt("file too small");
+	}
+	m_mapSize = st.st_size;
+	void* map = mmap(0, m_mapSize, PROT_READ, MAP_SHARED, m_fd, 0);
+	if (map == MAP_FAILED)
+	{
+		cerr << "Failed to map " << _filename << endl;
+		::close(m_fd);
+		m_fd = -1;
+		return false;
+	}
+	m_map = (uint8_t*) map;
+	memcpy(&m_header, m_map, sizeof(DbHeader));
+
+	const DbHeader& h = m_header;
+	if (memcmp(h.magic, DBMAGIC, sizeof(h.magic)) != 0)
+		return corrupt("not a database file");
+	if (h.version == DBVERSIONUNPACKED && h.headerSize == offsetof(DbHeader, keyBits))
+	{	// no bit widths, the header ends before them
+		m_header.keyBits = m_header.labelBits = 0;
+	}
+	else if (h.version != DBVERSION || h.headerSize != sizeof(DbHeader))
+	{
+		cerr << "The database file " << m_filename << " has format version " << h.version
+			 << ", this version of CuCLARK reads version " << DBVERSION << "." << endl;
+		close();
+		return false;
+	}
+	if (h.checksum != headerChecksum(h))
+		return corrupt("bad header checksum");
+	if (h.fileSize != m_mapSize)
+		return corrupt("truncated file");
+	if (h.labelBytes != sizeof(ILBL))
+		return corrupt("unsupported label size");
+	if (h.htSize == 0 || h.htSize > m_mapSize || h.numElements > m_mapSize || h.keyBytes > 8
+		|| h.numBigBuckets > h.htSize)
+		return corrupt("bad sizes");
+	if (h.keyBits > 0 && (h.keyBits < dbKeyBits(h.k, h.htSize) || h.keyBits > 8*h.keyBytes
+						  || h.labelBits == 0 || h.labelBits > 8*sizeof(ILBL)))
+		return corrupt("bad bit widths");
+
+	DbHeader expected = h;
+	layoutSections(expected, dbLayout(h));
+	if (expected.indexPos != h.indexPos || expected.anchorsPos != h.anchorsPos
+		|| expected.keysPos != h.keysPos || expected.labelsPos != h.labelsPos
+		|| expected.bigBucketsPos != h.bigBucketsPos || expected.fileSize != h.fileSize)
+		return corrupt("bad section positions");
+
+	for (uint64_t i = 0; i < h.numBigBuckets; i++)
+	{
+		const DbBigBucket& big = bigBuckets()[i];
+		if (big.bucket >= h.htSize || big.size < DBBIGBUCKET
+			|| (i > 0 && big.bucket <= bigBuckets()[i-1].bucket)
+			|| bucketSize(index()[big.bucket / DBGROUPBUCKETS], big.bucket % DBGROUPBUCKETS) != DBBIGBUCKET)
+			return corrupt("bad big-bucket table");
+	}
+
+	if (index()[0].anchor != 0 || anchors()[0] != 0
+		|| offset(h.htSize-1) + size(h.htSize-1) != h.numElements)
+		return corrupt("bad bucket index");
+
+	// start reading ahead, the sections are used directly
+	madvise(m_map, m_mapSize, MADV_WILLNEED);
+
+	return true;
+}
+
+bool DbFile::corrupt(const char* _reason)
+{
+	cerr << "The database file " << m_filename << " is corrupt (" << _reason << ")." << endl;
+	close();
+	return false;
+}
+
+void DbFile::close()
+{
+	if (m_map != NULL)
+	{
+		munmap(m_map, m_mapSize);
+		m_map = NULL;
+	}
+	if (m_fd != -1)
+	{
+		::close(m_fd);
+		m_fd = -1;
+	}
+	m_mapSize = 0;
+}
+
+/**
+ * Exact position of the first element of a bucket.
+ */
+uint64_t DbFile::offset(const uint64_t _bucket) const
+{
+	if (_bucket >= m_header.htSize)
+	{	// end of the last bucket, its group may not exist
+		return m_header.numElements;
+	}
+	const BucketGroup& group = index()[_bucket / DBGROUPBUCKETS];
+	uint64_t anchor = anchors()[_bucket / DBANCHORBUCKETS];
+	uint32_t size;
+	return anchor + (uint32_t) (group.anchor - (uint32_t) anchor)
+		+ bucketInGroup(group, _bucket % DBGROUPBUCKETS, size, bigBuckets(), m_header.numBigBuckets, _bucket);
+}
+
+/**
+ * Number of elements of a bucket.
+ */
+uint32_t DbFile::size(const uint64_t _bucket) const
+{
+	uint32_t size = bucketSize(index()[_bucket / DBGROUPBUCKETS], _bucket % DBGROUPBUCKETS);
+	if (size == DBBIGBUCKET)
+	{
+		const uint32_t i = findBigBucket(bigBuckets(), m_header.numBigBuckets, _bucket);
+		size = bigBuckets()[i].size;
+	}
+	return size;
+}
+
+/**
+ * Read file ranges to memory with parallel preads.
+ * Ranges are split into chunks of DBREADCHUNK bytes,
+ * so that large sections are read by all threads.
+ */
+bool DbFile::read(const std::vector<DbRange>& _ranges) const
+{
+	std::vector<DbRange> chunks;
+	for (size_t i = 0; i < _ranges.size(); i++)
+	{
+		for (uint64_t p = 0; p < _ranges[i].size; p += DBREADCHUNK)
+		{
+			DbRange chunk;
+			chunk.pos	= _ranges[i].pos + p;
+			chunk.size	= _ranges[i].size - p < DBREADCHUNK ? _ranges[i].size - p : DBREADCHUNK;
+			chunk.dest	= (uint8_t*) _ranges[i].dest + p;
+			chunks.push_back(chunk);
+		}
+	}
+
+	bool success = true;
+	#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic) reduction(&&:success)
+	#endif
+	for (size_t c = 0; c < chunks.size(); c++)
+	{
+		uint8_t* dest = (uint8_t*) chunks[c].dest;
+		uint64_t pos = chunks[c].pos;
+		uint64_t size = chunks[c].size;
+		while (size > 0)
+		{
+			ssize_t bytes = pread(m_fd, dest, size, pos);
+			if (bytes < 0 && errno == EINTR)
+				continue;
+			if (bytes <= 0)
+			{
+				success = false;
+				break;
+			}
+			dest += bytes;
+			pos += bytes;
+			size -= bytes;
+		}
+	}
+	if (!success)
+		cerr << "Failed to read " << m_filename << endl;
+	return success;
+}
+
+/**
+ * Fault in the whole mapping with parallel threads,
+ * instead of page by page during the first queries.
+ */
+void DbFile::populate() const
+{
+	const size_t pageSize = sysconf(_SC_PAGESIZE);
+	const size_t numChunks = (m_mapSize + DBREADCHUNK - 1) / DBREADCHUNK;
+	const volatile uint8_t* map = m_map;
+
+	#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic)
+	#endif
+	for (size_t c = 0; c < numChunks; c++)
+	{
+		size_t begin = c * DBREADCHUNK;
+		size_t end = begin + DBREADCHUNK < m_mapSize ? begin + DBREADCHUNK : m_mapSize;
+		madvise(m_map + begin, end - begin, MADV_WILLNEED);
+		for (size_t p = begin; p < end; p += pageSize)
+			(void) map[p];
+	}
+}
+
+/**
+ * Check that the database was built with the given settings.
+ */
+bool DbFile::matches(const uint8_t _k, const size_t _keyBytes, const uint64_t _htSize, const size_t _numTargets) const
+{
+	const DbHeader& h = m_header;
+	if (h.k == _k && h.keyBytes == _keyBytes && h.htSize == _htSize && h.numTargets == _numTargets)
+		return true;
+
+	cerr << "The database file " << m_filename << " does not match the settings:"
+		 << " k=" << h.k << " (expected " << (size_t) _k << "),"
+		 << " key size " << h.keyBytes << " (expected " << _keyBytes << "),"
+		 << " hash-table size " << h.htSize << " (expected " << _htSize << "),"
+		 << " targets " << h.numTargets << " (expected " << _numTargets << ")." << endl;
+	return false;
+}
+
+bool DbFile::exists(const char* _filename)
+{
+	struct stat st;
+	return stat(_filename, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+DbWriter::DbWriter(): m_fd(-1), m_bucket(0), m_elements(0), m_bucketBegin(0), m_layout(DBSPLIT),
+					  m_bitWord(0), m_bitCount(0), m_failed(false)
+{
+	memset(&m_header, 0, sizeof(DbHeader));
+	memset(&m_group, 0, sizeof(BucketGroup));
+}
+
+DbWriter::~DbWriter()
+{
+	// abandoned before close
+	if (m_fd != -1)
+	{
+		::close(m_fd);
+		unlink(m_tmpFilename.c_str());
+	}
+}
+
+/**
+ * Create the file and place the sections.
+ */
+bool DbWriter::open(const char* _filename, const uint8_t _k, const size_t _keyBytes,
+					const uint64_t _htSize, const size_t _numTargets, const uint64_t _numElements,
+					const uint32_t _samplingFactor, const DbLayout _layout)
+{
+	m_filename = _filename;
+	m_tmpFilename = m_filename + ".tmp";
+
+	m_fd = ::open(m_tmpFilename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (m_fd == -1)
+	{
+		cerr << "Failed to create " << m_tmpFilename << endl;
+		return false;
+	}
+
+	memset(&m_header, 0, sizeof(DbHeader));
+	memcpy(m_header.magic, DBMAGIC, sizeof(m_header.magic));
+	m_header.version		= DBVERSION;
+	m_header.headerSize		= sizeof(DbHeader);
+	m_header.k				= _k;
+	m_header.keyBytes		= _keyBytes;
+	m_header.labelBytes		= sizeof(ILBL);
+	m_header.samplingFactor	= _samplingFactor;
+	m_header.htSize			= _htSize;
+	m_header.numTargets		= _numTargets;
+	m_header.numElements	= _numElements;
+	m_layout				= _layout;
+	if (m_layout == DBPACKED)
+	{
+		m_header.keyBits	= dbKeyBits(_k, _htSize);
+		m_header.labelBits	= bitsOf(_numTargets > 0 ? _numTargets - 1 : 0);
+	}
+	layoutSections(m_header, m_layout);
+
+	m_positions[0] = m_header.indexPos;
+	m_positions[1] = m_header.keysPos;
+	m_positions[2] = m_header.labelsPos;
+	for (int s = 0; s < 3; s++)
+	{
+		m_buffers[s].clear();
+		m_buffers[s].reserve(DBWRITEBUFFER);
+	}
+	m_bucket = 0;
+	m_elements = 0;
+	m_bucketBegin = 0;
+	m_bigBuckets.clear();
+	m_bitWord = 0;
+	m_bitCount = 0;
+	m_failed = false;
+
+	// first bucket starts at 0
+	memset(&m_group, 0, sizeof(BucketGroup));
+	m_anchors.assign(1, 0);
+
+	return true;
+}
+
+void DbWriter::append(const int _section, const void* _data, const size_t _size)
+{
+	const uint8_t* data = (const uint8_t*) _data;
+	m_buffers[_section].insert(m_buffers[_section].end(), data, data + _size);
+	if (m_buffers[_section].size() >= DBWRITEBUFFER)
+		flush(_section);
+}
+
+/**
+ * Append the lower _bits bits of _value to the packed elements,
+ * whole 64-bit words go to the keys section.
+ */
+void DbWriter::appendBits(const uint64_t _value, const uint32_t _bits)
+{
+	m_bitWord |= _value << m_bitCount;
+	if (m_bitCount + _bits < 64)
+	{
+		m_bitCount += _bits;
+		return;
+	}
+	append(1, &m_bitWord, sizeof(uint64_t));
+	m_bitWord = m_bitCount > 0 ? _value >> (64 - m_bitCount) : 0;
+	m_bitCount = m_bitCount + _bits - 64;
+}
+
+bool DbWriter::flush(const int _section)
+{
+	const uint8_t* data = m_buffers[_section].data();
+	size_t size = m_buffers[_section].size();
+	while (size > 0 && !m_failed)
+	{
+		ssize_t written = pwrite(m_fd, data, size, m_positions[_section]);
+		if (written <= 0)
+		{
+			perror("Failed to write the database");
+			m_failed = true;
+			break;
+		}
+		data += written;
+		size -= written;
+		m_positions[_section] += written;
+	}
+	m_buffers[_section].clear();
+	return !m_failed;
+}
+
+/**
+ * Add an element to the current bucket.
+ * Keys are given with _keyBytes bytes, as stored in memory.
+ */
+void DbWriter::add(const void* _key, const ILBL& _label)
+{
+	if (m_layout == DBPACKED)
+	{
+		uint64_t key = 0;
+		memcpy(&key, _key, m_header.keyBytes);
+		if ((bitsOf(key) > m_header.keyBits || bitsOf(_label) > m_header.labelBits) && !m_failed)
+		{
+			cerr << "Failed to write the database: element " << key << " (label " << _label
+				 << ") does not fit in " << m_header.keyBits << "+" << m_header.labelBits << " bits." << endl;
+			m_failed = true;
+		}
+		appendBits(key, m_header.keyBits);
+		appendBits(_label, m_header.labelBits);
+	}
+	else
+	{
+		append(1, _key, m_header.keyBytes);
+		append(m_layout == DBINTERLEAVED ? 1 : 2, &_label, sizeof(ILBL));
+	}
+	m_elements++;
+}
+
+/**
+ * Close the current bucket, the next one starts.
+ * Buckets of DBBIGBUCKET or more elements go to the big-bucket table.
+ */
+void DbWriter::endBucket()
+{
+	uint64_t size = m_elements - m_bucketBegin;
+	if (size >= DBBIGBUCKET)
+	{
+		if (size > UINT32_MAX)
+		{
+			cerr << "Failed to write the database: bucket " << m_bucket << " has " << size << " elements." << endl;
+			m_failed = true;
+		}
+		DbBigBucket big;
+		big.bucket = m_bucket;
+		big.size = size;
+		m_bigBuckets.push_back(big);
+		size = DBBIGBUCKET;
+	}
+	uint32_t j = m_bucket % DBGROUPBUCKETS;
+	m_group.sizes[j >> 2] |= size << 8*(j & 3);
+
+	m_bucket++;
+	m_bucketBegin = m_elements;
+	if (m_bucket % DBGROUPBUCKETS == 0)
+	{
+		append(0, &m_group, sizeof(BucketGroup));
+		m_group.anchor = m_elements;
+		m_group.sizes[0] = m_group.sizes[1] = 0;
+	}
+	if (m_bucket % DBANCHORBUCKETS == 0)
+		m_anchors.push_back(m_elements);
+}
+
+/**
+ * Write remaining data, anchors, big-bucket table and header, rename to the final name.
+ */
+bool DbWriter::close()
+{
+	if (m_fd == -1)
+		return false;
+
+	// last group, not complete
+	if (m_bucket % DBGROUPBUCKETS != 0)
+		append(0, &m_group, sizeof(BucketGroup));
+
+	// last word of packed elements, not complete
+	if (m_bitCount > 0)
+	{
+		append(1, &m_bitWord, sizeof(uint64_t));
+		m_bitWord = 0;
+		m_bitCount = 0;
+	}
+
+	for (int s = 0; s < 3; s++)
+		flush(s);
+
+	if (m_bucket != m_header.htSize || m_elements != m_header.numElements)
+	{
+		cerr << "Failed to write the database: " << m_elements << " elements in " << m_bucket
+			 << " buckets written, expected " << m_header.numElements << " in " << m_header.htSize << "." << endl;
+		m_failed = true;
+	}
+
+	if (!m_failed)
+	{
+		m_positions[0] = m_header.anchorsPos;
+		append(0, m_anchors.data(), m_anchors.size()*sizeof(uint64_t));
+		flush(0);
+
+		m_header.numBigBuckets = m_bigBuckets.size();
+		layoutSections(m_header, m_layout);
+		m_positions[0] = m_header.bigBucketsPos;
+		append(0, m_bigBuckets.data(), m_bigBuckets.size()*sizeof(DbBigBucket));
+		flush(0);
+
+		// header last, an incomplete file is never valid
+		m_header.checksum = headerChecksum(m_header);
+		m_buffers[0].clear();
+		m_positions[0] = 0;
+		append(0, &m_header, sizeof(DbHeader));
+		flush(0);
+
+		if (ftruncate(m_fd, m_header.fileSize) == -1)
+		{
+			perror("Failed to write the database");
+			m_failed = true;
+		}
+	}
+
+	if (::close(m_fd) == -1)
+		m_failed = true;
+	m_fd = -1;
+
+	if (m_failed || rename(m_tmpFilename.c_str(), m_filename.c_str()) == -1)
+	{
+		unlink(m_tmpFilename.c_str());
+		cerr << "Failed to create " << m_filename << endl;
+		return false;
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Sequential reading of a file in large blocks.
+ */
+struct BlockReader
+{
+	FILE*					fd;
+	std::vector<uint8_t>	buffer;
+	size_t					pos;
+	size_t					end;
+
+	BlockReader(FILE* _fd): fd(_fd), buffer(DBWRITEBUFFER), pos(0), end(0)
+	{}
+
+	// pointer to the next _size bytes, NULL at the end of the file
+	const uint8_t* take(const size_t _size)
+	{
+		if (end - pos < _size)
+		{
+			memmove(&buffer[0], &buffer[pos], end - pos);
+			end -= pos;
+			pos = 0;
+			end += fread(&buffer[end], 1, buffer.size() - end, fd);
+			if (end < _size)
+				return NULL;
+		}
+		pos += _size;
+		return &buffer[pos - _size];
+	}
+};
+
+static FILE* openLegacyFile(const char* _filename, const char* _extension, size_t& _size)
+{
+	string filename = string(_filename) + _extension;
+	FILE* fd = fopen(filename.c_str(), "r");
+	if (fd == NULL)
+	{
+		cerr << "Failed to open " << filename << endl;
+		return NULL;
+	}
+	struct stat st;
+	fstat(fileno(fd), &st);
+	_size = st.st_size;
+	return fd;
+}
+
+bool legacyDbExists(const char* _filename)
+{
+	string filename(_filename);
+	return DbFile::exists((filename + ".sz").c_str())
+		&& DbFile::exists((filename + ".ky").c_str())
+		&& DbFile::exists((filename + ".lb").c_str());
+}
+
+/**
+ * Convert a database of the former format (.sz, .ky, .lb files)
+ * to <_filename>.db. The former files are kept.
+ */
+bool convertLegacyDb(const char* _filename, const uint8_t _k, const size_t _keyBytes,
+					 const uint64_t _htSize, const size_t _numTargets)
+{
+	size_t sizeSze, sizeKey, sizeLbl;
+	FILE* fd_s = openLegacyFile(_filename, ".sz", sizeSze);
+	FILE* fd_k = openLegacyFile(_filename, ".ky", sizeKey);
+	FILE* fd_l = openLegacyFile(_filename, ".lb", sizeLbl);
+	bool success = fd_s != NULL && fd_k != NULL && fd_l != NULL;
+
+	if (success)
+	{
+		cerr << "Converting database " << _filename << " (.sz, .ky, .lb) to " << _filename << ".db..." << endl;
+
+		// count elements
+		BlockReader sizes(fd_s);
+		uint64_t numElements = 0;
+		const uint8_t* size;
+		while ((size = sizes.take(1)) != NULL)
+			numElements += *size;
+
+		if (sizeSze != _htSize || sizeKey != numElements*_keyBytes || sizeLbl != numElements*sizeof(ILBL))
+		{
+			cerr << "Failed to convert the database: the files do not match (" << sizeSze << " buckets, "
+				 << numElements << " elements, expected " << _htSize << " buckets)." << endl;
+			success = false;
+		}
+		rewind(fd_s);
+
+		DbWriter writer;
+		string dbFile = string(_filename) + ".db";
+		if (success && writer.open(dbFile.c_str(), _k, _keyBytes, _htSize, _numTargets, numElements))
+		{
+			BlockReader bucketSizes(fd_s), keys(fd_k), labels(fd_l);
+			for (uint64_t t = 0; t < _htSize; t++)
+			{
+				uint8_t bucketSize = *bucketSizes.take(1);
+				for (uint8_t u = 0; u < bucketSize; u++)
+				{
+					const uint8_t* key = keys.take(_keyBytes);
+					ILBL label;
+					memcpy(&label, labels.take(sizeof(ILBL)), sizeof(ILBL));
+					writer.add(key, label);
+				}
+				writer.endBucket();
+			}
+			success = writer.close();
+		}
+		else
+		{
+			success = false;
+		}
+	}
+	if (fd_s != NULL) fclose(fd_s);
+	if (fd_k != NULL) fclose(fd_k);
+	if (fd_l != NULL) fclose(fd_l);
+	return success;
+}
@@ -0,0 +1,419 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * Single-file database format (<name>.db), written by hTable::write
+ * and memory-mapped by the query backends.
+ *
+ * Layout, each section aligned to DBALIGN bytes:
+ *   header		DbHeader
+ *   index		BucketGroup per DBGROUPBUCKETS buckets
+ *   anchors	uint64_t per DBANCHORBUCKETS buckets, exact first element
+ *   keys		numElements * keyBytes, sorted within each bucket
+ *   labels		numElements * labelBytes
+ *   bigBuckets	DbBigBucket per bucket of DBBIGBUCKET or more elements, sorted
+ *
+ * In the interleaved layout (--interleaved), the keys section holds
+ * key|label per element (keyBytes + labelBytes), so a hit reads its label
+ * from the cache line of its key. The labels section is empty, at the
+ * position of the keys section. Elements are read in 16-bit units,
+ * keys are stored in native byte order.
+ *
+ * In the packed layout (--packed), elements are bit-packed in the keys
+ * section: key in keyBits bits (the largest quotient of a k-mer by the
+ * hash-table size), then label in labelBits bits (the largest label),
+ * element i from bit i*(keyBits+labelBits) of little-endian 64-bit words.
+ * Elements are decoded at each lookup. The labels section is empty.
+ * Version 3 files (split or interleaved, no bit widths) are read.
+ *
+ * The index stores the size of each bucket in one byte and the first
+ * element of each group of buckets (modulo 2^32), 1.5 bytes per bucket.
+ * Larger buckets have the size byte DBBIGBUCKET, their sizes are in the
+ * big-bucket table.
+ * Differences of group anchors are exact within a database part
+ * (< 2^32 elements), the 64-bit anchors give the exact position
+ * of a part in the key and label sections.
+ *
+ * Databases of the former format (.sz, .ky and .lb files) are converted once.
+ */
+
+#ifndef DBFILE_HH
+#define DBFILE_HH
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <cstring>
+#include "./dataType.hh"
+
+#define DBMAGIC				"CUCLARKD"
+#define DBVERSION			4
+#define DBVERSIONUNPACKED	3			// former version, without the bit widths
+#define DBALIGN				4096
+#define DBGROUPBUCKETS		8
+#define DBANCHORBUCKETS		65536		// multiple of DBGROUPBUCKETS
+#define DBBIGBUCKET			255			// size byte of the buckets in the big-bucket table
+#define DBWRITEBUFFER		(1 << 22)	// bytes buffered per section while writing
+#define DBREADCHUNK			(1 << 23)	// bytes per parallel read
+
+struct DbHeader
+{
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	headerSize;
+	uint32_t	k;
+	uint32_t	keyBytes;
+	uint32_t	labelBytes;
+	uint32_t	samplingFactor;		// buckets kept when written, 1 = all
+	uint64_t	htSize;				// number of buckets
+	uint64_t	numTargets;
+	uint64_t	numElements;
+	// positions of the sections in the file
+	uint64_t	indexPos;
+	uint64_t	anchorsPos;
+	uint64_t	keysPos;
+	uint64_t	labelsPos;
+	uint64_t	bigBucketsPos;
+	uint64_t	numBigBuckets;
+	uint64_t	fileSize;
+	uint64_t	checksum;			// of the header (headerSize bytes), with checksum = 0
+	// since version 4, 0 if not packed
+	uint32_t	keyBits;
+	uint32_t	labelBits;
+};
+
+/**
+ * Layout of the elements in the keys and labels sections.
+ */
+enum DbLayout
+{
+	DBSPLIT,			// keys and labels in separate sections
+	DBINTERLEAVED,		// key|label per element in the keys section
+	DBPACKED			// key|label per element, bit-packed to keyBits and labelBits
+};
+
+inline DbLayout dbLayout(const DbHeader& _header)
+{
+	if (_header.keyBits > 0)
+		return DBPACKED;
+	return _header.labelsPos == _header.keysPos ? DBINTERLEAVED : DBSPLIT;
+}
+
+/**
+ * Bits of the largest value up to _max, at least 1.
+ */
+inline uint32_t bitsOf(uint64_t _max)
+{
+	uint32_t bits = 1;
+	while (bits < 64 && (_max >> bits) > 0)
+		bits++;
+	return bits;
+}
+
+/**
+ * Bits of the largest key (quotient of a k-mer by the hash-table size).
+ */
+inline uint32_t dbKeyBits(const uint32_t _k, const uint64_t _htSize)
+{
+	const uint64_t maxKmer = _k >= 32 ? (uint64_t) -1 : ((uint64_t) 1 << 2*_k) - 1;
+	return bitsOf(maxKmer / _htSize);
+}
+
+/**
+ * Bytes of _numElements packed elements of _elementBits bits, whole 64-bit words.
+ */
+inline uint64_t packedBytes(const uint64_t _numElements, const uint32_t _elementBits)
+{
+	return (_numElements * _elementBits + 63) / 64 * sizeof(uint64_t);
+}
+
+/**
+ * _bits bits (at most 64) from bit _bit of packed 64-bit words.
+ */
+HOSTDEVICE inline uint64_t readBits(const uint64_t* _words, const uint64_t _bit, const uint32_t _bits)
+{
+	const uint64_t* word = _words + (_bit >> 6);
+	const uint32_t shift = _bit & 63;
+	uint64_t value = word[0] >> shift;
+	if (shift + _bits > 64)
+		value |= word[1] << (64 - shift);
+	return _bits < 64 ? value & (((uint64_t) 1 << _bits) - 1) : value;
+}
+
+/**
+ * Index entry of DBGROUPBUCKETS consecutive buckets.
+ */
+struct BucketGroup
+{
+	uint32_t	anchor;		// first element of the group, modulo 2^32
+	uint32_t	sizes[2];	// one byte per bucket, bucket j in bits 8*(j%4) of sizes[j/4]
+};
+
+/**
+ * Size of bucket _j of a group.
+ */
+HOSTDEVICE inline uint32_t bucketSize(const BucketGroup& _group, const uint32_t _j)
+{
+	return (_group.sizes[_j >> 2] >> 8*(_j & 3)) & 0xFF;
+}
+
+/**
+ * Elements of the group before bucket _j, and size of bucket _j.
+ * The byte sizes are summed in parallel within a 64-bit word.
+ */
+HOSTDEVICE inline uint32_t bucketInGroup(const BucketGroup& _group, const uint32_t _j, uint32_t& _size)
+{
+	uint64_t sizes = _group.sizes[0] | ((uint64_t) _group.sizes[1] << 32);
+	_size = (sizes >> 8*_j) & 0xFF;
+
+	// sizes of buckets before _j, pairwise sums in 16-bit lanes, then sum of lanes
+	sizes &= ((uint64_t) 1 << 8*_j) - 1;
+	sizes = (sizes & 0x00FF00FF00FF00FFUL) + ((sizes >> 8) & 0x00FF00FF00FF00FFUL);
+	return (sizes * 0x0001000100010001UL) >> 48;
+}
+
+/**
+ * Bucket of DBBIGBUCKET or more elements.
+ */
+struct DbBigBucket
+{
+	uint32_t	bucket;
+	uint32_t	size;
+};
+
+/**
+ * True if a bucket of the group is in the big-bucket table (size byte 0xFF).
+ */
+HOSTDEVICE inline bool hasBigBucket(const BucketGroup& _group)
+{
+	const uint64_t sizes = ~(_group.sizes[0] | ((uint64_t) _group.sizes[1] << 32));
+	return ((sizes - 0x0101010101010101UL) & ~sizes & 0x8080808080808080UL) != 0;
+}
+
+/**
+ * First entry of the big-bucket table with a bucket >= _bucket.
+ */
+HOSTDEVICE inline uint32_t findBigBucket(const DbBigBucket* _big, uint32_t _numBig, const uint64_t _bucket)
+{
+	uint32_t first = 0;
+	while (_numBig > 0)
+	{
+		const uint32_t half = _numBig / 2;
+		if (_big[first + half].bucket < _bucket)
+		{
+			first += half + 1;
+			_numBig -= half + 1;
+		}
+		else
+			_numBig = half;
+	}
+	return first;
+}
+
+/**
+ * As bucketInGroup, with the sizes of big buckets from the big-bucket table.
+ * _bucket is the number of bucket _j in the table.
+ */
+HOSTDEVICE inline uint32_t bucketInGroup(const BucketGroup& _group, const uint32_t _j, uint32_t& _size,
+										 const DbBigBucket* _big, const uint32_t _numBig, const uint64_t _bucket)
+{
+	uint32_t begin = bucketInGroup(_group, _j, _size);
+	if (!hasBigBucket(_group))
+		return begin;
+	for (uint32_t i = findBigBucket(_big, _numBig, _bucket - _j); i < _numBig && _big[i].bucket <= _bucket; i++)
+	{
+		if (_big[i].bucket < _bucket)
+			begin += _big[i].size - DBBIGBUCKET;
+		else
+			_size = _big[i].size;
+	}
+	return begin;
+}
+
+/**
+ * Range of the file to read to memory.
+ */
+struct DbRange
+{
+	uint64_t	pos;
+	uint64_t	size;
+	void*		dest;
+};
+
+/**
+ * Read-only, memory-mapped database file.
+ */
+class DbFile
+{
+	private:
+		int				m_fd;
+		uint8_t*		m_map;
+		size_t			m_mapSize;
+		DbHeader		m_header;
+		std::string		m_filename;
+
+		bool corrupt(const char* _reason);
+
+	public:
+		DbFile();
+
+		~DbFile();
+
+		bool open(const char* _filename);
+
+		void close();
+
+		bool isOpen() const
+		{	return m_map != NULL;	}
+
+		const DbHeader& header() const
+		{	return m_header;	}
+
+		const BucketGroup* index() const
+		{	return (const BucketGroup*) (m_map + m_header.indexPos);	}
+
+		const uint64_t* anchors() const
+		{	return (const uint64_t*) (m_map + m_header.anchorsPos);	}
+
+		const uint8_t* keys() const
+		{	return m_map + m_header.keysPos;	}
+
+		const ILBL* labels() const
+		{	return (const ILBL*) (m_map + m_header.labelsPos);	}
+
+		DbLayout layout() const
+		{	return dbLayout(m_header);	}
+
+		/**
+		 * Bytes per element in the keys section, keyBytes or keyBytes + labelBytes
+		 * (not for the packed layout).
+		 */
+		size_t elementBytes() const
+		{	return m_header.keyBytes + (layout() == DBINTERLEAVED ? m_header.labelBytes : 0);	}
+
+		/**
+		 * Bits per element of the packed layout.
+		 */
+		uint32_t elementBits() const
+		{	return m_header.keyBits + m_header.labelBits;	}
+
+		/**
+		 * Key of element _i, in any layout.
+		 */
+		uint64_t key(const uint64_t _i) const
+		{
+			if (layout() == DBPACKED)
+				return readBits((const uint64_t*) keys(), _i * elementBits(), m_header.keyBits);
+			uint64_t key = 0;
+			memcpy(&key, keys() + _i * elementBytes(), m_header.keyBytes);
+			return key;
+		}
+
+		/**
+		 * Label of element _i, in any layout.
+		 */
+		ILBL label(const uint64_t _i) const
+		{
+			switch (layout())
+			{
+				case DBSPLIT:
+					return labels()[_i];
+				case DBPACKED:
+					return readBits((const uint64_t*) keys(), _i * elementBits() + m_header.keyBits, m_header.labelBits);
+				default:
+					ILBL label;
+					memcpy(&label, keys() + _i * elementBytes() + m_header.keyBytes, sizeof(ILBL));
+					return label;
+			}
+		}
+
+		const DbBigBucket* bigBuckets() const
+		{	return (const DbBigBucket*) (m_map + m_header.bigBucketsPos);	}
+
+		uint64_t offset(const uint64_t _bucket) const;
+
+		uint32_t size(const uint64_t _bucket) const;
+
+		bool read(const std::vector<DbRange>& _ranges) const;
+
+		void populate() const;
+
+		bool matches(const uint8_t _k, const size_t _keyBytes, const uint64_t _htSize, const size_t _numTargets) const;
+
+		static bool exists(const char* _filename);
+};
+
+/**
+ * Writes a database file bucket by bucket.
+ * The number of elements must be known in advance to place the sections.
+ * The file is written to <name>.tmp and renamed when complete.
+ */
+class DbWriter
+{
+	private:
+		int						m_fd;
+		DbHeader				m_header;
+		std::string				m_filename;
+		std::string				m_tmpFilename;
+
+		uint64_t				m_bucket;
+		uint64_t				m_elements;
+		uint64_t				m_bucketBegin;
+		BucketGroup				m_group;
+		std::vector<DbBigBucket>	m_bigBuckets;
+
+		DbLayout				m_layout;
+		std::vector<uint8_t>	m_buffers[3];	// index, keys, labels
+		uint64_t				m_bitWord;		// packed elements not yet in the keys buffer
+		uint32_t				m_bitCount;
+		uint64_t				m_positions[3];
+		std::vector<uint64_t>	m_anchors;
+		bool					m_failed;
+
+		void append(const int _section, const void* _data, const size_t _size);
+		void appendBits(const uint64_t _value, const uint32_t _bits);
+		bool flush(const int _section);
+
+	public:
+		DbWriter();
+
+		~DbWriter();
+
+		bool open(const char* _filename, const uint8_t _k, const size_t _keyBytes,
+				  const uint64_t _htSize, const size_t _numTargets, const uint64_t _numElements,
+				  const uint32_t _samplingFactor = 1, const DbLayout _layout = DBSPLIT);
+
+		void add(const void* _key, const ILBL& _label);
+
+		void endBucket();
+
+		bool close();
+};
+
+bool convertLegacyDb(const char* _filename, const uint8_t _k, const size_t _keyBytes,
+					 const uint64_t _htSize, const size_t _numTargets);
+
+bool legacyDbExists(const char* _filename);
+
+#endif
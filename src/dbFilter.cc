@@ -0,0 +1,208 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * Prefilter of the database k-mers, creation, reading and writing.
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "./dbFilter.hh"
+
+using namespace std;
+
+DbFilter::DbFilter(): m_numBlocks(1)
+{
+	memset(&m_header, 0, sizeof(DbFilterHeader));
+}
+
+void DbFilter::clear()
+{
+	std::vector<uint64_t>().swap(m_blocks);
+}
+
+/**
+ * Header of the filter for a database file.
+ */
+bool DbFilter::describeDb(const char* _dbFilename, const DbFile& _db, DbFilterHeader& _header)
+{
+	struct stat st;
+	if (stat(_dbFilename, &st) != 0)
+		return false;
+	const DbHeader& h = _db.header();
+
+	memset(&_header, 0, sizeof(DbFilterHeader));
+	memcpy(_header.magic, DBFILTERMAGIC, sizeof(_header.magic));
+	_header.version		= DBFILTERVERSION;
+	_header.headerSize	= sizeof(DbFilterHeader);
+	_header.k			= h.k;
+	_header.bitsPerKmer	= DBFILTERBITS;
+	_header.numBlocks	= (h.numElements * DBFILTERBITS + DBFILTERWORDS*64 - 1) / (DBFILTERWORDS*64);
+	if (_header.numBlocks == 0)
+		_header.numBlocks = 1;
+	_header.blocksPos	= (sizeof(DbFilterHeader) + 63) / 64 * 64;
+	_header.fileSize	= _header.blocksPos + _header.numBlocks * DBFILTERWORDS * sizeof(uint64_t);
+	_header.dbChecksum	= h.checksum;
+	_header.dbSize		= st.st_size;
+	_header.dbTime		= st.st_mtim.tv_sec;
+	_header.dbTimeNs	= st.st_mtim.tv_nsec;
+	return true;
+}
+
+/**
+ * Load the filter of a database, built from the database file if its
+ * filter file is missing or was built from another database.
+ */
+bool DbFilter::load(const char* _dbFilename, const char* _filterFilename, const bool _verbose)
+{
+	clear();
+	DbFile db;
+	if (!db.open(_dbFilename))
+		return false;
+	if (!describeDb(_dbFilename, db, m_header))
+	{
+		cerr << "Failed to open " << _dbFilename << endl;
+		return false;
+	}
+	m_numBlocks = HtSize(m_header.numBlocks);
+
+	if (readFile(_filterFilename, m_header))
+	{
+		if (_verbose)
+			cerr << "Prefilter loaded (" << bytes()/1000000/1000.0 << " GB)." << endl;
+		return true;
+	}
+
+	cerr << "Building the prefilter of the database (" << m_header.numBlocks * DBFILTERWORDS * sizeof(uint64_t)/1000000/1000.0
+		 << " GB)..." << endl;
+	build(db);
+	if (!writeFile(_filterFilename))
+		cerr << "The prefilter is not saved, it is built again at the next run." << endl;
+	return true;
+}
+
+/**
+ * Add the k-mers of the database, by ranges of buckets in parallel.
+ * K-mers of different ranges can share a block, bits are set atomically.
+ */
+void DbFilter::build(const DbFile& _db)
+{
+	const DbHeader& h = _db.header();
+	m_blocks.assign(m_header.numBlocks * DBFILTERWORDS, 0);
+	uint64_t* blocks = &m_blocks[0];
+
+	const size_t numRanges = (h.htSize + DBREADCHUNK - 1) / DBREADCHUNK;
+	#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic)
+	#endif
+	for (size_t r = 0; r < numRanges; r++)
+	{
+		const uint64_t first = r * DBREADCHUNK;
+		const uint64_t last = std::min<uint64_t>(first + DBREADCHUNK, h.htSize);
+		uint64_t i = _db.offset(first);
+		for (uint64_t bucket = first; bucket < last; bucket++)
+		{
+			const uint64_t end = i + _db.size(bucket);
+			for (; i < end; i++)
+			{
+				const uint64_t hash = dbFilterHash(_db.key(i) * h.htSize + bucket);
+				uint64_t* block = blocks + m_numBlocks.remainder(hash) * DBFILTERWORDS;
+				uint64_t bits = hash * 0x9e3779b97f4a7c15UL;
+				for (int b = 0; b < DBFILTERHASHES; b++, bits <<= 9)
+				{
+					const uint32_t bit = bits >> 55;
+					const uint64_t mask = (uint64_t) 1 << (bit & 63);
+					if ((block[bit >> 6] & mask) == 0)
+					{
+						#ifdef _OPENMP
+						#pragma omp atomic
+						#endif
+						block[bit >> 6] |= mask;
+					}
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Read a filter file, if it was built for the database of _expected.
+ */
+bool DbFilter::readFile(const char* _filename, const DbFilterHeader& _expected)
+{
+	FILE* fd = fopen(_filename, "r");
+	if (fd == NULL)
+		return false;
+	DbFilterHeader h;
+	bool valid = fread(&h, sizeof(DbFilterHeader), 1, fd) == 1 && memcmp(&h, &_expected, sizeof(DbFilterHeader)) == 0
+				 && fseek(fd, h.blocksPos, SEEK_SET) == 0;
+	if (valid)
+	{
+		m_blocks.resize(h.numBlocks * DBFILTERWORDS);
+		valid = fread(&m_blocks[0], sizeof(uint64_t), m_blocks.size(), fd) == m_blocks.size();
+	}
+	fclose(fd);
+	if (!valid)
+	{
+		clear();
+		cerr << "The prefilter " << _filename << " does not belong to the database." << endl;
+	}
+	return valid;
+}
+
+/**
+ * Write the filter to <name>.tmp and rename it when complete.
+ */
+bool DbFilter::writeFile(const char* _filename) const
+{
+	const string tmpFilename = string(_filename) + ".tmp";
+	FILE* fd = fopen(tmpFilename.c_str(), "w");
+	if (fd == NULL)
+	{
+		cerr << "Failed to create " << tmpFilename << endl;
+		return false;
+	}
+	std::vector<char> padding(m_header.blocksPos - sizeof(DbFilterHeader), 0);
+	bool written = fwrite(&m_header, sizeof(DbFilterHeader), 1, fd) == 1
+				   && fwrite(padding.data(), 1, padding.size(), fd) == padding.size()
+				   && fwrite(&m_blocks[0], sizeof(uint64_t), m_blocks.size(), fd) == m_blocks.size();
+	written = fclose(fd) == 0 && written;
+	if (!written || rename(tmpFilename.c_str(), _filename) != 0)
+	{
+		unlink(tmpFilename.c_str());
+		cerr << "Failed to write " << _filename << endl;
+		return false;
+	}
+	return true;
+}
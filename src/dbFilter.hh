@@ -0,0 +1,139 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * Prefilter of the database k-mers (--prefilter), a blocked Bloom filter.
+ *
+ * Each k-mer sets DBFILTERHASHES bits in one block of 512 bits (a cache
+ * line), chosen by a hash of the canonical k-mer. A k-mer with one of its
+ * bits not set is not in the database, most read k-mers are rejected by
+ * reading one cache line instead of the bucket index and the keys.
+ * With DBFILTERBITS bits per k-mer, about 0.5% of the other k-mers pass.
+ *
+ * The filter is built from the database file at the first load and saved
+ * next to it (<name>.bf), with the size, time and header checksum of the
+ * database it was built from.
+ *
+ * Layout (native byte order):
+ *   header		DbFilterHeader
+ *   blocks		numBlocks * DBFILTERWORDS * uint64_t at blocksPos
+ */
+
+#ifndef DBFILTER_HH
+#define DBFILTER_HH
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include "./dataType.hh"
+#include "./dbFile.hh"
+
+#define DBFILTERMAGIC		"CUCLARKF"
+#define DBFILTERVERSION		1
+#define DBFILTERBITS		16		// bits per k-mer of the database
+#define DBFILTERWORDS		8		// 64-bit words per block, one cache line
+#define DBFILTERHASHES		6		// bits set per k-mer, 9 bits of the hash each
+
+struct DbFilterHeader
+{
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	headerSize;
+	uint32_t	k;
+	uint32_t	bitsPerKmer;
+	uint64_t	numBlocks;
+	uint64_t	blocksPos;
+	uint64_t	fileSize;
+	// database the filter was built from
+	uint64_t	dbChecksum;
+	uint64_t	dbSize;
+	int64_t		dbTime;
+	int64_t		dbTimeNs;
+};
+
+/**
+ * Hash of a canonical k-mer for the filter (64-bit finalizer of
+ * MurmurHash3, of the k-mer offset, unlike the minimizer order).
+ */
+inline uint64_t dbFilterHash(uint64_t _kmerC)
+{
+	_kmerC += 0x9e3779b97f4a7c15UL;
+	_kmerC ^= _kmerC >> 33;
+	_kmerC *= 0xff51afd7ed558ccdUL;
+	_kmerC ^= _kmerC >> 33;
+	_kmerC *= 0xc4ceb9fe1a85ec53UL;
+	_kmerC ^= _kmerC >> 33;
+	return _kmerC;
+}
+
+/**
+ * Blocked Bloom filter of the k-mers of a database, in host memory.
+ */
+class DbFilter
+{
+	private:
+		DbFilterHeader			m_header;
+		HtSize					m_numBlocks;
+		std::vector<uint64_t>	m_blocks;
+
+		void build(const DbFile& _db);
+
+		bool readFile(const char* _filename, const DbFilterHeader& _expected);
+
+		bool writeFile(const char* _filename) const;
+
+		static bool describeDb(const char* _dbFilename, const DbFile& _db, DbFilterHeader& _header);
+
+	public:
+		DbFilter();
+
+		bool load(const char* _dbFilename, const char* _filterFilename, const bool _verbose);
+
+		void clear();
+
+		bool isEmpty() const
+		{	return m_blocks.empty();	}
+
+		size_t bytes() const
+		{	return m_blocks.size() * sizeof(uint64_t);	}
+
+		/**
+		 * False if the canonical k-mer is not in the database.
+		 */
+		bool contains(const uint64_t _kmerC) const
+		{
+			const uint64_t hash = dbFilterHash(_kmerC);
+			const uint64_t* block = &m_blocks[m_numBlocks.remainder(hash) * DBFILTERWORDS];
+			uint64_t bits = hash * 0x9e3779b97f4a7c15UL;
+			for (int i = 0; i < DBFILTERHASHES; i++, bits <<= 9)
+			{
+				const uint32_t bit = bits >> 55;
+				if (((block[bit >> 6] >> (bit & 63)) & 1) == 0)
+					return false;
+			}
+			return true;
+		}
+};
+
+#endif
@@ -202,71 +202,6 @@ bool getFirstAndSecondElementInLine(FILE*& _fileStream, std::string& _line, ITYP
 }
 
 
-void mergePairedFiles(const char* _file1, const char* _file2, const char* _objFile)
-{
-        string line1, line2 = "";
-        vector<string> ele1;
-        vector<string> ele2;
-        vector<char> sep;
-        sep.push_back(' ');
-        sep.push_back('/');
-        sep.push_back('\t');
-        FILE * fd1 = fopen(_file1, "r");
-        FILE * fd2 = fopen(_file2, "r");
-        getLineFromFile(fd1, line1);
-        getLineFromFile(fd2, line2);
-        if (line1[0] != line2[0])
-        {
-                perror("Error: the files have different format!");
-                exit(1);
-        }
-        char delim = line1[0];
-        if (delim != '@')
-        {
-                perror("Error: paired-end reads must be FASTQ files!");
-                exit(1);
-        }
-        sep.push_back(delim);
-        rewind(fd1);
-        rewind(fd2);
-        ofstream fout(_objFile, std::ios::binary);
-        while(getLineFromFile(fd1, line1) && getLineFromFile(fd2, line2))
-        {
-                if (line1[0] == delim && line2[0] == delim)
-                {
-                        ele1.clear();
-                        ele2.clear();
-                        getElementsFromLine(line1, sep, ele1);
-                        getElementsFromLine(line2, sep, ele2);
-                        if (ele1[0] != ele2[0])
-                        {
-                                perror("Error: read id does not match between files!");
-                                exit(1);
-                        }
-                        fout << ">" << ele1[0] << endl;
-                        if (getLineFromFile(fd1, line1) && getLineFromFile(fd2, line2))
-                        {
-                                // Add "N" to concatenate sequences, and separate content of each sequence
-                                fout << line1 << "N" << line2 << endl;
-                                if (getLineFromFile(fd1, line1) && getLineFromFile(fd2, line2))
-                                {
-                                        if (getLineFromFile(fd1, line1) && getLineFromFile(fd2, line2))
-                                        {       continue;       }
-                                }
-                        }
-                        else
-                        {
-                                perror("Error: Found read without sequence");
-                                exit(1);
-                        }
-                        continue;
-                }
-        }
-        fclose(fd1);
-        fclose(fd2);
-        fout.close();
-}
-
 void deleteFile(const char* _filename)
 {
         if (_filename != NULL)
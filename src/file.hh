@@ -49,8 +49,6 @@ bool getFirstAndSecondElementInLine(FILE*& _fileStream, std::string& _line, ITYP
 
 bool getFirstAndSecondElementInLine(FILE*& _fileStream, uint64_t& _kIndex, ITYPE& _index);
 
-void mergePairedFiles(const char* _file1, const char* _file2, const char* _objFile);
-
 void deleteFile(const char* _filename);
 
 bool validFile(const char* _file);
@@ -26,6 +26,12 @@
  * 
  * Changes:
  * Changed hash table operations to canonical k-mers.
+ * Database written to and read from a single file (dbFile.hh).
+ * Hash-table size set at runtime.
+ * Buckets sorted, counted and filled in parallel (disjoint buckets are independent).
+ * Cells of all buckets stored in one array, allocated after counting (count, allocate, insert).
+ * Buckets of any size written to the database (no limit of 255 elements).
+ * Database written in the requested layout (split, interleaved or bit-packed elements).
  */
 
 #ifndef HASHTABLE_HH
@@ -34,7 +40,9 @@
 #include<vector>
 #include<stdint.h>
 #include<string>
+#include<map>
 #include "./dataType.hh"
+#include "./dbFile.hh"
 #include "stdint.h"
 
 template <typename HKMERr, typename ELMTr> struct htCell
@@ -64,26 +72,83 @@ template <typename HKMERr, typename ELMTr> struct htCell
 
 };
 
+#define HTBIGBUCKET		255		// size of a bucket stored in m_bigBuckets
+
+/**
+ * Bucket with HTBIGBUCKET or more cells.
+ */
+struct BigBucket
+{
+	uint64_t	bucket;
+	uint64_t	capacity;
+	uint64_t	size;
+
+	bool operator<(const BigBucket& _b) const
+	{	return bucket < _b.bucket;	}
+};
+
+/**
+ * Hash table of k-mers, the cells of all buckets are stored one after another.
+ * The cells of each bucket are counted first (count), then the table
+ * is allocated (allocate) and filled (insert).
+ * Buckets are independent, different buckets can be counted and filled in parallel.
+ */
 template <typename HKMERr, typename ELMTr>
 class hTable
 {
 	private:
-		std::vector< sVector< htCell<HKMERr,ELMTr> > >   	m_table;
-		size_t							m_load;
+		std::vector< htCell<HKMERr,ELMTr> >		m_cells;
+		std::vector<BucketGroup>			m_index;		// capacity of the buckets, as in the database file
+		std::vector<uint64_t>				m_anchors;		// first cell per DBANCHORBUCKETS buckets
+		std::vector<uint8_t>				m_size;			// cells counted, then used, HTBIGBUCKET: see m_bigBuckets
+		std::vector<BigBucket>				m_bigBuckets;	// sorted by bucket
+		std::vector< std::map<uint64_t, uint64_t> >	m_overflow;	// cells counted beyond HTBIGBUCKET-1, per thread
 		size_t							m_it_x;
 		size_t							m_it_y;
 		uint8_t							m_k;
+		HtSize							m_htSize;
+
+		void countBucket(const size_t& _bucket, const size_t& _n);
+
+		const BigBucket& bigBucket(const size_t& _bucket) const
+		{	return *std::lower_bound(m_bigBuckets.begin(), m_bigBuckets.end(), BigBucket{_bucket, 0, 0});	}
+
+		BigBucket& bigBucket(const size_t& _bucket)
+		{	return *std::lower_bound(m_bigBuckets.begin(), m_bigBuckets.end(), BigBucket{_bucket, 0, 0});	}
+
+		uint64_t begin(const size_t& _bucket) const;
+
+		htCell<HKMERr,ELMTr>* cells(const size_t& _bucket)
+		{	return m_cells.data() + begin(_bucket);	}
+
+		const htCell<HKMERr,ELMTr>* cells(const size_t& _bucket) const
+		{	return m_cells.data() + begin(_bucket);	}
+
+		htCell<HKMERr,ELMTr>& push(const size_t& _bucket);
 
 	public:
 		hTable();
-		hTable(const uint8_t _k);
+		hTable(const uint8_t _k, const HtSize& _htSize = HtSize());
 
 		~hTable();
 
-		size_t Load() const 
-		{	return m_load;	}
+		const HtSize& htSize() const
+		{	return m_htSize;	}
+
+		size_t bucketSize(const size_t& _bucket) const
+		{	return m_size[_bucket] < HTBIGBUCKET ? m_size[_bucket] : bigBucket(_bucket).size;	}
 
-		void sortall(const size_t& _iteratorPos = 0);
+		ELMTr& element(const size_t& _bucket, const size_t& _pos)
+		{	return cells(_bucket)[_pos].CElement;	}
+
+		uint64_t kmer(const size_t& _bucket, const size_t& _pos) const
+		{	return _bucket + cells(_bucket)[_pos].CKey * m_htSize.size;	}
+
+		void count(const uint64_t& _kmer, const size_t& _n = 1);
+
+		void allocate();
+
+		void sortall();
 
 		bool insert(const uint64_t& 			_kmer,
 				const htCell<HKMERr,ELMTr>& 	_cell
@@ -116,23 +181,12 @@ class hTable
 				ILBL&                           _label
 			 );
 
-		bool find(const uint64_t& 			_ikmer, 
-				const uint64_t& 		_ikmerR, 
-				ILBL& 				_label
-			 ) const;
-
-		void updateElement(const size_t&	 	_xElement, 
-				const size_t& 			_yElement, 
-				const size_t& 			_count, 
-				const bool& 			_lbl, 
-				const bool& 			_isSameLbl = false
-				); 
-
 		void clear();
 
 		uint64_t write(const char*	 		_fileht, 
-				const size_t& 			iteratorPos, 
-				const bool& 			_clearAfter = true
+				const size_t& 			_numTargets, 
+				const bool& 			_clearAfter = true,
+				const DbLayout&			_layout = DBSPLIT
 			      );
 
 		bool read(const char * 				_filename, 
@@ -143,7 +197,6 @@ class hTable
 			 );
 
 		bool resetIterator();
-		bool nextIterator();
 		void markElementAtIterator();
 		void updateLabelAtIterator(const ILBL& _label);
 		bool next();
@@ -161,9 +214,11 @@ class hTable
  *
  */
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <cmath>
 #include <algorithm>
+#include <map>
 
 #ifdef _OPENMP
 #include <omp.h>
@@ -178,14 +233,24 @@ class hTable
 using namespace std;
 
 	template <typename HKMERr, typename ELMTr>
-hTable<HKMERr, ELMTr>::hTable(): m_load(0), m_it_x(0), m_it_y(0), m_k(0)
+hTable<HKMERr, ELMTr>::hTable(): m_it_x(0), m_it_y(0), m_k(0)
 {
-	m_table.resize(HTSIZE);
+	m_size.resize(m_htSize.size, 0);
+#ifdef _OPENMP
+	m_overflow.resize(omp_get_max_threads());
+#else
+	m_overflow.resize(1);
+#endif
 }
 	template <typename HKMERr, typename ELMTr>
-hTable<HKMERr, ELMTr>::hTable(const uint8_t _k): m_load(0), m_it_x(0), m_it_y(0), m_k(_k)
+hTable<HKMERr, ELMTr>::hTable(const uint8_t _k, const HtSize& _htSize): m_it_x(0), m_it_y(0), m_k(_k), m_htSize(_htSize)
 {
-	m_table.resize(HTSIZE);
+	m_size.resize(m_htSize.size, 0);
+#ifdef _OPENMP
+	m_overflow.resize(omp_get_max_threads());
+#else
+	m_overflow.resize(1);
+#endif
 }
 
 	template <typename HKMERr, typename ELMTr>
@@ -196,142 +261,252 @@ hTable<HKMERr, ELMTr>::~hTable()
 	template <typename HKMERr, typename ELMTr>
 void hTable<HKMERr, ELMTr>::clear()
 {
-	m_load = 0;
-	m_table.clear();
+	std::vector< htCell<HKMERr,ELMTr> >().swap(m_cells);
+	std::vector<BucketGroup>().swap(m_index);
+	std::vector<uint64_t>().swap(m_anchors);
+	std::vector<uint8_t>().swap(m_size);
+	std::vector<BigBucket>().swap(m_bigBuckets);
+	m_overflow.clear();
 }
 
+/**
+ * Count _n cells for a bucket, before the table is allocated.
+ */
 	template <typename HKMERr, typename ELMTr>
-void hTable<HKMERr, ELMTr>::sortall(const size_t& _iteratorPos)
+void hTable<HKMERr, ELMTr>::countBucket(const size_t& _bucket, const size_t& _n)
 {
-	size_t maxSize = 0;
-	for(size_t t = 0; t < m_table.size() ; t++)
+	const size_t free = HTBIGBUCKET - 1 - std::min<size_t>(m_size[_bucket], HTBIGBUCKET - 1);
+	if (_n <= free)
 	{
-		maxSize = !m_table[t].empty() ? (m_table[t].size() > maxSize? m_table[t].size(): maxSize): maxSize;
-		if (!m_table[t].empty())
-		{
-			std::sort(m_table[t].begin()+_iteratorPos, m_table[t].end());
-		}
+		m_size[_bucket] += _n;
+		return;
 	}
-	cerr << "Hashtable sorting done: maximum number of collisions: " << maxSize -_iteratorPos << endl;
+	m_size[_bucket] = HTBIGBUCKET;
+#ifdef _OPENMP
+	m_overflow[omp_get_thread_num()][_bucket] += _n - free;
+#else
+	m_overflow[0][_bucket] += _n - free;
+#endif
 }
 
+/**
+ * Count _n cells for the bucket of _kmer, before the table is allocated.
+ */
 	template <typename HKMERr, typename ELMTr>
-bool hTable<HKMERr, ELMTr>::insert(const uint64_t& _kmer, const ILBL& _label, const size_t& _count)
+void hTable<HKMERr, ELMTr>::count(const uint64_t& _kmer, const size_t& _n)
 {
-	size_t quotient(_kmer / HTSIZE);
-	htCell<HKMERr, ELMTr> e(quotient, _label, _count);
-	return insert(_kmer, e);
+	countBucket(_kmer - m_htSize.quotient(_kmer) * m_htSize.size, _n);
 }
 
-//// used for loading without counts
+/**
+ * Allocate the cells counted, all buckets are empty afterwards.
+ * Big buckets are marked with HTBIGBUCKET in m_size and in the index.
+ */
 	template <typename HKMERr, typename ELMTr>
-bool hTable<HKMERr, ELMTr>::insert(const uint64_t& _kmer, const ILBL& _label)
+void hTable<HKMERr, ELMTr>::allocate()
 {
-	size_t q( _kmer / HTSIZE);
-	htCell<HKMERr, ELMTr> e(q, _label, 1);
-	size_t xline = _kmer % HTSIZE;
-	m_table[xline].push_back(e);
-	m_load++;
-	return true;
-}
+	std::map<uint64_t, uint64_t> overflow;
+	for(size_t t = 0; t < m_overflow.size(); t++)
+	{
+		for(std::map<uint64_t, uint64_t>::const_iterator it = m_overflow[t].begin(); it != m_overflow[t].end(); it++)
+		{
+			overflow[it->first] += it->second;
+		}
+		m_overflow[t].clear();
+	}
+	m_bigBuckets.clear();
+	for(std::map<uint64_t, uint64_t>::const_iterator it = overflow.begin(); it != overflow.end(); it++)
+	{
+		BigBucket big = {it->first, HTBIGBUCKET - 1 + it->second, 0};
+		m_bigBuckets.push_back(big);
+	}
 
-	template <typename HKMERr, typename ELMTr>
-bool hTable<HKMERr,  ELMTr>::insert(const uint64_t& _kmer, const htCell<HKMERr, ELMTr>& _cell)
-{
-	size_t xline  = _kmer % HTSIZE;
-	size_t q = _kmer  / HTSIZE;
-	if (m_table[xline].empty())
+	//// cells per range of DBANCHORBUCKETS buckets, prefix scan gives the anchors
+	const size_t numBlocks = (m_htSize.size + DBANCHORBUCKETS - 1) / DBANCHORBUCKETS;
+	std::vector<uint64_t> blockStart(numBlocks + 1, 0);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for(size_t a = 0; a < numBlocks; a++)
 	{
-		//// min
-		m_table[xline].push_back(_cell);
-		//// max
-		m_table[xline].push_back(_cell);
-		//// cell iteself
-		m_table[xline].push_back(_cell); 
+		const size_t last = std::min<size_t>((a+1) * DBANCHORBUCKETS, m_htSize.size);
+		for(size_t b = a * DBANCHORBUCKETS; b < last; b++)
+		{
+			blockStart[a+1] += m_size[b] < HTBIGBUCKET ? m_size[b] : bigBucket(b).capacity;
+		}
 	}
-	else
+	for(size_t a = 0; a < numBlocks; a++)
 	{
-		//// insert
-		m_table[xline].push_back(_cell);
-		//// update min
-		if (q < m_table[xline][0].CKey)
+		if (blockStart[a+1] >= ((uint64_t) 1 << 32))
 		{
-			m_table[xline][0] = q;	
+			cerr << "Too many k-mers in buckets " << a * DBANCHORBUCKETS << " to " << (a+1) * DBANCHORBUCKETS - 1 << "." << endl;
+			cerr << "Please increase the size of the hash-table (--ht-size)." << endl;
+			exit(-1);
 		}
-		//// update max
-		else if (q > m_table[xline][1].CKey)
+		blockStart[a+1] += blockStart[a];
+	}
+
+	m_anchors.assign(numBlocks, 0);
+	BucketGroup emptyGroup = {0, {0, 0}};
+	m_index.assign((m_htSize.size + DBGROUPBUCKETS - 1) / DBGROUPBUCKETS, emptyGroup);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for(size_t a = 0; a < numBlocks; a++)
+	{
+		uint64_t pos = blockStart[a];
+		m_anchors[a] = pos;
+		const size_t last = std::min<size_t>((a+1) * DBANCHORBUCKETS, m_htSize.size);
+		for(size_t b = a * DBANCHORBUCKETS; b < last; b++)
 		{
-			m_table[xline][1] = q;
+			BucketGroup& group = m_index[b / DBGROUPBUCKETS];
+			const size_t j = b % DBGROUPBUCKETS;
+			if (j == 0)
+			{	group.anchor = (uint32_t) pos;	}
+			group.sizes[j >> 2] |= (uint32_t) m_size[b] << 8*(j & 3);
+			if (m_size[b] < HTBIGBUCKET)
+			{
+				pos += m_size[b];
+				m_size[b] = 0;
+			}
+			else
+			{	pos += bigBucket(b).capacity;	}
 		}
 	}
-	m_load++;
-	return true;
+	m_cells.resize(blockStart[numBlocks]);
 }
 
-template <typename HKMERr, typename ELMTr>
-bool hTable<HKMERr, ELMTr>::find(const uint64_t& _kmer, size_t& _xElement, size_t& _yElement, ILBL& _label, IOCCR& _mult, ICount& _count) const
+/**
+ * Position of the first cell of a bucket.
+ */
+	template <typename HKMERr, typename ELMTr>
+inline uint64_t hTable<HKMERr, ELMTr>::begin(const size_t& _bucket) const
+{
+	const BucketGroup& group = m_index[_bucket / DBGROUPBUCKETS];
+	const uint64_t anchor = m_anchors[_bucket / DBANCHORBUCKETS];
+	uint32_t capacity;
+	uint64_t pos = anchor + (uint32_t) (group.anchor - (uint32_t) anchor) + bucketInGroup(group, _bucket % DBGROUPBUCKETS, capacity);
+	if (!m_bigBuckets.empty())
+	{	// big buckets before _bucket in the group count HTBIGBUCKET cells in the index
+		for(size_t b = _bucket - _bucket % DBGROUPBUCKETS; b < _bucket; b++)
+		{
+			if (m_size[b] == HTBIGBUCKET)
+			{	pos += bigBucket(b).capacity - HTBIGBUCKET;	}
+		}
+	}
+	return pos;
+}
+
+/**
+ * Next free cell of a bucket.
+ */
+	template <typename HKMERr, typename ELMTr>
+inline htCell<HKMERr,ELMTr>& hTable<HKMERr, ELMTr>::push(const size_t& _bucket)
 {
-	const size_t remainder = _kmer % HTSIZE;
-	if (m_table[remainder].empty())
+	uint64_t size, capacity;
+	if (m_size[_bucket] < HTBIGBUCKET)
 	{
-		return false;
+		size = m_size[_bucket]++;
+		capacity = ::bucketSize(m_index[_bucket / DBGROUPBUCKETS], _bucket % DBGROUPBUCKETS);
 	}
-	HKMERr quotient = (_kmer / HTSIZE);
-	if (quotient < m_table[remainder][0].CKey || quotient > m_table[remainder][1].CKey)
+	else
 	{
-		return false;
+		BigBucket& big = bigBucket(_bucket);
+		size = big.size++;
+		capacity = big.capacity;
 	}
-	bool isContained = false;
-
-	size_t t = 0;
-	size_t t_index = 0;	
-
-	size_t init_t =  rand() % (m_table[remainder].size() - 2);
-	bool  dir_t = rand() % 2;
-
-	for(t = init_t + 2; !isContained && t < m_table[remainder].size() && t >= 2; t = dir_t?t+1:t-1) 
+	if (size >= capacity)
 	{
-		isContained = m_table[remainder][t].CKey == quotient ;
-		t_index = t;
+		cerr << "Hash table bucket " << _bucket << " is full, more k-mers inserted than counted." << endl;
+		exit(-1);
 	}
-	if (isContained)
+	return cells(_bucket)[size];
+}
+
+	template <typename HKMERr, typename ELMTr>
+void hTable<HKMERr, ELMTr>::sortall()
+{
+	size_t maxSize = 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 65536) reduction(max:maxSize)
+#endif
+	for(size_t t = 0; t < m_htSize.size ; t++)
 	{
-		_xElement = remainder;
-		_yElement = t_index;
-		_label	  = m_table[remainder][t_index].CElement.GetLabel();
-		_mult	  = m_table[remainder][t_index].CElement.GetMultiplicity();
-		_count	  = m_table[remainder][t_index].CElement.GetCount();
-		return true;
+		const size_t size = bucketSize(t);
+		maxSize = size > maxSize ? size : maxSize;
+		if (size > 1)
+		{
+			htCell<HKMERr, ELMTr>* cell = cells(t);
+			std::sort(cell, cell + size);
+		}
 	}
-	init_t = (init_t > 0 && init_t < m_table[remainder].size() - 2)? (dir_t ? init_t -1: init_t+1): init_t;
+	cerr << "Hashtable sorting done: maximum number of collisions: " << maxSize << endl;
+}
+
+	template <typename HKMERr, typename ELMTr>
+bool hTable<HKMERr, ELMTr>::insert(const uint64_t& _kmer, const ILBL& _label, const size_t& _count)
+{
+	size_t quotient(m_htSize.quotient(_kmer));
+	htCell<HKMERr, ELMTr> e(quotient, _label, _count);
+	return insert(_kmer, e);
+}
+
+//// used for loading without counts
+	template <typename HKMERr, typename ELMTr>
+bool hTable<HKMERr, ELMTr>::insert(const uint64_t& _kmer, const ILBL& _label)
+{
+	return insert(_kmer, _label, 1);
+}
 
-	for(t = init_t + 2;  !isContained && t < m_table[remainder].size() && t >= 2 ; t = dir_t?t-1:t+1)
+	template <typename HKMERr, typename ELMTr>
+bool hTable<HKMERr,  ELMTr>::insert(const uint64_t& _kmer, const htCell<HKMERr, ELMTr>& _cell)
+{
+	size_t q = m_htSize.quotient(_kmer);
+	size_t xline  = _kmer - q * m_htSize.size;
+	push(xline) = _cell;
+	return true;
+}
+
+template <typename HKMERr, typename ELMTr>
+bool hTable<HKMERr, ELMTr>::find(const uint64_t& _kmer, size_t& _xElement, size_t& _yElement, ILBL& _label, IOCCR& _mult, ICount& _count) const
+{
+	const size_t q = m_htSize.quotient(_kmer);
+	const size_t remainder = _kmer - q * m_htSize.size;
+	const size_t size = bucketSize(remainder);
+	if (size == 0)
 	{
-		isContained = m_table[remainder][t].CKey == quotient ;
-		t_index = t;
+		return false;
 	}
-	if (isContained)
+	const HKMERr quotient = q;
+	const htCell<HKMERr, ELMTr>* cell = cells(remainder);
+	for(size_t t = 0; t < size; t++)
 	{
-		_xElement = remainder;
-		_yElement = t_index;
-		_label    = m_table[remainder][t_index].CElement.GetLabel();
-		_mult     = m_table[remainder][t_index].CElement.GetMultiplicity();
-		_count    = m_table[remainder][t_index].CElement.GetCount();
+		if (cell[t].CKey == quotient)
+		{
+			_xElement = remainder;
+			_yElement = t;
+			_label	  = cell[t].CElement.GetLabel();
+			_mult	  = cell[t].CElement.GetMultiplicity();
+			_count	  = cell[t].CElement.GetCount();
+			return true;
+		}
 	}
-	return isContained;
+	return false;
 }
 
 template <typename HKMERr, typename ELMTr>
 bool hTable<HKMERr, ELMTr>::find(const IKMER& _ikmer,  const size_t& _remainderI, const size_t& _quotientI, ILBL& _label) const
 {
 	const size_t remainder = _ikmer.skmer[_remainderI];
+	const size_t size = bucketSize(remainder);
 
-	if (m_table[remainder].empty())
+	if (size == 0)
 	{
 		return false;
 	}
-	size_t _endI = m_table[remainder].size() - 1;
-	if (m_table[remainder][0].CKey > _ikmer.skmer[_quotientI] || m_table[remainder][_endI].CKey < _ikmer.skmer[_quotientI])
+	const htCell<HKMERr, ELMTr>* cell = cells(remainder);
+	size_t _endI = size - 1;
+	if (cell[0].CKey > _ikmer.skmer[_quotientI] || cell[_endI].CKey < _ikmer.skmer[_quotientI])
 	{
 		return false;
 	}
@@ -340,16 +515,16 @@ bool hTable<HKMERr, ELMTr>::find(const IKMER& _ikmer,  const size_t& _remainderI
 	while (_endI > _startI)
 	{
 		midPoint = _startI + (_endI - _startI)/2;
-		if (_ikmer.skmer[_quotientI] <= m_table[remainder][midPoint].CKey)
+		if (_ikmer.skmer[_quotientI] <= cell[midPoint].CKey)
 		{
 			_endI = midPoint;
 			continue;
 		}
 		_startI = midPoint+1;
 	}
-	if (m_table[remainder][_startI].CKey == _ikmer.skmer[_quotientI])
+	if (cell[_startI].CKey == _ikmer.skmer[_quotientI])
 	{
-		_label = m_table[remainder][_startI].CElement.Label;
+		_label = cell[_startI].CElement.Label;
 		return true;
 	}
 	return false;
@@ -371,18 +546,19 @@ bool hTable<HKMERr, ELMTr>::find(const uint64_t& _ikmer, ILBL& _label)
 	//// getting canonical kmer
 	size_t _ikmerC = _ikmer < _ikmerR ? _ikmer : _ikmerR;
 
-	size_t quotient = _ikmerC / HTSIZE;
-	size_t remainder = _ikmerC - quotient * HTSIZE;
+	size_t quotient = m_htSize.quotient(_ikmerC);
+	size_t remainder = _ikmerC - quotient * m_htSize.size;
 
 	//// check remainder in HT
-	if (m_table[remainder].empty()) return false;
+	const size_t size = bucketSize(remainder);
+	if (size == 0) return false;
 	
 	//// check quotient range in HT
-	uint8_t _endI = m_table[remainder].size() - 1;
-	if (m_table[remainder][0].CKey > quotient || m_table[remainder][_endI].CKey < quotient)	return false;
+	const htCell<HKMERr, ELMTr>* ptr = cells(remainder);
+	size_t _endI = size - 1;
+	if (ptr[0].CKey > quotient || ptr[_endI].CKey < quotient)	return false;
 
 	//// check quotients
-	htCell<HKMERr, ELMTr>* ptr = &m_table[remainder].front();
 	while (ptr->CKey <= quotient)
 	{
 		if (ptr->CKey == quotient)
@@ -395,152 +571,98 @@ bool hTable<HKMERr, ELMTr>::find(const uint64_t& _ikmer, ILBL& _label)
 	return false;
 }
 
-	template <typename HKMERr, typename ELMTr>
-void hTable<HKMERr, ELMTr>::updateElement(const size_t& _xElement, const size_t& _yElement, const size_t& _count, const bool& _lbl, const bool& _isSameLbl)
-{
-	if (!_isSameLbl)
-	{
-		m_table[_xElement][_yElement].CElement.IncreaseMultiplicity();
-	}
-	m_table[_xElement][_yElement].CElement.AddToCount(_count);
-	if (_lbl)
-	{
-		m_table[_xElement][_yElement].CElement.IncreaseMultiplicity();
-	}
-}
-
 	template <typename HKMERr, typename ELMTr>
 bool hTable<HKMERr, ELMTr>::resetIterator()
 {
 	m_it_x = 0;
-	m_it_y = 1;
+	m_it_y = (size_t) -1;
 	return true;
 }
 
-	template <typename HKMERr, typename ELMTr>
-bool hTable<HKMERr, ELMTr>::nextIterator()
-{
-	if (!m_table[m_it_x].empty() && m_table[m_it_x].size() > m_it_y + 1)
-	{
-		m_it_y++;
-	}
-	else
-	{
-		m_it_y = 2;
-		m_it_x++;
-	}
-	return (!m_table[m_it_x].empty() && m_table[m_it_x].size() > m_it_y);
-}
-
 	template <typename HKMERr, typename ELMTr>
 bool hTable<HKMERr, ELMTr>::next()
 {
-	bool loop = true;
-	while (loop && m_it_x < m_table.size())
+	m_it_y++;
+	while (m_it_x < m_htSize.size && m_it_y >= bucketSize(m_it_x))
 	{
-		loop = !nextIterator();
+		m_it_x++;
+		m_it_y = 0;
 	}
-	if (m_it_x >= m_table.size())
-	{	return false;}
-	return true;
+	return m_it_x < m_htSize.size;
 }
 
 	template <typename HKMERr, typename ELMTr>
 void  hTable<HKMERr, ELMTr>::updateLabelAtIterator(const ILBL& _label)
 {
-	m_table[m_it_x][m_it_y].CElement.Label = _label;
+	cells(m_it_x)[m_it_y].CElement.Label = _label;
 }
 
 	template <typename HKMERr, typename ELMTr>
 void hTable<HKMERr, ELMTr>::markElementAtIterator()
 {
-	m_table[m_it_x][m_it_y].CElement.Mark();	
+	cells(m_it_x)[m_it_y].CElement.Mark();	
 }
 
 template <typename HKMERr, typename ELMTr>
 void hTable<HKMERr, ELMTr>::elementIterator(ELMTr& _cElement) const
 {
-	_cElement = m_table[m_it_x][m_it_y].CElement;
+	_cElement = cells(m_it_x)[m_it_y].CElement;
 }
 
 template <typename HKMERr, typename ELMTr>
 void hTable<HKMERr, ELMTr>::elementIterator(uint64_t& _kmer, ELMTr& _cElement) const
 {
-	_kmer = m_it_x + m_table[m_it_x][m_it_y].CKey*m_table.size();
-	_cElement = m_table[m_it_x][m_it_y].CElement;
+	const htCell<HKMERr, ELMTr>& cell = cells(m_it_x)[m_it_y];
+	_kmer = m_it_x + cell.CKey * m_htSize.size;
+	_cElement = cell.CElement;
 }
 
 	template <typename HKMERr, typename ELMTr>
-uint64_t hTable<HKMERr, ELMTr>::write(const char* _fileht, const size_t& _iteratorPos, const bool& _clearAfter)
+uint64_t hTable<HKMERr, ELMTr>::write(const char* _fileht, const size_t& _numTargets, const bool& _clearAfter, const DbLayout& _layout)
 {
-	char * file_lbl = (char*) calloc(strlen(_fileht)+4,sizeof(char));
-	char * file_key = (char*) calloc(strlen(_fileht)+4,sizeof(char));
-	char * file_sze = (char*) calloc(strlen(_fileht)+4,sizeof(char));
-	sprintf(file_lbl, "%s.lb", _fileht);
-	sprintf(file_key, "%s.ky", _fileht);
-	sprintf(file_sze, "%s.sz", _fileht);
-
-	FILE * fd_l = fopen(file_lbl,"w+");
-	FILE * fd_k = fopen(file_key,"w+");
-	FILE * fd_s = fopen(file_sze,"w+");
 	uint64_t nbElement = 0;
-	uint8_t size = 0;
-	for(ITYPE t = 0; t < HTSIZE; t++)
+	//// count marked elements, the file sections are placed by the total
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 65536) reduction(+:nbElement)
+#endif
+	for(size_t t = 0; t < m_htSize.size; t++)
 	{
-		size = 0;
-		if (!m_table[t].empty())
+		const size_t size = bucketSize(t);
+		const htCell<HKMERr, ELMTr>* cell = size > 0 ? cells(t) : NULL;
+		size_t  l_size = 0;
+		for(size_t u = 0; u < size; u++)
 		{
-			size_t  l_size = 0;
-			//// count marked elements in bucket
-			for(size_t u = _iteratorPos;  u < m_table[t].size() ;u++)
-			{
-				l_size += m_table[t][u].CElement.Marked() ? 1: 0;
-			}
-			if ( l_size >=  256) 
-			{
-				cerr << "This table can not be stored on disk: Some bucket list size exceeds 255." << endl;
-				cerr << "Please relaunch all computations by applying the following modifications: " << endl;
-				cerr << "- choose a smaller k-mers length, and/or" << endl;
-				cerr << "- increase the size of the hash-table as " << m_table.size() << " is way too small!" << endl;
-				cerr << "The program must exit now." << endl;
-				exit(-1);
-			}
-			nbElement += l_size;
-			size = l_size;
-			//// write bucket size to file
-			fwrite(&size, 1,1, fd_s);
-			//// write keys and labels to files
-			for(size_t u = _iteratorPos; u < m_table[t].size() ;u++)
-			{
-				if (m_table[t][u].CElement.Marked())
-				{
-					fwrite(&m_table[t][u].CKey,sizeof(HKMERr),1, fd_k);
-					fwrite(&m_table[t][u].CElement.Label, sizeof(ILBL),1, fd_l);
-				}
-			}
-			if (_clearAfter)
-			{	
-				m_table[t].clear();
-			}
+			l_size += cell[u].CElement.Marked() ? 1: 0;
 		}
-		else
+		nbElement += l_size;
+	}
+	std::string dbFilename = std::string(_fileht) + ".db";
+	DbWriter writer;
+	if (!writer.open(dbFilename.c_str(), m_k, sizeof(HKMERr), m_htSize.size, _numTargets, nbElement, 1, _layout))
+	{
+		exit(-1);
+	}
+	for(size_t t = 0; t < m_htSize.size; t++)
+	{
+		//// write keys and labels of the bucket
+		const size_t size = bucketSize(t);
+		const htCell<HKMERr, ELMTr>* cell = size > 0 ? cells(t) : NULL;
+		for(size_t u = 0; u < size; u++)
 		{
-			//// write bucket size 0 to file
-			fwrite(&size, 1,1, fd_s);
+			if (cell[u].CElement.Marked())
+			{
+				writer.add(&cell[u].CKey, cell[u].CElement.Label);
+			}
 		}
+		writer.endBucket();
+	}
+	if (!writer.close())
+	{
+		exit(-1);
 	}
-	fclose(fd_l);
-	fclose(fd_k);
-	fclose(fd_s);
-	free(file_lbl); 
-	file_lbl=NULL;
-	free(file_key); 
-	file_key=NULL;
-	free(file_sze); 
-	file_sze=NULL;
 	if (_clearAfter)
 	{       
-		m_table.clear();
+		clear();
 	}
 	return nbElement;
 }
@@ -548,283 +670,53 @@ uint64_t hTable<HKMERr, ELMTr>::write(const char* _fileht, const size_t& _iterat
 	template <typename HKMERr, typename ELMTr>
 bool hTable<HKMERr, ELMTr>::read(const char * _filename, size_t& _fileSize,  const size_t& _nbCPU, const ITYPE& _modCollision, const bool& _isfastLoadingRequested)
 {
-	char * file_lbl = (char*) calloc(strlen(_filename)+4,sizeof(char));
-	char * file_key = (char*) calloc(strlen(_filename)+4,sizeof(char));
-	char * file_sze = (char*) calloc(strlen(_filename)+4,sizeof(char));
+	// the database file is always mapped, _isfastLoadingRequested has no effect
+	std::string dbFilename = std::string(_filename) + ".db";
+	DbFile db;
+	if (!db.open(dbFilename.c_str()))
+	{
+		return false;
+	}
+	if (!db.matches(m_k, sizeof(HKMERr), m_htSize.size, db.header().numTargets))
+	{
+		return false;
+	}
 
-	sprintf(file_lbl, "%s.lb", _filename);
-	sprintf(file_key, "%s.ky", _filename);
-	sprintf(file_sze, "%s.sz", _filename);
+	// Initialization
+	ITYPE loadf = 0;
+	bool allCollision = _modCollision <= 1;
+	vector<uint8_t>		choice(m_htSize.size,0);
 
-	if (_isfastLoadingRequested)
+	for(size_t t = 0; t < m_htSize.size; t++)
 	{
-#ifdef _OPENMP
-		omp_set_num_threads(_nbCPU);
-#endif
-
-		// Opening File with sizes
-		_fileSize = HTSIZE;
-		int fd_s = open(file_sze, O_RDONLY);
-		if (fd_s == -1)
+		if (db.size(t) != 0)
 		{
-			cerr << "Failed to open " << file_sze << endl;
-			return false;
-		}
-		uint8_t *map;
-		map = (uint8_t*) mmap(0, _fileSize, PROT_READ, MAP_SHARED, fd_s, 0);
-		if (map == MAP_FAILED)
-		{
-			close(fd_s);
-			cerr << "Failed to mmapping the file!" << endl;
-			exit(-1);
+			loadf++;
+			choice[t] = (allCollision || (loadf % _modCollision)== 0) ? 2: 1;	
+			if (choice[t] == 2)
+			{	countBucket(t, db.size(t));	}
 		}
-		if (_fileSize < 1)
-		{
-			close(fd_s);
-			cerr << "Failed to load database: the database ["<< file_sze<< "] contains no data." << endl;
-			exit(-1);
-		}
-		// Initialization
-		ITYPE loadf = 0;
-		bool allCollision = _modCollision <= 1;
-		
-		uint64_t 		nbElement = 0;
-		vector<uint8_t>		choice(HTSIZE,0);
-		vector<uint64_t> 	it_Key(_nbCPU,0);
-
-		ITYPE i = 0;
-		vector<ITYPE> Pos(_nbCPU+1, 0);
-		for(i = 1; i < _nbCPU ; i++)
-		{       Pos[i] = (HTSIZE/_nbCPU) * i;   }
-		Pos[_nbCPU] = HTSIZE;
-
-		/// PART 1: Setting bucket size
-		i = 0;
-		for(size_t t = 0; t < HTSIZE; t++)
-		{
-			if (t == Pos[i+1])
-			{       it_Key[++i] = nbElement; }
-			if (map[t] > 0)
-			{
-				loadf++;
-				nbElement += map[t];
-				choice[t] = (allCollision || (loadf % _modCollision)== 0) ? 2: 1;	
-			}
-		}
-		i = 0;
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
-		for (i = 0; i < _nbCPU; i++)
-		{
-			ITYPE min = Pos[i], max = Pos[i+1];
-			for(ITYPE u = min; u < max; u++)
-			{
-				if (choice[u] == 2)
-				{	m_table[u].resize(map[u]); } 
-			}
-		}
-		/// PART 2: Populating key/label
-		// Opening Files
-		size_t _fileSizek = nbElement * sizeof(HKMERr);
-		size_t _fileSizel = nbElement * sizeof(ILBL);
-		// kmers keys
-		int fd_k = open(file_key, O_RDONLY);
-		if (fd_k == -1)
-		{
-			cerr << "Failed to open " << file_key << endl;
-			return false;
-		}
-		HKMERr *key;
-		key = (HKMERr*) mmap(0, _fileSizek, PROT_READ, MAP_SHARED, fd_k, 0);
-		if (key == MAP_FAILED)
-		{
-			close(fd_k);
-			cerr << "Failed to mmapping the file!" << endl;
-			exit(-1);
-		}
-		if ( _fileSizek < 1)
-		{
-			close(fd_k);
-			cerr << "Failed to load database: ["<< file_key<< "] contains no data." << endl;
-			exit(-1);
-		}
-		/// targets Labels
-		int fd_l = open(file_lbl, O_RDONLY);
-		if (fd_l == -1)
-		{
-			cerr << "Failed to open " << file_lbl << endl;
-			return false;
-		}
-		ILBL *lbl;
-		lbl = (ILBL*) mmap(0, _fileSizel, PROT_READ, MAP_SHARED, fd_l, 0);
-		if (lbl == MAP_FAILED)
-		{
-			close(fd_l);
-			cerr << "Failed to mmapping the file!" << endl;
-			exit(-1);
-		}
-		if ( _fileSizel < 1)
-		{
-			close(fd_l);
-			cerr << "Failed to load database: ["<< file_lbl<< "] contains no data." << endl;
-			exit(-1);
-		}
-		/// Loading in memory key-label for each k-mer
-		i = 0;
+	}
+	allocate();
+	/// Loading in memory key-label for each k-mer
 #ifdef _OPENMP
-#pragma omp parallel for
+	omp_set_num_threads(_nbCPU);
+#pragma omp parallel for schedule(dynamic, 65536)
 #endif
-		for(i = 0; i < _nbCPU ; i++)
-		{
-			ITYPE min = Pos[i], max = Pos[i+1];
-			uint64_t u =0, v = 0, it_e = it_Key[i];
-
-			for(ITYPE t = min; t < max; t++)
-			{
-				if (choice[t] > 0)
-				{
-					if (choice[t] == 2)
-					{
-						u = 0;
-						for(v = it_e; v < it_e + map[t]; v++)
-						{
-							m_table[t][u].CKey = key[v];
-							m_table[t][u++].CElement.Label = lbl[v];
-						}
-					}
-					it_e += map[t];
-				}
-			}
-		}
-		/// End
-		if (munmap(map, _fileSize) == -1)
-		{
-			perror("Error un-mmapping the database file (size)");
-		}
-		close(fd_s);
-		if (munmap(key, _fileSizek) == -1)
-		{
-			perror("Error un-mmapping the database file (key)");
-		}
-		if (munmap(lbl, _fileSizel) == -1)
-		{
-			perror("Error un-mmapping the database file (label)");
-		}
-		close(fd_l);
-		close(fd_k);
-
-		_fileSize = HTSIZE + _fileSizek + _fileSizel;
-
-		free(file_lbl); 
-		file_lbl=NULL;
-		free(file_key); 
-		file_key=NULL;
-		free(file_sze); 
-		file_sze=NULL;
-
-		return true;
-	}
-	FILE * fd_l = fopen(file_lbl,"r");
-	FILE * fd_k = fopen(file_key,"r");
-	FILE * fd_s = fopen(file_sze,"r");
-
-#define LEN 100000
-	
-	if (fd_l == NULL)
-	{	cerr << "Failed to open " << file_lbl << endl; return false;	}
-	if (fd_k == NULL)
-	{       cerr << "Failed to open " << file_key << endl; return false;   }
-	if (fd_s == NULL)
-	{       cerr << "Failed to open " << file_sze << endl; return false;   }
-
-
-	ITYPE t = 0, i	= 0;
-	ITYPE loadf 	= 0;
-	bool allCollision = _modCollision <= 1;
-
-	uint8_t 	c[LEN];
-	ILBL 		lbl[LEN];
-	HKMERr  	key[LEN];
-	size_t len 	= fread(c,   1, LEN, fd_s);
-	size_t len_l 	= fread(lbl, sizeof(ILBL), LEN, fd_l);
-	size_t len_k 	= fread(key, sizeof(HKMERr), LEN, fd_k);
-
-	size_t nbElement = 0, u = 0, v = 0, v_c = 0;
-
-	_fileSize = len + len_l*sizeof(ILBL) + len_k*sizeof(HKMERr);
-	//htCell<HKMERr, ELMTr> defCell;
-	bool readDone = false;
-	while (true)
+	for(ITYPE t = 0; t < m_htSize.size; t++)
 	{
-		while (i < len)
+		if (choice[t] == 2)
 		{
-			if (c[i] > 0)
+			uint64_t v = db.offset(t);
+			uint32_t size = db.size(t);
+			for(uint32_t u = 0; u < size; u++, v++)
 			{
-				loadf++;
-				nbElement += c[i];
-				readDone = false;
-				if (allCollision || (loadf % _modCollision)== 0)
-				{	
-					//m_table[t].reserve(c[i]);	
-					m_table[t].resize(c[i]);
-					u = 0;
-					v_c = v;
-					while (u < c[i])
-					{
-						if (v_c < len_l)
-						{
-							//m_table[t].push_back(defCell);
-							m_table[t][u].CKey = key[v_c];
-							m_table[t][u++].CElement.Label = lbl[v_c++];
-							continue;
-						}
-						len_l = fread(lbl, sizeof(ILBL), LEN, fd_l);
-						len_k = fread(key, sizeof(HKMERr), LEN, fd_k);
-						readDone = true;
-						_fileSize += len_l*sizeof(ILBL) + len_k*sizeof(HKMERr);
-						v_c = 0;
-						if (len_l == 0)
-						{       break;  }
-					}
-				}
-				if (readDone)
-				{	v = v_c;}
-				else
-				{
-					if (v+c[i] >= LEN)
-					{ 
-						len_l = fread(lbl, sizeof(ILBL), LEN, fd_l);
-						len_k = fread(key, sizeof(HKMERr), LEN, fd_k);
-						_fileSize += len_l*sizeof(ILBL) + len_k*sizeof(HKMERr);
-						if (len_l == 0)
-						{       break;  }
-						v = v+c[i] - LEN;
-					}
-					else
-					{	v += c[i];}
-				}  
+				htCell<HKMERr, ELMTr>& cell = push(t);
+				cell.CKey = db.key(v);
+				cell.CElement.Label = db.label(v);
 			}
-			i++;
-			t++;
 		}
-		len = fread(c, 1, LEN, fd_s);
-		_fileSize += len;
-		i = 0;
-		if (len == 0)
-		{	break;	}
 	}
-	fclose(fd_l);
-	fclose(fd_k);
-	fclose(fd_s);
-
-	free(file_lbl); 
-	file_lbl=NULL;
-	free(file_key); 
-	file_key=NULL;
-	free(file_sze); 
-	file_sze=NULL;
-
-	return true;	
+	_fileSize = db.header().fileSize;
+	return true;
 }
-
@@ -0,0 +1,271 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * Sequential input from plain, gzip or zstd compressed files.
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "./inputFile.hh"
+
+using namespace std;
+
+InputFile::InputFile():
+	m_fd(-1),
+	m_compression(INPUT_PLAIN),
+	m_gz(NULL),
+	m_zstd(NULL),
+	m_zstdInPos(0),
+	m_zstdInSize(0),
+	m_zstdFrameOpen(false),
+	m_linePos(0),
+	m_lineEnd(0),
+	m_lineEof(false)
+{
+}
+
+InputFile::~InputFile()
+{
+	close();
+}
+
+/**
+ * Detect compression from the magic bytes of a file.
+ */
+int InputFile::compression(const char* _filename)
+{
+	uint8_t magic[4] = {0, 0, 0, 0};
+	int fd = ::open(_filename, O_RDONLY);
+	if (fd == -1)
+		return INPUT_PLAIN;
+	ssize_t n = ::read(fd, magic, 4);
+	::close(fd);
+
+	if (n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+		return INPUT_GZIP;
+	if (n == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd)
+		return INPUT_ZSTD;
+	return INPUT_PLAIN;
+}
+
+/**
+ * Open file, compressed files are decompressed while reading.
+ */
+bool InputFile::open(const char* _filename)
+{
+	close();
+
+	m_compression = compression(_filename);
+	m_fd = ::open(_filename, O_RDONLY);
+	if (m_fd == -1)
+		return false;
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+	m_linePos = m_lineEnd = 0;
+	m_lineEof = false;
+
+	if (m_compression == INPUT_GZIP)
+	{
+		// zlib takes care of the file descriptor, concatenated members are read as one stream
+		m_gz = gzdopen(m_fd, "rb");
+		m_fd = -1;
+		if (m_gz == NULL)
+			return false;
+		gzbuffer(m_gz, 1 << 20);
+	}
+	else if (m_compression == INPUT_ZSTD)
+	{
+#ifdef HAVE_ZSTD
+		m_zstd = ZSTD_createDCtx();
+		m_zstdIn.resize(ZSTD_DStreamInSize());
+		m_zstdInPos = m_zstdInSize = 0;
+		m_zstdFrameOpen = false;
+#else
+		cerr << "Failed to read " << _filename << ": zstd input is not supported by this build." << endl;
+		close();
+		return false;
+#endif
+	}
+	return true;
+}
+
+void InputFile::close()
+{
+	if (m_gz != NULL)
+		gzclose(m_gz);
+	m_gz = NULL;
+#ifdef HAVE_ZSTD
+	if (m_zstd != NULL)
+		ZSTD_freeDCtx((ZSTD_DCtx*) m_zstd);
+#endif
+	m_zstd = NULL;
+	if (m_fd != -1)
+		::close(m_fd);
+	m_fd = -1;
+}
+
+/**
+ * Read up to _size (decompressed) bytes.
+ * Returns less than _size only at end of file.
+ */
+size_t InputFile::read(uint8_t* _buffer, const size_t _size)
+{
+	size_t total = 0;
+	while (total < _size)
+	{
+		size_t n = 0;
+		if (m_compression == INPUT_GZIP)
+		{
+			size_t request = _size - total < (1u << 30) ? _size - total : (1u << 30);
+			int ret = gzread(m_gz, _buffer + total, (unsigned) request);
+			if (ret < 0)
+			{
+				int errnum;
+				cerr << "Failed to decompress the input file: " << gzerror(m_gz, &errnum) << endl;
+				exit(1);
+			}
+			n = ret;
+		}
+		else if (m_compression == INPUT_ZSTD)
+		{
+			n = readZstd(_buffer + total, _size - total);
+		}
+		else
+		{
+			ssize_t ret = ::read(m_fd, _buffer + total, _size - total);
+			if (ret < 0)
+			{
+				cerr << "Failed to read the input file." << endl;
+				exit(1);
+			}
+			n = ret;
+		}
+		if (n == 0)
+			break;
+		total += n;
+	}
+	return total;
+}
+
+/**
+ * Get next line without '\n'.
+ * The line stays valid until the next call, do not mix with read().
+ * Returns false at end of file.
+ */
+bool InputFile::readLine(const uint8_t* &_line, size_t& _length)
+{
+	if (m_lineBuffer.empty())
+		m_lineBuffer.resize(LINEBUFFERSIZE);
+
+	while (true)
+	{
+		uint8_t* begin = &m_lineBuffer[m_linePos];
+		uint8_t* end = (uint8_t*) memchr(begin, '\n', m_lineEnd - m_linePos);
+		if (end != NULL)
+		{
+			_line = begin;
+			_length = end - begin;
+			m_linePos += _length + 1;
+			return true;
+		}
+		if (m_lineEof)
+		{
+			// last line without '\n'
+			if (m_linePos == m_lineEnd)
+				return false;
+			_line = begin;
+			_length = m_lineEnd - m_linePos;
+			m_linePos = m_lineEnd;
+			return true;
+		}
+		// keep begin of line, grow buffer for long lines
+		size_t rest = m_lineEnd - m_linePos;
+		memmove(&m_lineBuffer[0], begin, rest);
+		m_linePos = 0;
+		m_lineEnd = rest;
+		if (m_lineBuffer.size() - rest < LINEBUFFERSIZE/2)
+			m_lineBuffer.resize(m_lineBuffer.size()*2);
+
+		size_t request = m_lineBuffer.size() - m_lineEnd;
+		size_t n = read(&m_lineBuffer[m_lineEnd], request);
+		m_lineEnd += n;
+		if (n < request)
+			m_lineEof = true;
+	}
+}
+
+/**
+ * Decompress zstd frames until _buffer is full or input ends.
+ */
+size_t InputFile::readZstd(uint8_t* _buffer, const size_t _size)
+{
+#ifdef HAVE_ZSTD
+	ZSTD_outBuffer out = {_buffer, _size, 0};
+	while (out.pos < out.size)
+	{
+		if (m_zstdInPos == m_zstdInSize)
+		{
+			ssize_t n = ::read(m_fd, &m_zstdIn[0], m_zstdIn.size());
+			if (n < 0)
+			{
+				cerr << "Failed to read the input file." << endl;
+				exit(1);
+			}
+			if (n == 0)
+			{
+				if (m_zstdFrameOpen)
+				{
+					cerr << "Failed to decompress the input file: truncated zstd frame." << endl;
+					exit(1);
+				}
+				break;
+			}
+			m_zstdInPos = 0;
+			m_zstdInSize = n;
+		}
+		ZSTD_inBuffer in = {&m_zstdIn[0], m_zstdInSize, m_zstdInPos};
+		size_t ret = ZSTD_decompressStream((ZSTD_DCtx*) m_zstd, &out, &in);
+		if (ZSTD_isError(ret))
+		{
+			cerr << "Failed to decompress the input file: " << ZSTD_getErrorName(ret) << endl;
+			exit(1);
+		}
+		m_zstdInPos = in.pos;
+		// 0 at the end of a frame, further frames may follow
+		m_zstdFrameOpen = ret != 0;
+	}
+	return out.pos;
+#else
+	return 0;
+#endif
+}
@@ -0,0 +1,82 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * Sequential input from plain, gzip or zstd compressed files.
+ * The compression is detected from the first bytes of the file.
+ * zstd requires building with HAVE_ZSTD (see Makefile).
+ */
+
+#ifndef INPUTFILE_HH
+#define INPUTFILE_HH
+
+#include <stdint.h>
+#include <vector>
+#include <zlib.h>
+
+#define INPUT_PLAIN	0
+#define INPUT_GZIP	1
+#define INPUT_ZSTD	2
+
+#define LINEBUFFERSIZE	(1 << 20)
+
+class InputFile
+{
+	private:
+		int						m_fd;
+		int						m_compression;
+		gzFile					m_gz;
+
+		// zstd stream state
+		void*					m_zstd;
+		std::vector<uint8_t>	m_zstdIn;
+		size_t					m_zstdInPos;
+		size_t					m_zstdInSize;
+		bool					m_zstdFrameOpen;
+
+		// buffered input for readLine
+		std::vector<uint8_t>	m_lineBuffer;
+		size_t					m_linePos;
+		size_t					m_lineEnd;
+		bool					m_lineEof;
+
+		size_t readZstd(uint8_t* _buffer, const size_t _size);
+
+	public:
+		InputFile();
+
+		~InputFile();
+
+		bool open(const char* _filename);
+
+		void close();
+
+		size_t read(uint8_t* _buffer, const size_t _size);
+
+		bool readLine(const uint8_t* &_line, size_t& _length);
+
+		static int compression(const char* _filename);
+};
+
+#endif
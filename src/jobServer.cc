@@ -0,0 +1,246 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * Job server for the persistent classification mode (--server).
+ */
+
+#include <iostream>
+#include <cstdio>
+#include <vector>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "./jobServer.hh"
+
+using namespace std;
+
+JobServer::JobServer(const char* _socketPath, const uint32_t _minimizerWindow):
+	m_socketPath(_socketPath),
+	m_listenFd(-1),
+	m_clientFd(-1),
+	m_minimizerWindow(_minimizerWindow)
+{
+}
+
+JobServer::~JobServer()
+{
+	close();
+}
+
+/**
+ * Create the socket and listen for clients.
+ * A stale socket file (no server answering) is replaced.
+ */
+bool JobServer::open()
+{
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (m_socketPath.size() >= sizeof(addr.sun_path))
+	{
+		cerr << "Socket path is too long: " << m_socketPath << endl;
+		return false;
+	}
+	strcpy(addr.sun_path, m_socketPath.c_str());
+
+	// clients closing early must not terminate the server
+	signal(SIGPIPE, SIG_IGN);
+
+	struct stat st;
+	if (stat(m_socketPath.c_str(), &st) == 0)
+	{
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		bool running = fd != -1 && connect(fd, (struct sockaddr*) &addr, sizeof(addr)) == 0;
+		if (fd != -1)
+			::close(fd);
+		if (running)
+		{
+			cerr << "A server is already running on " << m_socketPath << endl;
+			return false;
+		}
+		if (!S_ISSOCK(st.st_mode))
+		{
+			cerr << "Failed to create socket: " << m_socketPath << " exists and is not a socket." << endl;
+			return false;
+		}
+		unlink(m_socketPath.c_str());
+	}
+
+	m_listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (m_listenFd == -1 || bind(m_listenFd, (struct sockaddr*) &addr, sizeof(addr)) != 0 || listen(m_listenFd, 16) != 0)
+	{
+		cerr << "Failed to create socket " << m_socketPath << ": " << strerror(errno) << endl;
+		if (m_listenFd != -1)
+			::close(m_listenFd);
+		m_listenFd = -1;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Stop listening and remove the socket file.
+ */
+void JobServer::close()
+{
+	if (m_clientFd != -1)
+		::close(m_clientFd);
+	m_clientFd = -1;
+	if (m_listenFd != -1)
+	{
+		::close(m_listenFd);
+		unlink(m_socketPath.c_str());
+	}
+	m_listenFd = -1;
+}
+
+/**
+ * Wait for the next classification job.
+ * PING requests and invalid requests are answered here.
+ * Returns false when a STOP request was received.
+ */
+bool JobServer::nextJob(ServerJob& _job)
+{
+	while (m_listenFd != -1)
+	{
+		if (m_clientFd != -1)
+			reply(false, "no result");
+
+		m_clientFd = accept(m_listenFd, NULL, NULL);
+		if (m_clientFd == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			cerr << "Failed to accept client: " << strerror(errno) << endl;
+			return false;
+		}
+		// a client that sends nothing does not block the server
+		struct timeval timeout;
+		timeout.tv_sec = JOBREQUESTTIMEOUT;
+		timeout.tv_usec = 0;
+		setsockopt(m_clientFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		setsockopt(m_clientFd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+		string request;
+		if (!readRequest(request))
+		{
+			reply(false, errno == EAGAIN || errno == EWOULDBLOCK ? "request timed out" : "invalid request");
+			continue;
+		}
+
+		vector<string> fields;
+		size_t begin = 0, end;
+		while ((end = request.find('\t', begin)) != string::npos)
+		{
+			fields.push_back(request.substr(begin, end - begin));
+			begin = end + 1;
+		}
+		fields.push_back(request.substr(begin));
+
+		if (fields[0] == "PING")
+		{
+			char status[32];
+			snprintf(status, sizeof(status), "minimizer %u", m_minimizerWindow);
+			reply(true, status);
+			continue;
+		}
+		if (fields[0] == "STOP")
+		{
+			reply(true);
+			return false;
+		}
+		if (fields[0] != "CLASSIFY" || fields.size() != 5 || fields[1].empty() || fields[3].empty())
+		{
+			reply(false, "invalid request");
+			continue;
+		}
+		if (access(fields[1].c_str(), R_OK) != 0)
+		{
+			reply(false, "failed to find/read " + fields[1]);
+			continue;
+		}
+		if (!fields[2].empty() && access(fields[2].c_str(), R_OK) != 0)
+		{
+			reply(false, "failed to find/read " + fields[2]);
+			continue;
+		}
+		_job.objects	= fields[1];
+		_job.objects2	= fields[2];
+		_job.results	= fields[3];
+		_job.extended	= fields[4] == "1" || fields[4] == "2";
+		_job.sparse		= fields[4] == "2";
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Answer the current client and close the connection.
+ */
+void JobServer::reply(const bool _success, const string& _message)
+{
+	if (m_clientFd == -1)
+		return;
+	string line = _success ? "OK" : "ERROR";
+	if (!_message.empty())
+		line += " " + _message;
+	line += "\n";
+	send(m_clientFd, line.c_str(), line.size(), MSG_NOSIGNAL);
+	::close(m_clientFd);
+	m_clientFd = -1;
+}
+
+/**
+ * Read one request line from the current client.
+ * On failure, errno is EAGAIN or EWOULDBLOCK if the client timed out.
+ */
+bool JobServer::readRequest(string& _request)
+{
+	_request.clear();
+	errno = 0;
+	char buffer[4096];
+	while (_request.size() < JOBREQUESTMAX)
+	{
+		ssize_t n = recv(m_clientFd, buffer, sizeof(buffer), 0);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		_request.append(buffer, n);
+		size_t end = _request.find('\n');
+		if (end != string::npos)
+		{
+			_request.resize(end);
+			return true;
+		}
+	}
+	return false;
+}
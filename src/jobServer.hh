@@ -0,0 +1,81 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * Job server for the persistent classification mode (--server).
+ * The database is loaded once, jobs are received over a Unix socket
+ * and processed one after another.
+ *
+ * Protocol: one request line per connection, fields separated by tabs,
+ * answered by one line "OK" or "ERROR <message>". A client that does not
+ * send its request line in JOBREQUESTTIMEOUT seconds is answered with an
+ * error, so that it does not block the next jobs.
+ *   CLASSIFY <objects> <objects2 or empty> <results> <extended 0|1|2, 2 sparse>
+ *   PING		answered by "OK minimizer <w>", the window of the database minimizers (0: all k-mers)
+ *   STOP
+ */
+
+#ifndef JOBSERVER_HH
+#define JOBSERVER_HH
+
+#include <string>
+#include <stdint.h>
+
+#define JOBREQUESTMAX	(1 << 16)	// maximum length of a request line
+#define JOBREQUESTTIMEOUT	10		// seconds for a client to send its request line
+
+struct ServerJob
+{
+	std::string		objects;
+	std::string		objects2;		// empty for single-end reads
+	std::string		results;
+	bool			extended;
+	bool			sparse;			// extended results with the targets hit only
+};
+
+class JobServer
+{
+	private:
+		std::string		m_socketPath;
+		int				m_listenFd;
+		int				m_clientFd;
+		uint32_t		m_minimizerWindow;	// of the database, for the clients to check their jobs
+
+		bool readRequest(std::string& _request);
+
+	public:
+		JobServer(const char* _socketPath, const uint32_t _minimizerWindow = 0);
+
+		~JobServer();
+
+		bool open();
+
+		void close();
+
+		bool nextJob(ServerJob& _job);
+
+		void reply(const bool _success, const std::string& _message = "");
+};
+
+#endif
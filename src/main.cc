@@ -26,6 +26,18 @@
  * 
  * Changes:
  * Deprecated some parameters and added new parameters.
+ * Host (CPU) query backend, selected by --cpu or if no CUDA device is found.
+ * Size of input chunks (--chunk-size).
+ * Server mode (--server), the database is loaded once for many jobs.
+ * Hash-table size set at runtime (--ht-size) or found from the database directory.
+ * Out-of-core database creation (--build-memory).
+ * Incremental database update when targets are added or removed (--update).
+ * Minimizer-sampled database and queries (--minimizer).
+ * Prefilter of the database k-mers for the host backend (--prefilter).
+ * Interleaved keys and labels in the database (--interleaved).
+ * Bit-packed keys and labels in the database (--packed).
+ * Number of batches chosen from the input and the memory (-b auto, --mem-budget).
+ * Sparse extended results (--sparse).
  */
 
 #include<iostream>
@@ -33,9 +45,13 @@
 #include<stdio.h>
 #include<cmath>
 #include<fstream>
+#include<dirent.h>
 
 #include "./CuCLARK_hh.hh"
 #include "./parameters.hh"
+#include "./jobServer.hh"
+#include "./minimizer.hh"
+#include "./batchPlan.hh"
 #define MAXK 32
 
 using namespace std;
@@ -56,8 +72,21 @@ void printUsage()
 	cout << "-P <file1> <file2>,  \t filenames of paired-end reads:\t texts.\n";
 	cout << "-R <fileResults>,    \t filename to store results (or corresponding list of results file):\t text.\n";
 	cout << "-n <numberofthreads>,\t number of threads:\tinteger >= 1.\n";
-	cout << "-b <numberofbatches>,\t number of batches:\tinteger >= 1.\n";
+	cout << "-b <numberofbatches>,\t number of batches:\tinteger >= 1, or 'auto' to choose it from the reads and the memory (device memory reserved for batches, host memory budget).\n";
 	cout << "-d <numberofdevices>,\t number of CUDA devices to use:\tinteger >= 1.\n";
+	cout << "--ht-size <buckets>, \t number of buckets of the database hash table:\tinteger >= 1. By default, the size of the existing database is used, otherwise " << HTSIZE << ".\n";
+	cout << "--build-memory <MB>,\t to create the database out of core, with sorted runs of k-mers in the database directory and about this memory for k-mers, in MB:\tinteger >= 1. By default, the database is created in memory.\n";
+	cout << "--minimizer <w>,     \t to keep in the database and to query only the minimizers of windows of w consecutive k-mers, for a database and lookups about w/2 times smaller; reads of fewer than w k-mers are not classified, and the hit rate (Gamma) is the share of the minimizers queried that hit:\tinteger in [2," << MINIMIZERMAXW << "]. By default, all k-mers are used.\n";
+	cout << "--interleaved,       \t to store the label of each k-mer next to its key when the database is created, so that a hit reads one cache line instead of two. Databases of any layout are read.\n";
+	cout << "--packed,            \t to store the keys and labels of the database with the bits they need (k-mer quotients of the hash-table size and target numbers) when the database is created, for a smaller database decoded at each lookup. Databases of any layout are read.\n";
+	cout << "--update,            \t to keep the k-mer occurrences of the targets next to the database (.occ file), and to update the database from them when targets are added, removed or changed, reading only the new target files.\n";
+	cout << "--chunk-size <MB>,   \t size of input chunks read and classified at a time, in MB:\tinteger >= 1. The default value is " << CHUNKSIZE << ".\n";
+	cout << "--mem-budget <MB>,   \t host memory for the reads and results of a chunk with -b auto, in MB, chunks are made smaller if needed:\tinteger >= 1. By default, half of the available memory.\n";
+	cout << "--prefilter,         \t to check the k-mers of the reads with a compact filter of the database (about 2 bytes per k-mer, built at the first run and saved next to the database) before the lookups, when querying on the host (CPU).\n";
+	cout << "--cpu,               \t to query the database on the host (CPU) instead of CUDA devices. Used by default if no CUDA device is found.\n";
+	cout << "--extended,          \t to request an extended output for the results file, with the score of each target.\n";
+	cout << "--sparse,            \t to request an extended output with the targets hit only, as target:score pairs (cf. sparseToDense for the extended output).\n";
+	cout << "--server <socket>,   \t to keep the database loaded and classify jobs received on the Unix socket (cf. README file), instead of -O/-P and -R.\n";
 	cout << "--tsk,               \t to request a detailed creation of the database (target specific k-mers files).\n";
 	cout << "-g <iteration>,      \t gap or number of non-overlapping k-mers to pass for the database creation (for CuCLARK-l only). The default value is 4.\n";
 	cout << "-s <factor>,         \t sampling factor value (for CuCLARK only).\n";
@@ -68,6 +97,79 @@ void printUsage()
 	return;
 }
 
+/**
+ * Find the hash-table size of the databases in _folder built with the given parameters.
+ * Returns 0 if there is none, exits if several sizes are found.
+ */
+uint64_t findHtSize(const string& _folder, const size_t _k, const ITYPE _minT, const bool _light, const size_t _iterKmers, const size_t _minimizerWindow)
+{
+	DIR* dir = opendir(_folder.c_str());
+	if (dir == NULL)
+	{	return 0;	}
+
+	uint64_t htSize = 0;
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		unsigned long k, targets, size, minT, iterKmers, minimizerWindow;
+		int pos = 0;
+		const char* name = entry->d_name;
+		if (sscanf(name, "db_central_k%lu_t%lu_s%lu_m%lu%n", &k, &targets, &size, &minT, &pos) < 4 || pos == 0)
+		{	continue;	}
+		name += pos;
+		if (_light)
+		{
+			pos = 0;
+			if (sscanf(name, "_light_%lu%n", &iterKmers, &pos) < 1 || pos == 0 || iterKmers != _iterKmers)
+			{	continue;	}
+			name += pos;
+		}
+		if (_minimizerWindow > 0)
+		{
+			pos = 0;
+			if (sscanf(name, "_w%lu%n", &minimizerWindow, &pos) < 1 || pos == 0 || minimizerWindow != _minimizerWindow)
+			{	continue;	}
+			name += pos;
+		}
+		if (k != _k || minT != _minT || (strcmp(name, ".tsk.db") != 0 && strcmp(name, ".tsk.sz") != 0))
+		{	continue;	}
+		if (htSize != 0 && htSize != size)
+		{
+			cerr << "Databases with different hash-table sizes (" << htSize << ", " << size << ") found in " << _folder << ", please specify one with --ht-size." << endl;
+			exit(1);
+		}
+		htSize = size;
+	}
+	closedir(dir);
+	return htSize;
+}
+
+/**
+ * Classify jobs received by the server until it is stopped.
+ */
+template <typename HKMERr>
+int serveJobs(CuCLARK<HKMERr>& _classifier, const char* _socketPath, const ITYPE& _minCountO, const uint32_t _minimizerWindow)
+{
+	JobServer server(_socketPath, _minimizerWindow);
+	if (!server.open())
+		return 1;
+	cerr << "Database loaded, waiting for jobs on " << _socketPath << endl;
+
+	ServerJob job;
+	while (server.nextJob(job))
+	{
+		bool success;
+		if (job.objects2.empty())
+			success = _classifier.run(job.objects.c_str(), job.results.c_str(), _minCountO, job.extended, job.sparse);
+		else
+			success = _classifier.run(job.objects.c_str(), job.objects2.c_str(), job.results.c_str(), _minCountO, job.extended, job.sparse);
+		server.reply(success, success ? "" : "classification failed");
+	}
+	server.close();
+	cerr << "Server stopped." << endl;
+	return 0;
+}
+
 int main(int argc, char** argv)
 {
 	// check number of arguments
@@ -94,10 +196,18 @@ int main(int argc, char** argv)
 	// set default parameters
 	size_t k = 31, cpu = 1, iterKmers = 0;
 	ITYPE minT = 0, minO = 0, sfactor = 1;
-	bool cLightDB = false, tsk = false, ext = false, verbose = false;
-	int i_targets = -1, i_objects = -1, i_objects2 = -1, i_folder=-1, i_results =-1;
+	bool cLightDB = false, tsk = false, ext = false, sparse = false, verbose = false, useCpu = false;
+	int i_targets = -1, i_objects = -1, i_objects2 = -1, i_folder=-1, i_results =-1, i_socket = -1;
 	
-	size_t batches = 1, dbParts = 1, devices = 0;
+	size_t batches = 1, dbParts = 1, devices = 0, chunkSize = CHUNKSIZE;
+	bool autoBatches = false;
+	size_t memBudget = 0;
+	uint64_t htSize = 0;
+	size_t buildMemory = 0;
+	bool update = false;
+	uint32_t minimizerWindow = 0;
+	bool prefilter = false;
+	DbLayout layout = DBSPLIT;
 
 	// parse arguments
 	for(size_t i = 1; i < argc ; i++)
@@ -132,6 +242,10 @@ int main(int argc, char** argv)
         {
             ext = true; continue;
         }
+		if (val ==   "--sparse")
+		{
+			ext = true; sparse = true; continue;
+		}
 		if (val ==  "-T")
 		{
 			if (i++ >= argc) {cerr << "Please specify the targets!"<< endl; exit(1);    }
@@ -188,6 +302,9 @@ int main(int argc, char** argv)
         if (val == "-b")
         {
 			if (i++ >= argc) {cerr << "Please specify the number of batches!"<< endl; exit(1);    }
+			autoBatches = string(argv[i]) == "auto";
+			if (autoBatches)
+				continue;
 			batches =  atoi(argv[i]);
 			if (batches < cpu)
 			{	cerr << "The number of batches should be higher than the number of threads."<< endl; exit(1);    }
@@ -205,32 +322,95 @@ int main(int argc, char** argv)
 		{
 			verbose = true; continue;
 		}
+		if (val == "--chunk-size")
+		{
+			if (i++ >= argc) {cerr << "Please specify the chunk size!"<< endl; exit(1);    }
+			chunkSize =  atoi(argv[i]);
+			if (chunkSize < 1)
+			{	cerr << "The chunk size should be higher than 0."<< endl; exit(1);    }
+			continue;
+		}
+		if (val == "--mem-budget")
+		{
+			if (i++ >= argc) {cerr << "Please specify the memory budget!"<< endl; exit(1);    }
+			memBudget =  atoi(argv[i]);
+			if (memBudget < 1)
+			{	cerr << "The memory budget should be higher than 0."<< endl; exit(1);    }
+			continue;
+		}
+		if (val == "--ht-size")
+		{
+			if (i++ >= argc) {cerr << "Please specify the hash-table size!"<< endl; exit(1);    }
+			htSize =  strtoull(argv[i], NULL, 10);
+			if (htSize < 1 || htSize > UINT32_MAX)
+			{	cerr << "The hash-table size should be in [1," << UINT32_MAX << "]." << endl; exit(1);    }
+			continue;
+		}
+		if (val == "--build-memory")
+		{
+			if (i++ >= argc) {cerr << "Please specify the memory for the database creation!"<< endl; exit(1);    }
+			buildMemory =  atoi(argv[i]);
+			if (buildMemory < 1)
+			{	cerr << "The memory for the database creation should be higher than 0."<< endl; exit(1);    }
+			continue;
+		}
+		if (val == "--update")
+		{
+			update = true; continue;
+		}
+		if (val == "--minimizer")
+		{
+			if (i++ >= argc) {cerr << "Please specify the window of the minimizers!"<< endl; exit(1);    }
+			minimizerWindow =  atoi(argv[i]);
+			if (minimizerWindow < 2 || minimizerWindow > MINIMIZERMAXW)
+			{	cerr << "The window of the minimizers should be in [2," << MINIMIZERMAXW << "]." << endl; exit(1);    }
+			continue;
+		}
+		if (val == "--prefilter")
+		{
+			prefilter = true; continue;
+		}
+		if (val == "--interleaved")
+		{
+			layout = DBINTERLEAVED; continue;
+		}
+		if (val == "--packed")
+		{
+			layout = DBPACKED; continue;
+		}
+		if (val == "--cpu")
+		{
+			useCpu = true; continue;
+		}
+		if (val == "--server")
+		{
+			if (i++ >= argc) {cerr << "Please specify the socket of the server!"<< endl; exit(1);    }
+			i_socket =  i;
+			continue;
+		}
 		//
 
 		cerr << "Failed to recognize option: " << val << endl;
 		exit(1);
 	}
 	
-	if (HTSIZE == LHTSIZE)
-	{	// CuCLARK-l
-		cLightDB = true; 
-		if (iterKmers == 0)
-		{ 	iterKmers = 4 ;}
-	 	k = 27;
-		if (cLightDB)
-		{	sfactor = 1;}
-	}
-	else
-	{
-		iterKmers = 0;
-	}
+#ifdef LIGHTVERSION
+	// CuCLARK-l
+	cLightDB = true; 
+	if (iterKmers == 0)
+	{ 	iterKmers = 4 ;}
+ 	k = 27;
+	sfactor = 1;
+#else
+	iterKmers = 0;
+#endif
 	if (k == 0) // should never occur because of the code above
 	{
 		cerr << "Please specify a k-mers length: -k <integer>" << endl;
 		exit(1);
 	}
 	// check for sufficient parameters
-	if ( i_targets < 0 || i_folder < 0 || i_objects < 0 ||  i_results < 0)
+	if ( i_targets < 0 || i_folder < 0 || (i_socket < 0 && (i_objects < 0 ||  i_results < 0)))
 	{
 		cerr << "Failed to run " << argv[0] << ": at least four  parameters are necessary" ;
 		cerr << ": file of targets, directory of database, file of objects, file for results."<< endl;
@@ -246,9 +426,44 @@ int main(int argc, char** argv)
 	if (folder[folder.size()-1] != '/')
 	{	folder.push_back('/');	}
 	
+#ifdef CPUONLY
+	useCpu = true;
+#else
+	if (!useCpu && getCudaDeviceCount() == 0)
+	{
+		cerr << "No CUDA device found, querying on the host (CPU)." << endl;
+		useCpu = true;
+	}
+#endif
+	if (useCpu && devices > 0 && verbose)
+	{	cerr << "Option -d is ignored when querying on the host (CPU)." << endl;	}
+	if (!useCpu && prefilter)
+	{	cerr << "Option --prefilter is ignored when querying on CUDA devices." << endl;	}
+	if (!autoBatches && memBudget > 0 && verbose)
+	{	cerr << "Option --mem-budget is ignored without -b auto." << endl;	}
+
+	if (autoBatches)
+	{
+		InputSample sample;
+		sampleInput(objects, objects2, sample);
+		// the server's jobs may have extended output
+		BatchPlan plan = planBatches(sample, cpu, chunkSize << 20, useCpu, ext || i_socket > 0, memBudget << 20);
+		if (verbose)
+		{	printBatchPlan(sample, plan);	}
+		batches = plan.batches;
+		chunkSize = plan.chunkSize >> 20;
+	}
+
+	if (htSize == 0)
+	{	htSize = findHtSize(folder, k, minT, cLightDB, iterKmers, minimizerWindow);	}
+	if (htSize == 0)
+	{	htSize = HTSIZE;	}
+	if (verbose)
+	{	cerr << "Hash-table size: " << htSize << endl;	}
+
 	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	
-	size_t t_b = log(HTSIZE)/log(4.0);	// 15 for (Cu)CLARK, 12 for (Cu)CLARK-l
+	size_t t_b = log(htSize)/log(4.0);	// 15 for (Cu)CLARK, 12 for (Cu)CLARK-l
 	size_t max16 = t_b + 8;				// 23 for (Cu)CLARK, 20 for (Cu)CLARK-l
 	size_t max32 = t_b + 16;			// 31 for (Cu)CLARK, 28 for (Cu)CLARK-l
 	
@@ -257,31 +472,37 @@ int main(int argc, char** argv)
 	if (k <= max16)
 	{
 		// Use 2Bytes to store each discriminative k-mer
-		CuCLARK<T16> classifier(k, argv[i_targets], folder.c_str(), minT, tsk, cLightDB, iterKmers, cpu, sfactor, batches, devices, verbose);
+		CuCLARK<T16> classifier(k, argv[i_targets], folder.c_str(), minT, tsk, cLightDB, iterKmers, cpu, sfactor, batches, devices, verbose, useCpu, chunkSize << 20, htSize, buildMemory << 20, update, minimizerWindow, prefilter, layout);
+		if (i_socket > 0)
+			exit(serveJobs(classifier, argv[i_socket], minO, minimizerWindow));
 		if (paired)
-			classifier.run(objects, objects2, argv[i_results], minO, ext);
+			classifier.run(objects, objects2, argv[i_results], minO, ext, sparse);
 		else
-			classifier.run(objects, argv[i_results], minO, ext);
+			classifier.run(objects, argv[i_results], minO, ext, sparse);
 		exit(0);
 	}
 	if (k <= max32)
 	{
 		// Use 4Bytes to store each discriminative k-mer
-		CuCLARK<T32> classifier(k, argv[i_targets], folder.c_str(), minT, tsk, cLightDB, iterKmers, cpu, sfactor, batches, devices, verbose);
+		CuCLARK<T32> classifier(k, argv[i_targets], folder.c_str(), minT, tsk, cLightDB, iterKmers, cpu, sfactor, batches, devices, verbose, useCpu, chunkSize << 20, htSize, buildMemory << 20, update, minimizerWindow, prefilter, layout);
+		if (i_socket > 0)
+			exit(serveJobs(classifier, argv[i_socket], minO, minimizerWindow));
 		if (paired)
-			classifier.run(objects, objects2, argv[i_results], minO, ext);
+			classifier.run(objects, objects2, argv[i_results], minO, ext, sparse);
 		else
-			classifier.run(objects, argv[i_results], minO, ext);
+			classifier.run(objects, argv[i_results], minO, ext, sparse);
 		exit(0);
 	}
 	if (k <= MAXK)
 	{
 		// Use 8Bytes to store each discriminative k-mer
-		CuCLARK<T64> classifier(k, argv[i_targets], folder.c_str(), minT, tsk, cLightDB, iterKmers, cpu, sfactor, batches, devices, verbose);
+		CuCLARK<T64> classifier(k, argv[i_targets], folder.c_str(), minT, tsk, cLightDB, iterKmers, cpu, sfactor, batches, devices, verbose, useCpu, chunkSize << 20, htSize, buildMemory << 20, update, minimizerWindow, prefilter, layout);
+		if (i_socket > 0)
+			exit(serveJobs(classifier, argv[i_socket], minO, minimizerWindow));
 		if (paired)
-			classifier.run(objects, objects2, argv[i_results], minO, ext);
+			classifier.run(objects, objects2, argv[i_results], minO, ext, sparse);
 		else
-			classifier.run(objects, argv[i_results], minO, ext);
+			classifier.run(objects, argv[i_results], minO, ext, sparse);
 		exit(0);
 	}
 	std::cout <<"This version of CuCLARK does not support k-mer length strictly higher than " << MAXK << std::endl;
@@ -0,0 +1,363 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * Merge of two databases built with the same k-mer length and hash-table
+ * size, without reading the targets again.
+ *
+ * The targets definition of the merged database is the targets of the
+ * first database followed by the targets of the second one. Labels are
+ * numbered as cuCLARK numbers them for this file, the labels of both
+ * databases are mapped to it by name. The buckets of both databases are
+ * merged key by key: a k-mer of both databases is kept if it has the same
+ * label in both, and removed as not specific otherwise. The merged
+ * database has the layout (split, interleaved or packed) of the first one.
+ *
+ * K-mers removed as common to several targets of one database are not
+ * known any more, if such a k-mer is specific in the other database, it
+ * is kept in the merged database where a full creation would remove it.
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+#include "./file.hh"
+#include "./dbFile.hh"
+
+#define MERGEBUCKETS	(1 << 22)	// buckets per range merged by one thread
+
+/**
+ * Targets definition: lines as read, and labels numbered as in cuCLARK,
+ * labels first, then labels of centromeres.
+ */
+struct TargetsDef
+{
+	std::vector<std::string>	lines;
+	std::vector<std::string>	labels;
+	std::vector<std::string>	labels_c;
+
+	void add(const std::string& _line)
+	{
+		vector<string> ele;
+		getElementsFromLine(_line, 3, ele);
+		if (ele.size() == 0)
+			return;
+		lines.push_back(_line);
+		if (ele.size() > 1 && find(ele[1], labels) == labels.size())
+			labels.push_back(ele[1]);
+		if (ele.size() > 2 && find(ele[2], labels_c) == labels_c.size())
+			labels_c.push_back(ele[2]);
+	}
+
+	size_t numLabels() const
+	{	return labels.size() + labels_c.size();	}
+
+	const std::string& label(const size_t _l) const
+	{	return _l < labels.size() ? labels[_l] : labels_c[_l - labels.size()];	}
+
+	// number of a label, numLabels() if not found
+	size_t index(const std::string& _label, const bool _centromere) const
+	{
+		if (_centromere)
+			return labels.size() + find(_label, labels_c);
+		return find(_label, labels);
+	}
+
+	static size_t find(const std::string& _label, const std::vector<std::string>& _labels)
+	{
+		size_t t = 0;
+		while (t < _labels.size() && _labels[t] != _label)
+			t++;
+		return t;
+	}
+};
+
+static bool readTargets(const char* _filename, TargetsDef& _targets)
+{
+	FILE* fd = fopen(_filename, "r");
+	if (fd == NULL)
+	{
+		cerr << "Failed to open targets data in file: " << _filename << endl;
+		return false;
+	}
+	string line;
+	while (getLineFromFile(fd, line))
+		_targets.add(line);
+	fclose(fd);
+	return true;
+}
+
+/**
+ * Labels of a database in the numbering of the merged targets,
+ * the last one for no label.
+ */
+static std::vector<ILBL> mapLabels(const TargetsDef& _targets, const TargetsDef& _merged)
+{
+	std::vector<ILBL> map(_targets.numLabels() + 1);
+	for (size_t l = 0; l < _targets.numLabels(); l++)
+		map[l] = _merged.index(_targets.label(l), l >= _targets.labels.size());
+	map[_targets.numLabels()] = _merged.numLabels();
+	return map;
+}
+
+/**
+ * Database to merge, its keys are read in place.
+ */
+struct MergeInput
+{
+	DbFile				db;
+	std::vector<ILBL>	labels;
+
+	uint64_t key(const uint64_t _i) const
+	{	return db.key(_i);	}
+
+	ILBL label(const uint64_t _i) const
+	{
+		const ILBL label = db.label(_i);
+		return labels[label < labels.size() ? label : labels.size() - 1];
+	}
+};
+
+/**
+ * Merged buckets of a range, or only counts if not kept.
+ */
+struct MergedRange
+{
+	uint64_t				begin;
+	uint64_t				end;
+	uint64_t				numElements;
+	uint64_t				numRemoved;
+	std::vector<uint32_t>	sizes;
+	std::vector<uint64_t>	keys;
+	std::vector<ILBL>		labels;
+};
+
+static void mergeRange(const MergeInput& _a, const MergeInput& _b, MergedRange& _range, const bool _keep)
+{
+	_range.numElements = 0;
+	_range.numRemoved = 0;
+	_range.sizes.clear();
+	_range.keys.clear();
+	_range.labels.clear();
+
+	uint64_t ia = _a.db.offset(_range.begin), ib = _b.db.offset(_range.begin);
+	for (uint64_t bucket = _range.begin; bucket < _range.end; bucket++)
+	{
+		const uint64_t ea = ia + _a.db.size(bucket), eb = ib + _b.db.size(bucket);
+		uint32_t size = 0;
+		while (ia < ea || ib < eb)
+		{
+			uint64_t key;
+			ILBL label;
+			const uint64_t ka = ia < ea ? _a.key(ia) : 0, kb = ib < eb ? _b.key(ib) : 0;
+			if (ib == eb || (ia < ea && ka < kb))
+			{
+				key = ka;
+				label = _a.label(ia++);
+			}
+			else if (ia == ea || kb < ka)
+			{
+				key = kb;
+				label = _b.label(ib++);
+			}
+			else
+			{	// in both databases, specific only with the same label
+				key = ka;
+				label = _a.label(ia++);
+				if (label != _b.label(ib++))
+				{
+					_range.numRemoved++;
+					continue;
+				}
+			}
+			size++;
+			if (_keep)
+			{
+				_range.keys.push_back(key);
+				_range.labels.push_back(label);
+			}
+		}
+		_range.numElements += size;
+		if (_keep)
+			_range.sizes.push_back(size);
+	}
+}
+
+/**
+ * Merged database name, from the name of the first database
+ * with the number of targets of the merged one.
+ */
+static std::string mergedName(const char* _output, const char* _first, const size_t _numTargets)
+{
+	struct stat st;
+	if (stat(_output, &st) != 0 || !S_ISDIR(st.st_mode))
+		return _output;
+
+	string name(_first);
+	name = name.substr(name.rfind('/') == string::npos ? 0 : name.rfind('/') + 1);
+	size_t t = name.find("_t");
+	size_t s = name.find('_', t + 2);
+	if (t != string::npos && s != string::npos)
+	{
+		char numTargets[32];
+		sprintf(numTargets, "_t%lu", _numTargets);
+		name = name.substr(0, t) + numTargets + name.substr(s);
+	}
+	return string(_output) + "/" + name;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 7)
+	{
+		cerr << "Usage: " << argv[0] << " <targets 1> <database 1> <targets 2> <database 2> <merged targets> <merged database>" << endl;
+		cerr << "Databases are database files (.db). If the merged database is a directory, the file is named" << endl;
+		cerr << "as the first database with the number of targets of the merged one." << endl;
+		exit(1);
+	}
+
+	TargetsDef targets[2], merged;
+	MergeInput inputs[2];
+	for (int d = 0; d < 2; d++)
+	{
+		if (!readTargets(argv[1 + 2*d], targets[d]) || !inputs[d].db.open(argv[2 + 2*d]))
+			exit(-1);
+		if (inputs[d].db.header().numTargets != targets[d].numLabels())
+		{
+			cerr << "The database " << argv[2 + 2*d] << " has " << inputs[d].db.header().numTargets
+				 << " targets, " << argv[1 + 2*d] << " defines " << targets[d].numLabels() << "." << endl;
+			exit(-1);
+		}
+	}
+	const DbHeader& h = inputs[0].db.header();
+	const DbHeader& h2 = inputs[1].db.header();
+	if (h.k != h2.k || h.keyBytes != h2.keyBytes || h.htSize != h2.htSize || h.samplingFactor != h2.samplingFactor)
+	{
+		cerr << "The databases do not have the same settings:"
+			 << " k=" << h.k << "/" << h2.k << ","
+			 << " key size " << h.keyBytes << "/" << h2.keyBytes << ","
+			 << " hash-table size " << h.htSize << "/" << h2.htSize << ","
+			 << " sampling factor " << h.samplingFactor << "/" << h2.samplingFactor << "." << endl;
+		exit(-1);
+	}
+
+	for (int d = 0; d < 2; d++)
+	{
+		for (size_t l = 0; l < targets[d].lines.size(); l++)
+			merged.add(targets[d].lines[l]);
+	}
+	if (merged.numLabels() > MTRGTS)
+	{
+		cerr << "The merged database has " << merged.numLabels() << " targets, at most " << MTRGTS << " are supported." << endl;
+		exit(-1);
+	}
+	for (int d = 0; d < 2; d++)
+		inputs[d].labels = mapLabels(targets[d], merged);
+
+	// count the elements to place the sections of the merged database
+	std::vector<MergedRange> ranges((h.htSize + MERGEBUCKETS - 1) / MERGEBUCKETS);
+	for (size_t r = 0; r < ranges.size(); r++)
+	{
+		ranges[r].begin = r * MERGEBUCKETS;
+		ranges[r].end = std::min<uint64_t>(ranges[r].begin + MERGEBUCKETS, h.htSize);
+	}
+	uint64_t numElements = 0, numRemoved = 0;
+	#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic) reduction(+:numElements,numRemoved)
+	#endif
+	for (size_t r = 0; r < ranges.size(); r++)
+	{
+		mergeRange(inputs[0], inputs[1], ranges[r], false);
+		numElements += ranges[r].numElements;
+		numRemoved += ranges[r].numRemoved;
+	}
+
+	const string dbFilename = mergedName(argv[6], argv[2], merged.numLabels());
+	cerr << "Merging " << h.numElements << " and " << h2.numElements << " " << h.k << "-mers into "
+		 << dbFilename << ": " << numElements << " " << h.k << "-mers, " << numRemoved
+		 << " found in both databases with different targets removed." << endl;
+
+	FILE* fd = fopen(argv[5], "w");
+	if (fd == NULL)
+	{
+		cerr << "Failed to create " << argv[5] << endl;
+		exit(-1);
+	}
+	for (size_t l = 0; l < merged.lines.size(); l++)
+		fprintf(fd, "%s\n", merged.lines[l].c_str());
+	if (fclose(fd) != 0)
+	{
+		cerr << "Failed to write " << argv[5] << endl;
+		exit(-1);
+	}
+
+	// ranges merged in parallel, written in order
+	DbWriter writer;
+	if (!writer.open(dbFilename.c_str(), h.k, h.keyBytes, h.htSize, merged.numLabels(), numElements, h.samplingFactor, dbLayout(h)))
+		exit(-1);
+#ifdef _OPENMP
+	const size_t numThreads = omp_get_max_threads();
+#else
+	const size_t numThreads = 1;
+#endif
+	for (size_t first = 0; first < ranges.size(); first += numThreads)
+	{
+		const size_t last = std::min(first + numThreads, ranges.size());
+		#ifdef _OPENMP
+		#pragma omp parallel for schedule(dynamic)
+		#endif
+		for (size_t r = first; r < last; r++)
+			mergeRange(inputs[0], inputs[1], ranges[r], true);
+
+		for (size_t r = first; r < last; r++)
+		{
+			size_t i = 0;
+			for (size_t b = 0; b < ranges[r].sizes.size(); b++)
+			{
+				for (uint32_t u = 0; u < ranges[r].sizes[b]; u++, i++)
+					writer.add(&ranges[r].keys[i], ranges[r].labels[i]);
+				writer.endBucket();
+			}
+			std::vector<uint32_t>().swap(ranges[r].sizes);
+			std::vector<uint64_t>().swap(ranges[r].keys);
+			std::vector<ILBL>().swap(ranges[r].labels);
+		}
+	}
+	if (!writer.close())
+		exit(-1);
+
+	cerr << "Merged targets written to " << argv[5] << " (" << merged.numLabels() << " targets)." << endl;
+	return 0;
+}
@@ -0,0 +1,158 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * (w,k)-minimizers of sequences (--minimizer <w>).
+ *
+ * Of each window of w consecutive k-mers of a sequence, the minimizer is
+ * the k-mer of lowest order, the leftmost one if several k-mers have it.
+ * K-mers are compared in canonical form, ordered by a bijective mix of
+ * their value, so that both strands give the same minimizers and low
+ * complexity k-mers (AAA...) are not favoured.
+ * A sequence of fewer than w k-mers has no minimizer.
+ *
+ * The database keeps the minimizers of the targets, and only the
+ * minimizers of the reads are queried: the same positions are selected
+ * by the rolling window on the host (MinimizerWindow) and by one thread
+ * per k-mer in the query kernel (isPartMinimizer).
+ */
+
+#ifndef MINIMIZER_HH
+#define MINIMIZER_HH
+
+#include <stdint.h>
+#include "./dataType.hh"
+
+#define MINIMIZERMAXW		256		// largest window, in k-mers
+
+/**
+ * Order of a canonical k-mer (64-bit finalizer of MurmurHash3, bijective).
+ */
+HOSTDEVICE inline uint64_t minimizerOrder(uint64_t _kmerC)
+{
+	_kmerC ^= _kmerC >> 33;
+	_kmerC *= 0xff51afd7ed558ccdUL;
+	_kmerC ^= _kmerC >> 33;
+	_kmerC *= 0xc4ceb9fe1a85ec53UL;
+	_kmerC ^= _kmerC >> 33;
+	return _kmerC;
+}
+
+/**
+ * Order of the k-mer at position _pos of a read part (nucleotides in
+ * containers, from the most significant bits on).
+ */
+HOSTDEVICE inline uint64_t partKmerOrder(const CONTAINER* _part, const uint32_t _pos, const uint8_t _k)
+{
+	const uint32_t nucsPerCon = sizeof(CONTAINER)*4;
+	uint64_t kmer = 0;
+	for (uint32_t n = _pos; n < _pos + _k; n++)
+	{
+		CONTAINER nuc = _part[n/nucsPerCon] >> 2*(nucsPerCon-1-n%nucsPerCon);
+		kmer = (kmer << 2) | (nuc & 3);
+	}
+	return minimizerOrder(canonicalKmer(_k, kmer));
+}
+
+/**
+ * True if the k-mer at position _pos of a part of _numKmers k-mers is the
+ * minimizer of a window of _w k-mers, as selected by MinimizerWindow:
+ * it is if the k-mers of higher order before it and of higher or equal
+ * order after it, with itself, span a window.
+ */
+HOSTDEVICE inline bool isPartMinimizer(const CONTAINER* _part, const uint32_t _numKmers, const uint32_t _pos,
+									   const uint8_t _k, const uint32_t _w, const uint64_t _order)
+{
+	uint32_t span = 1;
+	for (uint32_t p = _pos; p > 0 && span < _w; p--, span++)
+	{
+		if (partKmerOrder(_part, p - 1, _k) <= _order)
+			break;
+	}
+	for (uint32_t p = _pos + 1; p < _numKmers && span < _w; p++, span++)
+	{
+		if (partKmerOrder(_part, p, _k) < _order)
+			break;
+	}
+	return span >= _w;
+}
+
+/**
+ * Minimizers of a sequence, k-mer by k-mer.
+ * Each minimizer is returned once, when it is selected the first time.
+ */
+class MinimizerWindow
+{
+	private:
+		uint32_t	m_w;
+		uint64_t	m_count;					// k-mers pushed
+		uint64_t	m_minPos;					// minimizer of the current window
+		uint64_t	m_lastPos;					// last minimizer returned
+		uint64_t	m_kmers[MINIMIZERMAXW];		// canonical k-mers of the window, by position % m_w
+		uint64_t	m_orders[MINIMIZERMAXW];
+
+	public:
+		MinimizerWindow(const uint32_t _w): m_w(_w)
+		{	reset();	}
+
+		/**
+		 * Start of a new sequence.
+		 */
+		void reset()
+		{
+			m_count = 0;
+			m_minPos = 0;
+			m_lastPos = (uint64_t) -1;
+		}
+
+		/**
+		 * Add the next canonical k-mer of the sequence.
+		 * Returns true with the minimizer if a new one is selected.
+		 */
+		bool push(const uint64_t _kmerC, uint64_t& _minimizer)
+		{
+			const uint64_t pos = m_count++;
+			m_kmers[pos % m_w] = _kmerC;
+			m_orders[pos % m_w] = minimizerOrder(_kmerC);
+
+			if (pos == 0 || m_orders[pos % m_w] < m_orders[m_minPos % m_w])
+			{	m_minPos = pos;	}
+			else if (m_minPos + m_w <= pos)
+			{	// minimizer left the window, leftmost lowest k-mer of the window
+				m_minPos = pos + 1 - m_w;
+				for (uint64_t p = m_minPos + 1; p <= pos; p++)
+				{
+					if (m_orders[p % m_w] < m_orders[m_minPos % m_w])
+					{	m_minPos = p;	}
+				}
+			}
+			if (m_count < m_w || m_minPos == m_lastPos)
+			{	return false;	}
+			m_lastPos = m_minPos;
+			_minimizer = m_kmers[m_minPos % m_w];
+			return true;
+		}
+};
+
+#endif
@@ -0,0 +1,291 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * K-mer occurrences file of the incremental database update, reading and writing.
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "./occFile.hh"
+
+using namespace std;
+
+/**
+ * Records start at the first multiple of 8 after the targets.
+ */
+static uint64_t recordsPosition(const uint64_t _targetsSize)
+{
+	return (sizeof(OccHeader) + _targetsSize + 7) / 8 * 8;
+}
+
+/**
+ * Size and modification time of a target file.
+ */
+bool getOccTarget(const std::string& _file, OccTarget& _target)
+{
+	struct stat st;
+	if (stat(_file.c_str(), &st) == -1)
+	{
+		cerr << "Failed to open " << _file << endl;
+		return false;
+	}
+	_target.file	= _file;
+	_target.size	= st.st_size;
+	_target.mtime	= st.st_mtime;
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+OccFile::OccFile(): m_fd(-1)
+{
+	memset(&m_header, 0, sizeof(OccHeader));
+}
+
+OccFile::~OccFile()
+{
+	close();
+}
+
+/**
+ * Open an occurrences file and read its targets.
+ * Files of other k-mer length or hash-table size are rejected.
+ */
+bool OccFile::open(const char* _filename, const uint8_t _k, const uint64_t _htSize)
+{
+	close();
+	m_filename = _filename;
+
+	m_fd = ::open(_filename, O_RDONLY);
+	if (m_fd == -1)
+	{	return false;	}
+	struct stat st;
+	if (fstat(m_fd, &st) == -1 || pread(m_fd, &m_header, sizeof(OccHeader), 0) != (ssize_t) sizeof(OccHeader))
+		return corrupt("file too small");
+
+	const OccHeader& h = m_header;
+	if (memcmp(h.magic, OCCMAGIC, sizeof(h.magic)) != 0)
+		return corrupt("not an occurrences file");
+	if (h.version != OCCVERSION || h.headerSize != sizeof(OccHeader) || h.recordSize != sizeof(BuildRecord))
+	{
+		cerr << "The occurrences file " << m_filename << " has format version " << h.version
+			 << ", this version of CuCLARK reads version " << OCCVERSION << "." << endl;
+		close();
+		return false;
+	}
+	if (h.k != _k || h.htSize != _htSize)
+	{
+		cerr << "The occurrences file " << m_filename << " does not match the database parameters." << endl;
+		close();
+		return false;
+	}
+	if (h.recordsPos != recordsPosition(h.targetsSize)
+		|| (uint64_t) st.st_size != h.recordsPos + h.numRecords * sizeof(BuildRecord))
+		return corrupt("bad sizes");
+
+	std::vector<char> lines(h.targetsSize + 1, 0);
+	if (pread(m_fd, &lines[0], h.targetsSize, sizeof(OccHeader)) != (ssize_t) h.targetsSize)
+		return corrupt("truncated targets");
+	const char* line = &lines[0];
+	for (uint64_t t = 0; t < h.numTargets; t++)
+	{
+		OccTarget target;
+		unsigned long size;
+		long mtime;
+		int pos = 0;
+		const char* end = strchr(line, '\n');
+		if (end == NULL || sscanf(line, "%lu %ld %n", &size, &mtime, &pos) < 2 || pos == 0 || line + pos > end)
+			return corrupt("bad targets");
+		target.file.assign(line + pos, end);
+		target.size = size;
+		target.mtime = mtime;
+		m_targets.push_back(target);
+		line = end + 1;
+	}
+	return true;
+}
+
+bool OccFile::corrupt(const char* _reason)
+{
+	cerr << "The occurrences file " << m_filename << " is corrupt (" << _reason << ")." << endl;
+	close();
+	return false;
+}
+
+void OccFile::close()
+{
+	if (m_fd != -1)
+	{
+		::close(m_fd);
+		m_fd = -1;
+	}
+	m_targets.clear();
+}
+
+/**
+ * The file descriptor, closed by the caller from now on.
+ */
+int OccFile::release()
+{
+	int fd = m_fd;
+	m_fd = -1;
+	return fd;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+OccWriter::OccWriter(): m_fd(-1), m_position(0), m_failed(false)
+{
+	memset(&m_header, 0, sizeof(OccHeader));
+}
+
+OccWriter::~OccWriter()
+{
+	// abandoned before close
+	if (m_fd != -1)
+	{
+		::close(m_fd);
+		unlink(m_tmpFilename.c_str());
+	}
+}
+
+/**
+ * Create the file and write the targets.
+ */
+bool OccWriter::open(const char* _filename, const uint8_t _k, const uint64_t _htSize,
+					 const std::vector<OccTarget>& _targets)
+{
+	m_filename = _filename;
+	m_tmpFilename = m_filename + ".tmp";
+
+	m_fd = ::open(m_tmpFilename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (m_fd == -1)
+	{
+		cerr << "Failed to create " << m_tmpFilename << endl;
+		return false;
+	}
+
+	string lines;
+	for (size_t t = 0; t < _targets.size(); t++)
+	{
+		char numbers[64];
+		sprintf(numbers, "%lu %ld ", (unsigned long) _targets[t].size, (long) _targets[t].mtime);
+		lines += numbers + _targets[t].file + "\n";
+	}
+
+	memset(&m_header, 0, sizeof(OccHeader));
+	memcpy(m_header.magic, OCCMAGIC, sizeof(m_header.magic));
+	m_header.version		= OCCVERSION;
+	m_header.headerSize		= sizeof(OccHeader);
+	m_header.recordSize		= sizeof(BuildRecord);
+	m_header.k				= _k;
+	m_header.htSize			= _htSize;
+	m_header.numTargets		= _targets.size();
+	m_header.targetsSize	= lines.size();
+	m_header.recordsPos		= recordsPosition(lines.size());
+
+	m_buffer.clear();
+	m_buffer.reserve(OCCWRITEBUFFER);
+	m_failed = false;
+	m_position = sizeof(OccHeader);
+	append(lines.data(), lines.size());
+	flush();
+	m_position = m_header.recordsPos;
+	return !m_failed;
+}
+
+void OccWriter::append(const void* _data, const size_t _size)
+{
+	const uint8_t* data = (const uint8_t*) _data;
+	m_buffer.insert(m_buffer.end(), data, data + _size);
+	if (m_buffer.size() >= OCCWRITEBUFFER)
+		flush();
+}
+
+bool OccWriter::flush()
+{
+	const uint8_t* data = m_buffer.data();
+	size_t size = m_buffer.size();
+	while (size > 0 && !m_failed)
+	{
+		ssize_t written = pwrite(m_fd, data, size, m_position);
+		if (written <= 0)
+		{
+			perror("Failed to write the occurrences file");
+			m_failed = true;
+			break;
+		}
+		data += written;
+		size -= written;
+		m_position += written;
+	}
+	m_buffer.clear();
+	return !m_failed;
+}
+
+/**
+ * Add records, in sorted order.
+ */
+void OccWriter::add(const std::vector<BuildRecord>& _records)
+{
+	append(_records.data(), _records.size() * sizeof(BuildRecord));
+	m_header.numRecords += _records.size();
+}
+
+/**
+ * Write remaining records and the header, rename to the final name.
+ */
+bool OccWriter::close()
+{
+	if (m_fd == -1)
+		return false;
+
+	flush();
+	if (!m_failed)
+	{
+		// header last, an incomplete file is never valid
+		m_position = 0;
+		append(&m_header, sizeof(OccHeader));
+		flush();
+	}
+
+	if (::close(m_fd) == -1)
+		m_failed = true;
+	m_fd = -1;
+
+	if (m_failed || rename(m_tmpFilename.c_str(), m_filename.c_str()) == -1)
+	{
+		unlink(m_tmpFilename.c_str());
+		cerr << "Failed to create " << m_filename << endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,143 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * K-mer occurrences file of the incremental database update (--update).
+ *
+ * Layout (native byte order):
+ *   header		OccHeader
+ *   targets	one line per target: "<size> <mtime> <file>\n"
+ *   records	numRecords * BuildRecord at recordsPos, sorted (bucket, key, target)
+ *
+ * The records are the occurrences of the k-mers in the targets, as merged
+ * for the database (buildRuns.hh), targets numbered in the order of the file.
+ * A target is identified by its file, size and modification time, a changed
+ * file counts as a removed and an added target. Labels are not stored, they
+ * are taken from the current targets definition.
+ */
+
+#ifndef OCCFILE_HH
+#define OCCFILE_HH
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include "./buildRuns.hh"
+
+#define OCCMAGIC			"CUCLARKO"
+#define OCCVERSION			1
+#define OCCWRITEBUFFER		(1 << 22)	// bytes buffered while writing
+
+struct OccHeader
+{
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	headerSize;
+	uint32_t	recordSize;
+	uint32_t	k;
+	uint64_t	htSize;
+	uint64_t	numTargets;
+	uint64_t	targetsSize;		// bytes of the targets lines
+	uint64_t	recordsPos;
+	uint64_t	numRecords;
+};
+
+/**
+ * Target file, as found when its k-mers were read.
+ */
+struct OccTarget
+{
+	std::string	file;
+	uint64_t	size;
+	int64_t		mtime;
+
+	bool operator==(const OccTarget& _t) const
+	{	return file == _t.file && size == _t.size && mtime == _t.mtime;	}
+};
+
+bool getOccTarget(const std::string& _file, OccTarget& _target);
+
+/**
+ * Occurrences file of a former creation, read by the runs of the update.
+ */
+class OccFile
+{
+	private:
+		int						m_fd;
+		OccHeader				m_header;
+		std::vector<OccTarget>	m_targets;
+		std::string				m_filename;
+
+		bool corrupt(const char* _reason);
+
+	public:
+		OccFile();
+
+		~OccFile();
+
+		bool open(const char* _filename, const uint8_t _k, const uint64_t _htSize);
+
+		void close();
+
+		int release();
+
+		const OccHeader& header() const
+		{	return m_header;	}
+
+		const std::vector<OccTarget>& targets() const
+		{	return m_targets;	}
+};
+
+/**
+ * Writes an occurrences file, records in sorted order.
+ * The file is written to <name>.tmp and renamed when complete.
+ */
+class OccWriter
+{
+	private:
+		int						m_fd;
+		OccHeader				m_header;
+		std::string				m_filename;
+		std::string				m_tmpFilename;
+		std::vector<uint8_t>	m_buffer;
+		uint64_t				m_position;
+		bool					m_failed;
+
+		void append(const void* _data, const size_t _size);
+		bool flush();
+
+	public:
+		OccWriter();
+
+		~OccWriter();
+
+		bool open(const char* _filename, const uint8_t _k, const uint64_t _htSize,
+				  const std::vector<OccTarget>& _targets);
+
+		void add(const std::vector<BuildRecord>& _records);
+
+		bool close();
+};
+
+#endif
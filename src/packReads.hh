@@ -0,0 +1,100 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * Packing of read bases into containers, eight bases at a time.
+ *
+ * Eight bytes of a read are loaded in one 64-bit word and handled in its
+ * bytes in parallel (SWAR): the word is checked to hold only nucleotides
+ * (ACGTU in both cases), their 2-bit codes are computed from bits 1-2 of
+ * the characters and gathered into one container, the first base in the
+ * most significant bits. The result is the same as the base by base
+ * packing with the reverse table (A 3, C 2, G 1, T/U 0).
+ * Words with any other character (N, newline, end of the part) are left
+ * to the base by base packing, which also is used on big-endian hosts.
+ */
+
+#ifndef PACKREADS_HH
+#define PACKREADS_HH
+
+#include <stdint.h>
+#include <string.h>
+
+#define PACKBASES		8		// bases per packed word
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define PACKREADS_SWAR
+#endif
+
+#ifdef PACKREADS_SWAR
+
+#define PACKBYTES(c)	((uint64_t) (c) * 0x0101010101010101UL)
+
+/**
+ * 0x80 in each zero byte of _word, 0 in the others.
+ */
+inline uint64_t packZeroBytes(const uint64_t _word)
+{
+	const uint64_t low = PACKBYTES(0x7F);
+	return ~(((_word & low) + low) | _word | low);
+}
+
+/**
+ * Pack the eight bases at _seq into _packed, if they all are nucleotides.
+ */
+inline bool packBases(const uint8_t* _seq, uint16_t& _packed)
+{
+	uint64_t word;
+	memcpy(&word, _seq, sizeof(word));
+
+	// upper case, only 'a'-'u' map to 'A'-'U'
+	const uint64_t upper = word & PACKBYTES(0xDF);
+	const uint64_t valid = packZeroBytes(upper ^ PACKBYTES('A')) | packZeroBytes(upper ^ PACKBYTES('C'))
+						 | packZeroBytes(upper ^ PACKBYTES('G')) | packZeroBytes(upper ^ PACKBYTES('T'))
+						 | packZeroBytes(upper ^ PACKBYTES('U'));
+	if (valid != PACKBYTES(0x80))
+		return false;
+
+	// bits 1-2 are A 0, C 1, G 3, T/U 2: gray decoded and reversed to A 3, C 2, G 1, T/U 0
+	uint64_t codes = (word >> 1) & PACKBYTES(3);
+	codes ^= ((codes >> 1) & PACKBYTES(1)) ^ PACKBYTES(3);
+
+	// first base in the most significant byte, then 2 bits per byte gathered
+	codes = __builtin_bswap64(codes);
+	codes = (codes | (codes >> 6)) & 0x000F000F000F000FUL;
+	codes = (codes | (codes >> 12)) & 0x000000FF000000FFUL;
+	_packed = (uint16_t) (codes | (codes >> 24));
+	return true;
+}
+
+#undef PACKBYTES
+
+#else
+
+inline bool packBases(const uint8_t* _seq, uint16_t& _packed)
+{	return false;	}
+
+#endif
+
+#endif
@@ -26,6 +26,7 @@
  * 
  * Changes:
  * Added additional defines.
+ * Settings of cuCLARK-l selected by LIGHTVERSION.
  */
 
 
@@ -36,16 +37,26 @@
 
 #define SB              4       
 #define LHTSIZE 	57777779
-#define HTSIZE  	1610612741
 #define NBN		1
 #define SFACTORMAX 	30
 
 //// new defines
+#ifdef LIGHTVERSION			// cuCLARK-l
+#define HTSIZE  	LHTSIZE		// default number of buckets, see --ht-size
+#define MAXHITS		23			// maximum number of targets per object, maximum hits in light test 10M was 21
+#define RESERVED	150000000	// reserved GPU memory for a batch
+#define DBPARTSPERDEVICE 1
+#else
+#define HTSIZE  	1610612741	// default number of buckets, see --ht-size
 #define MAXHITS		15			// maximum number of targets per object, maximum hits in normal test 10M was 10
 #define RESERVED	200000000	// reserved GPU memory for a batch
-#define OBJECTNAMEMAX	40		// maximum length for object names
-
 #define DBPARTSPERDEVICE 3
+#endif
+#define RESULTROWSIZE	(2*MAXHITS+2)	// results of an object: index and counter of each target hit, sum
+#define FINALROWSIZE	5		// final results of an object: sumN, indexBest, best, index_sBest, s_best
+#define OBJECTNAMEMAX	40		// maximum length for object names
+#define CHUNKSIZE	256			// default size of input chunks in MB
+#define MAXBATCHBYTES	(1UL << 31)	// maximum input per batch, keeps its container offsets in 32 bits
 ////
 
 typedef uint64_t      T64;
@@ -0,0 +1,125 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * Output of the results file, formatted per batch and written in order.
+ */
+
+#include <iostream>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "./resultWriter.hh"
+
+using namespace std;
+
+ResultWriter::ResultWriter():
+	m_fd(-1),
+	m_next(0),
+	m_failed(false)
+{
+}
+
+ResultWriter::~ResultWriter()
+{
+	close();
+}
+
+/**
+ * Open the results file to append the results of _batches batches.
+ */
+bool ResultWriter::open(const char* _filename, const size_t _batches)
+{
+	close();
+	m_fd = ::open(_filename, O_WRONLY | O_APPEND);
+	if (m_fd < 0)
+	{
+		cerr << "Failed to open file result: " << _filename << endl;
+		return false;
+	}
+	m_buffers.assign(_batches, string());
+	m_ready.assign(_batches, false);
+	m_next = 0;
+	m_failed = false;
+	return true;
+}
+
+bool ResultWriter::writeBuffer(const string& _buffer)
+{
+	size_t done = 0;
+	while (done < _buffer.size())
+	{
+		ssize_t n = ::write(m_fd, _buffer.data() + done, _buffer.size() - done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		done += n;
+	}
+	return true;
+}
+
+/**
+ * Hand over the results of a batch (_buffer is left empty),
+ * write them and the following batches ready if the batches before are written.
+ */
+void ResultWriter::put(const size_t _batchId, string& _buffer)
+{
+#ifdef _OPENMP
+	#pragma omp critical(resultWriter)
+#endif
+	{
+		m_buffers[_batchId].swap(_buffer);
+		m_ready[_batchId] = true;
+		while (m_next < m_buffers.size() && m_ready[m_next])
+		{
+			if (m_fd >= 0 && !m_failed && !writeBuffer(m_buffers[m_next]))
+			{
+				cerr << "Failed to write results." << endl;
+				m_failed = true;
+			}
+			string().swap(m_buffers[m_next]);
+			m_next++;
+		}
+	}
+	_buffer.clear();
+}
+
+/**
+ * Close the file, false if results could not be written.
+ */
+bool ResultWriter::close()
+{
+	bool success = !m_failed && m_next == m_buffers.size();
+	if (m_fd >= 0)
+	{
+		success = ::close(m_fd) == 0 && success;
+		m_fd = -1;
+	}
+	m_buffers.clear();
+	m_ready.clear();
+	m_next = 0;
+	return success;
+}
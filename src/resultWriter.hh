@@ -0,0 +1,183 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * Output of the results file, formatted per batch and written in order.
+ *
+ * The results of each batch are formatted into a buffer by the thread of
+ * the batch, and the buffers are written with one write() each, in the
+ * order of the batches, as soon as the batches before them are written.
+ * Numbers are formatted without stdio: unsigned integers as "%u", and
+ * doubles as "%g" with the same digits (exactly rounded to 6 significant
+ * digits, trailing zeros removed). Doubles printed in exponent style by
+ * "%g" (below 1e-4 or from 1e6), infinities and NaNs use snprintf.
+ */
+
+#ifndef RESULTWRITER_HH
+#define RESULTWRITER_HH
+
+#include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+#include <string>
+#include <vector>
+
+#define GDIGITS		6		// significant digits of "%g"
+
+/**
+ * Append _value as "%u".
+ */
+inline void appendUnsigned(std::string& _out, uint32_t _value)
+{
+	char digits[10];
+	size_t n = 0;
+	do
+	{
+		digits[n++] = '0' + _value % 10;
+		_value /= 10;
+	} while (_value > 0);
+	while (n > 0)
+		_out += digits[--n];
+}
+
+/**
+ * Format _value as "%g" in style f into _buffer, if it has this style.
+ * Return the length, 0 if the value is left to snprintf.
+ */
+inline size_t formatG(const double _value, char* _buffer)
+{
+	static const uint64_t pow10[] = {1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL, 1000000UL,
+									 10000000UL, 100000000UL, 1000000000UL, 10000000000UL};
+	size_t len = 0;
+	if (signbit(_value))
+		_buffer[len++] = '-';
+	const double a = fabs(_value);
+	if (a == 0)
+	{
+		_buffer[len++] = '0';
+		return len;
+	}
+	// also not finite
+	if (!(a >= 1e-5 && a < 1e6))
+		return 0;
+
+	// a = m / 2^q exactly
+	int e2;
+	const uint64_t m = (uint64_t) ldexp(frexp(a, &e2), 53);
+	const int q = 53 - e2;
+
+	// N = a * 10^(GDIGITS-1-X) rounded to nearest even, GDIGITS digits,
+	// X is the exponent of a in style e, after rounding
+	int x = (int) floor(log10(a));
+	uint64_t n;
+	while (true)
+	{
+		const int s = GDIGITS-1 - x;
+		if (s < 0 || s > 10)
+			return 0;
+		const unsigned __int128 p = (unsigned __int128) m * pow10[s];
+		const unsigned __int128 half = (unsigned __int128) 1 << (q-1);
+		const unsigned __int128 rem = p & ((half << 1) - 1);
+		n = (uint64_t) (p >> q);
+		if (rem > half || (rem == half && (n & 1)))
+			n++;
+		if (n < pow10[GDIGITS-1])
+			x--;
+		else if (n >= pow10[GDIGITS])
+			x++;
+		else
+			break;
+	}
+	// style e
+	if (x < -4 || x >= GDIGITS)
+		return 0;
+
+	char digits[GDIGITS];
+	for (int i = GDIGITS-1; i >= 0; i--, n /= 10)
+		digits[i] = '0' + n % 10;
+	// no trailing zeros
+	int last = GDIGITS-1;
+	while (last > x && last > 0 && digits[last] == '0')
+		last--;
+
+	if (x >= 0)
+	{
+		for (int i = 0; i <= x; i++)
+			_buffer[len++] = digits[i];
+		if (last > x)
+		{
+			_buffer[len++] = '.';
+			for (int i = x+1; i <= last; i++)
+				_buffer[len++] = digits[i];
+		}
+	}
+	else
+	{
+		_buffer[len++] = '0';
+		_buffer[len++] = '.';
+		for (int i = x+1; i < 0; i++)
+			_buffer[len++] = '0';
+		for (int i = 0; i <= last; i++)
+			_buffer[len++] = digits[i];
+	}
+	return len;
+}
+
+/**
+ * Append _value as "%g".
+ */
+inline void appendDouble(std::string& _out, const double _value)
+{
+	char buffer[32];
+	size_t len = formatG(_value, buffer);
+	if (len == 0)
+		len = snprintf(buffer, sizeof(buffer), "%g", _value);
+	_out.append(buffer, len);
+}
+
+class ResultWriter
+{
+	private:
+		int							m_fd;
+		// formatted batches waiting for the batches before them
+		std::vector<std::string>	m_buffers;
+		std::vector<bool>			m_ready;
+		size_t						m_next;
+		bool						m_failed;
+
+		bool writeBuffer(const std::string& _buffer);
+
+	public:
+		ResultWriter();
+
+		~ResultWriter();
+
+		bool open(const char* _filename, const size_t _batches);
+
+		void put(const size_t _batchId, std::string& _buffer);
+
+		bool close();
+};
+
+#endif
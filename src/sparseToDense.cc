@@ -0,0 +1,212 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * Conversion of sparse extended results (--sparse) to the extended results
+ * (--extended), with one column per target.
+ *
+ * The header of the sparse results names all targets in its column
+ * "Hits(T1;T2;...)", and each row has the targets hit with their score
+ * ("T2:5;T1:3"). The scores are written in the column of their target,
+ * in the order of the row, the other targets have a score of 0, as the
+ * classifier writes the extended results.
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <map>
+#include <string.h>
+
+using namespace std;
+
+#define OUTBUFFER	(1 << 22)	// bytes of output written at a time
+
+/**
+ * Split the last _count fields of _line (separated by ',') from the first ones.
+ * _fields gets the positions of the _count commas, from the left.
+ */
+static bool splitLast(const string& _line, const size_t _count, vector<size_t>& _fields)
+{
+	_fields.assign(_count, 0);
+	size_t pos = _line.size();
+	for (size_t f = _count; f > 0; f--)
+	{
+		if (pos == 0)
+			return false;
+		const size_t comma = _line.rfind(',', pos - 1);
+		if (comma == string::npos)
+			return false;
+		_fields[f-1] = comma;
+		pos = comma;
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 3)
+	{
+		cerr << "Usage: " << argv[0] << " <sparse results> <extended results>" << endl;
+		cerr << "Sparse results are written by cuCLARK with --sparse, the extended results are" << endl;
+		cerr << "written as with --extended." << endl;
+		exit(1);
+	}
+
+	FILE* fd_in = fopen(argv[1], "r");
+	if (fd_in == NULL)
+	{
+		cerr << "Failed to open sparse results: " << argv[1] << endl;
+		exit(-1);
+	}
+
+	// header: Object_ID,Hits(T1;T2;...),Gamma,Assignment,Score,Confidence
+	string line;
+	char* buffer = NULL;
+	size_t bufferSize = 0;
+	ssize_t len = getline(&buffer, &bufferSize, fd_in);
+	if (len <= 0)
+	{
+		cerr << "Failed to read the header of: " << argv[1] << endl;
+		exit(-1);
+	}
+	line.assign(buffer, len);
+	if (line[line.size()-1] == '\n')
+		line.resize(line.size()-1);
+
+	vector<size_t> fields;
+	const size_t open = line.find(",Hits(");
+	if (open == string::npos || !splitLast(line, 4, fields) || fields[0] == 0 || line[fields[0]-1] != ')'
+			|| open + 6 > fields[0] - 1)
+	{
+		cerr << "The file " << argv[1] << " has no sparse results (no column Hits(...))." << endl;
+		exit(-1);
+	}
+	vector<string> targets;
+	map<string, size_t> index;
+	for (size_t s = open + 6, e; s < fields[0]; s = e + 1)
+	{
+		e = line.find(';', s);
+		if (e == string::npos || e > fields[0] - 1)
+			e = fields[0] - 1;
+		const string name = line.substr(s, e - s);
+		// the first target of a name, as the column of the targets file
+		if (index.find(name) == index.end())
+			index[name] = targets.size();
+		targets.push_back(name);
+	}
+	const size_t numTargets = targets.size();
+
+	FILE* fd_out = fopen(argv[2], "w");
+	if (fd_out == NULL)
+	{
+		cerr << "Failed to create extended results: " << argv[2] << endl;
+		exit(-1);
+	}
+
+	string out;
+	out.reserve(OUTBUFFER + (1 << 16));
+	out += line.substr(0, open);
+	for (size_t t = 0; t < numTargets; t++)
+	{
+		out += ',';
+		out += targets[t];
+	}
+	out.append(line, fields[0], string::npos);
+	out += '\n';
+
+	string zeros;
+	for (size_t t = 0; t < numTargets; t++)
+		zeros += ",0";
+	size_t rows = 0;
+	while ((len = getline(&buffer, &bufferSize, fd_in)) > 0)
+	{
+		line.assign(buffer, len);
+		if (line[line.size()-1] == '\n')
+			line.resize(line.size()-1);
+		rows++;
+
+		// name, may have commas, hits, then four fields
+		if (!splitLast(line, 5, fields))
+		{
+			cerr << "Line " << rows + 1 << " of " << argv[1] << " has no sparse results." << endl;
+			exit(-1);
+		}
+		out.append(line, 0, fields[0]);
+
+		size_t writeIndex = 0;
+		for (size_t s = fields[0] + 1, e; s < fields[1]; s = e + 1)
+		{
+			e = line.find(';', s);
+			if (e == string::npos || e > fields[1])
+				e = fields[1];
+			const size_t colon = line.rfind(':', e - 1);
+			map<string, size_t>::const_iterator it;
+			if (colon == string::npos || colon < s
+					|| (it = index.find(line.substr(s, colon - s))) == index.end())
+			{
+				cerr << "Line " << rows + 1 << " of " << argv[1] << " has an unknown target hit: "
+					 << line.substr(s, e - s) << endl;
+				exit(-1);
+			}
+			// write zeros until target, then the score
+			const size_t targetIndex = it->second;
+			if (writeIndex < targetIndex)
+			{
+				out.append(zeros, 0, 2*(targetIndex-writeIndex));
+				writeIndex = targetIndex;
+			}
+			out += ',';
+			out.append(line, colon + 1, e - colon - 1);
+			writeIndex++;
+		}
+		// write zeros until end
+		if (writeIndex < numTargets)
+			out.append(zeros, 0, 2*(numTargets-writeIndex));
+
+		out.append(line, fields[1], string::npos);
+		out += '\n';
+		if (out.size() >= OUTBUFFER)
+		{
+			if (fwrite(out.data(), 1, out.size(), fd_out) != out.size())
+			{
+				cerr << "Failed to write extended results: " << argv[2] << endl;
+				exit(-1);
+			}
+			out.clear();
+		}
+	}
+	free(buffer);
+	fclose(fd_in);
+
+	if (fwrite(out.data(), 1, out.size(), fd_out) != out.size() || fclose(fd_out) != 0)
+	{
+		cerr << "Failed to write extended results: " << argv[2] << endl;
+		exit(-1);
+	}
+	cerr << rows << " results converted for " << numTargets << " targets." << endl;
+	return 0;
+}
@@ -0,0 +1,305 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * Binary targets-specific k-mers files, reading and writing.
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "./tskFile.hh"
+
+using namespace std;
+
+/**
+ * Positions of the sections for the given number of k-mers.
+ */
+static void layoutSections(TskHeader& _header)
+{
+	_header.kmersPos	= (sizeof(TskHeader) + 7) / 8 * 8;
+	_header.countsPos	= _header.kmersPos + _header.numKmers * sizeof(uint64_t);
+	_header.fileSize	= _header.countsPos + _header.numKmers * sizeof(ITYPE);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+TskFile::TskFile(): m_fd(-1), m_map(NULL), m_mapSize(0)
+{
+	memset(&m_header, 0, sizeof(TskHeader));
+}
+
+TskFile::~TskFile()
+{
+	close();
+}
+
+/**
+ * True if the file starts as a binary targets-specific k-mers file.
+ */
+bool TskFile::isBinary(const char* _filename)
+{
+	char magic[8];
+	FILE* fd = fopen(_filename, "r");
+	if (fd == NULL)
+		return false;
+	const bool binary = fread(magic, 1, sizeof(magic), fd) == sizeof(magic) && memcmp(magic, TSKMAGIC, sizeof(magic)) == 0;
+	fclose(fd);
+	return binary;
+}
+
+/**
+ * Map a targets-specific k-mers file and check its header.
+ */
+bool TskFile::open(const char* _filename, const uint8_t _k)
+{
+	close();
+	m_filename = _filename;
+
+	m_fd = ::open(_filename, O_RDONLY);
+	if (m_fd == -1)
+	{
+		cerr << "Failed to open " << _filename << endl;
+		return false;
+	}
+	struct stat st;
+	if (fstat(m_fd, &st) == -1 || (size_t) st.st_size < sizeof(TskHeader))
+		return corrupt("file too small");
+	m_mapSize = st.st_size;
+	void* map = mmap(0, m_mapSize, PROT_READ, MAP_SHARED, m_fd, 0);
+	if (map == MAP_FAILED)
+	{
+		cerr << "Failed to map " << _filename << endl;
+		::close(m_fd);
+		m_fd = -1;
+		return false;
+	}
+	m_map = (uint8_t*) map;
+	memcpy(&m_header, m_map, sizeof(TskHeader));
+
+	const TskHeader& h = m_header;
+	if (memcmp(h.magic, TSKMAGIC, sizeof(h.magic)) != 0)
+		return corrupt("not a targets-specific k-mers file");
+	if (h.version != TSKVERSION || h.headerSize != sizeof(TskHeader) || h.countBytes != sizeof(ITYPE))
+	{
+		cerr << "The file " << m_filename << " has format version " << h.version
+			 << ", this version of CuCLARK reads version " << TSKVERSION << "." << endl;
+		close();
+		return false;
+	}
+	if (h.k != _k)
+	{
+		cerr << "The file " << m_filename << " has " << h.k << "-mers, expected " << (size_t) _k << "-mers." << endl;
+		close();
+		return false;
+	}
+	TskHeader expected = h;
+	layoutSections(expected);
+	if (h.htSize == 0 || h.numKmers > m_mapSize || expected.kmersPos != h.kmersPos
+		|| expected.countsPos != h.countsPos || expected.fileSize != h.fileSize || h.fileSize != m_mapSize)
+		return corrupt("bad sizes");
+
+	madvise(m_map, m_mapSize, MADV_WILLNEED);
+	return true;
+}
+
+bool TskFile::corrupt(const char* _reason)
+{
+	cerr << "The file " << m_filename << " is corrupt (" << _reason << ")." << endl;
+	close();
+	return false;
+}
+
+void TskFile::close()
+{
+	if (m_map != NULL)
+	{
+		munmap(m_map, m_mapSize);
+		m_map = NULL;
+	}
+	if (m_fd != -1)
+	{
+		::close(m_fd);
+		m_fd = -1;
+	}
+	m_mapSize = 0;
+}
+
+/**
+ * First k-mer of a bucket >= _bucket, for a table of the size of the file.
+ */
+uint64_t TskFile::lowerBound(const HtSize& _htSize, const uint64_t _bucket) const
+{
+	const uint64_t* kmers = this->kmers();
+	uint64_t first = 0, count = m_header.numKmers;
+	while (count > 0)
+	{
+		const uint64_t half = count / 2;
+		if (_htSize.remainder(kmers[first + half]) < _bucket)
+		{
+			first += half + 1;
+			count -= half + 1;
+		}
+		else
+			count = half;
+	}
+	return first;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+TskWriter::TskWriter(): m_fd(-1), m_kmers(0), m_failed(false)
+{
+	memset(&m_header, 0, sizeof(TskHeader));
+}
+
+TskWriter::~TskWriter()
+{
+	// abandoned before close
+	if (m_fd != -1)
+	{
+		::close(m_fd);
+		unlink(m_tmpFilename.c_str());
+	}
+}
+
+/**
+ * Create the file and place the sections.
+ */
+bool TskWriter::open(const char* _filename, const uint8_t _k, const uint64_t _htSize, const uint64_t _numKmers)
+{
+	m_filename = _filename;
+	m_tmpFilename = m_filename + ".tmp";
+
+	m_fd = ::open(m_tmpFilename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (m_fd == -1)
+	{
+		cerr << "Failed to create " << m_tmpFilename << endl;
+		return false;
+	}
+
+	memset(&m_header, 0, sizeof(TskHeader));
+	memcpy(m_header.magic, TSKMAGIC, sizeof(m_header.magic));
+	m_header.version	= TSKVERSION;
+	m_header.headerSize	= sizeof(TskHeader);
+	m_header.k			= _k;
+	m_header.countBytes	= sizeof(ITYPE);
+	m_header.htSize		= _htSize;
+	m_header.numKmers	= _numKmers;
+	layoutSections(m_header);
+
+	m_positions[0] = m_header.kmersPos;
+	m_positions[1] = m_header.countsPos;
+	for (int s = 0; s < 2; s++)
+	{
+		m_buffers[s].clear();
+		m_buffers[s].reserve(TSKWRITEBUFFER);
+	}
+	m_kmers = 0;
+	m_failed = false;
+	return true;
+}
+
+void TskWriter::append(const int _section, const void* _data, const size_t _size)
+{
+	const uint8_t* data = (const uint8_t*) _data;
+	m_buffers[_section].insert(m_buffers[_section].end(), data, data + _size);
+	if (m_buffers[_section].size() >= TSKWRITEBUFFER)
+		flush(_section);
+}
+
+bool TskWriter::flush(const int _section)
+{
+	const uint8_t* data = m_buffers[_section].data();
+	size_t size = m_buffers[_section].size();
+	while (size > 0 && !m_failed)
+	{
+		ssize_t written = pwrite(m_fd, data, size, m_positions[_section]);
+		if (written <= 0)
+		{
+			perror("Failed to write the targets-specific k-mers");
+			m_failed = true;
+			break;
+		}
+		data += written;
+		size -= written;
+		m_positions[_section] += written;
+	}
+	m_buffers[_section].clear();
+	return !m_failed;
+}
+
+/**
+ * Add a k-mer, in the order of the buckets.
+ */
+void TskWriter::add(const uint64_t _kmer, const ITYPE _count)
+{
+	append(0, &_kmer, sizeof(uint64_t));
+	append(1, &_count, sizeof(ITYPE));
+	m_kmers++;
+}
+
+/**
+ * Write remaining k-mers and the header, rename to the final name.
+ */
+bool TskWriter::close()
+{
+	if (m_fd == -1)
+		return false;
+
+	for (int s = 0; s < 2; s++)
+		flush(s);
+
+	if (m_kmers != m_header.numKmers)
+	{
+		cerr << "Failed to write " << m_filename << ": " << m_kmers << " k-mers written, expected "
+			 << m_header.numKmers << "." << endl;
+		m_failed = true;
+	}
+	if (!m_failed)
+	{
+		// header last, an incomplete file is never valid
+		m_positions[0] = 0;
+		append(0, &m_header, sizeof(TskHeader));
+		flush(0);
+	}
+
+	if (::close(m_fd) == -1)
+		m_failed = true;
+	m_fd = -1;
+
+	if (m_failed || rename(m_tmpFilename.c_str(), m_filename.c_str()) == -1)
+	{
+		unlink(m_tmpFilename.c_str());
+		cerr << "Failed to create " << m_filename << endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,137 @@
+/*
+   CuCLARK, CLARK for CUDA-enabled GPUs.
+
+   based on CLARK version 1.1.3, CLAssifier based on Reduced K-mers.
+   Copyright 2013-2016, Rachid Ounit <rouni001@cs.ucr.edu>
+
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * @project: CuCLARK, Metagenomic Classification with CUDA-enabled GPUs
+ *
+ * New file:
+ * Binary targets-specific k-mers files (--tsk), one per label (<label>_k<k>.ht).
+ *
+ * Layout (native byte order):
+ *   header		TskHeader
+ *   k-mers		numKmers * uint64_t at kmersPos, canonical k-mers
+ *   counts		numKmers * ITYPE at countsPos
+ *
+ * The k-mers are in the order of their buckets (k-mer % htSize) in a table
+ * of htSize buckets, as written from the database creation. A table of the
+ * same size is filled by ranges of buckets in parallel, a range is found in
+ * each file by binary search.
+ *
+ * Files of the former text format ("<k-mer index> <count> <k-mer>" lines)
+ * are still read, see EHashtable::Load.
+ */
+
+#ifndef TSKFILE_HH
+#define TSKFILE_HH
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include "./dataType.hh"
+
+#define TSKMAGIC			"CUCLARKT"
+#define TSKVERSION			1
+#define TSKWRITEBUFFER		(1 << 16)	// bytes buffered per section while writing, files are written together
+
+struct TskHeader
+{
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	headerSize;
+	uint32_t	k;
+	uint32_t	countBytes;
+	uint64_t	htSize;				// buckets of the order of the k-mers
+	uint64_t	numKmers;
+	uint64_t	kmersPos;
+	uint64_t	countsPos;
+	uint64_t	fileSize;
+};
+
+/**
+ * Read-only, memory-mapped targets-specific k-mers file.
+ */
+class TskFile
+{
+	private:
+		int				m_fd;
+		uint8_t*		m_map;
+		size_t			m_mapSize;
+		TskHeader		m_header;
+		std::string		m_filename;
+
+		bool corrupt(const char* _reason);
+
+	public:
+		TskFile();
+
+		~TskFile();
+
+		bool open(const char* _filename, const uint8_t _k);
+
+		void close();
+
+		const TskHeader& header() const
+		{	return m_header;	}
+
+		const uint64_t* kmers() const
+		{	return (const uint64_t*) (m_map + m_header.kmersPos);	}
+
+		const ITYPE* counts() const
+		{	return (const ITYPE*) (m_map + m_header.countsPos);	}
+
+		uint64_t lowerBound(const HtSize& _htSize, const uint64_t _bucket) const;
+
+		static bool isBinary(const char* _filename);
+};
+
+/**
+ * Writes a targets-specific k-mers file, k-mers in the order of their buckets.
+ * The number of k-mers must be known in advance to place the sections.
+ * The file is written to <name>.tmp and renamed when complete.
+ */
+class TskWriter
+{
+	private:
+		int						m_fd;
+		TskHeader				m_header;
+		std::string				m_filename;
+		std::string				m_tmpFilename;
+		uint64_t				m_kmers;
+		std::vector<uint8_t>	m_buffers[2];	// k-mers, counts
+		uint64_t				m_positions[2];
+		bool					m_failed;
+
+		void append(const int _section, const void* _data, const size_t _size);
+		bool flush(const int _section);
+
+	public:
+		TskWriter();
+
+		~TskWriter();
+
+		bool open(const char* _filename, const uint8_t _k, const uint64_t _htSize, const uint64_t _numKmers);
+
+		void add(const uint64_t _kmer, const ITYPE _count);
+
+		bool close();
+};
+
+#endif